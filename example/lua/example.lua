@@ -10,7 +10,7 @@ void sf_destroy_engine(SF_Engine* engine);
 SF_ErrorCode sf_create_value_node(SF_Engine* engine, const char* name, double value);
 SF_ErrorCode sf_get_node_value(SF_Engine* engine, const char* name, double* out_value);
 
-const char* sf_last_error(void);
+const char* sf_engine_last_error(SF_Engine* engine);
 ]])
 
 local lib = ffi.load("build/src/libStatForge.so")
@@ -30,12 +30,12 @@ local nodeValue = ffi.new("double[1]")
 local err = lib.sf_get_node_value(engine, lifeNodeName, nodeValue)
 
 if tonumber(err) ~= SF_OK then
-    io.write(string.format("Error: %s\n", ffi.string(lib.sf_last_error())))
+    io.write(string.format("Error: %s\n", ffi.string(lib.sf_engine_last_error(engine))))
 else
     io.write(string.format("Val: %.0f\n", tonumber(nodeValue[0])))
 end
 
 lib.sf_create_value_node(engine, lifeNodeName, 100.0)
-io.write(string.format("Error: %s\n", ffi.string(lib.sf_last_error())))
+io.write(string.format("Error: %s\n", ffi.string(lib.sf_engine_last_error(engine))))
 
 lib.sf_destroy_engine(engine)
@@ -1,10 +1,59 @@
 #include "c.h"
+#include "dsl/functions.hpp"
 #include "runtime/engine.hpp"
+#include "runtime/engine_group.hpp"
+#include "stat_kernel/sheet.hpp"
+#include "stat_kernel/snapshot.hpp"
+
+#include <cmath>
+#include <format>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+static_assert(SF_VARIADIC == statforge::dsl::variadic);
+
+// last error of a handle without an engine, kept like the errors of engines. mutable, reading
+// handles can fail too
+struct HandleError {
+    std::optional<statforge::ErrorInfo> last;
+    std::string reported;
+};
 
 struct SF_Engine {
     statforge::runtime::EngineImpl engine;
 };
 
+struct SF_Sheet {
+    std::shared_ptr<statforge::statkernel::Sheet const> sheet;
+};
+
+struct SF_SheetInstance {
+    statforge::statkernel::SheetInstance instance;
+    mutable HandleError error;
+};
+
+struct SF_EntityBatch {
+    statforge::statkernel::SheetBatch batch;
+    mutable HandleError error;
+};
+
+struct SF_EngineFork {
+    statforge::statkernel::SheetFork fork;
+    mutable HandleError error;
+};
+
+struct SF_EngineGroup {
+    statforge::runtime::EngineGroup group;
+    mutable HandleError error;
+};
+
+struct SF_Snapshot {
+    std::shared_ptr<statforge::statkernel::Snapshot const> snapshot;
+    mutable HandleError error;
+};
+
 namespace {
 
 SF_ErrorCode validateEngine(SF_Engine* engine) {
@@ -15,12 +64,118 @@ SF_ErrorCode validateEngine(SF_Engine* engine) {
     return SF_ERR_INVALID_ENGINE_HANDLE;
 }
 
-SF_ErrorCode validateStringArg(const char* value, const char* name) {
+// "engine" has to be valid, the error is reported to it
+SF_ErrorCode validateArg(SF_Engine* engine, const void* value, const char* name) {
     if (value != nullptr) {
         return SF_OK;
     }
+    return engine->engine.fail(SF_ERR_INTERNAL_INVALID_ENGINE_STATE,
+                               std::format("{} is null", name));
+}
+
+// node names of batch calls, empty if any of them is null
+std::vector<statforge::NodeId> collectNames(SF_Engine* engine,
+                                            const char* const* names,
+                                            std::size_t count,
+                                            const char* argName) {
+    if (count > 0 && validateArg(engine, names, argName) != SF_OK) {
+        return {};
+    }
+
+    std::vector<statforge::NodeId> collected;
+    collected.reserve(count);
+    for (auto const* name : std::span{names, count}) {
+        if (validateArg(engine, name, argName) != SF_OK) {
+            return {};
+        }
+        collected.emplace_back(name);
+    }
+    return collected;
+}
+
+// null handles and queueing threads have nowhere else to report to, they use the thread
+// local error
+SF_ErrorCode validateHandle(const void* handle, const char* name) {
+    if (handle != nullptr) {
+        return SF_OK;
+    }
     sf_set_error("%s is null", name);
-    return SF_ERR_INTERNAL_INVALID_ENGINE_STATE;
+    return SF_ERR_INVALID_ENGINE_HANDLE;
+}
+
+// instances, batches, forks, groups and snapshots keep their own last error. "handle" has to
+// be valid
+template <typename Handle>
+SF_ErrorCode reportError(Handle const* handle, statforge::ErrorInfo error) {
+    handle->error.last = std::move(error);
+    return handle->error.last->errorCode;
+}
+
+template <typename Handle>
+SF_ErrorCode validateHandleArg(Handle const* handle, const void* value, const char* name) {
+    if (value != nullptr) {
+        return SF_OK;
+    }
+    return reportError(
+        handle, statforge::buildErrorInfo(SF_ERR_INVALID_ENGINE_HANDLE, std::format("{} is null", name)));
+}
+
+// same as sf_engine_last_error() for handles
+template <typename Handle>
+const char* lastError(Handle const* handle) {
+    if (handle == nullptr) {
+        return sf_last_error();
+    }
+    auto& error = handle->error;
+    error.reported = error.last ? std::move(error.last->message) : std::string{};
+    error.last.reset();
+    return error.reported.c_str();
+}
+
+SF_ErrorCode validateBuffer(SF_Engine* engine,
+                            const void* buffer,
+                            std::size_t count,
+                            const char* name) {
+    if (count == 0) {
+        return SF_OK;
+    }
+    return validateArg(engine, buffer, name);
+}
+
+// changes of a scored candidate, empty with the error reported to "engine" if any is invalid
+std::optional<std::vector<statforge::statkernel::Command>>
+collectChanges(SF_Engine* engine, SF_Candidate const& candidate) {
+    if (validateBuffer(engine, candidate.changes, candidate.count, "changes") != SF_OK) {
+        return std::nullopt;
+    }
+
+    std::vector<statforge::statkernel::Command> changes;
+    changes.reserve(candidate.count);
+    for (auto const& change : std::span{candidate.changes, candidate.count}) {
+        if (validateArg(engine, change.name, "name") != SF_OK) {
+            return std::nullopt;
+        }
+        if (change.type == SF_CHANGE_SET_VALUE) {
+            changes.emplace_back(statforge::statkernel::SetValueCommand{change.name, change.value});
+            continue;
+        }
+        if (validateArg(engine, change.member, "member") != SF_OK) {
+            return std::nullopt;
+        }
+        if (change.type == SF_CHANGE_ADD_MEMBER) {
+            changes.emplace_back(
+                statforge::statkernel::AddMemberCommand{change.name, change.member});
+        } else if (change.type == SF_CHANGE_REMOVE_MEMBER) {
+            changes.emplace_back(
+                statforge::statkernel::RemoveMemberCommand{change.name, change.member});
+        } else {
+            engine->engine.fail(
+                SF_ERR_INTERNAL_INVALID_ENGINE_STATE,
+                std::format("Unknown change type {}", static_cast<int>(change.type)));
+            return std::nullopt;
+        }
+    }
+    return changes;
 }
 
 } // namespace
@@ -39,40 +194,111 @@ SF_ErrorCode sf_create_collection_node(SF_Engine* engine,
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
     return engine->engine.createCollectionNode(name, operation);
 }
 
+SF_ErrorCode sf_create_query_collection_node(SF_Engine* engine,
+                                             const char* name,
+                                             const char* query,
+                                             SF_CollectionOperation operation) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, query, "query"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.createQueryCollectionNode(name, query, operation);
+}
+
 SF_ErrorCode sf_create_formula_node(SF_Engine* engine, const char* name, const char* formula) {
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(formula, "formula"); code != SF_OK) {
+    if (auto code = validateArg(engine, formula, "formula"); code != SF_OK) {
         return code;
     }
     return engine->engine.createFormulaNode(name, formula);
 }
 
+SF_ErrorCode sf_create_modifier_node(SF_Engine* engine,
+                                     const char* name,
+                                     const char* base,
+                                     const char* increased,
+                                     const char* more) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, base, "base"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, increased, "increased"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, more, "more"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.createModifierNode(name, base, increased, more);
+}
+
 SF_ErrorCode sf_create_value_node(SF_Engine* engine, const char* name, double value) {
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
     return engine->engine.createValueNode(name, value);
 }
 
+SF_ErrorCode sf_create_formula_template(SF_Engine* engine, const char* name, const char* formula) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, formula, "formula"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.createFormulaTemplate(name, formula);
+}
+
+SF_ErrorCode sf_create_template_node(SF_Engine* engine,
+                                     const char* name,
+                                     const char* template_name,
+                                     const char* bindings) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, template_name, "template_name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, bindings, "bindings"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.createTemplateNode(name, template_name, bindings);
+}
+
 SF_ErrorCode sf_remove_node(SF_Engine* engine, const char* name) {
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
     return engine->engine.removeNode(name);
@@ -82,7 +308,7 @@ SF_ErrorCode sf_set_node_value(SF_Engine* engine, const char* name, double value
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
     return engine->engine.setNodeValue(name, value);
@@ -92,10 +318,10 @@ SF_ErrorCode sf_set_node_formula(SF_Engine* engine, const char* name, const char
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(formula, "formula"); code != SF_OK) {
+    if (auto code = validateArg(engine, formula, "formula"); code != SF_OK) {
         return code;
     }
     return engine->engine.setNodeFormula(name, formula);
@@ -105,26 +331,122 @@ SF_ErrorCode sf_set_node_dependency(SF_Engine* engine, const char* name, const c
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(dependencies, "dependencies"); code != SF_OK) {
+    if (auto code = validateArg(engine, dependencies, "dependencies"); code != SF_OK) {
         return code;
     }
     return engine->engine.setNodeDependency(name, dependencies);
 }
 
-SF_ErrorCode sf_get_node_value(SF_Engine* engine, const char* name, double* out_value) {
+SF_ErrorCode sf_set_modifier_node_groups(SF_Engine* engine,
+                                         const char* name,
+                                         const char* base,
+                                         const char* increased,
+                                         const char* more) {
     if (auto code = validateEngine(engine); code != SF_OK) {
         return code;
     }
-    if (auto code = validateStringArg(name, "name"); code != SF_OK) {
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
         return code;
     }
-    if (out_value == nullptr) {
-        sf_set_error("out_value is null");
+    if (auto code = validateArg(engine, base, "base"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, increased, "increased"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, more, "more"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.setModifierNodeGroups(name, base, increased, more);
+}
+
+SF_ErrorCode sf_add_collection_member(SF_Engine* engine, const char* name, const char* member) {
+    return sf_add_collection_members(engine, name, &member, 1);
+}
+
+SF_ErrorCode sf_add_collection_members(SF_Engine* engine,
+                                       const char* name,
+                                       const char* const* members,
+                                       size_t count) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    auto names = collectNames(engine, members, count, "members");
+    if (names.size() != count) {
         return SF_ERR_INTERNAL_INVALID_ENGINE_STATE;
     }
+    return engine->engine.addCollectionMembers(name, names);
+}
+
+SF_ErrorCode sf_remove_collection_member(SF_Engine* engine, const char* name, const char* member) {
+    return sf_remove_collection_members(engine, name, &member, 1);
+}
+
+SF_ErrorCode sf_remove_collection_members(SF_Engine* engine,
+                                          const char* name,
+                                          const char* const* members,
+                                          size_t count) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    auto names = collectNames(engine, members, count, "members");
+    if (names.size() != count) {
+        return SF_ERR_INTERNAL_INVALID_ENGINE_STATE;
+    }
+    return engine->engine.removeCollectionMembers(name, names);
+}
+
+SF_ErrorCode sf_add_gated_collection_member(SF_Engine* engine,
+                                            const char* name,
+                                            const char* member,
+                                            const char* gate) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, member, "member"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, gate, "gate"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.addGatedCollectionMember(name, member, gate);
+}
+
+SF_ErrorCode sf_set_node_tags(SF_Engine* engine, const char* name, const char* tags) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, tags, "tags"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.setNodeTags(name, tags);
+}
+
+SF_ErrorCode sf_get_node_value(SF_Engine* engine, const char* name, double* out_value) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, out_value, "out_value"); code != SF_OK) {
+        return code;
+    }
     return engine->engine.getNodeValue(name, *out_value);
 }
 
@@ -143,6 +465,119 @@ SF_Value sf_get_node_value2(SF_Engine* engine, const char* name) {
     return result;
 }
 
+SF_ErrorCode sf_get_node_value_view(SF_Engine* engine, const char* name, const double** out_view) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, out_view, "out_view"); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.getNodeValueView(name, *out_view);
+}
+
+uint64_t sf_get_clean_epoch(SF_Engine* engine) {
+    if (validateEngine(engine) != SF_OK) {
+        return 0;
+    }
+    return engine->engine.getCleanEpoch();
+}
+
+SF_ErrorCode sf_set_node_values(SF_Engine* engine,
+                                const char* const* names,
+                                const double* values,
+                                size_t count,
+                                SF_ErrorCode* out_errors) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateBuffer(engine, values, count, "values"); code != SF_OK) {
+        return code;
+    }
+    auto collected = collectNames(engine, names, count, "names");
+    if (collected.size() != count) {
+        return SF_ERR_INTERNAL_INVALID_ENGINE_STATE;
+    }
+    return engine->engine.setNodeValues(
+        collected,
+        std::span{values, count},
+        out_errors == nullptr ? std::span<SF_ErrorCode>{} : std::span{out_errors, count});
+}
+
+SF_ErrorCode sf_get_node_values(SF_Engine* engine,
+                                const char* const* names,
+                                double* out_values,
+                                size_t count,
+                                SF_ErrorCode* out_errors) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateBuffer(engine, out_values, count, "out_values"); code != SF_OK) {
+        return code;
+    }
+    auto collected = collectNames(engine, names, count, "names");
+    if (collected.size() != count) {
+        return SF_ERR_INTERNAL_INVALID_ENGINE_STATE;
+    }
+    return engine->engine.getNodeValues(
+        collected,
+        std::span{out_values, count},
+        out_errors == nullptr ? std::span<SF_ErrorCode>{} : std::span{out_errors, count});
+}
+
+SF_ErrorCode sf_register_function(SF_Engine* engine,
+                                  const char* name,
+                                  SF_Function function,
+                                  void* user_data,
+                                  size_t min_arguments,
+                                  size_t max_arguments,
+                                  int pure) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (function == nullptr) {
+        return engine->engine.fail(SF_ERR_INVALID_FUNCTION, "function is null");
+    }
+    return engine->engine.registerFunction(
+        name,
+        [function, user_data](std::span<double const> args) {
+            return function(args.data(), args.size(), user_data);
+        },
+        min_arguments,
+        max_arguments,
+        pure != 0);
+}
+
+void sf_set_formula_cache_capacity(SF_Engine* engine, size_t capacity) {
+    if (validateEngine(engine) != SF_OK) {
+        return;
+    }
+    engine->engine.setFormulaCacheCapacity(capacity);
+}
+
+SF_ErrorCode sf_get_formula_cache_stats(SF_Engine* engine, SF_FormulaCacheStats* out_stats) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateArg(engine, out_stats, "out_stats"); code != SF_OK) {
+        return code;
+    }
+    *out_stats = engine->engine.getFormulaCacheStats();
+    return SF_OK;
+}
+
+const char* sf_engine_last_error(SF_Engine* engine) {
+    if (engine == nullptr) {
+        return sf_last_error();
+    }
+    return engine->engine.lastErrorMessage();
+}
+
 void sf_reset_engine(SF_Engine* engine) {
     if (validateEngine(engine) != SF_OK) {
         return;
@@ -156,3 +591,427 @@ void sf_evaluate_engine(SF_Engine* engine) {
     }
     engine->engine.evaluate();
 }
+
+SF_Sheet* sf_compile_sheet(SF_Engine* engine) {
+    if (validateEngine(engine) != SF_OK) {
+        return nullptr;
+    }
+    auto sheet = engine->engine.compileSheet();
+    if (!sheet) {
+        return nullptr;
+    }
+    return new SF_Sheet{std::move(sheet)};
+}
+
+void sf_release_sheet(SF_Sheet* sheet) {
+    delete sheet;
+}
+
+SF_SheetInstance* sf_create_sheet_instance(SF_Sheet* sheet) {
+    if (validateHandle(sheet, "sheet") != SF_OK) {
+        return nullptr;
+    }
+    return new SF_SheetInstance{statforge::statkernel::SheetInstance{sheet->sheet}, {}};
+}
+
+void sf_destroy_sheet_instance(SF_SheetInstance* instance) {
+    delete instance;
+}
+
+SF_ErrorCode sf_set_instance_value(SF_SheetInstance* instance, const char* name, double value) {
+    if (auto code = validateHandle(instance, "instance"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(instance, name, "name"); code != SF_OK) {
+        return code;
+    }
+    auto result = instance->instance.setNodeValue(name, value);
+    return result ? SF_OK : reportError(instance, std::move(result).error());
+}
+
+SF_ErrorCode sf_get_instance_value(SF_SheetInstance* instance,
+                                   const char* name,
+                                   double* out_value) {
+    if (auto code = validateHandle(instance, "instance"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(instance, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(instance, out_value, "out_value"); code != SF_OK) {
+        return code;
+    }
+    auto result = instance->instance.getNodeValue(name);
+    if (!result) {
+        return reportError(instance, std::move(result).error());
+    }
+    *out_value = *result;
+    return SF_OK;
+}
+
+void sf_evaluate_instance(SF_SheetInstance* instance) {
+    if (validateHandle(instance, "instance") != SF_OK) {
+        return;
+    }
+    instance->instance.evaluate();
+}
+
+const char* sf_instance_last_error(SF_SheetInstance* instance) {
+    return lastError(instance);
+}
+
+SF_EntityBatch* sf_create_entity_batch(SF_Engine* engine, size_t entities) {
+    if (validateEngine(engine) != SF_OK) {
+        return nullptr;
+    }
+    auto sheet = engine->engine.compileSheet();
+    if (!sheet) {
+        return nullptr;
+    }
+    return new SF_EntityBatch{statforge::statkernel::SheetBatch{std::move(sheet), entities}, {}};
+}
+
+void sf_destroy_entity_batch(SF_EntityBatch* batch) {
+    delete batch;
+}
+
+SF_ErrorCode sf_set_entity_value(SF_EntityBatch* batch,
+                                 size_t entity,
+                                 const char* name,
+                                 double value) {
+    if (auto code = validateHandle(batch, "batch"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(batch, name, "name"); code != SF_OK) {
+        return code;
+    }
+    auto result = batch->batch.setNodeValue(entity, name, value);
+    return result ? SF_OK : reportError(batch, std::move(result).error());
+}
+
+SF_ErrorCode sf_get_entity_value(SF_EntityBatch* batch,
+                                 size_t entity,
+                                 const char* name,
+                                 double* out_value) {
+    if (auto code = validateHandle(batch, "batch"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(batch, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(batch, out_value, "out_value"); code != SF_OK) {
+        return code;
+    }
+    auto result = batch->batch.getNodeValue(entity, name);
+    if (!result) {
+        return reportError(batch, std::move(result).error());
+    }
+    *out_value = *result;
+    return SF_OK;
+}
+
+void sf_evaluate_entity_batch(SF_EntityBatch* batch) {
+    if (validateHandle(batch, "batch") != SF_OK) {
+        return;
+    }
+    batch->batch.evaluate();
+}
+
+const char* sf_entity_batch_last_error(SF_EntityBatch* batch) {
+    return lastError(batch);
+}
+
+SF_ErrorCode sf_score_candidates(SF_Engine* engine,
+                                 const SF_Candidate* candidates,
+                                 size_t candidate_count,
+                                 const char* const* targets,
+                                 size_t target_count,
+                                 double* out_deltas) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    auto const deltas = candidate_count * target_count;
+    if (auto code = validateBuffer(engine, out_deltas, deltas, "out_deltas"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateBuffer(engine, candidates, candidate_count, "candidates");
+        code != SF_OK) {
+        return code;
+    }
+    auto collectedTargets = collectNames(engine, targets, target_count, "targets");
+    if (collectedTargets.size() != target_count) {
+        return SF_ERR_INTERNAL_INVALID_ENGINE_STATE;
+    }
+
+    std::vector<std::vector<statforge::statkernel::Command>> collected;
+    collected.reserve(candidate_count);
+    for (auto const& candidate : std::span{candidates, candidate_count}) {
+        auto changes = collectChanges(engine, candidate);
+        if (!changes) {
+            return SF_ERR_INTERNAL_INVALID_ENGINE_STATE;
+        }
+        collected.push_back(std::move(*changes));
+    }
+    return engine->engine.scoreCandidates(
+        collected, collectedTargets, std::span{out_deltas, deltas});
+}
+
+SF_EngineFork* sf_fork_engine(SF_Engine* engine) {
+    if (validateEngine(engine) != SF_OK) {
+        return nullptr;
+    }
+    auto fork = engine->engine.fork();
+    if (!fork) {
+        return nullptr;
+    }
+    return new SF_EngineFork{std::move(*fork), {}};
+}
+
+SF_EngineFork* sf_copy_fork(const SF_EngineFork* fork) {
+    if (validateHandle(fork, "fork") != SF_OK) {
+        return nullptr;
+    }
+    return new SF_EngineFork{fork->fork, {}};
+}
+
+void sf_destroy_fork(SF_EngineFork* fork) {
+    delete fork;
+}
+
+SF_ErrorCode sf_set_fork_value(SF_EngineFork* fork, const char* name, double value) {
+    if (auto code = validateHandle(fork, "fork"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(fork, name, "name"); code != SF_OK) {
+        return code;
+    }
+    auto result = fork->fork.setNodeValue(name, value);
+    return result ? SF_OK : reportError(fork, std::move(result).error());
+}
+
+SF_ErrorCode sf_add_fork_member(SF_EngineFork* fork, const char* name, const char* member) {
+    if (auto code = validateHandle(fork, "fork"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(fork, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(fork, member, "member"); code != SF_OK) {
+        return code;
+    }
+    auto result = fork->fork.addCollectionMember(name, member);
+    return result ? SF_OK : reportError(fork, std::move(result).error());
+}
+
+SF_ErrorCode sf_remove_fork_member(SF_EngineFork* fork, const char* name, const char* member) {
+    if (auto code = validateHandle(fork, "fork"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(fork, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(fork, member, "member"); code != SF_OK) {
+        return code;
+    }
+    auto result = fork->fork.removeCollectionMember(name, member);
+    return result ? SF_OK : reportError(fork, std::move(result).error());
+}
+
+SF_ErrorCode sf_get_fork_value(SF_EngineFork* fork, const char* name, double* out_value) {
+    if (auto code = validateHandle(fork, "fork"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(fork, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(fork, out_value, "out_value"); code != SF_OK) {
+        return code;
+    }
+    auto result = fork->fork.getNodeValue(name);
+    if (!result) {
+        return reportError(fork, std::move(result).error());
+    }
+    *out_value = *result;
+    return SF_OK;
+}
+
+void sf_evaluate_fork(SF_EngineFork* fork) {
+    if (validateHandle(fork, "fork") != SF_OK) {
+        return;
+    }
+    fork->fork.evaluate();
+}
+
+const char* sf_fork_last_error(SF_EngineFork* fork) {
+    return lastError(fork);
+}
+
+SF_ErrorCode sf_queue_set_node_value(SF_Engine* engine, const char* name, double value) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandle(name, "name"); code != SF_OK) {
+        return code;
+    }
+    engine->engine.queueCommand(statforge::statkernel::SetValueCommand{name, value});
+    return SF_OK;
+}
+
+SF_ErrorCode sf_queue_set_node_formula(SF_Engine* engine, const char* name, const char* formula) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandle(name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandle(formula, "formula"); code != SF_OK) {
+        return code;
+    }
+    engine->engine.queueCommand(statforge::statkernel::SetFormulaCommand{name, formula});
+    return SF_OK;
+}
+
+SF_ErrorCode sf_queue_add_collection_member(SF_Engine* engine,
+                                            const char* name,
+                                            const char* member) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandle(name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandle(member, "member"); code != SF_OK) {
+        return code;
+    }
+    engine->engine.queueCommand(statforge::statkernel::AddMemberCommand{name, member});
+    return SF_OK;
+}
+
+SF_ErrorCode sf_queue_remove_collection_member(SF_Engine* engine,
+                                               const char* name,
+                                               const char* member) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandle(name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandle(member, "member"); code != SF_OK) {
+        return code;
+    }
+    engine->engine.queueCommand(statforge::statkernel::RemoveMemberCommand{name, member});
+    return SF_OK;
+}
+
+SF_ErrorCode sf_apply_commands(SF_Engine* engine) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.applyCommands();
+}
+
+SF_EngineGroup* sf_create_engine_group(void) {
+    return new SF_EngineGroup{};
+}
+
+void sf_destroy_engine_group(SF_EngineGroup* group) {
+    delete group;
+}
+
+SF_ErrorCode sf_group_add_engine(SF_EngineGroup* group, SF_Engine* engine) {
+    if (auto code = validateHandle(group, "group"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(group, engine, "engine"); code != SF_OK) {
+        return code;
+    }
+    group->group.add(engine->engine);
+    return SF_OK;
+}
+
+SF_ErrorCode sf_group_remove_engine(SF_EngineGroup* group, SF_Engine* engine) {
+    if (auto code = validateHandle(group, "group"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(group, engine, "engine"); code != SF_OK) {
+        return code;
+    }
+    group->group.remove(engine->engine);
+    return SF_OK;
+}
+
+SF_ErrorCode sf_group_evaluate(SF_EngineGroup* group, size_t threads) {
+    if (auto code = validateHandle(group, "group"); code != SF_OK) {
+        return code;
+    }
+    group->group.evaluate(threads);
+    return SF_OK;
+}
+
+const char* sf_group_last_error(SF_EngineGroup* group) {
+    return lastError(group);
+}
+
+SF_ErrorCode sf_publish_snapshot(SF_Engine* engine) {
+    if (auto code = validateEngine(engine); code != SF_OK) {
+        return code;
+    }
+    return engine->engine.publishSnapshot();
+}
+
+SF_Snapshot* sf_acquire_snapshot(SF_Engine* engine) {
+    if (validateEngine(engine) != SF_OK) {
+        return nullptr;
+    }
+    auto snapshot = engine->engine.latestSnapshot();
+    if (!snapshot) {
+        return nullptr;
+    }
+    return new SF_Snapshot{std::move(snapshot), {}};
+}
+
+void sf_release_snapshot(SF_Snapshot* snapshot) {
+    delete snapshot;
+}
+
+uint64_t sf_snapshot_version(const SF_Snapshot* snapshot) {
+    if (validateHandle(snapshot, "snapshot") != SF_OK) {
+        return 0;
+    }
+    return snapshot->snapshot->version();
+}
+
+SF_ErrorCode sf_snapshot_find(const SF_Snapshot* snapshot,
+                              const char* name,
+                              SF_SnapshotHandle* out_handle) {
+    if (auto code = validateHandle(snapshot, "snapshot"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(snapshot, name, "name"); code != SF_OK) {
+        return code;
+    }
+    if (auto code = validateHandleArg(snapshot, out_handle, "out_handle"); code != SF_OK) {
+        return code;
+    }
+    auto const handle = snapshot->snapshot->find(name);
+    if (!handle) {
+        return reportError(
+            snapshot,
+            statforge::buildErrorInfo(
+                SF_ERR_NODE_NOT_FOUND,
+                std::format(R"(Trying to find non-existing node "{}")", name)));
+    }
+    *out_handle = *handle;
+    return SF_OK;
+}
+
+double sf_snapshot_value(const SF_Snapshot* snapshot, SF_SnapshotHandle handle) {
+    if (validateHandle(snapshot, "snapshot") != SF_OK) {
+        return std::nan("");
+    }
+    return snapshot->snapshot->value(handle);
+}
+
+const char* sf_snapshot_last_error(const SF_Snapshot* snapshot) {
+    return lastError(snapshot);
+}
@@ -7,7 +7,50 @@ extern "C" {
 #include "../error/error.h"
 #include "../types/collection_operation.h"
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef struct SF_Engine SF_Engine;
+typedef struct SF_Sheet SF_Sheet;
+typedef struct SF_SheetInstance SF_SheetInstance;
+typedef struct SF_EntityBatch SF_EntityBatch;
+typedef struct SF_EngineFork SF_EngineFork;
+typedef struct SF_Snapshot SF_Snapshot;
+typedef struct SF_EngineGroup SF_EngineGroup;
+typedef uint32_t SF_SnapshotHandle;
+
+// host function callable from formulas. "user_data" is passed through unchanged.
+typedef double (*SF_Function)(const double* args, size_t count, void* user_data);
+
+// max_arguments of functions without an upper bound
+#define SF_VARIADIC ((size_t)-1)
+
+typedef enum SF_ChangeType {
+    SF_CHANGE_SET_VALUE,
+    SF_CHANGE_ADD_MEMBER,
+    SF_CHANGE_REMOVE_MEMBER,
+} SF_ChangeType;
+
+// one change of a scored candidate. "name" is the node or the collection, "member" is only used
+// by membership changes and "value" only by value changes
+typedef struct SF_Change {
+    SF_ChangeType type;
+    const char* name;
+    const char* member;
+    double value;
+} SF_Change;
+
+typedef struct SF_Candidate {
+    const SF_Change* changes;
+    size_t count;
+} SF_Candidate;
+
+typedef struct SF_FormulaCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t size;
+    size_t capacity;
+} SF_FormulaCacheStats;
 
 SF_Engine* sf_create_engine(void);
 void sf_destroy_engine(SF_Engine*);
@@ -15,18 +58,213 @@ void sf_destroy_engine(SF_Engine*);
 SF_ErrorCode sf_create_collection_node(SF_Engine* engine,
                                        const char* name,
                                        SF_CollectionOperation operation);
+// members are all tagged nodes matching "query", e.g. "tag:FlatLife & !disabled"
+SF_ErrorCode sf_create_query_collection_node(SF_Engine* engine,
+                                             const char* name,
+                                             const char* query,
+                                             SF_CollectionOperation operation);
 SF_ErrorCode sf_create_formula_node(SF_Engine* engine, const char* name, const char* formula);
+// sum(base) * (1 + sum(increased)) * product(1 + more). every group is a comma or whitespace
+// separated list, a node can only be part of one group
+SF_ErrorCode sf_create_modifier_node(SF_Engine* engine,
+                                     const char* name,
+                                     const char* base,
+                                     const char* increased,
+                                     const char* more);
 SF_ErrorCode sf_create_value_node(SF_Engine* engine, const char* name, double value);
+// "bindings" is a comma or whitespace separated list, bound to <$0>, <$1>, ... in order
+SF_ErrorCode sf_create_formula_template(SF_Engine* engine, const char* name, const char* formula);
+SF_ErrorCode sf_create_template_node(SF_Engine* engine,
+                                     const char* name,
+                                     const char* template_name,
+                                     const char* bindings);
 SF_ErrorCode sf_remove_node(SF_Engine* engine, const char* name);
 SF_ErrorCode sf_set_node_value(SF_Engine* engine, const char* name, double value);
 SF_ErrorCode sf_set_node_formula(SF_Engine* engine, const char* name, const char* formula);
 SF_ErrorCode sf_set_node_dependency(SF_Engine* engine, const char* name, const char* dependencies);
+SF_ErrorCode sf_set_modifier_node_groups(SF_Engine* engine,
+                                         const char* name,
+                                         const char* base,
+                                         const char* increased,
+                                         const char* more);
+// changes single members instead of replacing the whole list. batches of "count" names are
+// applied completely or not at all
+SF_ErrorCode sf_add_collection_member(SF_Engine* engine, const char* name, const char* member);
+SF_ErrorCode sf_add_collection_members(SF_Engine* engine,
+                                       const char* name,
+                                       const char* const* members,
+                                       size_t count);
+SF_ErrorCode sf_remove_collection_member(SF_Engine* engine, const char* name, const char* member);
+SF_ErrorCode sf_remove_collection_members(SF_Engine* engine,
+                                          const char* name,
+                                          const char* const* members,
+                                          size_t count);
+// "member" only takes part while "gate" is non-zero and not NaN, e.g. a "low life" flag node
+SF_ErrorCode sf_add_gated_collection_member(SF_Engine* engine,
+                                            const char* name,
+                                            const char* member,
+                                            const char* gate);
+// "tags" is a comma or whitespace separated list replacing the current tags
+SF_ErrorCode sf_set_node_tags(SF_Engine* engine, const char* name, const char* tags);
 SF_ErrorCode sf_get_node_value(SF_Engine* engine, const char* name, double* out_value);
 SF_Value sf_get_node_value2(SF_Engine* engine, const char* name);
+// address of the value of "name" inside the engine, read without any call. it stays valid
+// until the node is removed or the engine is reset, and holds the current value whenever the
+// clean epoch is even, e.g. right after sf_evaluate_engine
+SF_ErrorCode sf_get_node_value_view(SF_Engine* engine, const char* name, const double** out_view);
+// even while all nodes are clean after sf_evaluate_engine, odd once anything changed since.
+// an unchanged even epoch means no value changed and views can be skipped
+uint64_t sf_get_clean_epoch(SF_Engine* engine);
+// batches of "count" nodes in one call. every entry is handled on its own, "out_errors" is
+// either NULL or receives one code per entry. the first failure is returned
+SF_ErrorCode sf_set_node_values(SF_Engine* engine,
+                                const char* const* names,
+                                const double* values,
+                                size_t count,
+                                SF_ErrorCode* out_errors);
+SF_ErrorCode sf_get_node_values(SF_Engine* engine,
+                                const char* const* names,
+                                double* out_values,
+                                size_t count,
+                                SF_ErrorCode* out_errors);
+
+// functions can't be replaced and survive sf_reset_engine().
+// impure functions (pure == 0) are called on every evaluation and never folded.
+SF_ErrorCode sf_register_function(SF_Engine* engine,
+                                  const char* name,
+                                  SF_Function function,
+                                  void* user_data,
+                                  size_t min_arguments,
+                                  size_t max_arguments,
+                                  int pure);
+
+// compiled formulas are shared by their normalized text, capacity 0 disables the cache.
+// the cache survives sf_reset_engine().
+void sf_set_formula_cache_capacity(SF_Engine* engine, size_t capacity);
+SF_ErrorCode sf_get_formula_cache_stats(SF_Engine* engine, SF_FormulaCacheStats* out_stats);
+
+// message of the last failing call on "engine", reading it consumes it. the pointer stays
+// valid until the next call on "engine". errors are kept per engine, engines on different
+// threads don't interfere. calls without a valid engine report to sf_last_error(), so do
+// calls without a valid instance, batch, fork, group or snapshot
+const char* sf_engine_last_error(SF_Engine* engine);
 
 void sf_reset_engine(SF_Engine* engine);
 void sf_evaluate_engine(SF_Engine* engine);
 
+// evaluates "engine" and freezes its nodes into a sheet shared by any number of instances.
+// later changes to the engine don't reach the sheet. NULL on failure
+SF_Sheet* sf_compile_sheet(SF_Engine* engine);
+// instances keep their sheet alive, it can be released while they're still in use
+void sf_release_sheet(SF_Sheet* sheet);
+// values of one entity, starting at the values the engine had when the sheet was compiled.
+// instances keep their own last error and must not be used by several threads at once
+SF_SheetInstance* sf_create_sheet_instance(SF_Sheet* sheet);
+void sf_destroy_sheet_instance(SF_SheetInstance* instance);
+SF_ErrorCode sf_set_instance_value(SF_SheetInstance* instance, const char* name, double value);
+// only evaluates what "name" depends on
+SF_ErrorCode sf_get_instance_value(SF_SheetInstance* instance,
+                                   const char* name,
+                                   double* out_value);
+void sf_evaluate_instance(SF_SheetInstance* instance);
+// like sf_engine_last_error() for instances
+const char* sf_instance_last_error(SF_SheetInstance* instance);
+
+// evaluates "engine" and creates "entities" copies of its nodes, stored side by side and
+// evaluated together. later changes to the engine don't reach the batch. NULL on failure.
+// batches keep their own last error and must not be used by several threads at once
+SF_EntityBatch* sf_create_entity_batch(SF_Engine* engine, size_t entities);
+void sf_destroy_entity_batch(SF_EntityBatch* batch);
+SF_ErrorCode sf_set_entity_value(SF_EntityBatch* batch,
+                                 size_t entity,
+                                 const char* name,
+                                 double value);
+// evaluates the dirty nodes "name" depends on for all entities
+SF_ErrorCode sf_get_entity_value(SF_EntityBatch* batch,
+                                 size_t entity,
+                                 const char* name,
+                                 double* out_value);
+void sf_evaluate_entity_batch(SF_EntityBatch* batch);
+const char* sf_entity_batch_last_error(SF_EntityBatch* batch);
+
+// evaluates "engine" and creates a copy-on-write child of it for what-if evaluation. the fork
+// reads the values of the engine until it diverges and only reevaluates what diverged, later
+// changes to the engine don't reach it. NULL on failure.
+// forks keep their own last error and must not be used by several threads at once
+SF_EngineFork* sf_fork_engine(SF_Engine* engine);
+// child of "fork" including its changes. "fork" is only read, so several threads may copy the
+// same fork as long as nobody changes or reads it meanwhile. the copy starts without an error
+SF_EngineFork* sf_copy_fork(const SF_EngineFork* fork);
+void sf_destroy_fork(SF_EngineFork* fork);
+SF_ErrorCode sf_set_fork_value(SF_EngineFork* fork, const char* name, double value);
+// membership changes only "fork" sees. added members are never gated
+SF_ErrorCode sf_add_fork_member(SF_EngineFork* fork, const char* name, const char* member);
+SF_ErrorCode sf_remove_fork_member(SF_EngineFork* fork, const char* name, const char* member);
+// only evaluates what "name" depends on
+SF_ErrorCode sf_get_fork_value(SF_EngineFork* fork, const char* name, double* out_value);
+void sf_evaluate_fork(SF_EngineFork* fork);
+const char* sf_fork_last_error(SF_EngineFork* fork);
+
+// scores alternative changes against the current values of "engine" without applying any of
+// them. "out_deltas" receives candidate_count * target_count values, one row of targets per
+// candidate: the value of the target with the candidate minus its current value. only nodes
+// that any candidate can affect on the way to the targets are evaluated. rows of failing
+// candidates are NaN and the first failure is returned
+SF_ErrorCode sf_score_candidates(SF_Engine* engine,
+                                 const SF_Candidate* candidates,
+                                 size_t candidate_count,
+                                 const char* const* targets,
+                                 size_t target_count,
+                                 double* out_deltas);
+
+// queue changes to "engine" without blocking. unlike every other call on "engine" they may be
+// used from other threads while the owning thread keeps using the engine, nothing changes
+// until the owning thread calls sf_apply_commands(). queueing runs on other threads than the
+// engine and reports to sf_last_error()
+SF_ErrorCode sf_queue_set_node_value(SF_Engine* engine, const char* name, double value);
+SF_ErrorCode sf_queue_set_node_formula(SF_Engine* engine, const char* name, const char* formula);
+SF_ErrorCode sf_queue_add_collection_member(SF_Engine* engine,
+                                            const char* name,
+                                            const char* member);
+SF_ErrorCode sf_queue_remove_collection_member(SF_Engine* engine,
+                                               const char* name,
+                                               const char* member);
+// applies the queued changes in order. of several value or formula changes to one node only
+// the last is applied. failing changes are skipped, the first failure is returned
+SF_ErrorCode sf_apply_commands(SF_Engine* engine);
+
+// evaluates many independent engines together on a thread pool. every engine keeps its thread
+// between calls as long as the group and the thread count don't change, idle threads steal
+// work from busy ones. engines of a group must not be used elsewhere while it's evaluated
+// and have to be removed before they are destroyed. groups keep their own last error
+SF_EngineGroup* sf_create_engine_group(void);
+void sf_destroy_engine_group(SF_EngineGroup* group);
+// adding an engine twice or removing one that isn't part of the group does nothing
+SF_ErrorCode sf_group_add_engine(SF_EngineGroup* group, SF_Engine* engine);
+SF_ErrorCode sf_group_remove_engine(SF_EngineGroup* group, SF_Engine* engine);
+// evaluates every engine of "group" with pending changes on "threads" threads including the
+// calling one, 0 uses one thread per core. evaluation errors are reported to the engines
+SF_ErrorCode sf_group_evaluate(SF_EngineGroup* group, size_t threads);
+const char* sf_group_last_error(SF_EngineGroup* group);
+
+// evaluates "engine" and publishes the values of all its nodes for reader threads
+SF_ErrorCode sf_publish_snapshot(SF_Engine* engine);
+// latest published snapshot, NULL before the first. unlike every other call on "engine" it
+// may be used from other threads while the owning thread keeps using the engine, only
+// destroying the engine has to wait for it. snapshots stay readable until released and keep
+// their own last error, every thread acquires its own
+SF_Snapshot* sf_acquire_snapshot(SF_Engine* engine);
+void sf_release_snapshot(SF_Snapshot* snapshot);
+// increases with every publish
+uint64_t sf_snapshot_version(const SF_Snapshot* snapshot);
+// handles stay valid for every later snapshot of the engine until it's reset
+SF_ErrorCode sf_snapshot_find(const SF_Snapshot* snapshot,
+                              const char* name,
+                              SF_SnapshotHandle* out_handle);
+// NaN for nodes removed since the handle was found
+double sf_snapshot_value(const SF_Snapshot* snapshot, SF_SnapshotHandle handle);
+const char* sf_snapshot_last_error(const SF_Snapshot* snapshot);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,11 @@
 #include "cpp.hpp"
 #include "runtime/engine.hpp"
+#include "runtime/engine_group.hpp"
+#include "stat_kernel/sheet.hpp"
+#include "stat_kernel/snapshot.hpp"
+
+#include <utility>
+#include <vector>
 
 namespace statforge {
 
@@ -17,14 +23,37 @@ SF_ErrorCode Engine::createCollectionNode(std::string const& name,
     return _impl->createCollectionNode(name, operation);
 }
 
+SF_ErrorCode Engine::createQueryCollectionNode(std::string const& name,
+                                               std::string const& query,
+                                               SF_CollectionOperation operation) {
+    return _impl->createQueryCollectionNode(name, query, operation);
+}
+
 SF_ErrorCode Engine::createFormulaNode(std::string const& name, std::string const& formula) {
     return _impl->createFormulaNode(name, formula);
 }
 
+SF_ErrorCode Engine::createModifierNode(std::string const& name,
+                                        std::string const& base,
+                                        std::string const& increased,
+                                        std::string const& more) {
+    return _impl->createModifierNode(name, base, increased, more);
+}
+
 SF_ErrorCode Engine::createValueNode(std::string const& name, double value) {
     return _impl->createValueNode(name, value);
 }
 
+SF_ErrorCode Engine::createFormulaTemplate(std::string const& name, std::string const& formula) {
+    return _impl->createFormulaTemplate(name, formula);
+}
+
+SF_ErrorCode Engine::createTemplateNode(std::string const& name,
+                                        std::string const& templateName,
+                                        std::string const& bindings) {
+    return _impl->createTemplateNode(name, templateName, bindings);
+}
+
 SF_ErrorCode Engine::removeNode(std::string const& name) {
     return _impl->removeNode(name);
 }
@@ -41,10 +70,85 @@ SF_ErrorCode Engine::setNodeDependency(std::string const& name, std::string cons
     return _impl->setNodeDependency(name, dependencies);
 }
 
+SF_ErrorCode Engine::setModifierNodeGroups(std::string const& name,
+                                           std::string const& base,
+                                           std::string const& increased,
+                                           std::string const& more) {
+    return _impl->setModifierNodeGroups(name, base, increased, more);
+}
+
+SF_ErrorCode Engine::addCollectionMember(std::string const& name, std::string const& member) {
+    return _impl->addCollectionMembers(name, std::span{&member, 1});
+}
+
+SF_ErrorCode Engine::addCollectionMembers(std::string const& name,
+                                          std::span<std::string const> members) {
+    return _impl->addCollectionMembers(name, members);
+}
+
+SF_ErrorCode Engine::removeCollectionMember(std::string const& name, std::string const& member) {
+    return _impl->removeCollectionMembers(name, std::span{&member, 1});
+}
+
+SF_ErrorCode Engine::removeCollectionMembers(std::string const& name,
+                                             std::span<std::string const> members) {
+    return _impl->removeCollectionMembers(name, members);
+}
+
+SF_ErrorCode Engine::addGatedCollectionMember(std::string const& name,
+                                              std::string const& member,
+                                              std::string const& gate) {
+    return _impl->addGatedCollectionMember(name, member, gate);
+}
+
+SF_ErrorCode Engine::setNodeTags(std::string const& name, std::string const& tags) {
+    return _impl->setNodeTags(name, tags);
+}
+
 SF_ErrorCode Engine::getNodeValue(std::string const& name, double& value) const {
     return _impl->getNodeValue(name, value);
 }
 
+void Engine::evaluate() {
+    _impl->evaluate();
+}
+
+SF_ErrorCode Engine::getNodeValueView(std::string const& name, double const*& view) const {
+    return _impl->getNodeValueView(name, view);
+}
+
+std::uint64_t Engine::getCleanEpoch() const {
+    return _impl->getCleanEpoch();
+}
+
+SF_ErrorCode Engine::setNodeValues(std::span<std::string const> names,
+                                   std::span<double const> values,
+                                   std::span<SF_ErrorCode> errors) {
+    return _impl->setNodeValues(names, values, errors);
+}
+
+SF_ErrorCode Engine::getNodeValues(std::span<std::string const> names,
+                                   std::span<double> values,
+                                   std::span<SF_ErrorCode> errors) const {
+    return _impl->getNodeValues(names, values, errors);
+}
+
+SF_ErrorCode Engine::registerFunction(std::string const& name,
+                                      std::function<double(std::span<double const>)> function,
+                                      std::size_t minArguments,
+                                      std::size_t maxArguments,
+                                      bool pure) {
+    return _impl->registerFunction(name, std::move(function), minArguments, maxArguments, pure);
+}
+
+void Engine::setFormulaCacheCapacity(std::size_t capacity) {
+    _impl->setFormulaCacheCapacity(capacity);
+}
+
+SF_FormulaCacheStats Engine::getFormulaCacheStats() const {
+    return _impl->getFormulaCacheStats();
+}
+
 SF_ErrorCode Engine::createRule(std::string const& /*name*/,
                                 std::string const& /*action*/,
                                 double /*initValue*/) {
@@ -68,4 +172,213 @@ std::string Engine::getLastError() {
     return _impl->getLastError();
 }
 
+std::optional<EntityBatch> Engine::createEntityBatch(std::size_t entities) {
+    auto sheet = _impl->compileSheet();
+    if (!sheet) {
+        return std::nullopt;
+    }
+    return EntityBatch{std::make_unique<statkernel::SheetBatch>(std::move(sheet), entities)};
+}
+
+EntityBatch::EntityBatch(std::unique_ptr<statkernel::SheetBatch> batch)
+    : _batch(std::move(batch)) {
+}
+
+EntityBatch::~EntityBatch() = default;
+
+EntityBatch::EntityBatch(EntityBatch&& other) noexcept = default;
+
+EntityBatch& EntityBatch::operator=(EntityBatch&& other) noexcept = default;
+
+std::size_t EntityBatch::entities() const {
+    return _batch->entities();
+}
+
+SF_ErrorCode EntityBatch::setNodeValue(std::size_t entity, std::string const& name, double value) {
+    auto result = _batch->setNodeValue(entity, name, value);
+    if (!result) {
+        _lastError = std::move(result.error().message);
+        return result.error().errorCode;
+    }
+    return SF_OK;
+}
+
+SF_ErrorCode EntityBatch::getNodeValue(std::size_t entity, std::string const& name, double& value) {
+    auto result = _batch->getNodeValue(entity, name);
+    if (!result) {
+        _lastError = std::move(result.error().message);
+        return result.error().errorCode;
+    }
+    value = *result;
+    return SF_OK;
+}
+
+void EntityBatch::evaluate() {
+    _batch->evaluate();
+}
+
+std::string EntityBatch::getLastError() {
+    return std::exchange(_lastError, {});
+}
+
+std::optional<EngineFork> Engine::fork() {
+    auto fork = _impl->fork();
+    if (!fork) {
+        return std::nullopt;
+    }
+    return EngineFork{std::make_unique<statkernel::SheetFork>(std::move(*fork))};
+}
+
+SF_ErrorCode Engine::scoreCandidates(std::span<std::vector<CandidateChange> const> candidates,
+                                     std::span<std::string const> targets,
+                                     std::span<double> deltas) {
+    std::vector<std::vector<statkernel::Command>> commands(candidates.size());
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        commands[i].reserve(candidates[i].size());
+        for (auto const& change : candidates[i]) {
+            switch (change.type) {
+            case SF_CHANGE_SET_VALUE:
+                commands[i].emplace_back(statkernel::SetValueCommand{change.name, change.value});
+                break;
+            case SF_CHANGE_ADD_MEMBER:
+                commands[i].emplace_back(statkernel::AddMemberCommand{change.name, change.member});
+                break;
+            case SF_CHANGE_REMOVE_MEMBER:
+                commands[i].emplace_back(
+                    statkernel::RemoveMemberCommand{change.name, change.member});
+                break;
+            }
+        }
+    }
+    return _impl->scoreCandidates(commands, targets, deltas);
+}
+
+EngineFork::EngineFork(std::unique_ptr<statkernel::SheetFork> fork) : _fork(std::move(fork)) {
+}
+
+EngineFork::~EngineFork() = default;
+
+EngineFork::EngineFork(EngineFork&& other) noexcept = default;
+
+EngineFork& EngineFork::operator=(EngineFork&& other) noexcept = default;
+
+EngineFork EngineFork::fork() const {
+    return EngineFork{std::make_unique<statkernel::SheetFork>(*_fork)};
+}
+
+SF_ErrorCode EngineFork::setNodeValue(std::string const& name, double value) {
+    auto result = _fork->setNodeValue(name, value);
+    if (!result) {
+        _lastError = std::move(result.error().message);
+        return result.error().errorCode;
+    }
+    return SF_OK;
+}
+
+SF_ErrorCode EngineFork::addCollectionMember(std::string const& name, std::string const& member) {
+    auto result = _fork->addCollectionMember(name, member);
+    if (!result) {
+        _lastError = std::move(result.error().message);
+        return result.error().errorCode;
+    }
+    return SF_OK;
+}
+
+SF_ErrorCode EngineFork::removeCollectionMember(std::string const& name,
+                                                std::string const& member) {
+    auto result = _fork->removeCollectionMember(name, member);
+    if (!result) {
+        _lastError = std::move(result.error().message);
+        return result.error().errorCode;
+    }
+    return SF_OK;
+}
+
+SF_ErrorCode EngineFork::getNodeValue(std::string const& name, double& value) {
+    auto result = _fork->getNodeValue(name);
+    if (!result) {
+        _lastError = std::move(result.error().message);
+        return result.error().errorCode;
+    }
+    value = *result;
+    return SF_OK;
+}
+
+void EngineFork::evaluate() {
+    _fork->evaluate();
+}
+
+std::string EngineFork::getLastError() {
+    return std::exchange(_lastError, {});
+}
+
+void Engine::queueSetNodeValue(std::string const& name, double value) {
+    _impl->queueCommand(statkernel::SetValueCommand{name, value});
+}
+
+void Engine::queueSetNodeFormula(std::string const& name, std::string const& formula) {
+    _impl->queueCommand(statkernel::SetFormulaCommand{name, formula});
+}
+
+void Engine::queueAddCollectionMember(std::string const& name, std::string const& member) {
+    _impl->queueCommand(statkernel::AddMemberCommand{name, member});
+}
+
+void Engine::queueRemoveCollectionMember(std::string const& name, std::string const& member) {
+    _impl->queueCommand(statkernel::RemoveMemberCommand{name, member});
+}
+
+SF_ErrorCode Engine::applyCommands() {
+    return _impl->applyCommands();
+}
+
+SF_ErrorCode Engine::publishSnapshot() {
+    return _impl->publishSnapshot();
+}
+
+std::optional<Snapshot> Engine::latestSnapshot() const {
+    auto snapshot = _impl->latestSnapshot();
+    if (!snapshot) {
+        return std::nullopt;
+    }
+    return Snapshot{std::move(snapshot)};
+}
+
+Snapshot::Snapshot(std::shared_ptr<statkernel::Snapshot const> snapshot)
+    : _snapshot(std::move(snapshot)) {
+}
+
+std::uint64_t Snapshot::version() const {
+    return _snapshot->version();
+}
+
+std::optional<SF_SnapshotHandle> Snapshot::find(std::string const& name) const {
+    return _snapshot->find(name);
+}
+
+double Snapshot::value(SF_SnapshotHandle handle) const {
+    return _snapshot->value(handle);
+}
+
+EngineGroup::EngineGroup() : _impl(std::make_unique<runtime::EngineGroup>()) {
+}
+
+EngineGroup::~EngineGroup() = default;
+
+EngineGroup::EngineGroup(EngineGroup&& other) noexcept = default;
+
+EngineGroup& EngineGroup::operator=(EngineGroup&& other) noexcept = default;
+
+void EngineGroup::add(Engine& engine) {
+    _impl->add(*engine._impl);
+}
+
+void EngineGroup::remove(Engine& engine) {
+    _impl->remove(*engine._impl);
+}
+
+void EngineGroup::evaluate(std::size_t threads) {
+    _impl->evaluate(threads);
+}
+
 } // namespace statforge
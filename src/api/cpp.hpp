@@ -1,15 +1,115 @@
 #pragma once
 
+#include "api/c.h"
 #include "error/error.h"
 #include "types/collection_operation.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace statforge {
 namespace runtime {
 class EngineImpl;
+class EngineGroup;
 }
+namespace statkernel {
+class SheetBatch;
+class SheetFork;
+class Snapshot;
+}
+
+// read-only values of all nodes of an engine at the time it was published, safe to read from
+// any thread. handles stay valid for every later snapshot of the engine until it's reset
+class Snapshot {
+public:
+    // increases with every publish
+    std::uint64_t version() const;
+    std::optional<SF_SnapshotHandle> find(std::string const& name) const;
+    // NaN for nodes removed since the handle was found
+    double value(SF_SnapshotHandle handle) const;
+
+private:
+    friend class Engine;
+    explicit Snapshot(std::shared_ptr<statkernel::Snapshot const> snapshot);
+
+    std::shared_ptr<statkernel::Snapshot const> _snapshot;
+};
+
+// entities sharing the nodes of the engine they were created from, stored side by side and
+// evaluated together. every entity starts at the values the engine had, later changes to the
+// engine don't reach the batch
+class EntityBatch {
+public:
+    ~EntityBatch();
+    EntityBatch(EntityBatch&&) noexcept;
+    EntityBatch& operator=(EntityBatch&&) noexcept;
+    EntityBatch(EntityBatch const&) = delete;
+    EntityBatch& operator=(EntityBatch const&) = delete;
+
+    std::size_t entities() const;
+    SF_ErrorCode setNodeValue(std::size_t entity, std::string const& name, double value);
+    // evaluates the dirty nodes "name" depends on for all entities
+    SF_ErrorCode getNodeValue(std::size_t entity, std::string const& name, double& value);
+    void evaluate();
+
+    // message of the last failing call on this batch, reading it consumes it
+    std::string getLastError();
+
+private:
+    friend class Engine;
+    explicit EntityBatch(std::unique_ptr<statkernel::SheetBatch> batch);
+
+    std::unique_ptr<statkernel::SheetBatch> _batch;
+    std::string _lastError;
+};
+
+// one change of a scored candidate. "member" is only used by membership changes and "value"
+// only by value changes
+struct CandidateChange {
+    SF_ChangeType type{SF_CHANGE_SET_VALUE};
+    std::string name;
+    std::string member;
+    double value{0};
+};
+
+// copy-on-write child of an engine for what-if evaluation. it reads the values of the engine
+// until it diverges and only reevaluates what diverged, later changes to the engine don't
+// reach it
+class EngineFork {
+public:
+    ~EngineFork();
+    EngineFork(EngineFork&&) noexcept;
+    EngineFork& operator=(EngineFork&&) noexcept;
+    EngineFork(EngineFork const&) = delete;
+    EngineFork& operator=(EngineFork const&) = delete;
+
+    // child including the changes of this fork. it's only read, so several threads may fork
+    // the same fork as long as nobody changes or reads it meanwhile
+    EngineFork fork() const;
+    SF_ErrorCode setNodeValue(std::string const& name, double value);
+    // membership changes only this fork sees. added members are never gated
+    SF_ErrorCode addCollectionMember(std::string const& name, std::string const& member);
+    SF_ErrorCode removeCollectionMember(std::string const& name, std::string const& member);
+    // evaluates the dirty nodes "name" depends on
+    SF_ErrorCode getNodeValue(std::string const& name, double& value);
+    void evaluate();
+
+    // message of the last failing call on this fork, reading it consumes it
+    std::string getLastError();
+
+private:
+    friend class Engine;
+    explicit EngineFork(std::unique_ptr<statkernel::SheetFork> fork);
+
+    std::unique_ptr<statkernel::SheetFork> _fork;
+    std::string _lastError;
+};
 
 class Engine {
 public:
@@ -22,24 +122,150 @@ public:
 
     /******* Nodes ********/
     SF_ErrorCode createCollectionNode(std::string const& name, SF_CollectionOperation operation);
+    // members are all tagged nodes matching "query", e.g. "tag:FlatLife & !disabled"
+    SF_ErrorCode createQueryCollectionNode(std::string const& name,
+                                           std::string const& query,
+                                           SF_CollectionOperation operation);
     SF_ErrorCode createFormulaNode(std::string const& name, std::string const& formula);
+    // sum(base) * (1 + sum(increased)) * product(1 + more). every group is a comma or
+    // whitespace separated list, a node can only be part of one group
+    SF_ErrorCode createModifierNode(std::string const& name,
+                                    std::string const& base,
+                                    std::string const& increased,
+                                    std::string const& more);
     SF_ErrorCode createValueNode(std::string const& name, double value);
+    // "bindings" is a comma or whitespace separated list, bound to <$0>, <$1>, ... in order
+    SF_ErrorCode createFormulaTemplate(std::string const& name, std::string const& formula);
+    SF_ErrorCode createTemplateNode(std::string const& name,
+                                    std::string const& templateName,
+                                    std::string const& bindings);
     SF_ErrorCode removeNode(std::string const& name);
     SF_ErrorCode setNodeValue(std::string const& name, double value);
     SF_ErrorCode setNodeFormula(std::string const& name, std::string const& formula);
     SF_ErrorCode setNodeDependency(std::string const& name, std::string const& dependencies);
+    SF_ErrorCode setModifierNodeGroups(std::string const& name,
+                                       std::string const& base,
+                                       std::string const& increased,
+                                       std::string const& more);
+    // changes single members instead of replacing the whole list, batches are applied
+    // completely or not at all
+    SF_ErrorCode addCollectionMember(std::string const& name, std::string const& member);
+    SF_ErrorCode addCollectionMembers(std::string const& name,
+                                      std::span<std::string const> members);
+    SF_ErrorCode removeCollectionMember(std::string const& name, std::string const& member);
+    SF_ErrorCode removeCollectionMembers(std::string const& name,
+                                         std::span<std::string const> members);
+    // "member" only takes part while "gate" is non-zero and not NaN, e.g. a "low life" flag node
+    SF_ErrorCode addGatedCollectionMember(std::string const& name,
+                                          std::string const& member,
+                                          std::string const& gate);
+    // "tags" is a comma or whitespace separated list replacing the current tags
+    SF_ErrorCode setNodeTags(std::string const& name, std::string const& tags);
     SF_ErrorCode getNodeValue(std::string const& name, double& value) const;
+    // address of the value of "name", valid until the node is removed. it holds the current
+    // value whenever getCleanEpoch() is even, e.g. right after evaluate()
+    SF_ErrorCode getNodeValueView(std::string const& name, double const*& view) const;
+    // even while all nodes are clean after evaluate(), odd once anything changed since
+    std::uint64_t getCleanEpoch() const;
+    // every entry is handled on its own, "errors" is either empty or receives one code per
+    // entry. the first failure is returned
+    SF_ErrorCode setNodeValues(std::span<std::string const> names,
+                               std::span<double const> values,
+                               std::span<SF_ErrorCode> errors = {});
+    SF_ErrorCode getNodeValues(std::span<std::string const> names,
+                               std::span<double> values,
+                               std::span<SF_ErrorCode> errors = {}) const;
+    // evaluates every dirty node
+    void evaluate();
+
+    /******* Functions ********/
+    // maxArguments == SF_VARIADIC for functions without an upper bound.
+    // impure functions are called on every evaluation and never folded.
+    SF_ErrorCode registerFunction(std::string const& name,
+                                  std::function<double(std::span<double const>)> function,
+                                  std::size_t minArguments,
+                                  std::size_t maxArguments,
+                                  bool pure = true);
+
+    /******* Formula cache ********/
+    // compiled formulas are shared by their normalized text, capacity 0 disables the cache
+    void setFormulaCacheCapacity(std::size_t capacity);
+    SF_FormulaCacheStats getFormulaCacheStats() const;
 
     /******* Rules ********/
     SF_ErrorCode createRule(std::string const& name, std::string const& action, double initValue);
     SF_ErrorCode editRule(std::string const& name, std::string const& action, double initValue);
     SF_ErrorCode deleteRule(std::string const& name);
 
+    /******* Entity batches ********/
+    // evaluates the engine and creates "entities" copies of its nodes.
+    // std::nullopt on failure, see getLastError()
+    std::optional<EntityBatch> createEntityBatch(std::size_t entities);
+
+    /******* Forks ********/
+    // evaluates the engine and creates a copy-on-write child for what-if evaluation. forks
+    // share one compiled copy of the engine until it changes, so they are cheap to create per
+    // candidate. std::nullopt on failure, see getLastError()
+    std::optional<EngineFork> fork();
+    // scores alternative changes against the current values without applying any of them.
+    // "deltas" receives candidates.size() * targets.size() values, one row of targets per
+    // candidate. only nodes any candidate can affect on the way to the targets are evaluated.
+    // rows of failing candidates are NaN and the first failure is returned
+    SF_ErrorCode scoreCandidates(std::span<std::vector<CandidateChange> const> candidates,
+                                 std::span<std::string const> targets,
+                                 std::span<double> deltas);
+
+    /******* Commands ********/
+    // queue changes without blocking. unlike everything else they may be called from other
+    // threads while the owning thread keeps using the engine, nothing changes until the
+    // owning thread calls applyCommands()
+    void queueSetNodeValue(std::string const& name, double value);
+    void queueSetNodeFormula(std::string const& name, std::string const& formula);
+    void queueAddCollectionMember(std::string const& name, std::string const& member);
+    void queueRemoveCollectionMember(std::string const& name, std::string const& member);
+    // applies the queued changes in order. of several value or formula changes to one node
+    // only the last is applied. failing changes are skipped, the first failure is returned
+    SF_ErrorCode applyCommands();
+
+    /******* Snapshots ********/
+    // evaluates the engine and publishes the values of all nodes for reader threads
+    SF_ErrorCode publishSnapshot();
+    // std::nullopt before the first publish. unlike everything else it may be called from
+    // other threads while the owning thread keeps using the engine
+    std::optional<Snapshot> latestSnapshot() const;
+
     /******* Error ********/
+    // message of the last failing call on this engine, reading it consumes it
     std::string getLastError();
 
 private:
+    friend class EngineGroup;
+
     std::unique_ptr<runtime::EngineImpl> _impl;
 };
 
+// evaluates many independent engines together on a thread pool. every engine keeps its thread
+// between calls as long as the group and the thread count don't change, idle threads steal
+// work from busy ones. engines of a group must not be used elsewhere while it's evaluated
+// and have to be removed before they are destroyed
+class EngineGroup {
+public:
+    EngineGroup();
+    ~EngineGroup();
+    EngineGroup(EngineGroup&&) noexcept;
+    EngineGroup& operator=(EngineGroup&&) noexcept;
+    EngineGroup(EngineGroup const&) = delete;
+    EngineGroup& operator=(EngineGroup const&) = delete;
+
+    // adding an engine twice or removing one that isn't part of the group does nothing
+    void add(Engine& engine);
+    void remove(Engine& engine);
+    // evaluates every engine with pending changes on "threads" threads including the calling
+    // one, 0 uses one thread per core
+    void evaluate(std::size_t threads = 0);
+
+private:
+    std::unique_ptr<runtime::EngineGroup> _impl;
+};
+
 } // namespace statforge
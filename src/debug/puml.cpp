@@ -27,6 +27,7 @@ void logNodes(std::string const& fileName,
                  "  BackgroundColor<<Dirty>> Red\n"
                  "  BorderColor<<Agg>> Black\n"
                  "  BorderColor<<Formula>> Green\n"
+                 "  BorderColor<<Modifier>> Blue\n"
                  "  BorderColor<<Value>> Red\n"
                  "  FontColor<<Dirty>> White\n"
                  "  BorderThickness 2.5\n"
@@ -60,6 +61,9 @@ void logNodes(std::string const& fileName,
         if (node.type == NodeType::Collection) {
             rectangleDescriptions << " <<Collection>>";
         }
+        if (node.type == NodeType::Modifier) {
+            rectangleDescriptions << " <<Modifier>>";
+        }
         rectangleDescriptions << "\n";
 
         if (!dependencyMap.contains(id)) {
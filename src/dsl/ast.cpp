@@ -1,6 +1,8 @@
 #include "dsl/ast.hpp"
 
 #include <sstream>
+#include <utility>
+#include <vector>
 
 namespace statforge::dsl {
 
@@ -16,6 +18,8 @@ std::string opName(TokenKind kind) {
         return "*";
     case TokenKind::Slash:
         return "/";
+    case TokenKind::Percent:
+        return "%";
     case TokenKind::Caret:
         return "^";
     case TokenKind::Less:
@@ -40,7 +44,7 @@ std::string opName(TokenKind kind) {
         return "?";
     }
 }
-void dump(const ExpressionTree& expression, std::ostringstream& out) {
+void dump(const ExpressionTree& tree, ExprIndex index, std::ostringstream& out) {
     std::visit(
         [&](auto&& node) {
             using T = std::decay_t<decltype(node)>;
@@ -51,40 +55,109 @@ void dump(const ExpressionTree& expression, std::ostringstream& out) {
                 out << '<' << node.name << '>';
             } else if constexpr (std::is_same_v<T, Unary>) {
                 out << '(' << opName(node.op) << ' ';
-                dump(*node.rhs, out);
+                dump(tree, node.rhs, out);
                 out << ')';
             } else if constexpr (std::is_same_v<T, Binary>) {
                 out << '(' << opName(node.op) << ' ';
-                dump(*node.lhs, out);
+                dump(tree, node.lhs, out);
                 out << ' ';
-                dump(*node.rhs, out);
+                dump(tree, node.rhs, out);
                 out << ')';
             } else if constexpr (std::is_same_v<T, Ternary>) {
                 out << "(? ";
-                dump(*node.cond, out);
+                dump(tree, node.cond, out);
                 out << ' ';
-                dump(*node.thenExpr, out);
+                dump(tree, node.thenExpr, out);
                 out << ' ';
-                dump(*node.elseExpr, out);
+                dump(tree, node.elseExpr, out);
                 out << ')';
             } else if constexpr (std::is_same_v<T, Call>) {
                 out << "(call " << node.name;
-                for (auto& arg : node.args) {
+                for (auto arg : tree.args(node)) {
                     out << ' ';
-                    dump(*arg, out);
+                    dump(tree, arg, out);
                 }
                 out << ')';
             }
         },
-        expression);
+        tree[index]);
 }
 
 } // namespace
 
+ExprIndex ExpressionTree::add(Expression node) {
+    _nodes.push_back(node);
+    return static_cast<ExprIndex>(_nodes.size() - 1);
+}
+
+ExprIndex ExpressionTree::addCall(std::string_view name,
+                                  std::span<ExprIndex const> args,
+                                  Span span,
+                                  FunctionIndex function) {
+    return add(Call{.name = name,
+                    .firstArg = addArgs(args),
+                    .argCount = static_cast<std::uint32_t>(args.size()),
+                    .span = span,
+                    .function = function});
+}
+
+std::uint32_t ExpressionTree::addArgs(std::span<ExprIndex const> args) {
+    auto const first = static_cast<std::uint32_t>(_args.size());
+    _args.insert(_args.end(), args.begin(), args.end());
+    return first;
+}
+
+void ExpressionTree::reserve(std::size_t nodes) {
+    _nodes.reserve(nodes);
+}
+
+void ExpressionTree::compact() {
+    if (_nodes.empty()) {
+        return;
+    }
+    ExpressionTree compacted;
+    compacted.reserve(_nodes.size());
+    compacted._root = compacted.copy(*this, _root);
+    *this = std::move(compacted);
+}
+
+ExpressionTree ExpressionTree::subtree(ExprIndex index) const {
+    ExpressionTree tree;
+    tree._root = tree.copy(*this, index);
+    return tree;
+}
+
+ExprIndex ExpressionTree::copy(ExpressionTree const& source, ExprIndex index) {
+    return std::visit(
+        [&](auto node) -> ExprIndex {
+            using T = std::decay_t<decltype(node)>;
+
+            if constexpr (std::is_same_v<T, Unary>) {
+                node.rhs = copy(source, node.rhs);
+            } else if constexpr (std::is_same_v<T, Binary>) {
+                node.lhs = copy(source, node.lhs);
+                node.rhs = copy(source, node.rhs);
+            } else if constexpr (std::is_same_v<T, Ternary>) {
+                node.cond = copy(source, node.cond);
+                node.thenExpr = copy(source, node.thenExpr);
+                node.elseExpr = copy(source, node.elseExpr);
+            } else if constexpr (std::is_same_v<T, Call>) {
+                // arguments are copied first, so the argument list of this call stays contiguous
+                std::vector<ExprIndex> args(source.args(node).begin(), source.args(node).end());
+                for (auto& arg : args) {
+                    arg = copy(source, arg);
+                }
+                node.firstArg = addArgs(args);
+            }
+            return add(node);
+        },
+        source[index]);
+}
+
 std::string dumpSExpr(const ExpressionTree& expression) {
     std::ostringstream out;
-    dump(expression, out);
+    dump(expression, expression.root(), out);
     return out.str();
 }
 
-} // namespace statforge
\ No newline at end of file
+} // namespace statforge::dsl
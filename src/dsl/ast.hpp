@@ -1,16 +1,19 @@
 #pragma once
+#include "dsl/functions.hpp"
 #include "dsl/tokenizer.hpp"
 #include "error/internal/error.hpp"
 
-#include <memory>
+#include <cstdint>
+#include <span>
+#include <string>
 #include <string_view>
 #include <variant>
 #include <vector>
 
 namespace statforge::dsl {
 
-struct ExpressionTree; // fwd
-using ExprPtr = std::unique_ptr<ExpressionTree>;
+// position of a node inside its ExpressionTree
+using ExprIndex = std::uint32_t;
 
 struct Literal {
     double value;
@@ -23,29 +26,83 @@ struct Ref {
 
 struct Unary {
     TokenKind op;
-    ExprPtr rhs;
+    ExprIndex rhs;
     Span span;
 };
 struct Binary {
     TokenKind op;
-    ExprPtr lhs, rhs;
+    ExprIndex lhs, rhs;
     Span span;
 };
 struct Ternary {
-    ExprPtr cond, thenExpr, elseExpr;
+    ExprIndex cond, thenExpr, elseExpr;
     Span span;
 };
 
 struct Call {
     std::string_view name;
-    std::vector<ExprPtr> args;
+    // arguments are stored contiguously, see ExpressionTree::args()
+    std::uint32_t firstArg;
+    std::uint32_t argCount;
     Span span;
+    // resolved by the parser
+    FunctionIndex function{};
 };
 
-struct ExpressionTree : std::variant<Literal, Ref, Unary, Binary, Ternary, Call> {
-    using std::variant<Literal, Ref, Unary, Binary, Ternary, Call>::variant;
+using Expression = std::variant<Literal, Ref, Unary, Binary, Ternary, Call>;
+
+// flat AST. nodes live in one contiguous vector and reference their children by index.
+// rewrites append new nodes and leave replaced ones behind until compact() is called.
+class ExpressionTree {
+public:
+    ExprIndex add(Expression node);
+    ExprIndex addCall(std::string_view name,
+                      std::span<ExprIndex const> args,
+                      Span span,
+                      FunctionIndex function = {});
+    // returns the first index for Call::firstArg
+    std::uint32_t addArgs(std::span<ExprIndex const> args);
+
+    [[nodiscard]] Expression& operator[](ExprIndex index) {
+        return _nodes[index];
+    }
+    [[nodiscard]] Expression const& operator[](ExprIndex index) const {
+        return _nodes[index];
+    }
+    // invalidated by adding nodes or arguments
+    [[nodiscard]] std::span<ExprIndex> args(Call const& call) {
+        return {_args.data() + call.firstArg, call.argCount};
+    }
+    [[nodiscard]] std::span<ExprIndex const> args(Call const& call) const {
+        return {_args.data() + call.firstArg, call.argCount};
+    }
+
+    [[nodiscard]] ExprIndex root() const {
+        return _root;
+    }
+    void setRoot(ExprIndex root) {
+        _root = root;
+    }
+    [[nodiscard]] std::size_t size() const {
+        return _nodes.size();
+    }
+    void reserve(std::size_t nodes);
+
+    // drops nodes no longer reachable from the root. children are stored before their parents.
+    void compact();
+    // copy of the subtree at "index"
+    [[nodiscard]] ExpressionTree subtree(ExprIndex index) const;
+
+private:
+    ExprIndex copy(ExpressionTree const& source, ExprIndex index);
+
+    std::vector<Expression> _nodes;
+    std::vector<ExprIndex> _args;
+    ExprIndex _root{0};
 };
 
+using ExpressionTreeResult = Result<ExpressionTree>;
+
 std::string dumpSExpr(const ExpressionTree&);
 
-} // namespace statforge::dsl
\ No newline at end of file
+} // namespace statforge::dsl
@@ -4,7 +4,9 @@
 #include "types/definitions.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <span>
 #include <string>
 #include <utility>
 
@@ -15,8 +17,11 @@ namespace {
 constexpr double trueD = 1.0;
 constexpr double falseD = 0.0;
 
+// host function arguments up to this count are passed without heap allocation
+constexpr std::size_t maxInlineArguments = 8;
+
 inline double logicalValue(double val) {
-    return static_cast<double>((val != 0.0) && !std::isnan(val));
+    return static_cast<double>(statforge::dsl::isTruthy(val));
 }
 
 auto constexpr logic = [](double lhs, double rhs, TokenKind const kind) -> double {
@@ -54,6 +59,8 @@ auto constexpr arithmetic = [](double const lhs, double const rhs, TokenKind con
     case TokenKind::Slash:
         //FIXME DIVIDE BY ZERO DETECTION std::fetestexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW)
         return lhs / rhs;
+    case TokenKind::Percent:
+        return std::fmod(lhs, rhs);
     case TokenKind::Caret:
         return std::pow(lhs, rhs);
     default:
@@ -67,101 +74,169 @@ auto constexpr arithmetic = [](double const lhs, double const rhs, TokenKind con
 namespace statforge::dsl {
 
 double evaluate(ExpressionTree const& expression, Context const& context) {
-    std::function<double(ExpressionTree const&)> const visit =
-        [&](ExpressionTree const& node) -> double {
-        return std::visit(
-            [&](auto const& actual) -> double {
-                using Node = std::decay_t<decltype(actual)>;
+    return evaluate(expression, expression.root(), context);
+}
+
+double evaluate(ExpressionTree const& expression, ExprIndex index, Context const& context) {
+    auto const visit = [&](ExprIndex child) { return evaluate(expression, child, context); };
+
+    return std::visit(
+        [&](auto const& actual) -> double {
+            using Node = std::decay_t<decltype(actual)>;
 
-                if constexpr (std::is_same_v<Node, Literal>) {
-                    return actual.value;
+            if constexpr (std::is_same_v<Node, Literal>) {
+                return actual.value;
+            }
+
+            if constexpr (std::is_same_v<Node, Ref>) {
+                if (context.refLookup) {
+                    return context.refLookup(index);
+                }
+                if (!context.nodeLookup) {
+                    unreachable("Missing node-lookup callback");
                 }
+                return context.nodeLookup(actual.name);
+            }
 
-                if constexpr (std::is_same_v<Node, Ref>) {
-                    if (!context.nodeLookup) {
-                        unreachable("Missing node-lookup callback");
-                    }
-                    return context.nodeLookup(actual.name);
-                }
-
-                if constexpr (std::is_same_v<Node, Unary>) {
-                    double const rhs{visit(*actual.rhs)};
-                    switch (actual.op) {
-                    case TokenKind::Plus:
-                        return rhs;
-                    case TokenKind::Minus:
-                        return -rhs;
-                    case TokenKind::Bang:
-                        return logicalValue(rhs) == falseD ? trueD : falseD;
-                    default:
-                        statforge::unreachable(
-                            std::format("Unknown unary op: {}", std::to_underlying(actual.op)));
-                    }
+            if constexpr (std::is_same_v<Node, Unary>) {
+                double const rhs{visit(actual.rhs)};
+                switch (actual.op) {
+                case TokenKind::Plus:
+                    return rhs;
+                case TokenKind::Minus:
+                    return -rhs;
+                case TokenKind::Bang:
+                    return logicalValue(rhs) == falseD ? trueD : falseD;
+                default:
+                    statforge::unreachable(
+                        std::format("Unknown unary op: {}", std::to_underlying(actual.op)));
                 }
+            }
 
-                if constexpr (std::is_same_v<Node, Binary>) {
-                    double const lhs{visit(*actual.lhs)};
-                    double const rhs{visit(*actual.rhs)};
-
-                    switch (actual.op) {
-                    case TokenKind::Plus:
-                    case TokenKind::Minus:
-                    case TokenKind::Star:
-                    case TokenKind::Slash:
-                    case TokenKind::Caret:
-                        return arithmetic(lhs, rhs, actual.op);
-
-                    case TokenKind::AndAnd:
-                    case TokenKind::OrOr:
-                    case TokenKind::EqualEqual:
-                    case TokenKind::BangEqual:
-                    case TokenKind::Less:
-                    case TokenKind::LessEqual:
-                    case TokenKind::Greater:
-                    case TokenKind::GreaterEqual:
-                        return logic(lhs, rhs, actual.op);
-
-                    default:
-                        statforge::unreachable(
-                            std::format("Unknown binary op: {}", std::to_underlying(actual.op)));
-                    }
+            if constexpr (std::is_same_v<Node, Binary>) {
+                // short-circuit, the rhs is only evaluated if it can change the result
+                if (actual.op == TokenKind::AndAnd) {
+                    double const lhs{logicalValue(visit(actual.lhs))};
+                    return lhs == falseD ? falseD : logicalValue(visit(actual.rhs));
                 }
+                if (actual.op == TokenKind::OrOr) {
+                    double const lhs{logicalValue(visit(actual.lhs))};
+                    return lhs == trueD ? trueD : logicalValue(visit(actual.rhs));
+                }
+
+                double const lhs{visit(actual.lhs)};
+                double const rhs{visit(actual.rhs)};
+
+                switch (actual.op) {
+                case TokenKind::Plus:
+                case TokenKind::Minus:
+                case TokenKind::Star:
+                case TokenKind::Slash:
+                case TokenKind::Percent:
+                case TokenKind::Caret:
+                    return arithmetic(lhs, rhs, actual.op);
 
-                if constexpr (std::is_same_v<Node, Ternary>) {
-                    double const predicate{visit(*actual.cond)};
-                    return logicalValue(predicate) == trueD ? visit(*actual.thenExpr)
-                                                            : visit(*actual.elseExpr);
+                case TokenKind::EqualEqual:
+                case TokenKind::BangEqual:
+                case TokenKind::Less:
+                case TokenKind::LessEqual:
+                case TokenKind::Greater:
+                case TokenKind::GreaterEqual:
+                    return logic(lhs, rhs, actual.op);
+
+                default:
+                    statforge::unreachable(
+                        std::format("Unknown binary op: {}", std::to_underlying(actual.op)));
                 }
+            }
 
-                if constexpr (std::is_same_v<Node, Call>) {
-                    if (actual.name == "root") {
-                        if (actual.args.size() != 2U) {
-                            unreachable("root() expects exactly two arguments, provided: " +
-                                        std::to_string(actual.args.size()));
-                        }
-                        double const index{visit(*actual.args[0])};
-                        double const value{visit(*actual.args[1])};
-                        return std::pow(value, 1.0 / index);
+            if constexpr (std::is_same_v<Node, Ternary>) {
+                double const predicate{visit(actual.cond)};
+                return logicalValue(predicate) == trueD ? visit(actual.thenExpr)
+                                                        : visit(actual.elseExpr);
+            }
+
+            if constexpr (std::is_same_v<Node, Call>) {
+                // builtins are dispatched directly, host functions go through the registry
+                auto const args = expression.args(actual);
+                auto const arg = [&](std::size_t position) { return visit(args[position]); };
+                switch (static_cast<Builtin>(actual.function)) {
+                case Builtin::Root: {
+                    double const rootIndex{arg(0)};
+                    return std::pow(arg(1), 1.0 / rootIndex);
+                }
+                case Builtin::Sqrt:
+                    return std::sqrt(arg(0));
+                case Builtin::Min: {
+                    double value{arg(0)};
+                    for (std::size_t i = 1; i < args.size(); ++i) {
+                        value = std::fmin(value, arg(i));
                     }
-                    statforge::unreachable(
-                        std::format("Unknown function: {}", std::string(actual.name)));
+                    return value;
+                }
+                case Builtin::Max: {
+                    double value{arg(0)};
+                    for (std::size_t i = 1; i < args.size(); ++i) {
+                        value = std::fmax(value, arg(i));
+                    }
+                    return value;
+                }
+                case Builtin::Clamp: {
+                    double const value{arg(0)};
+                    double const low{arg(1)};
+                    return std::fmin(std::fmax(value, low), arg(2));
+                }
+                case Builtin::Abs:
+                    return std::fabs(arg(0));
+                case Builtin::Floor:
+                    return std::floor(arg(0));
+                case Builtin::Ceil:
+                    return std::ceil(arg(0));
+                case Builtin::Round:
+                    return std::round(arg(0));
+                case Builtin::Exp:
+                    return std::exp(arg(0));
+                case Builtin::Log:
+                    return std::log(arg(0));
+                case Builtin::Pow: {
+                    double const base{arg(0)};
+                    return std::pow(base, arg(1));
+                }
+                case Builtin::Lerp: {
+                    double const from{arg(0)};
+                    double const to{arg(1)};
+                    return std::lerp(from, to, arg(2));
+                }
+                case Builtin::Fmod: {
+                    double const value{arg(0)};
+                    return std::fmod(value, arg(1));
+                }
                 }
 
-                statforge::unreachable("Unhandled node type in visitor");
-            },
-            node);
-    };
+                std::array<double, maxInlineArguments> inlineArguments{};
+                std::vector<double> heapArguments;
+                std::span<double> arguments{inlineArguments.data(), args.size()};
+                if (args.size() > maxInlineArguments) {
+                    heapArguments.resize(args.size());
+                    arguments = heapArguments;
+                }
+                for (std::size_t i = 0; i < args.size(); ++i) {
+                    arguments[i] = arg(i);
+                }
+                return context.functions->function(actual.function).callable(arguments);
+            }
 
-    return visit(expression);
+            statforge::unreachable("Unhandled node type in visitor");
+        },
+        expression[index]);
 }
 
 std::vector<NodeId> extractDependencies(ExpressionTree const& expression) {
     std::vector<NodeId> dependencies;
-    std::vector<ExpressionTree const*> queue;
-    queue.push_back(&expression);
+    std::vector<ExprIndex> queue;
+    queue.push_back(expression.root());
 
     for (std::size_t cursor = 0; cursor < queue.size(); ++cursor) {
-        ExpressionTree const* current{queue[cursor]};
 
         std::visit(
             [&](auto const& node) {
@@ -170,21 +245,56 @@ std::vector<NodeId> extractDependencies(ExpressionTree const& expression) {
                 if constexpr (std::is_same_v<Node, Ref>) {
                     dependencies.emplace_back(node.name);
                 } else if constexpr (std::is_same_v<Node, Unary>) {
-                    queue.push_back(node.rhs.get());
+                    queue.push_back(node.rhs);
                 } else if constexpr (std::is_same_v<Node, Binary>) {
-                    queue.push_back(node.lhs.get());
-                    queue.push_back(node.rhs.get());
+                    queue.push_back(node.lhs);
+                    queue.push_back(node.rhs);
                 } else if constexpr (std::is_same_v<Node, Ternary>) {
-                    queue.push_back(node.cond.get());
-                    queue.push_back(node.thenExpr.get());
-                    queue.push_back(node.elseExpr.get());
+                    queue.push_back(node.cond);
+                    queue.push_back(node.thenExpr);
+                    queue.push_back(node.elseExpr);
                 } else if constexpr (std::is_same_v<Node, Call>) {
-                    for (auto const& arg : node.args) {
-                        queue.push_back(arg.get());
+                    auto const args = expression.args(node);
+                    queue.insert(queue.end(), args.begin(), args.end());
+                }
+            },
+            expression[queue[cursor]]);
+    }
+
+    std::ranges::sort(dependencies);
+    auto dupes = std::ranges::unique(dependencies);
+    dependencies.erase(dupes.begin(), dupes.end());
+    return dependencies;
+}
+
+std::vector<NodeId> extractUnconditionalDependencies(ExpressionTree const& expression) {
+    std::vector<NodeId> dependencies;
+    std::vector<ExprIndex> queue;
+    queue.push_back(expression.root());
+
+    for (std::size_t cursor = 0; cursor < queue.size(); ++cursor) {
+
+        std::visit(
+            [&](auto const& node) {
+                using Node = std::decay_t<decltype(node)>;
+
+                if constexpr (std::is_same_v<Node, Ref>) {
+                    dependencies.emplace_back(node.name);
+                } else if constexpr (std::is_same_v<Node, Unary>) {
+                    queue.push_back(node.rhs);
+                } else if constexpr (std::is_same_v<Node, Binary>) {
+                    queue.push_back(node.lhs);
+                    if (node.op != TokenKind::AndAnd && node.op != TokenKind::OrOr) {
+                        queue.push_back(node.rhs);
                     }
+                } else if constexpr (std::is_same_v<Node, Ternary>) {
+                    queue.push_back(node.cond);
+                } else if constexpr (std::is_same_v<Node, Call>) {
+                    auto const args = expression.args(node);
+                    queue.insert(queue.end(), args.begin(), args.end());
                 }
             },
-            *current);
+            expression[queue[cursor]]);
     }
 
     std::ranges::sort(dependencies);
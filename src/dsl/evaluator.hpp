@@ -1,8 +1,10 @@
 #pragma once
 
 #include "dsl/ast.hpp"
+#include "dsl/functions.hpp"
 #include "types/definitions.hpp"
 
+#include <cmath>
 #include <functional>
 #include <string_view>
 #include <vector>
@@ -11,10 +13,26 @@ namespace statforge::dsl {
 
 struct Context {
     std::function<double(std::string_view)> nodeLookup;
+    // reads references by the index of their Ref node instead of by name, if set
+    std::function<double(ExprIndex)> refLookup{};
+    // has to be the registry the expression was parsed with
+    FunctionRegistry const* functions{&FunctionRegistry::builtins()};
 };
 
+// truth of a value in conditions and logical operators, NaN is false. gates of collection
+// members open the same way
+inline bool isTruthy(double value) {
+    return (value != 0.0) && !std::isnan(value);
+}
+
 double evaluate(ExpressionTree const& expression, Context const& context);
+// evaluates the subtree at "index"
+double evaluate(ExpressionTree const& expression, ExprIndex index, Context const& context);
 
 std::vector<NodeId> extractDependencies(ExpressionTree const& expression);
 
+// dependencies read on every evaluation, i.e. not only inside ternary branches
+// or the right hand side of && and ||
+std::vector<NodeId> extractUnconditionalDependencies(ExpressionTree const& expression);
+
 } // namespace statforge::dsl
\ No newline at end of file
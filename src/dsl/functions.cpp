@@ -0,0 +1,138 @@
+#include "dsl/functions.hpp"
+#include "error/error.h"
+#include "error/internal/error.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <format>
+#include <utility>
+
+namespace statforge::dsl {
+
+namespace {
+
+// same rules as identifiers in the tokenizer
+bool isValidName(std::string_view name) {
+    if (name.empty() || name == "true" || name == "false") {
+        return false;
+    }
+    if (std::isalpha(static_cast<unsigned char>(name.front())) == 0 && name.front() != '_') {
+        return false;
+    }
+    return std::ranges::all_of(name, [](unsigned char c) {
+        return (std::isalnum(c) != 0) || c == '_';
+    });
+}
+
+// the evaluator dispatches builtins directly, these back the registry entries
+
+double root(std::span<double const> args) {
+    return std::pow(args[1], 1.0 / args[0]);
+}
+
+double min(std::span<double const> args) {
+    double value{args[0]};
+    for (double const arg : args.subspan(1)) {
+        value = std::fmin(value, arg);
+    }
+    return value;
+}
+
+double max(std::span<double const> args) {
+    double value{args[0]};
+    for (double const arg : args.subspan(1)) {
+        value = std::fmax(value, arg);
+    }
+    return value;
+}
+
+double clamp(std::span<double const> args) {
+    return std::fmin(std::fmax(args[0], args[1]), args[2]);
+}
+
+double lerp(std::span<double const> args) {
+    return std::lerp(args[0], args[1], args[2]);
+}
+
+} // namespace
+
+FunctionRegistry::FunctionRegistry() {
+    auto builtin = [this](std::string name,
+                          Intrinsic callable,
+                          std::size_t minArguments,
+                          std::size_t maxArguments) {
+        [[maybe_unused]] auto result =
+            add(std::move(name), std::move(callable), minArguments, maxArguments);
+        assert(result);
+    };
+
+    // registration order has to match Builtin
+    builtin("root", root, 2, 2);
+    builtin("sqrt", [](auto args) { return std::sqrt(args[0]); }, 1, 1);
+    builtin("min", min, 1, variadic);
+    builtin("max", max, 1, variadic);
+    builtin("clamp", clamp, 3, 3);
+    builtin("abs", [](auto args) { return std::fabs(args[0]); }, 1, 1);
+    builtin("floor", [](auto args) { return std::floor(args[0]); }, 1, 1);
+    builtin("ceil", [](auto args) { return std::ceil(args[0]); }, 1, 1);
+    builtin("round", [](auto args) { return std::round(args[0]); }, 1, 1);
+    builtin("exp", [](auto args) { return std::exp(args[0]); }, 1, 1);
+    builtin("log", [](auto args) { return std::log(args[0]); }, 1, 1);
+    builtin("pow", [](auto args) { return std::pow(args[0], args[1]); }, 2, 2);
+    builtin("lerp", lerp, 3, 3);
+    builtin("fmod", [](auto args) { return std::fmod(args[0], args[1]); }, 2, 2);
+}
+
+VoidResult FunctionRegistry::add(std::string name,
+                                 Intrinsic callable,
+                                 std::size_t minArguments,
+                                 std::size_t maxArguments,
+                                 bool pure) {
+    SF_RETURN_UNEXPECTED_IF(!isValidName(name),
+                            SF_ERR_INVALID_FUNCTION,
+                            std::format(R"(Trying to register function with invalid name "{}")",
+                                        name));
+    SF_RETURN_UNEXPECTED_IF(
+        !callable,
+        SF_ERR_INVALID_FUNCTION,
+        std::format(R"(Trying to register function "{}" without callable)", name));
+    SF_RETURN_UNEXPECTED_IF(
+        minArguments > maxArguments,
+        SF_ERR_INVALID_FUNCTION,
+        std::format(R"(Trying to register function "{}" with invalid arity)", name));
+    SF_RETURN_UNEXPECTED_IF(
+        _indices.contains(name),
+        SF_ERR_FUNCTION_ALREADY_EXISTS,
+        std::format(R"(Trying to register already existing function "{}")", name));
+
+    auto const index = static_cast<FunctionIndex>(_functions.size());
+    _indices.emplace(name, index);
+    _functions.push_back({.name = std::move(name),
+                          .callable = std::move(callable),
+                          .minArguments = minArguments,
+                          .maxArguments = maxArguments,
+                          .pure = pure});
+    return {};
+}
+
+std::optional<FunctionIndex> FunctionRegistry::find(std::string_view name) const {
+    auto it = _indices.find(std::string(name));
+    if (it == _indices.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+Function const& FunctionRegistry::function(FunctionIndex index) const {
+    assert(index < _functions.size());
+    return _functions[index];
+}
+
+FunctionRegistry const& FunctionRegistry::builtins() {
+    static FunctionRegistry const registry;
+    return registry;
+}
+
+} // namespace statforge::dsl
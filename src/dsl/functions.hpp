@@ -0,0 +1,75 @@
+#pragma once
+
+#include "error/internal/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace statforge::dsl {
+
+using FunctionIndex = std::uint32_t;
+using Intrinsic = std::function<double(std::span<double const>)>;
+
+// maxArguments of functions without an upper bound
+constexpr std::size_t variadic = std::numeric_limits<std::size_t>::max();
+
+struct Function {
+    std::string name;
+    Intrinsic callable;
+    std::size_t minArguments;
+    std::size_t maxArguments;
+    // pure functions only depend on their arguments and get folded for constant arguments.
+    // impure ones are never folded or shared and are evaluated on every evaluation pass.
+    bool pure;
+};
+
+// functions every registry starts with, at fixed indices.
+// the evaluator dispatches these directly instead of calling through the registry.
+enum class Builtin : FunctionIndex {
+    Root,
+    Sqrt,
+    Min,
+    Max,
+    Clamp,
+    Abs,
+    Floor,
+    Ceil,
+    Round,
+    Exp,
+    Log,
+    Pow,
+    Lerp,
+    Fmod,
+};
+
+class FunctionRegistry {
+public:
+    FunctionRegistry();
+
+    // functions can't be replaced, compiled formulas refer to them by index
+    VoidResult add(std::string name,
+                   Intrinsic callable,
+                   std::size_t minArguments,
+                   std::size_t maxArguments,
+                   bool pure = true);
+
+    [[nodiscard]] std::optional<FunctionIndex> find(std::string_view name) const;
+    [[nodiscard]] Function const& function(FunctionIndex index) const;
+
+    // registry without host functions
+    [[nodiscard]] static FunctionRegistry const& builtins();
+
+private:
+    std::vector<Function> _functions;
+    std::unordered_map<std::string, FunctionIndex> _indices;
+};
+
+} // namespace statforge::dsl
@@ -0,0 +1,393 @@
+#include "dsl/optimizer.hpp"
+#include "dsl/evaluator.hpp"
+#include "dsl/tokenizer.hpp"
+#include "error/error.h"
+#include "error/internal/error.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace statforge::dsl {
+
+namespace {
+
+// highest constant integer power expanded into a multiply chain in fast-math mode
+constexpr double maxPowerChain = 8.0;
+
+ExprIndex literal(ExpressionTree& tree, double value, Span span) {
+    return tree.add(Literal{.value = value, .span = span});
+}
+
+ExprIndex unary(ExpressionTree& tree, TokenKind op, ExprIndex rhs, Span span) {
+    return tree.add(Unary{.op = op, .rhs = rhs, .span = span});
+}
+
+ExprIndex binary(ExpressionTree& tree, TokenKind op, ExprIndex lhs, ExprIndex rhs, Span span) {
+    return tree.add(Binary{.op = op, .lhs = lhs, .rhs = rhs, .span = span});
+}
+
+ExprIndex call(
+    ExpressionTree& tree, Builtin function, std::string_view name, ExprIndex arg, Span span) {
+    return tree.addCall(name, std::span{&arg, 1}, span, static_cast<FunctionIndex>(function));
+}
+
+std::optional<double> literalValue(ExpressionTree const& tree, ExprIndex index) {
+    if (auto const* lit = std::get_if<Literal>(&tree[index])) {
+        return lit->value;
+    }
+    return std::nullopt;
+}
+
+bool isBuiltin(Call const& call, Builtin function) {
+    return call.function == static_cast<FunctionIndex>(function);
+}
+
+// only called on literal-only subtrees. using the evaluator keeps folded results identical.
+double fold(ExpressionTree const& tree,
+            ExprIndex index,
+            FunctionRegistry const& functions = FunctionRegistry::builtins()) {
+    return evaluate(tree, index, Context{.nodeLookup = {}, .functions = &functions});
+}
+
+// x + -0 == x holds for every x, x + 0 doesn't for x == -0
+bool isNeutralAddend(double value, OptimizeOptions const& options) {
+    return value == 0.0 && (std::signbit(value) || options.fastMath);
+}
+
+// x * (1 / d) only equals x / d for every x if 1 / d is exact, i.e. d is a power of two
+bool canMultiplyByReciprocal(double divisor, OptimizeOptions const& options) {
+    double const reciprocal = 1.0 / divisor;
+    if (!std::isnormal(divisor) || !std::isnormal(reciprocal)) {
+        return false;
+    }
+    int exponent{};
+    return options.fastMath || std::fabs(std::frexp(divisor, &exponent)) == 0.5;
+}
+
+// returns nullopt if no rewrite applies
+std::optional<ExprIndex> simplifyPower(ExpressionTree& tree,
+                                       ExprIndex base,
+                                       double exponent,
+                                       Span span,
+                                       OptimizeOptions const& options) {
+    if (exponent == 1.0) {
+        return base;
+    }
+    if (exponent == 0.0) {
+        return literal(tree, 1.0, span); // pow(x, 0) is 1 even for NaN
+    }
+    if (exponent == -1.0) {
+        return binary(tree, TokenKind::Slash, literal(tree, 1.0, span), base, span);
+    }
+    if (options.fastMath && exponent == 0.5) {
+        return call(tree, Builtin::Sqrt, "sqrt", base, span);
+    }
+
+    // repeated evaluation is only cheap for node references
+    auto const* ref = std::get_if<Ref>(&tree[base]);
+    bool const chainable = options.fastMath ? (exponent == std::trunc(exponent) &&
+                                               std::fabs(exponent) <= maxPowerChain)
+                                            : exponent == 2.0;
+    if (ref == nullptr || !chainable) {
+        return std::nullopt;
+    }
+
+    // the reference node itself is reused, its value is looked up once per occurrence anyway
+    auto chain = base;
+    for (double i = 1.0; i < std::fabs(exponent); i += 1.0) {
+        chain = binary(tree, TokenKind::Star, chain, base, span);
+    }
+    if (exponent < 0.0) {
+        chain = binary(tree, TokenKind::Slash, literal(tree, 1.0, span), chain, span);
+    }
+    return chain;
+}
+
+Result<ExprIndex> optimizeNode(ExpressionTree& tree,
+                               ExprIndex index,
+                               OptimizeOptions const& options,
+                               FunctionRegistry const& functions);
+
+VoidResult optimizeChild(ExpressionTree& tree,
+                         ExprIndex& child,
+                         OptimizeOptions const& options,
+                         FunctionRegistry const& functions) {
+    auto result = optimizeNode(tree, child, options, functions);
+    SF_RETURN_ERROR_IF_UNEXPECTED(result);
+    child = *result;
+    return {};
+}
+
+ExprIndex simplifyUnary(ExpressionTree& tree, ExprIndex index) {
+    auto const expression = std::get<Unary>(tree[index]);
+
+    if (literalValue(tree, expression.rhs)) {
+        return literal(tree, fold(tree, index), expression.span);
+    }
+    if (expression.op == TokenKind::Plus) {
+        return expression.rhs;
+    }
+    if (expression.op == TokenKind::Minus) {
+        auto const* inner = std::get_if<Unary>(&tree[expression.rhs]);
+        if (inner != nullptr && inner->op == TokenKind::Minus) {
+            return inner->rhs;
+        }
+    }
+    return index;
+}
+
+Result<ExprIndex> simplifyBinary(ExpressionTree& tree,
+                                 ExprIndex index,
+                                 OptimizeOptions const& options) {
+    auto const expression = std::get<Binary>(tree[index]);
+    auto const span = expression.span;
+    auto const lhs = literalValue(tree, expression.lhs);
+    auto const rhs = literalValue(tree, expression.rhs);
+
+    if (lhs && rhs) {
+        SF_RETURN_UNEXPECTED_IF_SPAN((expression.op == TokenKind::Slash ||
+                                      expression.op == TokenKind::Percent) &&
+                                         *rhs == 0.0,
+                                     SF_ERR_INVALID_DSL,
+                                     "Division by zero not allowed",
+                                     span);
+        return literal(tree, fold(tree, index), span);
+    }
+
+    switch (expression.op) {
+    case TokenKind::Plus:
+        if (rhs && isNeutralAddend(*rhs, options)) {
+            return expression.lhs;
+        }
+        if (lhs && isNeutralAddend(*lhs, options)) {
+            return expression.rhs;
+        }
+        break;
+    case TokenKind::Minus:
+        // x - 0 == x holds for every x, x - -0 doesn't for x == -0
+        if (rhs == 0.0 && (!std::signbit(*rhs) || options.fastMath)) {
+            return expression.lhs;
+        }
+        if (lhs == 0.0 && options.fastMath) {
+            return unary(tree, TokenKind::Minus, expression.rhs, span);
+        }
+        break;
+    case TokenKind::Star:
+        if (rhs == 1.0) {
+            return expression.lhs;
+        }
+        if (lhs == 1.0) {
+            return expression.rhs;
+        }
+        if (rhs == -1.0) {
+            return unary(tree, TokenKind::Minus, expression.lhs, span);
+        }
+        if (lhs == -1.0) {
+            return unary(tree, TokenKind::Minus, expression.rhs, span);
+        }
+        if (options.fastMath && (rhs == 0.0 || lhs == 0.0)) {
+            return literal(tree, 0.0, span);
+        }
+        break;
+    case TokenKind::Slash:
+        if (rhs == 1.0) {
+            return expression.lhs;
+        }
+        if (rhs && canMultiplyByReciprocal(*rhs, options)) {
+            return binary(
+                tree, TokenKind::Star, expression.lhs, literal(tree, 1.0 / *rhs, span), span);
+        }
+        break;
+    case TokenKind::AndAnd:
+        // the rhs is never evaluated, dropping it also drops its dependencies
+        if (lhs && !isTruthy(*lhs)) {
+            return literal(tree, 0.0, span);
+        }
+        break;
+    case TokenKind::OrOr:
+        if (lhs && isTruthy(*lhs)) {
+            return literal(tree, 1.0, span);
+        }
+        break;
+    case TokenKind::Caret:
+        if (rhs) {
+            if (auto power = simplifyPower(tree, expression.lhs, *rhs, span, options)) {
+                return *power;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    return index;
+}
+
+bool isRounding(ExpressionTree const& tree, ExprIndex index) {
+    auto const* call = std::get_if<Call>(&tree[index]);
+    return call != nullptr &&
+           (isBuiltin(*call, Builtin::Floor) || isBuiltin(*call, Builtin::Ceil) ||
+            isBuiltin(*call, Builtin::Round));
+}
+
+// min/max are associative and commutative apart from the sign of zero results
+void mergeMinMax(ExpressionTree& tree, Call& expression, Builtin function) {
+    auto const original = tree.args(expression);
+    std::vector<ExprIndex> pending(original.begin(), original.end());
+    std::vector<ExprIndex> args;
+    std::optional<double> constant;
+    auto const combine = [function](double a, double b) {
+        return function == Builtin::Min ? std::fmin(a, b) : std::fmax(a, b);
+    };
+
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        auto const arg = pending[i];
+        if (auto const* nested = std::get_if<Call>(&tree[arg]);
+            nested && isBuiltin(*nested, function)) {
+            auto const nestedArgs = tree.args(*nested);
+            pending.insert(pending.end(), nestedArgs.begin(), nestedArgs.end());
+        } else if (auto const value = literalValue(tree, arg)) {
+            constant = constant ? combine(*constant, *value) : *value;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (constant) {
+        args.push_back(literal(tree, *constant, expression.span));
+    }
+    expression.firstArg = tree.addArgs(args);
+    expression.argCount = static_cast<std::uint32_t>(args.size());
+}
+
+Result<ExprIndex> simplifyCall(ExpressionTree& tree,
+                               ExprIndex index,
+                               OptimizeOptions const& options,
+                               FunctionRegistry const& functions) {
+    auto expression = std::get<Call>(tree[index]);
+    auto const arg = [&tree, &expression](std::size_t position) -> ExprIndex& {
+        return tree.args(expression)[position];
+    };
+
+    if (isBuiltin(expression, Builtin::Pow)) {
+        return simplifyBinary(
+            tree, binary(tree, TokenKind::Caret, arg(0), arg(1), expression.span), options);
+    }
+    if (isBuiltin(expression, Builtin::Min) || isBuiltin(expression, Builtin::Max)) {
+        if (options.fastMath) {
+            mergeMinMax(tree, expression, static_cast<Builtin>(expression.function));
+            tree[index] = expression;
+        }
+        if (expression.argCount == 1U) {
+            return arg(0);
+        }
+    }
+    if (isBuiltin(expression, Builtin::Abs)) {
+        // abs(abs(x)) and abs(-x) are abs(x)
+        auto const* nested = std::get_if<Call>(&tree[arg(0)]);
+        auto const* negated = std::get_if<Unary>(&tree[arg(0)]);
+        if (nested != nullptr && isBuiltin(*nested, Builtin::Abs)) {
+            return arg(0);
+        }
+        if (negated != nullptr && negated->op == TokenKind::Minus) {
+            arg(0) = negated->rhs;
+        }
+    }
+    // rounding an already rounded value changes nothing
+    if (isRounding(tree, index) && isRounding(tree, arg(0))) {
+        return arg(0);
+    }
+
+    // root(n, x) evaluates as x ^ (1 / n), folding the exponent removes the division
+    if (isBuiltin(expression, Builtin::Root)) {
+        if (auto const rootIndex = literalValue(tree, arg(0))) {
+            auto const exponent = literal(tree, 1.0 / *rootIndex, expression.span);
+            return simplifyBinary(
+                tree, binary(tree, TokenKind::Caret, arg(1), exponent, expression.span), options);
+        }
+    }
+
+    // impure functions have to be called on every evaluation, even for constant arguments
+    if (functions.function(expression.function).pure &&
+        std::ranges::all_of(tree.args(expression), [&tree](ExprIndex child) {
+            return literalValue(tree, child).has_value();
+        })) {
+        return literal(tree, fold(tree, index, functions), expression.span);
+    }
+
+    return index;
+}
+
+Result<ExprIndex> optimizeNode(ExpressionTree& tree,
+                               ExprIndex index,
+                               OptimizeOptions const& options,
+                               FunctionRegistry const& functions) {
+    // children are optimized on copies, optimizing may add nodes and invalidate references
+    if (auto const* node = std::get_if<Unary>(&tree[index])) {
+        auto expression = *node;
+        SF_RETURN_ERROR_IF_UNEXPECTED(optimizeChild(tree, expression.rhs, options, functions));
+        tree[index] = expression;
+        return simplifyUnary(tree, index);
+    }
+
+    if (auto const* node = std::get_if<Binary>(&tree[index])) {
+        auto expression = *node;
+        SF_RETURN_ERROR_IF_UNEXPECTED(optimizeChild(tree, expression.lhs, options, functions));
+        SF_RETURN_ERROR_IF_UNEXPECTED(optimizeChild(tree, expression.rhs, options, functions));
+        tree[index] = expression;
+        return simplifyBinary(tree, index, options);
+    }
+
+    if (auto const* node = std::get_if<Ternary>(&tree[index])) {
+        auto expression = *node;
+        SF_RETURN_ERROR_IF_UNEXPECTED(optimizeChild(tree, expression.cond, options, functions));
+        SF_RETURN_ERROR_IF_UNEXPECTED(
+            optimizeChild(tree, expression.thenExpr, options, functions));
+        SF_RETURN_ERROR_IF_UNEXPECTED(
+            optimizeChild(tree, expression.elseExpr, options, functions));
+        tree[index] = expression;
+
+        if (auto const cond = literalValue(tree, expression.cond)) {
+            return isTruthy(*cond) ? expression.thenExpr : expression.elseExpr;
+        }
+        return index;
+    }
+
+    if (auto const* node = std::get_if<Call>(&tree[index])) {
+        auto const expression = *node;
+        for (std::uint32_t i = 0; i < expression.argCount; ++i) {
+            auto child = tree.args(expression)[i];
+            SF_RETURN_ERROR_IF_UNEXPECTED(optimizeChild(tree, child, options, functions));
+            tree.args(expression)[i] = child;
+        }
+        return simplifyCall(tree, index, options, functions);
+    }
+
+    // literal/reference: nothing to do
+    return index;
+}
+
+} // namespace
+
+VoidResult optimize(ExpressionTree& expression,
+                    OptimizeOptions options,
+                    FunctionRegistry const& functions) {
+    auto const nodes = expression.size();
+    auto rootResult = optimizeNode(expression, expression.root(), options, functions);
+    SF_RETURN_ERROR_IF_UNEXPECTED(rootResult);
+
+    auto const changed = *rootResult != expression.root() || expression.size() != nodes;
+    expression.setRoot(*rootResult);
+    // rewrites leave replaced nodes behind
+    if (changed) {
+        expression.compact();
+    }
+    return {};
+}
+
+} // namespace statforge::dsl
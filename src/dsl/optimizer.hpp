@@ -0,0 +1,22 @@
+#pragma once
+
+#include "dsl/ast.hpp"
+#include "dsl/functions.hpp"
+#include "error/internal/error.hpp"
+
+namespace statforge::dsl {
+
+struct OptimizeOptions {
+    // allow rewrites that may change results for signed zeros, infinities, NaN or rounding
+    bool fastMath{false};
+};
+
+// constant folding, algebraic simplification and strength reduction.
+// without fastMath, rewrites keep the IEEE semantics of signed zeros, infinities and NaN
+// and never introduce additional rounding steps.
+// calls have to be resolved against "functions" already.
+VoidResult optimize(ExpressionTree& expression,
+                    OptimizeOptions options = {},
+                    FunctionRegistry const& functions = FunctionRegistry::builtins());
+
+} // namespace statforge::dsl
@@ -1,4 +1,5 @@
 #include "dsl/parser.hpp"
+#include "dsl/optimizer.hpp"
 #include "dsl/tokenizer.hpp"
 #include "error/error.h"
 #include "error/internal/error.hpp"
@@ -6,12 +7,51 @@
 #include <algorithm>
 #include <cmath>
 #include <expected>
+#include <format>
+#include <span>
+#include <variant>
 
 namespace statforge::dsl {
 
-VoidResult Parser::verify(ExprPtr const& /*ast*/) {
-    // FIXME IMPLEMENT
-    // verify that functions exist
+VoidResult Parser::verify(ExprIndex index) {
+    if (auto* call = std::get_if<Call>(&_tree[index])) {
+        auto const functionIndex = _functions.find(call->name);
+        SF_RETURN_UNEXPECTED_IF_SPAN(!functionIndex,
+                                     SF_ERR_INVALID_DSL,
+                                     std::format("Unknown function '{}'", call->name),
+                                     call->span);
+
+        auto const& function = _functions.function(*functionIndex);
+        auto const count = std::size_t{call->argCount};
+        if (count < function.minArguments || count > function.maxArguments) [[unlikely]] {
+            auto const expected =
+                function.minArguments == function.maxArguments
+                    ? std::format("{}", function.minArguments)
+                : function.maxArguments == variadic
+                    ? std::format("at least {}", function.minArguments)
+                    : std::format("{} to {}", function.minArguments, function.maxArguments);
+            return std::unexpected(buildErrorInfo(
+                SF_ERR_INVALID_DSL,
+                std::format(
+                    "{}() expects {} arguments, provided: {}", call->name, expected, count),
+                call->span));
+        }
+        call->function = *functionIndex;
+
+        for (auto arg : _tree.args(*call)) {
+            SF_RETURN_ERROR_IF_UNEXPECTED(verify(arg));
+        }
+    } else if (auto const* unary = std::get_if<Unary>(&_tree[index])) {
+        SF_RETURN_ERROR_IF_UNEXPECTED(verify(unary->rhs));
+    } else if (auto const* binary = std::get_if<Binary>(&_tree[index])) {
+        SF_RETURN_ERROR_IF_UNEXPECTED(verify(binary->lhs));
+        SF_RETURN_ERROR_IF_UNEXPECTED(verify(binary->rhs));
+    } else if (auto const* ternary = std::get_if<Ternary>(&_tree[index])) {
+        SF_RETURN_ERROR_IF_UNEXPECTED(verify(ternary->cond));
+        SF_RETURN_ERROR_IF_UNEXPECTED(verify(ternary->thenExpr));
+        SF_RETURN_ERROR_IF_UNEXPECTED(verify(ternary->elseExpr));
+    }
+
     return {};
 }
 
@@ -38,7 +78,8 @@ Parser::BindingPower Parser::leftBindingPower(TokenKind kind) {
         return 11; // ^
     case TokenKind::Star:
     case TokenKind::Slash:
-        return 9; // * /
+    case TokenKind::Percent:
+        return 9; // * / %
     case TokenKind::Plus:
     case TokenKind::Minus:
         return 8; // + -
@@ -64,6 +105,7 @@ Parser::BindingPower Parser::rightBindingPower(TokenKind kind) {
         return 11;
     case TokenKind::Star:
     case TokenKind::Slash:
+    case TokenKind::Percent:
         return 10;
     case TokenKind::Plus:
     case TokenKind::Minus:
@@ -84,141 +126,34 @@ Parser::BindingPower Parser::rightBindingPower(TokenKind kind) {
     }
 }
 
-ExprPtrResult Parser::foldConstants(ExprPtr node) {
-    auto lit = [](double val, Span span) {
-        return std::make_unique<ExpressionTree>(Literal{.value = val, .span = span});
-    };
-
-    std::optional<ErrorInfo> error;
-
-    std::visit(
-        [&](auto& actual) {
-            using Node = std::decay_t<decltype(actual)>;
-
-            auto prop = [&](ExprPtrResult r) {
-                if (!r) {
-                    error.emplace(std::move(r).error());
-                    return ExprPtr{};
-                }
-                return std::move(r).value();
-            };
-
-            if constexpr (std::is_same_v<Node, Unary>) {
-                actual.rhs = prop(foldConstants(std::move(actual.rhs)));
-                if (error) {
-                    return;
-                }
-                if (auto const* rhs = std::get_if<Literal>(actual.rhs.get())) {
-                    double val = (actual.op == TokenKind::Minus)  ? -rhs->value
-                                 : (actual.op == TokenKind::Plus) ? rhs->value
-                                                                  : (rhs->value == 0.0 ? 1.0 : 0.0);
-                    node = lit(val, actual.span);
-                }
-
-            } else if constexpr (std::is_same_v<Node, Binary>) {
-                actual.lhs = prop(foldConstants(std::move(actual.lhs)));
-                if (error) {
-                    return;
-                }
-                actual.rhs = prop(foldConstants(std::move(actual.rhs)));
-                if (error) {
-                    return;
-                }
-                if (auto const* lhs = std::get_if<Literal>(actual.lhs.get()))
-                    if (auto const* rhs = std::get_if<Literal>(actual.rhs.get())) {
-                        if (actual.op == TokenKind::Slash && rhs->value == 0.0) {
-                            error.emplace(buildErrorInfo(SF_ERR_INVALID_DSL,
-                                                         "Division by zero not allowed",
-                                                         actual.span));
-                            return;
-                        }
-                        double val{};
-                        switch (actual.op) {
-                        case TokenKind::Plus:
-                            val = lhs->value + rhs->value;
-                            break;
-                        case TokenKind::Minus:
-                            val = lhs->value - rhs->value;
-                            break;
-                        case TokenKind::Star:
-                            val = lhs->value * rhs->value;
-                            break;
-                        case TokenKind::Slash:
-                            val = lhs->value / rhs->value;
-                            break;
-                        case TokenKind::Caret:
-                            val = std::pow(lhs->value, rhs->value);
-                            break;
-                        default:
-                            return; // don't fold logical comps
-                        }
-                        node = lit(val, actual.span);
-                    }
-
-            } else if constexpr (std::is_same_v<Node, Ternary>) {
-                actual.cond = prop(foldConstants(std::move(actual.cond)));
-                if (error) {
-                    return;
-                }
-                actual.thenExpr = prop(foldConstants(std::move(actual.thenExpr)));
-                if (error) {
-                    return;
-                }
-                actual.elseExpr = prop(foldConstants(std::move(actual.elseExpr)));
-                if (error) {
-                    return;
-                }
-
-                if (auto const* c = std::get_if<Literal>(actual.cond.get())) {
-                    node =
-                        (c->value != 0.0) ? std::move(actual.thenExpr) : std::move(actual.elseExpr);
-                }
-
-            } else if constexpr (std::is_same_v<Node, Call>) {
-                for (auto& arg : actual.args) {
-                    arg = prop(foldConstants(std::move(arg)));
-                    if (error) {
-                        return;
-                    }
-                }
-            }
-            // literal/reference: nothing to do
-        },
-        *node);
-
-    if (error) {
-        return std::unexpected(std::move(*error));
-    }
-
-    return node;
-}
-
-ExprPtrResult Parser::parsePrimary() {
+Parser::IndexResult Parser::parsePrimary() {
     const Token& token = advance();
     switch (token.kind) {
     case TokenKind::Number:
-        return std::make_unique<ExpressionTree>(Literal{.value = token.number, .span = token.span});
+        return _tree.add(Literal{.value = token.number, .span = token.span});
 
     case TokenKind::NodeRef:
-        return std::make_unique<ExpressionTree>(Ref{.name = token.lexeme, .span = token.span});
+        return _tree.add(Ref{.name = token.lexeme, .span = token.span});
 
     case TokenKind::Identifier:
         if (match(TokenKind::LeftParen)) {
-            std::vector<ExprPtr> args;
+            auto const firstPending = _pendingArgs.size();
             if (!match(TokenKind::RightParen)) {
                 do {
-                    auto astResult = parseExpression(0);
-                    SF_RETURN_ERROR_IF_UNEXPECTED(astResult);
+                    auto argResult = parseExpression(0);
+                    SF_RETURN_ERROR_IF_UNEXPECTED(argResult);
 
-                    args.push_back(std::move(astResult).value());
+                    _pendingArgs.push_back(*argResult);
                 } while (match(TokenKind::Comma));
                 SF_RETURN_UNEXPECTED_IF_SPAN(!match(TokenKind::RightParen),
                                              SF_ERR_INVALID_DSL,
                                              "Missing ')' after arguments",
                                              peek().span);
             }
-            return std::make_unique<ExpressionTree>(
-                Call{.name = token.lexeme, .args = std::move(args), .span = token.span});
+            auto const args = std::span{_pendingArgs}.subspan(firstPending);
+            auto const call = _tree.addCall(token.lexeme, args, token.span);
+            _pendingArgs.resize(firstPending);
+            return call;
         }
         return std::unexpected(buildErrorInfo(SF_ERR_INVALID_DSL,
                                               "Bare identifier not allowed, use <id> for node ref",
@@ -230,8 +165,7 @@ ExprPtrResult Parser::parsePrimary() {
         auto rhsResult = parseExpression(11); // unary precedence
         SF_RETURN_ERROR_IF_UNEXPECTED(rhsResult);
 
-        return std::make_unique<ExpressionTree>(
-            Unary{.op = token.kind, .rhs = std::move(rhsResult).value(), .span = token.span});
+        return _tree.add(Unary{.op = token.kind, .rhs = *rhsResult, .span = token.span});
     }
 
     case TokenKind::LeftParen: {
@@ -252,10 +186,10 @@ ExprPtrResult Parser::parsePrimary() {
     }
 }
 
-ExprPtrResult Parser::parseExpression(BindingPower minBindingPower) {
+Parser::IndexResult Parser::parseExpression(BindingPower minBindingPower) {
     auto lhsResult = parsePrimary();
     SF_RETURN_ERROR_IF_UNEXPECTED(lhsResult);
-    auto lhs = std::move(lhsResult).value();
+    auto lhs = *lhsResult;
 
     while (true) {
         // ternary needs special peek
@@ -271,11 +205,10 @@ ExprPtrResult Parser::parseExpression(BindingPower minBindingPower) {
             auto elseResult = parseExpression(0);
             SF_RETURN_ERROR_IF_UNEXPECTED(elseResult);
 
-            lhs =
-                std::make_unique<ExpressionTree>(Ternary{.cond = std::move(lhs),
-                                                         .thenExpr = std::move(thenResult).value(),
-                                                         .elseExpr = std::move(elseResult).value(),
-                                                         .span = peek(-1).span});
+            lhs = _tree.add(Ternary{.cond = lhs,
+                                    .thenExpr = *thenResult,
+                                    .elseExpr = *elseResult,
+                                    .span = peek(-1).span});
             continue;
         }
 
@@ -290,33 +223,33 @@ ExprPtrResult Parser::parseExpression(BindingPower minBindingPower) {
         auto rhsResult = parseExpression(rhsBindingPower);
         SF_RETURN_ERROR_IF_UNEXPECTED(rhsResult);
 
-        lhs = std::make_unique<ExpressionTree>(Binary{.op = nextOperator,
-                                                      .lhs = std::move(lhs),
-                                                      .rhs = std::move(rhsResult).value(),
-                                                      .span = peek(-1).span});
+        lhs = _tree.add(
+            Binary{.op = nextOperator, .lhs = lhs, .rhs = *rhsResult, .span = peek(-1).span});
     }
-    return std::move(lhs);
+    return lhs;
 }
 
-ExprPtrResult Parser::parse(bool fold) {
-    auto astResult = parseExpression();
-    SF_RETURN_ERROR_IF_UNEXPECTED(astResult);
+ExpressionTreeResult Parser::parse(bool fold) {
+    // every token produces at most one node
+    _tree.reserve(_tokens.size());
+
+    auto rootResult = parseExpression();
+    SF_RETURN_ERROR_IF_UNEXPECTED(rootResult);
+    _tree.setRoot(*rootResult);
 
     SF_RETURN_UNEXPECTED_IF_SPAN(!match(TokenKind::EndOfFile),
                                  SF_ERR_INVALID_DSL,
                                  "Unexpected trailing tokens",
                                  peek().span);
 
-    if (fold) [[likely]] {
-        astResult = foldConstants(std::move(astResult).value());
-    }
+    // the optimizer relies on resolved functions
+    SF_RETURN_ERROR_IF_UNEXPECTED(verify(_tree.root()));
 
-    if (astResult) {
-        auto result = verify(astResult.value());
-        SF_RETURN_ERROR_IF_UNEXPECTED(result);
+    if (fold) [[likely]] {
+        SF_RETURN_ERROR_IF_UNEXPECTED(optimize(_tree, _options, _functions));
     }
 
-    return astResult;
+    return std::move(_tree);
 }
 
 } // namespace statforge::dsl
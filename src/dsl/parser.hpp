@@ -1,37 +1,47 @@
 #pragma once
 
 #include "dsl/ast.hpp"
+#include "dsl/functions.hpp"
+#include "dsl/optimizer.hpp"
 #include "dsl/tokenizer.hpp"
 #include "error/internal/error.hpp"
 
 namespace statforge::dsl {
 
-using ExprPtrResult = Result<ExprPtr>;
-
 class Parser {
 public:
-    explicit Parser(std::vector<Token> const& tokens) : _tokens{tokens} {
+    explicit Parser(std::vector<Token> const& tokens,
+                    OptimizeOptions options = {},
+                    FunctionRegistry const& functions = FunctionRegistry::builtins())
+        : _tokens{tokens}, _options{options}, _functions{functions} {
     }
-    [[nodiscard]] ExprPtrResult parse(bool fold = true);
+    [[nodiscard]] ExpressionTreeResult parse(bool fold = true);
 
 private:
     using BindingPower = int;
+    using IndexResult = Result<ExprIndex>;
 
-    VoidResult verify(ExprPtr const&);
+    // resolves function calls and checks their arity
+    VoidResult verify(ExprIndex index);
 
     [[nodiscard]] const Token& peek(std::size_t offset = 0) const;
     bool match(TokenKind kind);
     const Token& advance();
 
-    ExprPtrResult parseExpression(BindingPower minBindingPower = 0);
-    ExprPtrResult parsePrimary();
+    IndexResult parseExpression(BindingPower minBindingPower = 0);
+    IndexResult parsePrimary();
 
     static BindingPower leftBindingPower(TokenKind);
     static BindingPower rightBindingPower(TokenKind);
-    static ExprPtrResult foldConstants(ExprPtr);
 
     std::vector<Token> const& _tokens;
+    OptimizeOptions _options;
+    FunctionRegistry const& _functions;
     std::size_t _pos{0};
+
+    ExpressionTree _tree;
+    // arguments of calls still being parsed, nested calls push on top
+    std::vector<ExprIndex> _pendingArgs;
 };
 
 } // namespace statforge::dsl
\ No newline at end of file
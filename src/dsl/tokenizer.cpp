@@ -39,7 +39,7 @@ void Tokenizer::advance() {
 }
 
 void Tokenizer::add(TokenKind k) {
-    _tokens.push_back(Token{.kind = k, .lexeme = _source.substr(_pos - 1, 1), .span = _here});
+    _tokens->push_back(Token{.kind = k, .lexeme = _source.substr(_pos - 1, 1), .span = _here});
 }
 
 void Tokenizer::number() {
@@ -56,7 +56,7 @@ void Tokenizer::number() {
     const std::string_view lex = _source.substr(start, _pos - start);
     double value{};
     std::from_chars(lex.begin(), lex.end(), value);
-    _tokens.push_back(
+    _tokens->push_back(
         Token{.kind = TokenKind::Number, .lexeme = lex, .span = _here, .number = value});
 }
 
@@ -68,21 +68,42 @@ void Tokenizer::identifierOrKeyword() {
     const std::string_view lex = _source.substr(start, _pos - start);
 
     if (lex == "true" || lex == "false") {
-        _tokens.push_back(Token{.kind = TokenKind::Number,
+        _tokens->push_back(Token{.kind = TokenKind::Number,
                                 .lexeme = lex,
                                 .span = _here,
                                 .number = lex == "true" ? 1.0 : 0.0});
         return;
     }
-    _tokens.push_back(Token{.kind = TokenKind::Identifier, .lexeme = lex, .span = _here});
+    _tokens->push_back(Token{.kind = TokenKind::Identifier, .lexeme = lex, .span = _here});
 }
 
 VoidResult Tokenizer::nodeReference() {
     Span begin = _here;
     advance(); // skip leading '<'
     const std::size_t start = _pos;
-    while (isReferenceChar(peek())) {
-        advance();
+    if (match('$')) {
+        // formula template placeholder, <$0>, <$1>, ...
+        SF_RETURN_UNEXPECTED_IF_SPAN(std::isdigit(peek()) == 0,
+                                     SF_ERR_INVALID_DSL,
+                                     std::format(R"(Expected placeholder index after '$')"),
+                                     _here);
+        Span const index = _here;
+        while (std::isdigit(peek())) {
+            advance();
+        }
+        // template instances look their bindings up by this index
+        auto const digits = _source.substr(start + 1, _pos - start - 1);
+        std::size_t value{};
+        auto const* const last = digits.data() + digits.size();
+        auto const [end, error] = std::from_chars(digits.data(), last, value);
+        SF_RETURN_UNEXPECTED_IF_SPAN(error != std::errc{} || end != last,
+                                     SF_ERR_INVALID_DSL,
+                                     std::format(R"(Placeholder index "{}" is too large)", digits),
+                                     index);
+    } else {
+        while (isReferenceChar(peek())) {
+            advance();
+        }
     }
     const auto name = _source.substr(start, _pos - start);
     SF_RETURN_UNEXPECTED_IF_SPAN(peek() != '>',
@@ -91,12 +112,20 @@ VoidResult Tokenizer::nodeReference() {
                                  _here);
 
     advance(); // consume '>'
-    _tokens.push_back(Token{.kind = TokenKind::NodeRef, .lexeme = name, .span = begin});
+    _tokens->push_back(Token{.kind = TokenKind::NodeRef, .lexeme = name, .span = begin});
 
     return {};
 }
 
 TokenResult Tokenizer::tokenize() {
+    std::vector<Token> tokens;
+    SF_RETURN_ERROR_IF_UNEXPECTED(tokenize(tokens));
+    return tokens;
+}
+
+VoidResult Tokenizer::tokenize(std::vector<Token>& tokens) {
+    tokens.clear();
+    _tokens = &tokens;
     while (peek() != '\0') {
         char currentCharacter = peek();
         advance();
@@ -133,12 +162,15 @@ TokenResult Tokenizer::tokenize() {
         case '/':
             add(TokenKind::Slash);
             continue;
+        case '%':
+            add(TokenKind::Percent);
+            continue;
         case '^':
             add(TokenKind::Caret);
             continue;
         case '!':
             if (match('=')) {
-                _tokens.push_back(
+                _tokens->push_back(
                     Token{.kind = TokenKind::BangEqual, .lexeme = "!=", .span = _here});
             } else {
                 add(TokenKind::Bang);
@@ -146,9 +178,9 @@ TokenResult Tokenizer::tokenize() {
             continue;
         case '<':
             if (match('=')) {
-                _tokens.push_back(
+                _tokens->push_back(
                     Token{.kind = TokenKind::LessEqual, .lexeme = "<=", .span = _here});
-            } else if (std::isalpha(peek())) {
+            } else if (std::isalpha(peek()) || peek() == '$') {
                 _pos--;
                 _here.column--;
                 auto result = nodeReference();
@@ -159,7 +191,7 @@ TokenResult Tokenizer::tokenize() {
             continue;
         case '>':
             if (match('=')) {
-                _tokens.push_back(
+                _tokens->push_back(
                     Token{.kind = TokenKind::GreaterEqual, .lexeme = ">=", .span = _here});
             } else {
                 add(TokenKind::Greater);
@@ -167,7 +199,7 @@ TokenResult Tokenizer::tokenize() {
             continue;
         case '=':
             if (match('=')) {
-                _tokens.push_back(
+                _tokens->push_back(
                     Token{.kind = TokenKind::EqualEqual, .lexeme = "==", .span = _here});
             } else {
                 return std::unexpected(buildErrorInfo(
@@ -178,7 +210,7 @@ TokenResult Tokenizer::tokenize() {
             continue;
         case '&':
             if (match('&')) {
-                _tokens.push_back(Token{.kind = TokenKind::AndAnd, .lexeme = "&&", .span = _here});
+                _tokens->push_back(Token{.kind = TokenKind::AndAnd, .lexeme = "&&", .span = _here});
             } else {
                 return std::unexpected(buildErrorInfo(SF_ERR_INVALID_DSL,
                                                       std::format(R"(Single '&' not supported)"),
@@ -187,7 +219,7 @@ TokenResult Tokenizer::tokenize() {
             continue;
         case '|':
             if (match('|')) {
-                _tokens.push_back(Token{.kind = TokenKind::OrOr, .lexeme = "||", .span = _here});
+                _tokens->push_back(Token{.kind = TokenKind::OrOr, .lexeme = "||", .span = _here});
             } else {
                 return std::unexpected(buildErrorInfo(SF_ERR_INVALID_DSL,
                                                       std::format(R"(Single '|' not supported)"),
@@ -215,8 +247,8 @@ TokenResult Tokenizer::tokenize() {
             }
         }
     }
-    _tokens.push_back(Token{.kind = TokenKind::EndOfFile, .lexeme = {}, .span = _here});
-    return _tokens;
+    _tokens->push_back(Token{.kind = TokenKind::EndOfFile, .lexeme = {}, .span = _here});
+    return {};
 }
 
 } // namespace statforge::dsl
\ No newline at end of file
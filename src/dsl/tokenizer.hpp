@@ -21,6 +21,7 @@ enum class TokenKind : uint8_t {
     Minus,
     Star,
     Slash,
+    Percent,
     Caret,
     Bang,
 
@@ -54,6 +55,8 @@ public:
     explicit Tokenizer(std::string_view src) : _source{src} {
     }
     TokenResult tokenize();
+    // refills "tokens", reusing its capacity across formulas
+    VoidResult tokenize(std::vector<Token>& tokens);
 
 private:
     [[nodiscard]] char peek(std::size_t off = 0) const;
@@ -65,7 +68,7 @@ private:
     VoidResult nodeReference();
 
     std::string_view _source;
-    std::vector<Token> _tokens;
+    std::vector<Token>* _tokens{nullptr};
     std::size_t _pos{0};
     Span _here{};
 };
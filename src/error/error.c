@@ -6,7 +6,8 @@
 #include <sys/types.h>
 
 #define MAX_ERROR_MSG_LENGTH 1024
-static char sf_error_msg[MAX_ERROR_MSG_LENGTH];
+// engines keep their own errors, only calls without a valid engine end up here
+static _Thread_local char sf_error_msg[MAX_ERROR_MSG_LENGTH];
 
 
 void sf_set_error(const char* fmt, ...) {
@@ -17,7 +18,7 @@ void sf_set_error(const char* fmt, ...) {
 }
 
 const char* sf_last_error(void) {
-    static char msg_buffer[MAX_ERROR_MSG_LENGTH];
+    static _Thread_local char msg_buffer[MAX_ERROR_MSG_LENGTH];
     strncpy(msg_buffer, sf_error_msg, MAX_ERROR_MSG_LENGTH);
     msg_buffer[MAX_ERROR_MSG_LENGTH - 1] = '\0';
 
@@ -47,6 +47,27 @@ typedef enum SF_ErrorCode {
     // Attempted to use an unsupported collection operation.
     SF_ERR_INVALID_COLLECTION_OPERATION,
 
+    // Attempted to register a function with an invalid name, arity or callable.
+    SF_ERR_INVALID_FUNCTION,
+
+    // Attempted to register a function with a name that is already in use.
+    SF_ERR_FUNCTION_ALREADY_EXISTS,
+
+    // Attempted to create a formula template with a name that is already in use.
+    SF_ERR_TEMPLATE_ALREADY_EXISTS,
+
+    // Attempted to instantiate a formula template that does not exist.
+    SF_ERR_TEMPLATE_NOT_FOUND,
+
+    // Number of bound nodes doesn't match the placeholders of a formula template.
+    SF_ERR_TEMPLATE_BINDING_MISMATCH,
+
+    // Tag or tag query was ill-formed.
+    SF_ERR_INVALID_TAG,
+
+    // Attempted to access an entity outside of an entity batch.
+    SF_ERR_INVALID_ENTITY,
+
 
     /*** Evaluation ***/
     /*
@@ -82,15 +103,17 @@ typedef struct SF_Value {
 } SF_Value;
 
 /**
- * @brief sets an error message. overwrites the previous message.
+ * @brief sets the error message of the calling thread. overwrites the previous message.
+ *        errors of calls on a valid engine are kept by that engine instead,
+ *        see sf_engine_last_error().
  * 
  * @return  
  */
 void sf_set_error(const char* fmt, ...);
 
 /**
- * @brief returns the message of the last error and consumes that message.
- *        pointer is valid until a new error is written.
+ * @brief returns the message of the last error on the calling thread and consumes that
+ *        message. pointer is valid until the thread reads its next error.
  * 
  * @return const char* 
  */
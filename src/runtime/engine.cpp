@@ -2,20 +2,13 @@
 #include "error/error.h"
 
 #include <cctype>
+#include <utility>
 #include <vector>
 
 namespace statforge::runtime {
 
 namespace {
 
-SF_ErrorCode extractErrorCode(VoidResult&& result) {
-    if (result) {
-        return SF_OK;
-    }
-    sf_set_error("%s", result.error().message.c_str());
-    return result.error().errorCode;
-}
-
 std::vector<NodeId> parseDependencies(std::string_view dependencies) {
     std::vector<NodeId> parsed;
     std::string current;
@@ -49,14 +42,42 @@ SF_ErrorCode EngineImpl::createCollectionNode(NodeId const& name, SF_CollectionO
     return extractErrorCode(ctx.kernel.createCollectionNode(name, {}, operation));
 }
 
+SF_ErrorCode EngineImpl::createQueryCollectionNode(NodeId const& name,
+                                                   std::string_view query,
+                                                   SF_CollectionOperation operation) {
+    return extractErrorCode(ctx.kernel.createQueryCollectionNode(name, query, operation));
+}
+
 SF_ErrorCode EngineImpl::createFormulaNode(NodeId const& name, std::string_view formula) {
     return extractErrorCode(ctx.kernel.createFormulaNode(name, formula));
 }
 
+SF_ErrorCode EngineImpl::createModifierNode(NodeId const& name,
+                                            std::string_view base,
+                                            std::string_view increased,
+                                            std::string_view more) {
+    return extractErrorCode(ctx.kernel.createModifierNode(
+        name,
+        {.base = parseDependencies(base),
+         .increased = parseDependencies(increased),
+         .more = parseDependencies(more)}));
+}
+
 SF_ErrorCode EngineImpl::createValueNode(NodeId const& name, double value) {
     return extractErrorCode(ctx.kernel.createValueNode(name, value));
 }
 
+SF_ErrorCode EngineImpl::createFormulaTemplate(std::string const& name, std::string_view formula) {
+    return extractErrorCode(ctx.kernel.createFormulaTemplate(name, formula));
+}
+
+SF_ErrorCode EngineImpl::createTemplateNode(NodeId const& name,
+                                            std::string const& templateName,
+                                            std::string_view bindings) {
+    return extractErrorCode(
+        ctx.kernel.createTemplateNode(name, templateName, parseDependencies(bindings)));
+}
+
 SF_ErrorCode EngineImpl::removeNode(NodeId const& name) {
     return extractErrorCode(ctx.kernel.removeNode(name));
 }
@@ -73,30 +94,172 @@ SF_ErrorCode EngineImpl::setNodeDependency(NodeId const& name, std::string_view
     return extractErrorCode(ctx.kernel.setNodeDependencies(name, parseDependencies(dependencies)));
 }
 
+SF_ErrorCode EngineImpl::setModifierNodeGroups(NodeId const& name,
+                                               std::string_view base,
+                                               std::string_view increased,
+                                               std::string_view more) {
+    return extractErrorCode(ctx.kernel.setModifierNodeGroups(
+        name,
+        {.base = parseDependencies(base),
+         .increased = parseDependencies(increased),
+         .more = parseDependencies(more)}));
+}
+
+SF_ErrorCode EngineImpl::addCollectionMembers(NodeId const& name,
+                                              std::span<NodeId const> members) {
+    return extractErrorCode(ctx.kernel.addCollectionMembers(name, members));
+}
+
+SF_ErrorCode EngineImpl::removeCollectionMembers(NodeId const& name,
+                                                 std::span<NodeId const> members) {
+    return extractErrorCode(ctx.kernel.removeCollectionMembers(name, members));
+}
+
+SF_ErrorCode EngineImpl::addGatedCollectionMember(NodeId const& name,
+                                                  NodeId const& member,
+                                                  NodeId const& gate) {
+    return extractErrorCode(ctx.kernel.addGatedCollectionMember(name, member, gate));
+}
+
+SF_ErrorCode EngineImpl::setNodeTags(NodeId const& name, std::string_view tags) {
+    return extractErrorCode(ctx.kernel.setNodeTags(name, parseDependencies(tags)));
+}
+
 SF_ErrorCode EngineImpl::getNodeValue(NodeId const& name, double& value) {
     auto result = ctx.kernel.getNodeValue(name);
     if (!result) {
-        sf_set_error("%s", result.error().message.c_str());
-        return result.error().errorCode;
+        _lastError = std::move(result).error();
+        return _lastError->errorCode;
     }
     value = *result;
     return SF_OK;
 }
 
+SF_ErrorCode EngineImpl::getNodeValueView(NodeId const& name, double const*& view) {
+    auto result = ctx.kernel.getNodeValueView(name);
+    if (!result) {
+        _lastError = std::move(result).error();
+        return _lastError->errorCode;
+    }
+    view = *result;
+    return SF_OK;
+}
+
+std::uint64_t EngineImpl::getCleanEpoch() const {
+    return ctx.kernel.cleanEpoch();
+}
+
+SF_ErrorCode EngineImpl::setNodeValues(std::span<NodeId const> names,
+                                       std::span<double const> values,
+                                       std::span<SF_ErrorCode> errors) {
+    return extractErrorCode(ctx.kernel.setNodeValues(names, values, errors));
+}
+
+SF_ErrorCode EngineImpl::getNodeValues(std::span<NodeId const> names,
+                                       std::span<double> values,
+                                       std::span<SF_ErrorCode> errors) {
+    return extractErrorCode(ctx.kernel.getNodeValues(names, values, errors));
+}
+
+SF_ErrorCode EngineImpl::registerFunction(std::string name,
+                                          dsl::Intrinsic callable,
+                                          std::size_t minArguments,
+                                          std::size_t maxArguments,
+                                          bool pure) {
+    return extractErrorCode(ctx.kernel.registerFunction(
+        std::move(name), std::move(callable), minArguments, maxArguments, pure));
+}
+
+void EngineImpl::setFormulaCacheCapacity(std::size_t capacity) {
+    ctx.kernel.setFormulaCacheCapacity(capacity);
+}
+
+SF_FormulaCacheStats EngineImpl::getFormulaCacheStats() const {
+    auto const stats = ctx.kernel.formulaCacheStats();
+    return {.hits = stats.hits,
+            .misses = stats.misses,
+            .size = stats.size,
+            .capacity = stats.capacity};
+}
+
 std::string EngineImpl::getLastError() {
-    return sf_last_error();
+    if (!_lastError) {
+        return {};
+    }
+    auto message = std::move(_lastError->message);
+    _lastError.reset();
+    return message;
 }
 
-void EngineImpl::evaluate() {
-    auto result = ctx.kernel.evaluate();
-    if (!result) {
-        sf_set_error("%s", result.error().message.c_str());
-        return;
+char const* EngineImpl::lastErrorMessage() {
+    _reportedError = getLastError();
+    return _reportedError.c_str();
+}
+
+SF_ErrorCode EngineImpl::fail(SF_ErrorCode code, std::string message) {
+    _lastError = buildErrorInfo(code, std::move(message));
+    return code;
+}
+
+SF_ErrorCode EngineImpl::extractErrorCode(VoidResult&& result) {
+    if (result) {
+        return SF_OK;
     }
+    _lastError = std::move(result).error();
+    return _lastError->errorCode;
+}
+
+void EngineImpl::evaluate() {
+    extractErrorCode(ctx.kernel.evaluate());
+}
+
+bool EngineImpl::needsEvaluation() const {
+    return ctx.kernel.needsEvaluation();
 }
 
 void EngineImpl::reset() {
     ctx.reset();
 }
 
+std::shared_ptr<statkernel::Sheet const> EngineImpl::compileSheet() {
+    auto result = ctx.kernel.compileSheet();
+    if (!result) {
+        _lastError = std::move(result).error();
+        return nullptr;
+    }
+    return std::move(*result);
+}
+
+std::optional<statkernel::SheetFork> EngineImpl::fork() {
+    auto result = ctx.kernel.fork();
+    if (!result) {
+        _lastError = std::move(result).error();
+        return std::nullopt;
+    }
+    return std::move(*result);
+}
+
+SF_ErrorCode EngineImpl::scoreCandidates(
+    std::span<std::vector<statkernel::Command> const> candidates,
+    std::span<NodeId const> targets,
+    std::span<double> deltas) {
+    return extractErrorCode(ctx.kernel.scoreCandidates(candidates, targets, deltas));
+}
+
+void EngineImpl::queueCommand(statkernel::Command command) {
+    ctx.kernel.queueCommand(std::move(command));
+}
+
+SF_ErrorCode EngineImpl::applyCommands() {
+    return extractErrorCode(ctx.kernel.applyCommands());
+}
+
+SF_ErrorCode EngineImpl::publishSnapshot() {
+    return extractErrorCode(ctx.kernel.publishSnapshot());
+}
+
+std::shared_ptr<statkernel::Snapshot const> EngineImpl::latestSnapshot() const {
+    return ctx.kernel.latestSnapshot();
+}
+
 } // namespace statforge::runtime
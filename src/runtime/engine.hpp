@@ -1,8 +1,13 @@
 #pragma once
 
+#include "api/c.h"
 #include "runtime/context.hpp"
 #include "types/collection_operation.h"
 
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
 
 namespace statforge::runtime {
@@ -13,20 +18,80 @@ public:
                    statkernel::Executor::EvaluationType::Iterative);
 
     SF_ErrorCode createCollectionNode(NodeId const& name, SF_CollectionOperation operation);
+    SF_ErrorCode createQueryCollectionNode(NodeId const& name,
+                                           std::string_view query,
+                                           SF_CollectionOperation operation);
     SF_ErrorCode createFormulaNode(NodeId const& name, std::string_view formula);
+    SF_ErrorCode createModifierNode(NodeId const& name,
+                                    std::string_view base,
+                                    std::string_view increased,
+                                    std::string_view more);
     SF_ErrorCode createValueNode(NodeId const& name, double value);
+    SF_ErrorCode createFormulaTemplate(std::string const& name, std::string_view formula);
+    SF_ErrorCode createTemplateNode(NodeId const& name,
+                                    std::string const& templateName,
+                                    std::string_view bindings);
     SF_ErrorCode removeNode(NodeId const& name);
     SF_ErrorCode setNodeValue(NodeId const& name, double value);
     SF_ErrorCode setNodeFormula(NodeId const& name, std::string_view formula);
     SF_ErrorCode setNodeDependency(NodeId const& name, std::string_view dependencies);
+    SF_ErrorCode setModifierNodeGroups(NodeId const& name,
+                                       std::string_view base,
+                                       std::string_view increased,
+                                       std::string_view more);
+    SF_ErrorCode addCollectionMembers(NodeId const& name, std::span<NodeId const> members);
+    SF_ErrorCode removeCollectionMembers(NodeId const& name, std::span<NodeId const> members);
+    SF_ErrorCode addGatedCollectionMember(NodeId const& name,
+                                          NodeId const& member,
+                                          NodeId const& gate);
+    SF_ErrorCode setNodeTags(NodeId const& name, std::string_view tags);
     SF_ErrorCode getNodeValue(NodeId const& name, double& value);
+    SF_ErrorCode getNodeValueView(NodeId const& name, double const*& view);
+    std::uint64_t getCleanEpoch() const;
+    SF_ErrorCode setNodeValues(std::span<NodeId const> names,
+                               std::span<double const> values,
+                               std::span<SF_ErrorCode> errors);
+    SF_ErrorCode getNodeValues(std::span<NodeId const> names,
+                               std::span<double> values,
+                               std::span<SF_ErrorCode> errors);
+    SF_ErrorCode registerFunction(std::string name,
+                                  dsl::Intrinsic callable,
+                                  std::size_t minArguments,
+                                  std::size_t maxArguments,
+                                  bool pure);
+    void setFormulaCacheCapacity(std::size_t capacity);
+    SF_FormulaCacheStats getFormulaCacheStats() const;
+    // error of the last failing call on this engine, reading it consumes it
     std::string getLastError();
+    // same as getLastError(), valid until the next call on this engine
+    char const* lastErrorMessage();
+    // records an error of the api layer, e.g. a null argument
+    SF_ErrorCode fail(SF_ErrorCode code, std::string message);
 
     void evaluate();
+    [[nodiscard]] bool needsEvaluation() const;
     void reset();
+    // nullptr on failure
+    std::shared_ptr<statkernel::Sheet const> compileSheet();
+    // std::nullopt on failure
+    std::optional<statkernel::SheetFork> fork();
+    SF_ErrorCode scoreCandidates(std::span<std::vector<statkernel::Command> const> candidates,
+                                 std::span<NodeId const> targets,
+                                 std::span<double> deltas);
+    // safe to call from any thread
+    void queueCommand(statkernel::Command command);
+    SF_ErrorCode applyCommands();
+    SF_ErrorCode publishSnapshot();
+    // safe to call from other threads, like queueCommand()
+    std::shared_ptr<statkernel::Snapshot const> latestSnapshot() const;
 
 private:
+    SF_ErrorCode extractErrorCode(VoidResult&& result);
+
     Context ctx;
+    // kept as is until someone asks for it, failing calls don't copy or format the message
+    std::optional<ErrorInfo> _lastError;
+    std::string _reportedError;
 };
 
 } // namespace statforge::runtime
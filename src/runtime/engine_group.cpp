@@ -0,0 +1,136 @@
+#include "engine_group.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace statforge::runtime {
+
+namespace {
+
+std::uint64_t pack(std::uint64_t begin, std::uint64_t end) {
+    return begin | (end << 32);
+}
+
+} // namespace
+
+EngineGroup::~EngineGroup() {
+    resize(1);
+}
+
+void EngineGroup::add(EngineImpl& engine) {
+    if (std::ranges::find(_engines, &engine) == _engines.end()) {
+        assert(_engines.size() < std::numeric_limits<std::uint32_t>::max());
+        _engines.push_back(&engine);
+    }
+}
+
+void EngineGroup::remove(EngineImpl& engine) {
+    std::erase(_engines, &engine);
+}
+
+void EngineGroup::evaluate(std::size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    auto const workers = std::min(threads, std::max<std::size_t>(_engines.size(), 1));
+    if (workers != _workers || !_ranges) {
+        resize(workers);
+    }
+
+    // contiguous blocks of the group per thread, so an engine's home stays the same
+    _pending.clear();
+    for (std::size_t worker = 0; worker < _workers; ++worker) {
+        auto const begin = _pending.size();
+        auto const first = worker * _engines.size() / _workers;
+        auto const last = (worker + 1) * _engines.size() / _workers;
+        for (auto i = first; i < last; ++i) {
+            if (_engines[i]->needsEvaluation()) {
+                _pending.push_back(_engines[i]);
+            }
+        }
+        _ranges[worker].range.store(pack(begin, _pending.size()), std::memory_order_relaxed);
+    }
+    if (_pending.empty()) {
+        return;
+    }
+
+    if (_workers > 1) {
+        std::lock_guard lock(_mutex);
+        ++_round;
+        _running = _workers - 1;
+    }
+    _start.notify_all();
+    work(0);
+
+    std::unique_lock lock(_mutex);
+    _done.wait(lock, [this] { return _running == 0; });
+}
+
+void EngineGroup::resize(std::size_t workers) {
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+    _start.notify_all();
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+    _threads.clear();
+    _stopping = false;
+
+    _workers = workers;
+    _ranges = std::make_unique<WorkRange[]>(workers);
+    for (std::size_t worker = 1; worker < workers; ++worker) {
+        _threads.emplace_back(&EngineGroup::run, this, worker, _round);
+    }
+}
+
+void EngineGroup::run(std::size_t worker, std::uint64_t round) {
+    while (true) {
+        {
+            std::unique_lock lock(_mutex);
+            _start.wait(lock, [this, round] { return _stopping || _round != round; });
+            if (_stopping) {
+                return;
+            }
+            round = _round;
+        }
+        work(worker);
+        {
+            std::lock_guard lock(_mutex);
+            --_running;
+        }
+        _done.notify_one();
+    }
+}
+
+void EngineGroup::work(std::size_t worker) {
+    while (auto* engine = take(_ranges[worker], true)) {
+        engine->evaluate();
+    }
+    // steal from the others, starting with the next thread to spread the thieves
+    for (std::size_t offset = 1; offset < _workers; ++offset) {
+        auto& victim = _ranges[(worker + offset) % _workers];
+        while (auto* engine = take(victim, false)) {
+            engine->evaluate();
+        }
+    }
+}
+
+EngineImpl* EngineGroup::take(WorkRange& queue, bool front) {
+    auto range = queue.range.load(std::memory_order_relaxed);
+    while (true) {
+        auto const begin = range & 0xFFFFFFFFu;
+        auto const end = range >> 32;
+        if (begin >= end) {
+            return nullptr;
+        }
+        auto const next = front ? pack(begin + 1, end) : pack(begin, end - 1);
+        if (queue.range.compare_exchange_weak(range, next, std::memory_order_relaxed)) {
+            return _pending[front ? begin : end - 1];
+        }
+    }
+}
+
+} // namespace statforge::runtime
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "runtime/engine.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace statforge::runtime {
+
+// independent engines evaluated together on a pool of threads. every engine has a home thread
+// given by its position in the group, so it keeps running on the same thread between calls
+// as long as the group and the thread count don't change. threads that run out of work
+// steal engines from the others.
+// engines of a group must not be used elsewhere while evaluate() runs and have to be removed
+// before they are destroyed
+class EngineGroup {
+public:
+    EngineGroup() = default;
+    ~EngineGroup();
+    EngineGroup(EngineGroup const&) = delete;
+    EngineGroup& operator=(EngineGroup const&) = delete;
+
+    // adding an engine twice or removing one that isn't part of the group does nothing
+    void add(EngineImpl& engine);
+    void remove(EngineImpl& engine);
+    [[nodiscard]] std::size_t size() const {
+        return _engines.size();
+    }
+    // evaluates every engine with pending changes on "threads" threads including the calling
+    // one, 0 uses one thread per core. errors are reported to the failing engines
+    void evaluate(std::size_t threads);
+
+private:
+    // engines of one thread in "_pending", begin in the low and end in the high 32 bits.
+    // the owner takes from the front, thieves from the back, both with a single compare and
+    // swap on the whole range
+    struct alignas(64) WorkRange {
+        std::atomic<std::uint64_t> range{0};
+    };
+
+    void resize(std::size_t workers);
+    void run(std::size_t worker, std::uint64_t round);
+    void work(std::size_t worker);
+    [[nodiscard]] EngineImpl* take(WorkRange& queue, bool front);
+
+    std::vector<EngineImpl*> _engines;
+    // engines needing evaluation in the current call, grouped by home thread
+    std::vector<EngineImpl*> _pending;
+    std::unique_ptr<WorkRange[]> _ranges;
+    std::size_t _workers{1};
+
+    // the calling thread is worker 0, the pool runs the others
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    std::uint64_t _round{0};
+    std::size_t _running{0};
+    bool _stopping{false};
+};
+
+} // namespace statforge::runtime
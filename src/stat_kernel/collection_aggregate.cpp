@@ -0,0 +1,515 @@
+#include "collection_aggregate.hpp"
+
+#include "dsl/evaluator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace statforge::statkernel {
+
+namespace {
+
+// small collections still apply this many deltas between two rescans
+constexpr std::size_t minRescanInterval = 1024;
+
+} // namespace
+
+void CollectionAggregate::markChanged(NodeId const& member) {
+    if (_gated.contains(member)) {
+        if (!_resolved) {
+            return;
+        }
+        // gates toggling more often than once per update, resolving is cheaper now
+        if (_changedGates.size() > _gated.size()) {
+            invalidate();
+            return;
+        }
+        _changedGates.push_back(member);
+        return;
+    }
+    if (_stale || _operation == SF_COLLECTION_OP_COUNT) {
+        return;
+    }
+
+    // a member changing more often than once per update, rescanning is cheaper now
+    if (_changed.size() > _values.size()) {
+        _stale = true;
+        _changed.clear();
+        return;
+    }
+    _changed.push_back(member);
+}
+
+void CollectionAggregate::addMember(NodeId const& member, Node const& node) {
+    if (!_resolved) {
+        return;
+    }
+
+    auto const it = _slots.emplace(member, _members.size()).first;
+    _ids.push_back(&it->first);
+    _members.push_back(&node);
+    // "node" may not be evaluated yet, its current value replaces this one on the next update
+    _values.push_back(node.value + _offset);
+
+    if (_stale) {
+        return;
+    }
+    if (std::isnan(_values.back()) || (!ordered() && std::isinf(_values.back()))) {
+        _stale = true;
+        _changed.clear();
+        return;
+    }
+    if (ordered() && !_orderBuilt) {
+        buildOrder();
+    } else {
+        add(_values.back());
+    }
+    ++_updates;
+    _changed.push_back(member);
+}
+
+void CollectionAggregate::removeMember(NodeId const& member) {
+    if (auto gate = _gated.find(member); gate != _gated.end()) {
+        for (auto const& gated : gate->second) {
+            _gateOf.erase(gated);
+        }
+        _gated.erase(gate);
+        invalidate();
+        return;
+    }
+    if (!_resolved) {
+        return;
+    }
+
+    auto it = _slots.find(member);
+    if (it == _slots.end()) {
+        return;
+    }
+    auto const index = it->second;
+
+    if (!_stale) {
+        if (ordered() && !_orderBuilt) {
+            buildOrder();
+        }
+        remove(_values[index]);
+        ++_updates;
+    }
+
+    // the last member takes the free index
+    auto const last = _values.size() - 1;
+    if (index != last) {
+        _members[index] = _members[last];
+        _values[index] = _values[last];
+        _ids[index] = _ids[last];
+        _slots.find(*_ids[index])->second = index;
+    }
+    _members.pop_back();
+    _values.pop_back();
+    _ids.pop_back();
+    _slots.erase(it);
+
+    if (!exact()) {
+        _stale = true;
+        _changed.clear();
+    }
+}
+
+void CollectionAggregate::invalidate() {
+    _resolved = false;
+    _slots.clear();
+    _stale = true;
+    _changed.clear();
+    _changedGates.clear();
+}
+
+void CollectionAggregate::setGate(NodeId const& member, NodeId const& gate) {
+    _gateOf.insert_or_assign(member, gate);
+    _gated[gate].push_back(member);
+    // "member" may have joined as active, the gate decides on the next update
+    if (_resolved) {
+        _changedGates.push_back(gate);
+    }
+}
+
+std::optional<NodeId> CollectionAggregate::clearGate(NodeId const& member) {
+    auto it = _gateOf.find(member);
+    if (it == _gateOf.end()) {
+        return std::nullopt;
+    }
+    auto gate = std::move(it->second);
+    _gateOf.erase(it);
+
+    auto gated = _gated.find(gate);
+    std::erase(gated->second, member);
+    if (!gated->second.empty()) {
+        return std::nullopt;
+    }
+    _gated.erase(gated);
+    return gate;
+}
+
+NodeId const* CollectionAggregate::gate(NodeId const& member) const {
+    auto it = _gateOf.find(member);
+    return it == _gateOf.end() ? nullptr : &it->second;
+}
+
+void CollectionAggregate::clearGates() {
+    _gateOf.clear();
+    _gated.clear();
+    invalidate();
+}
+
+NodeValue CollectionAggregate::update(Graph const& graph, std::vector<NodeId> const& members) {
+    if (!_resolved) {
+        resolve(graph, members);
+    } else if (!_changedGates.empty()) {
+        applyGates(graph);
+    }
+    if (_stale) {
+        return rescan();
+    }
+
+    for (auto const& member : _changed) {
+        // members that left in the meantime
+        auto it = _slots.find(member);
+        if (it == _slots.end()) {
+            continue;
+        }
+
+        auto const index = it->second;
+        auto const current = _members[index]->value + _offset;
+        if (current == _values[index]) {
+            continue;
+        }
+        // ordering copes with infinities, running totals don't
+        if (std::isnan(current) || (!ordered() && std::isinf(current))) {
+            return rescan();
+        }
+
+        if (ordered() && !_orderBuilt) {
+            buildOrder();
+        }
+        remove(_values[index]);
+        add(current);
+        _values[index] = current;
+        ++_updates;
+    }
+    _changed.clear();
+
+    if (!exact() || (!ordered() && _updates >= std::max(_values.size(), minRescanInterval))) {
+        return rescan();
+    }
+    return result();
+}
+
+void CollectionAggregate::resolve(Graph const& graph, std::vector<NodeId> const& members) {
+    _members.clear();
+    _ids.clear();
+    _slots.clear();
+    _members.reserve(members.size());
+    _ids.reserve(members.size());
+    _slots.reserve(members.size());
+    for (auto const& member : members) {
+        if (!_gated.empty() && closed(graph, member)) {
+            continue;
+        }
+        auto const it = _slots.emplace(member, _members.size()).first;
+        _ids.push_back(&it->first);
+        _members.push_back(&graph.node(member));
+    }
+    _values.resize(_members.size());
+
+    _changedGates.clear();
+    _resolved = true;
+    _stale = true;
+}
+
+void CollectionAggregate::applyGates(Graph const& graph) {
+    // adding and removing members doesn't touch the gates
+    for (auto const& gate : _changedGates) {
+        auto it = _gated.find(gate);
+        if (it == _gated.end()) {
+            continue;
+        }
+        auto const open = dsl::isTruthy(graph.node(gate).value);
+        for (auto const& member : it->second) {
+            if (open == contains(member)) {
+                continue;
+            }
+            if (open) {
+                addMember(member, graph.node(member));
+            } else {
+                removeMember(member);
+            }
+        }
+    }
+    _changedGates.clear();
+}
+
+bool CollectionAggregate::closed(Graph const& graph, NodeId const& member) const {
+    // gates aren't members
+    if (_gated.contains(member)) {
+        return true;
+    }
+    auto it = _gateOf.find(member);
+    return it != _gateOf.end() && !dsl::isTruthy(graph.node(it->second).value);
+}
+
+NodeValue CollectionAggregate::rescan() {
+    _changed.clear();
+    _updates = 0;
+    _lower.clear();
+    _upper.clear();
+    _orderBuilt = false;
+
+    for (std::size_t i = 0; i < _members.size(); ++i) {
+        _values[i] = _members[i]->value + _offset;
+    }
+
+    // deltas can't undo infinities or NaN, dividing by an over- or underflown product is
+    // inexact and NaN has no place in an order. such collections are rescanned on every update
+    switch (_operation) {
+    case SF_COLLECTION_OP_COUNT:
+        _stale = false;
+        break;
+    case SF_COLLECTION_OP_SUM:
+    case SF_COLLECTION_OP_AVERAGE:
+        _sum = kernels::sum(_values);
+        _stale = !std::isfinite(_sum.sum) || !std::isfinite(_sum.compensation);
+        break;
+    case SF_COLLECTION_OP_PRODUCT:
+        _product = kernels::product(_values);
+        _stale = !exact();
+        break;
+    default:
+        _stale = std::ranges::any_of(_values, [](NodeValue value) { return std::isnan(value); });
+        if (_stale || _values.empty()) {
+            break;
+        }
+        if (_operation == SF_COLLECTION_OP_MIN) {
+            _scanned = kernels::min(_values);
+        } else if (_operation == SF_COLLECTION_OP_MAX) {
+            _scanned = kernels::max(_values);
+        } else {
+            _scratch.assign(_values.begin(), _values.end());
+            _scanned = kernels::median(_scratch);
+        }
+        break;
+    }
+
+    if (_stale) {
+        return sequentialResult();
+    }
+    return result();
+}
+
+NodeValue CollectionAggregate::sequentialResult() {
+    if (_operation == SF_COLLECTION_OP_MEDIAN) {
+        _scratch.assign(_values.begin(), _values.end());
+        return sequential(_operation, _scratch);
+    }
+    return sequential(_operation, _values);
+}
+
+NodeValue CollectionAggregate::scan(SF_CollectionOperation operation,
+                                    std::span<NodeValue> values) {
+    if (values.empty()) {
+        return sequential(operation, values);
+    }
+
+    // same conditions under which a rescan falls back to the sequential result
+    switch (operation) {
+    case SF_COLLECTION_OP_COUNT:
+        break;
+    case SF_COLLECTION_OP_SUM:
+    case SF_COLLECTION_OP_AVERAGE: {
+        auto const sum = kernels::sum(values);
+        if (!std::isfinite(sum.sum) || !std::isfinite(sum.compensation)) {
+            break;
+        }
+        if (operation == SF_COLLECTION_OP_AVERAGE) {
+            return sum.value() / static_cast<NodeValue>(values.size());
+        }
+        return sum.value();
+    }
+    case SF_COLLECTION_OP_PRODUCT: {
+        auto const product = kernels::product(values);
+        if (!std::isnormal(product.product)) {
+            break;
+        }
+        return product.value();
+    }
+    default:
+        if (std::ranges::any_of(values, [](NodeValue value) { return std::isnan(value); })) {
+            break;
+        }
+        if (operation == SF_COLLECTION_OP_MIN) {
+            return kernels::min(values);
+        }
+        if (operation == SF_COLLECTION_OP_MAX) {
+            return kernels::max(values);
+        }
+        return kernels::median(values);
+    }
+    return sequential(operation, values);
+}
+
+NodeValue CollectionAggregate::sequential(SF_CollectionOperation operation,
+                                          std::span<NodeValue> values) {
+    if (values.empty()) {
+        return operation == SF_COLLECTION_OP_PRODUCT ? 1.0 : 0.0;
+    }
+
+    switch (operation) {
+    case SF_COLLECTION_OP_COUNT:
+        return static_cast<NodeValue>(values.size());
+    case SF_COLLECTION_OP_PRODUCT: {
+        NodeValue value{1};
+        for (auto const member : values) {
+            value *= member;
+        }
+        return value;
+    }
+    case SF_COLLECTION_OP_MIN: {
+        NodeValue value = values.front();
+        for (auto const member : values) {
+            value = std::min(value, member);
+        }
+        return value;
+    }
+    case SF_COLLECTION_OP_MAX: {
+        NodeValue value = values.front();
+        for (auto const member : values) {
+            value = std::max(value, member);
+        }
+        return value;
+    }
+    case SF_COLLECTION_OP_MEDIAN:
+        return kernels::median(values);
+    default: {
+        NodeValue value{0};
+        for (auto const member : values) {
+            value += member;
+        }
+        if (operation == SF_COLLECTION_OP_AVERAGE) {
+            return value / static_cast<NodeValue>(values.size());
+        }
+        return value;
+    }
+    }
+}
+
+void CollectionAggregate::buildOrder() {
+    _scratch.assign(_values.begin(), _values.end());
+    std::ranges::sort(_scratch);
+
+    // sorted input is appended in amortized constant time
+    auto const middle = _scratch.begin() + static_cast<std::ptrdiff_t>((_scratch.size() + 1) / 2);
+    _lower.insert(_scratch.begin(), middle);
+    _upper.insert(middle, _scratch.end());
+    _orderBuilt = true;
+}
+
+bool CollectionAggregate::ordered() const {
+    return _operation == SF_COLLECTION_OP_MIN || _operation == SF_COLLECTION_OP_MAX ||
+           _operation == SF_COLLECTION_OP_MEDIAN;
+}
+
+bool CollectionAggregate::exact() const {
+    return _operation != SF_COLLECTION_OP_PRODUCT || std::isnormal(_product.product);
+}
+
+void CollectionAggregate::add(NodeValue value) {
+    if (_operation == SF_COLLECTION_OP_COUNT) {
+        return;
+    }
+    if (ordered()) {
+        if (_lower.empty() || value <= *_lower.rbegin()) {
+            _lower.insert(value);
+        } else {
+            _upper.insert(value);
+        }
+        rebalance();
+        return;
+    }
+    if (_operation == SF_COLLECTION_OP_PRODUCT) {
+        if (value == 0.0) {
+            ++_product.zeros;
+        } else {
+            _product.product *= value;
+        }
+        return;
+    }
+
+    kernels::add(_sum, value);
+}
+
+void CollectionAggregate::remove(NodeValue value) {
+    if (_operation == SF_COLLECTION_OP_COUNT) {
+        return;
+    }
+    if (ordered()) {
+        // every value in "_lower" is less than or equal to every value in "_upper"
+        if (!_lower.empty() && value <= *_lower.rbegin()) {
+            _lower.erase(_lower.find(value));
+        } else {
+            _upper.erase(_upper.find(value));
+        }
+        rebalance();
+        return;
+    }
+    if (_operation == SF_COLLECTION_OP_PRODUCT) {
+        if (value == 0.0) {
+            --_product.zeros;
+        } else {
+            _product.product /= value;
+        }
+        return;
+    }
+
+    kernels::add(_sum, -value);
+}
+
+void CollectionAggregate::rebalance() {
+    while (_lower.size() > _upper.size() + 1) {
+        _upper.insert(_lower.extract(std::prev(_lower.end())));
+    }
+    while (_upper.size() > _lower.size()) {
+        _lower.insert(_upper.extract(_upper.begin()));
+    }
+}
+
+NodeValue CollectionAggregate::result() const {
+    if (_values.empty()) {
+        return _operation == SF_COLLECTION_OP_PRODUCT ? 1.0 : 0.0;
+    }
+
+    switch (_operation) {
+    case SF_COLLECTION_OP_COUNT:
+        return static_cast<NodeValue>(_values.size());
+    case SF_COLLECTION_OP_PRODUCT:
+        return _product.value();
+    case SF_COLLECTION_OP_AVERAGE:
+        return _sum.value() / static_cast<NodeValue>(_values.size());
+    case SF_COLLECTION_OP_MIN:
+        return _orderBuilt ? *_lower.begin() : _scanned;
+    case SF_COLLECTION_OP_MAX:
+        if (!_orderBuilt) {
+            return _scanned;
+        }
+        return _upper.empty() ? *_lower.rbegin() : *_upper.rbegin();
+    case SF_COLLECTION_OP_MEDIAN:
+        if (!_orderBuilt) {
+            return _scanned;
+        }
+        if (_lower.size() > _upper.size()) {
+            return *_lower.rbegin();
+        }
+        return (*_lower.rbegin() + *_upper.begin()) / 2.0;
+    default:
+        return _sum.value();
+    }
+}
+
+} // namespace statforge::statkernel
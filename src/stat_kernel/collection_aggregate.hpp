@@ -0,0 +1,120 @@
+#pragma once
+
+#include "stat_kernel/collection_kernels.hpp"
+#include "stat_kernel/graph.hpp"
+#include "types/collection_operation.h"
+#include "types/definitions.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <set>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace statforge::statkernel {
+
+// running aggregate of a collection node. members that changed since the last update are
+// applied as deltas, everything else keeps its last seen value.
+// SUM, PRODUCT and AVERAGE keep running totals, MIN, MAX and MEDIAN keep the member values
+// ordered in two halves around the median, so an update is O(log n) and reading is O(1).
+// COUNT only follows the membership.
+// a full rescan runs the vectorized kernels over the contiguous member values. it happens on
+// membership replacement, for values deltas can't express and periodically to bound floating
+// point drift.
+// members can be gated by another node, they only take part while the gate is non-zero and
+// not NaN, like conditions of the DSL.
+// a gate flip adds or removes its members like any other membership change.
+class CollectionAggregate {
+public:
+    // "offset" is added to every member value before aggregating
+    explicit CollectionAggregate(SF_CollectionOperation operation, NodeValue offset = 0)
+        : _operation(operation), _offset(offset) {
+    }
+
+    // "member" or a gate changed, its new value is read on the next update
+    void markChanged(NodeId const& member);
+    // "member" joined the collection, its value is read on the next update
+    void addMember(NodeId const& member, Node const& node);
+    // "member" left the collection. a removed gate node ungates its members
+    void removeMember(NodeId const& member);
+    // members were replaced, the next update resolves and rescans all of them
+    void invalidate();
+
+    // gates are dependencies of the collection but never members of it
+    void setGate(NodeId const& member, NodeId const& gate);
+    // returns the gate of "member" if no other member uses it anymore
+    [[nodiscard]] std::optional<NodeId> clearGate(NodeId const& member);
+    void clearGates();
+    [[nodiscard]] bool isGate(NodeId const& id) const {
+        return _gated.contains(id);
+    }
+    // nullptr for ungated members
+    [[nodiscard]] NodeId const* gate(NodeId const& member) const;
+
+    // false until the first update after the members were replaced
+    [[nodiscard]] bool contains(NodeId const& member) const {
+        return _slots.contains(member);
+    }
+
+    // members and gates have to be evaluated already. "members" includes the gates
+    NodeValue update(Graph const& graph, std::vector<NodeId> const& members);
+
+    // what a rescan over "values" yields, without any running state. MEDIAN reorders them
+    [[nodiscard]] static NodeValue scan(SF_CollectionOperation operation,
+                                        std::span<NodeValue> values);
+
+private:
+    void resolve(Graph const& graph, std::vector<NodeId> const& members);
+    // adds or removes the members of gates that changed
+    void applyGates(Graph const& graph);
+    // gates and members whose gate is zero
+    [[nodiscard]] bool closed(Graph const& graph, NodeId const& member) const;
+    NodeValue rescan();
+    // result without running state, for collections deltas can't follow
+    [[nodiscard]] NodeValue sequentialResult();
+    [[nodiscard]] static NodeValue sequential(SF_CollectionOperation operation,
+                                              std::span<NodeValue> values);
+    // the order is only built once the first delta arrives after a rescan
+    void buildOrder();
+    [[nodiscard]] bool ordered() const;
+    [[nodiscard]] bool exact() const;
+    void add(NodeValue value);
+    void remove(NodeValue value);
+    void rebalance();
+    [[nodiscard]] NodeValue result() const;
+
+    SF_CollectionOperation _operation;
+    NodeValue _offset;
+
+    // members and their last seen values, offset included, at the same index. node addresses
+    // are stable until the node is removed, which removes it from the collection first
+    std::vector<Node const*> _members;
+    std::vector<NodeValue> _values;
+    std::unordered_map<NodeId, std::size_t> _slots;
+    // keys of "_slots" by index
+    std::vector<NodeId const*> _ids;
+    bool _resolved{false};
+
+    std::vector<NodeId> _changed;
+    std::vector<NodeValue> _scratch;
+    bool _stale{true};
+    // deltas applied since the last rescan
+    std::size_t _updates{0};
+
+    kernels::CompensatedSum _sum;
+    kernels::ZeroCountedProduct _product;
+    // MIN, MAX and MEDIAN. "_lower" holds the smaller half and one more value for odd sizes
+    std::multiset<NodeValue> _lower;
+    std::multiset<NodeValue> _upper;
+    bool _orderBuilt{false};
+    // result of the last rescan until the order is built
+    NodeValue _scanned{0};
+
+    // member -> gate and gate -> members
+    std::unordered_map<NodeId, NodeId> _gateOf;
+    std::unordered_map<NodeId, std::vector<NodeId>> _gated;
+    std::vector<NodeId> _changedGates;
+};
+
+} // namespace statforge::statkernel
@@ -0,0 +1,278 @@
+#include "collection_kernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace statforge::statkernel::kernels {
+
+namespace {
+
+struct Dispatch {
+    CompensatedSum (*sum)(std::span<NodeValue const>);
+    ZeroCountedProduct (*product)(std::span<NodeValue const>);
+    NodeValue (*min)(std::span<NodeValue const>);
+    NodeValue (*max)(std::span<NodeValue const>);
+    std::string_view instructionSet;
+};
+
+// scalar loops continuing "result", used for the tails of vectorized scans
+void sumScalar(std::span<NodeValue const> values, CompensatedSum& result) {
+    for (auto const value : values) {
+        add(result, value);
+    }
+}
+
+void productScalar(std::span<NodeValue const> values, ZeroCountedProduct& result) {
+    for (auto const value : values) {
+        if (value == 0.0) {
+            ++result.zeros;
+        } else {
+            result.product *= value;
+        }
+    }
+}
+
+NodeValue minScalar(std::span<NodeValue const> values, NodeValue result) {
+    for (auto const value : values) {
+        result = std::min(result, value);
+    }
+    return result;
+}
+
+NodeValue maxScalar(std::span<NodeValue const> values, NodeValue result) {
+    for (auto const value : values) {
+        result = std::max(result, value);
+    }
+    return result;
+}
+
+#if defined(__GNUC__)
+
+typedef NodeValue Lanes2 __attribute__((vector_size(2 * sizeof(NodeValue))));
+typedef NodeValue Lanes4 __attribute__((vector_size(4 * sizeof(NodeValue))));
+typedef NodeValue Lanes8 __attribute__((vector_size(8 * sizeof(NodeValue))));
+
+// the lane templates are always inlined into the entry points below, so each instantiation
+// is compiled for the instruction set of its entry point
+template <typename Vector>
+constexpr std::size_t laneCount = sizeof(Vector) / sizeof(NodeValue);
+
+// vectors aren't returned by value, their abi depends on the instruction set
+template <typename Vector>
+[[gnu::always_inline]] inline void load(Vector& vector, NodeValue const* values) {
+    std::memcpy(&vector, values, sizeof(Vector));
+}
+
+template <typename Vector>
+[[gnu::always_inline]] inline CompensatedSum sumLanes(std::span<NodeValue const> values) {
+    constexpr auto lanes = laneCount<Vector>;
+    Vector const zero{};
+    Vector sum{};
+    Vector compensation{};
+
+    std::size_t i = 0;
+    for (; i + lanes <= values.size(); i += lanes) {
+        Vector value;
+        load(value, values.data() + i);
+        auto const next = sum + value;
+        auto const sumMagnitude = sum < zero ? -sum : sum;
+        auto const valueMagnitude = value < zero ? -value : value;
+        compensation +=
+            sumMagnitude >= valueMagnitude ? (sum - next) + value : (value - next) + sum;
+        sum = next;
+    }
+
+    CompensatedSum result;
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+        add(result, sum[lane]);
+        result.compensation += compensation[lane];
+    }
+    sumScalar(values.subspan(i), result);
+    return result;
+}
+
+template <typename Vector>
+[[gnu::always_inline]] inline ZeroCountedProduct productLanes(std::span<NodeValue const> values) {
+    constexpr auto lanes = laneCount<Vector>;
+    Vector const zero{};
+    Vector const one = zero + 1.0;
+    Vector product = one;
+    // comparisons yield -1 per matching lane
+    decltype(zero == zero) zeros{};
+
+    std::size_t i = 0;
+    for (; i + lanes <= values.size(); i += lanes) {
+        Vector value;
+        load(value, values.data() + i);
+        auto const isZero = value == zero;
+        zeros -= isZero;
+        product *= isZero ? one : value;
+    }
+
+    ZeroCountedProduct result;
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+        result.product *= product[lane];
+        result.zeros += static_cast<std::size_t>(zeros[lane]);
+    }
+    productScalar(values.subspan(i), result);
+    return result;
+}
+
+template <typename Vector>
+[[gnu::always_inline]] inline NodeValue minLanes(std::span<NodeValue const> values) {
+    constexpr auto lanes = laneCount<Vector>;
+    Vector extreme = Vector{} + values.front();
+
+    std::size_t i = 0;
+    for (; i + lanes <= values.size(); i += lanes) {
+        Vector value;
+        load(value, values.data() + i);
+        extreme = value < extreme ? value : extreme;
+    }
+
+    auto result = values.front();
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+        result = std::min(result, extreme[lane]);
+    }
+    return minScalar(values.subspan(i), result);
+}
+
+template <typename Vector>
+[[gnu::always_inline]] inline NodeValue maxLanes(std::span<NodeValue const> values) {
+    constexpr auto lanes = laneCount<Vector>;
+    Vector extreme = Vector{} + values.front();
+
+    std::size_t i = 0;
+    for (; i + lanes <= values.size(); i += lanes) {
+        Vector value;
+        load(value, values.data() + i);
+        extreme = value > extreme ? value : extreme;
+    }
+
+    auto result = values.front();
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+        result = std::max(result, extreme[lane]);
+    }
+    return maxScalar(values.subspan(i), result);
+}
+
+#if defined(__x86_64__)
+
+[[gnu::target("avx512f")]] CompensatedSum sumAvx512(std::span<NodeValue const> values) {
+    return sumLanes<Lanes8>(values);
+}
+[[gnu::target("avx512f")]] ZeroCountedProduct productAvx512(std::span<NodeValue const> values) {
+    return productLanes<Lanes8>(values);
+}
+[[gnu::target("avx512f")]] NodeValue minAvx512(std::span<NodeValue const> values) {
+    return minLanes<Lanes8>(values);
+}
+[[gnu::target("avx512f")]] NodeValue maxAvx512(std::span<NodeValue const> values) {
+    return maxLanes<Lanes8>(values);
+}
+
+[[gnu::target("avx2")]] CompensatedSum sumAvx2(std::span<NodeValue const> values) {
+    return sumLanes<Lanes4>(values);
+}
+[[gnu::target("avx2")]] ZeroCountedProduct productAvx2(std::span<NodeValue const> values) {
+    return productLanes<Lanes4>(values);
+}
+[[gnu::target("avx2")]] NodeValue minAvx2(std::span<NodeValue const> values) {
+    return minLanes<Lanes4>(values);
+}
+[[gnu::target("avx2")]] NodeValue maxAvx2(std::span<NodeValue const> values) {
+    return maxLanes<Lanes4>(values);
+}
+
+#endif
+
+// sse2 on x86-64, whatever the target provides elsewhere
+CompensatedSum sumBaseline(std::span<NodeValue const> values) {
+    return sumLanes<Lanes2>(values);
+}
+ZeroCountedProduct productBaseline(std::span<NodeValue const> values) {
+    return productLanes<Lanes2>(values);
+}
+NodeValue minBaseline(std::span<NodeValue const> values) {
+    return minLanes<Lanes2>(values);
+}
+NodeValue maxBaseline(std::span<NodeValue const> values) {
+    return maxLanes<Lanes2>(values);
+}
+
+#else
+
+CompensatedSum sumBaseline(std::span<NodeValue const> values) {
+    CompensatedSum result;
+    sumScalar(values, result);
+    return result;
+}
+ZeroCountedProduct productBaseline(std::span<NodeValue const> values) {
+    ZeroCountedProduct result;
+    productScalar(values, result);
+    return result;
+}
+NodeValue minBaseline(std::span<NodeValue const> values) {
+    return minScalar(values, values.front());
+}
+NodeValue maxBaseline(std::span<NodeValue const> values) {
+    return maxScalar(values, values.front());
+}
+
+#endif
+
+Dispatch select() {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return {&sumAvx512, &productAvx512, &minAvx512, &maxAvx512, "avx512f"};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return {&sumAvx2, &productAvx2, &minAvx2, &maxAvx2, "avx2"};
+    }
+    return {&sumBaseline, &productBaseline, &minBaseline, &maxBaseline, "sse2"};
+#elif defined(__GNUC__)
+    return {&sumBaseline, &productBaseline, &minBaseline, &maxBaseline, "generic"};
+#else
+    return {&sumBaseline, &productBaseline, &minBaseline, &maxBaseline, "scalar"};
+#endif
+}
+
+Dispatch const& dispatch() {
+    static Dispatch const selected = select();
+    return selected;
+}
+
+} // namespace
+
+CompensatedSum sum(std::span<NodeValue const> values) {
+    return dispatch().sum(values);
+}
+
+ZeroCountedProduct product(std::span<NodeValue const> values) {
+    return dispatch().product(values);
+}
+
+NodeValue min(std::span<NodeValue const> values) {
+    return dispatch().min(values);
+}
+
+NodeValue max(std::span<NodeValue const> values) {
+    return dispatch().max(values);
+}
+
+NodeValue median(std::span<NodeValue> values) {
+    auto const middle = values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2);
+    std::nth_element(values.begin(), middle, values.end());
+    if (values.size() % 2 == 1) {
+        return *middle;
+    }
+    // the lower middle value is the largest one left of "middle"
+    return (max({values.begin(), middle}) + *middle) / 2.0;
+}
+
+std::string_view instructionSet() {
+    return dispatch().instructionSet;
+}
+
+} // namespace statforge::statkernel::kernels
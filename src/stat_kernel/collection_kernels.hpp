@@ -0,0 +1,55 @@
+#pragma once
+
+#include "types/definitions.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+// vectorized full scans over contiguous member values. the widest instruction set the cpu
+// supports is picked on first use.
+namespace statforge::statkernel::kernels {
+
+struct CompensatedSum {
+    NodeValue sum{0};
+    NodeValue compensation{0};
+
+    [[nodiscard]] NodeValue value() const {
+        return sum + compensation;
+    }
+};
+
+struct ZeroCountedProduct {
+    // product of the non-zero values
+    NodeValue product{1};
+    std::size_t zeros{0};
+
+    [[nodiscard]] NodeValue value() const {
+        return zeros > 0 ? 0.0 : product;
+    }
+};
+
+// neumaier step, shared with running sums
+inline void add(CompensatedSum& sum, NodeValue value) {
+    auto const next = sum.sum + value;
+    if (std::fabs(sum.sum) >= std::fabs(value)) {
+        sum.compensation += (sum.sum - next) + value;
+    } else {
+        sum.compensation += (value - next) + sum.sum;
+    }
+    sum.sum = next;
+}
+
+[[nodiscard]] CompensatedSum sum(std::span<NodeValue const> values);
+[[nodiscard]] ZeroCountedProduct product(std::span<NodeValue const> values);
+// "values" must not be empty or contain NaN
+[[nodiscard]] NodeValue min(std::span<NodeValue const> values);
+[[nodiscard]] NodeValue max(std::span<NodeValue const> values);
+// partially reorders "values", which must not be empty
+[[nodiscard]] NodeValue median(std::span<NodeValue> values);
+
+// "avx512f", "avx2", "sse2", "generic" or "scalar"
+[[nodiscard]] std::string_view instructionSet();
+
+} // namespace statforge::statkernel::kernels
@@ -0,0 +1,38 @@
+#include "command_queue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace statforge::statkernel {
+
+CommandQueue::~CommandQueue() {
+    clear();
+}
+
+void CommandQueue::push(Command command) {
+    auto* entry = new Entry{std::move(command), _head.load(std::memory_order_relaxed)};
+    // the consumer only ever takes the whole list, so a stale head can't be reused (no ABA)
+    while (!_head.compare_exchange_weak(
+        entry->next, entry, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<Command> CommandQueue::takeAll() {
+    auto* entry = _head.exchange(nullptr, std::memory_order_acquire);
+    std::vector<Command> commands;
+    while (entry != nullptr) {
+        commands.push_back(std::move(entry->command));
+        delete std::exchange(entry, entry->next);
+    }
+    std::ranges::reverse(commands);
+    return commands;
+}
+
+void CommandQueue::clear() {
+    auto* entry = _head.exchange(nullptr, std::memory_order_acquire);
+    while (entry != nullptr) {
+        delete std::exchange(entry, entry->next);
+    }
+}
+
+} // namespace statforge::statkernel
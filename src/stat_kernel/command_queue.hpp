@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types/definitions.hpp"
+
+#include <atomic>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace statforge::statkernel {
+
+struct SetValueCommand {
+    NodeId id;
+    NodeValue value;
+};
+
+struct SetFormulaCommand {
+    NodeId id;
+    std::string formula;
+};
+
+struct AddMemberCommand {
+    NodeId id;
+    NodeId member;
+};
+
+struct RemoveMemberCommand {
+    NodeId id;
+    NodeId member;
+};
+
+using Command =
+    std::variant<SetValueCommand, SetFormulaCommand, AddMemberCommand, RemoveMemberCommand>;
+
+// lock-free multi producer, single consumer queue of mutations. producers push from any
+// thread with a single compare and swap and never wait for each other or the consumer, the
+// thread owning the kernel takes everything queued so far at once
+class CommandQueue {
+public:
+    CommandQueue() = default;
+    ~CommandQueue();
+    CommandQueue(CommandQueue const&) = delete;
+    CommandQueue& operator=(CommandQueue const&) = delete;
+
+    // safe to call from any thread
+    void push(Command command);
+    // owning thread only, commands in the order they were pushed
+    [[nodiscard]] std::vector<Command> takeAll();
+    // owning thread only, drops everything pushed so far
+    void clear();
+
+private:
+    struct Entry {
+        Command command;
+        Entry* next;
+    };
+
+    // newest first
+    std::atomic<Entry*> _head{nullptr};
+};
+
+} // namespace statforge::statkernel
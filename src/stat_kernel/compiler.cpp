@@ -2,18 +2,212 @@
 #include "error/internal/error.hpp"
 
 #include "dsl/parser.hpp"
+#include "stat_kernel/collection_aggregate.hpp"
+#include "stat_kernel/modifier_aggregate.hpp"
 #include "stat_kernel/node.hpp"
 #include "types/definitions.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <format>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string_view>
 #include <utility>
 
 namespace {
 
+namespace dsl = statforge::dsl;
+
 constexpr bool skipCycleCheck = true;
 
+// a subexpression is only worth its own hidden node if it saves at least this many operations
+constexpr std::size_t minSharedCost = 2;
+
+struct SubexpressionInfo {
+    std::size_t cost{0};
+    bool hasRef{false};
+    bool impure{false};
+};
+
+void inspect(dsl::ExpressionTree const& tree,
+             dsl::ExprIndex index,
+             dsl::FunctionRegistry const& functions,
+             SubexpressionInfo& info) {
+    std::visit(
+        [&tree, &info, &functions](auto const& node) {
+            using T = std::decay_t<decltype(node)>;
+
+            if constexpr (std::is_same_v<T, dsl::Ref>) {
+                info.hasRef = true;
+            } else if constexpr (std::is_same_v<T, dsl::Unary>) {
+                info.cost += 1;
+                inspect(tree, node.rhs, functions, info);
+            } else if constexpr (std::is_same_v<T, dsl::Binary>) {
+                info.cost += 1;
+                inspect(tree, node.lhs, functions, info);
+                inspect(tree, node.rhs, functions, info);
+            } else if constexpr (std::is_same_v<T, dsl::Ternary>) {
+                info.cost += 1;
+                inspect(tree, node.cond, functions, info);
+                inspect(tree, node.thenExpr, functions, info);
+                inspect(tree, node.elseExpr, functions, info);
+            } else if constexpr (std::is_same_v<T, dsl::Call>) {
+                info.cost += 2;
+                info.impure = info.impure || !functions.function(node.function).pure;
+                for (auto arg : tree.args(node)) {
+                    inspect(tree, arg, functions, info);
+                }
+            }
+        },
+        tree[index]);
+}
+
+bool isImpure(dsl::ExpressionTree const& tree, dsl::FunctionRegistry const& functions) {
+    SubexpressionInfo info;
+    inspect(tree, tree.root(), functions, info);
+    return info.impure;
+}
+
+std::vector<dsl::ExprIndex> children(dsl::ExpressionTree const& tree, dsl::ExprIndex index) {
+    std::vector<dsl::ExprIndex> result;
+    std::visit(
+        [&result, &tree](auto const& node) {
+            using T = std::decay_t<decltype(node)>;
+
+            if constexpr (std::is_same_v<T, dsl::Unary>) {
+                result.push_back(node.rhs);
+            } else if constexpr (std::is_same_v<T, dsl::Binary>) {
+                result.insert(result.end(), {node.lhs, node.rhs});
+            } else if constexpr (std::is_same_v<T, dsl::Ternary>) {
+                result.insert(result.end(), {node.cond, node.thenExpr, node.elseExpr});
+            } else if constexpr (std::is_same_v<T, dsl::Call>) {
+                auto const args = tree.args(node);
+                result.insert(result.end(), args.begin(), args.end());
+            }
+        },
+        tree[index]);
+    return result;
+}
+
+struct Subexpression {
+    // exact textual identity. unlike dumpSExpr(), literals keep full precision
+    std::string key;
+    SubexpressionInfo info;
+};
+
+// impure calls are never shared, every occurrence has to be called on its own
+bool isShareable(Subexpression const& subexpression) {
+    auto const& info = subexpression.info;
+    return info.hasRef && !info.impure && info.cost >= minSharedCost;
+}
+
+// describes every subexpression reachable from "index" bottom up, parents reuse the keys and
+// costs of their children. "subexpressions" is indexed like "tree"
+void describe(dsl::ExpressionTree const& tree,
+              dsl::ExprIndex index,
+              dsl::FunctionRegistry const& functions,
+              std::vector<Subexpression>& subexpressions) {
+    auto const nested = children(tree, index);
+    for (auto const child : nested) {
+        describe(tree, child, functions, subexpressions);
+    }
+
+    auto& [key, info] = subexpressions[index];
+    for (auto const child : nested) {
+        auto const& childInfo = subexpressions[child].info;
+        info.cost += childInfo.cost;
+        info.hasRef = info.hasRef || childInfo.hasRef;
+        info.impure = info.impure || childInfo.impure;
+    }
+    auto const appendChildren = [&key, &nested, &subexpressions]() {
+        for (auto const child : nested) {
+            key.append(" ").append(subexpressions[child].key);
+        }
+        key.append(")");
+    };
+
+    std::visit(
+        [&](auto const& node) {
+            using T = std::decay_t<decltype(node)>;
+
+            if constexpr (std::is_same_v<T, dsl::Literal>) {
+                std::array<char, 32> buffer{};
+                auto const result = std::to_chars(buffer.begin(), buffer.end(), node.value);
+                key.append(buffer.begin(), result.ptr);
+            } else if constexpr (std::is_same_v<T, dsl::Ref>) {
+                info.hasRef = true;
+                key.append("<").append(node.name).append(">");
+            } else if constexpr (std::is_same_v<T, dsl::Unary> || std::is_same_v<T, dsl::Binary>) {
+                info.cost += 1;
+                key.append("(").append(std::to_string(std::to_underlying(node.op)));
+                appendChildren();
+            } else if constexpr (std::is_same_v<T, dsl::Ternary>) {
+                info.cost += 1;
+                key.append("(?");
+                appendChildren();
+            } else if constexpr (std::is_same_v<T, dsl::Call>) {
+                info.cost += 2;
+                info.impure = info.impure || !functions.function(node.function).pure;
+                key.append("(").append(node.name);
+                appendChildren();
+            }
+        },
+        tree[index]);
+}
+
+bool isPlaceholder(std::string_view reference) {
+    return reference.starts_with('$');
+}
+
+// the tokenizer rejects indices that don't fit
+std::size_t placeholderIndex(std::string_view reference) {
+    std::size_t index{};
+    [[maybe_unused]] auto const result =
+        std::from_chars(reference.data() + 1, reference.data() + reference.size(), index);
+    assert(result.ec == std::errc{} && result.ptr == reference.data() + reference.size());
+    return index;
+}
+
+// template instances resolve placeholders through their bindings, other references stay as is.
+// hidden nodes also start with '$', but templates never reference them.
+std::string_view bindReference(std::string_view reference,
+                               std::vector<statforge::NodeId> const& bindings) {
+    if (bindings.empty() || !isPlaceholder(reference)) {
+        return reference;
+    }
+    return bindings[placeholderIndex(reference)];
+}
+
+bool isStandalone(char c) {
+    static constexpr std::string_view standalone = "(),?:+-*/%^";
+    return standalone.contains(c);
+}
+
+// whitespace is only kept where dropping it could join two tokens, e.g. "1 2" or "< =".
+// formulas differing only in such whitespace share one cache entry.
+std::string normalizeFormula(std::string_view formula) {
+    std::string normalized;
+    normalized.reserve(formula.size());
+    bool pendingSpace = false;
+    for (char const c : formula) {
+        if (std::isspace(static_cast<unsigned char>(c)) != 0) {
+            pendingSpace = !normalized.empty();
+            continue;
+        }
+        if (pendingSpace && !isStandalone(normalized.back()) && !isStandalone(c)) {
+            normalized.push_back(' ');
+        }
+        pendingSpace = false;
+        normalized.push_back(c);
+    }
+    return normalized;
+}
+
 bool isValidCollectionOperation(SF_CollectionOperation operation) {
     switch (operation) {
     case SF_COLLECTION_OP_SUM:
@@ -33,6 +227,57 @@ bool isValidCollectionOperation(SF_CollectionOperation operation) {
 
 namespace statforge::statkernel {
 
+void Compiler::setOptions(CompileOptions options) {
+    _options = options;
+    _formulaCache.clear();
+}
+
+void Compiler::setFormulaCacheCapacity(std::size_t capacity) {
+    _formulaCache.setCapacity(capacity);
+}
+
+FormulaCacheStats Compiler::formulaCacheStats() const {
+    return {.hits = _formulaCache.hits(),
+            .misses = _formulaCache.misses(),
+            .size = _formulaCache.size(),
+            .capacity = _formulaCache.capacity()};
+}
+
+VoidResult Compiler::registerFunction(std::string name,
+                                      dsl::Intrinsic callable,
+                                      std::size_t minArguments,
+                                      std::size_t maxArguments,
+                                      bool pure) {
+    return _functions.add(std::move(name), std::move(callable), minArguments, maxArguments, pure);
+}
+
+void Compiler::reset() {
+    _templates.clear();
+    _tags.clear();
+    _sharedKeys.clear();
+    _sharedNodes.clear();
+    _hoistings.clear();
+    _inlineKeys.clear();
+    _rehoists.clear();
+    _nextSharedId = 0;
+    _instantiations.clear();
+}
+
+bool Compiler::isHidden(NodeId const& id) const {
+    return _sharedNodes.contains(id);
+}
+
+FormulaProgram Compiler::formulaProgram(NodeId const& id) const {
+    auto const& [ast, bindings] = _instantiations.at(id);
+
+    FormulaProgram program{.expr = {ast, &ast->expr}, .references = {}, .impure = ast->impure};
+    program.references.reserve(ast->dependencies.size());
+    for (auto const& reference : ast->dependencies) {
+        program.references.emplace_back(reference, bindReference(reference, bindings));
+    }
+    return program;
+}
+
 VoidResult Compiler::addCollectionNode(NodeId const& id,
                                        std::vector<NodeId> const& dependencies,
                                        SF_CollectionOperation operation) {
@@ -42,6 +287,12 @@ VoidResult Compiler::addCollectionNode(NodeId const& id,
         std::format(R"(Trying to create collection node "{}" with invalid operation "{}")",
                     id,
                     static_cast<int>(operation)));
+    for (auto const& dependency : dependencies) {
+        SF_RETURN_UNEXPECTED_IF(
+            isHidden(dependency),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to add non-existing dependency "{}" to "{}")", dependency, id));
+    }
 
     SF_RETURN_ERROR_IF_UNEXPECTED(_graph.addNode(id, {}));
 
@@ -53,124 +304,178 @@ VoidResult Compiler::addCollectionNode(NodeId const& id,
         return result;
     }
 
-    _graph.node(id) = {.formula = compileCollectionFormula(id, operation),
+    auto aggregate = std::make_shared<CollectionAggregate>(operation);
+    _graph.node(id) = {.formula = compileCollectionFormula(id, aggregate),
                        .value = 0,
                        .type = NodeType::Collection,
                        .collectionOperation = operation,
-                       .dirty = true};
+                       .dirty = true,
+                       .aggregate = aggregate};
 
     return {};
 }
 
-NodeFormula Compiler::compileCollectionFormula(NodeId const& id, SF_CollectionOperation operation) {
-    switch (operation) {
-    case SF_COLLECTION_OP_SUM:
-        return [this, id]() -> NodeValue {
-            NodeValue value{0};
-            for (auto const& dependency : _graph.dependencies(id)) {
-                value += _graph.node(dependency).value;
-            }
-            return value;
-        };
-    case SF_COLLECTION_OP_PRODUCT:
-        return [this, id]() -> NodeValue {
-            NodeValue value{1};
-            for (auto const& dependency : _graph.dependencies(id)) {
-                value *= _graph.node(dependency).value;
-            }
-            return value;
-        };
-    case SF_COLLECTION_OP_MEDIAN:
-        return [this, id]() -> NodeValue {
-            const auto& dependencies = _graph.dependencies(id);
-            if (dependencies.empty()) {
-                return 0.0;
-            }
+VoidResult Compiler::addQueryCollectionNode(NodeId const& id,
+                                            std::string_view query,
+                                            SF_CollectionOperation operation) {
+    auto queryResult = TagQuery::parse(query);
+    SF_RETURN_ERROR_IF_UNEXPECTED(queryResult);
 
-            std::vector<NodeValue> values;
-            values.reserve(dependencies.size());
-            for (auto const& dependency : dependencies) {
-                values.push_back(_graph.node(dependency).value);
-            }
+    SF_RETURN_ERROR_IF_UNEXPECTED(
+        addCollectionNode(id, _tags.matches(*queryResult, id), operation));
+    _tags.addQuery(id, std::move(*queryResult));
+    return {};
+}
 
-            std::ranges::sort(values);
-            auto const middle = values.size() / 2;
-            if (values.size() % 2 == 1) {
-                return values[middle];
-            }
-            return (values[middle - 1] + values[middle]) / 2.0;
-        };
-    case SF_COLLECTION_OP_AVERAGE:
-        return [this, id]() -> NodeValue {
-            const auto& dependencies = _graph.dependencies(id);
-            if (dependencies.empty()) {
-                return 0.0;
-            }
+NodeFormula Compiler::compileCollectionFormula(NodeId const& id,
+                                               std::shared_ptr<CollectionAggregate> aggregate) {
+    // members that didn't change since the last evaluation aren't read again
+    return [this, id, aggregate = std::move(aggregate)]() -> NodeValue {
+        return aggregate->update(_graph, _graph.dependencies(id));
+    };
+}
 
-            NodeValue value{0};
-            for (auto const& dependency : dependencies) {
-                value += _graph.node(dependency).value;
-            }
-            return value / static_cast<NodeValue>(dependencies.size());
-        };
-    case SF_COLLECTION_OP_MIN:
-        return [this, id]() -> NodeValue {
-            const auto& dependencies = _graph.dependencies(id);
-            if (dependencies.empty()) {
-                return 0.0;
-            }
+VoidResult Compiler::addFormulaNode(NodeId const& id, std::string_view formula) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_graph.addNode(id, {}));
+    auto& node = _graph.node(id);
+    node = {.formula = {}, .value = 0.0, .type = NodeType::Formula, .dirty = true};
 
-            auto first = dependencies.begin();
-            NodeValue value = _graph.node(*first).value;
-            for (auto iter = std::next(first); iter != dependencies.end(); ++iter) {
-                value = std::min(value, _graph.node(*iter).value);
-            }
-            return value;
-        };
-    case SF_COLLECTION_OP_MAX:
-        return [this, id]() -> NodeValue {
-            const auto& dependencies = _graph.dependencies(id);
-            if (dependencies.empty()) {
-                return 0.0;
-            }
+    auto programResult = compileProgram(id, formula);
+    if (!programResult) {
+        _graph.removeNode(id);
+        return std::unexpected(std::move(programResult).error());
+    }
 
-            auto first = dependencies.begin();
-            NodeValue value = _graph.node(*first).value;
-            for (auto iter = std::next(first); iter != dependencies.end(); ++iter) {
-                value = std::max(value, _graph.node(*iter).value);
-            }
-            return value;
-        };
-    case SF_COLLECTION_OP_COUNT:
-        return [this, id]() -> NodeValue {
-            return static_cast<NodeValue>(_graph.dependencies(id).size());
-        };
+    // newly created nodes cannot appear as dependencies of existing nodes.
+    // this guarantees skipCycleCheck is safe here.
+    auto formulaResult = wireFormula(id, std::move(*programResult), skipCycleCheck);
+    if (!formulaResult) {
+        _graph.removeNode(id);
+        rehoistSubexpressions();
+        return std::unexpected(std::move(formulaResult).error());
     }
+    node.formula = std::move(*formulaResult);
+    rehoistSubexpressions();
 
-    std::unreachable();
+    return {};
 }
 
-VoidResult Compiler::addFormulaNode(NodeId const& id, std::string_view formula) {
+VoidResult Compiler::addModifierNode(NodeId const& id, ModifierGroups const& groups) {
+    auto const members = groups.members();
+    for (auto const& member : members) {
+        SF_RETURN_UNEXPECTED_IF(
+            isHidden(member),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to add non-existing dependency "{}" to "{}")", member, id));
+    }
+
     SF_RETURN_ERROR_IF_UNEXPECTED(_graph.addNode(id, {}));
-    auto& node = _graph.node(id);
-    node = {.formula = {}, .value = 0.0, .type = NodeType::Formula, .dirty = true};
 
-    auto astResult = compileAst(id, formula);
-    if (!astResult) {
+    // newly created nodes cannot appear as dependencies of existing nodes.
+    // this guarantees skipCycleCheck is safe here.
+    auto result = _graph.setNodeDependencies(id, members, skipCycleCheck);
+    if (!result) {
         _graph.removeNode(id);
-        return std::unexpected(std::move(astResult).error());
+        return result;
+    }
+
+    auto modifier = std::make_shared<ModifierAggregate>(groups);
+    _graph.node(id) = {.formula = [this, modifier]() -> NodeValue {
+                           return modifier->update(_graph);
+                       },
+                       .value = 0,
+                       .type = NodeType::Modifier,
+                       .dirty = true,
+                       .modifier = modifier};
+
+    return {};
+}
+
+VoidResult Compiler::addFormulaTemplate(std::string const& name, std::string_view formula) {
+    SF_RETURN_UNEXPECTED_IF(
+        _templates.contains(name),
+        SF_ERR_TEMPLATE_ALREADY_EXISTS,
+        std::format(R"(Trying to create already existing formula template "{}")", name));
+
+    auto astResult = compileAst(name, formula, "Template");
+    SF_RETURN_ERROR_IF_UNEXPECTED(astResult);
+
+    FormulaTemplate formulaTemplate{
+        .program = std::make_shared<CompiledAst const>(std::move(*astResult)), .placeholders = 0};
+    std::vector<std::size_t> indices;
+    for (auto const& reference : formulaTemplate.program->dependencies) {
+        if (isPlaceholder(reference)) {
+            indices.push_back(placeholderIndex(reference));
+        }
     }
+    std::ranges::sort(indices);
+    auto dupes = std::ranges::unique(indices);
+    indices.erase(dupes.begin(), dupes.end());
+    // bindings are positional, an unused placeholder would need a binding nothing checks
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        SF_RETURN_UNEXPECTED_IF(
+            indices[i] != i,
+            SF_ERR_INVALID_DSL,
+            std::format(R"(Formula template "{}" uses placeholder <${}> without <${}>)",
+                        name,
+                        indices[i],
+                        i));
+    }
+    formulaTemplate.placeholders = indices.size();
+
+    _templates.emplace(name, std::move(formulaTemplate));
+    return {};
+}
+
+VoidResult Compiler::addTemplateNode(NodeId const& id,
+                                     std::string const& templateName,
+                                     std::vector<NodeId> const& bindings) {
+    auto it = _templates.find(templateName);
+    SF_RETURN_UNEXPECTED_IF(
+        it == _templates.end(),
+        SF_ERR_TEMPLATE_NOT_FOUND,
+        std::format(R"(Trying to create node "{}" from non-existing formula template "{}")",
+                    id,
+                    templateName));
+    auto const& formulaTemplate = it->second;
+    SF_RETURN_UNEXPECTED_IF(
+        bindings.size() != formulaTemplate.placeholders,
+        SF_ERR_TEMPLATE_BINDING_MISMATCH,
+        std::format(R"(Formula template "{}" expects {} bindings, node "{}" provided {})",
+                    templateName,
+                    formulaTemplate.placeholders,
+                    id,
+                    bindings.size()));
+
+    std::vector<NodeId> dependencies;
+    dependencies.reserve(formulaTemplate.program->dependencies.size());
+    for (auto const& reference : formulaTemplate.program->dependencies) {
+        auto const dependency = bindReference(reference, bindings);
+        SF_RETURN_UNEXPECTED_IF(
+            isHidden(NodeId{dependency}),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to add non-existing dependency "{}" to "{}")", dependency, id));
+        dependencies.emplace_back(dependency);
+    }
+    // different placeholders may be bound to the same node
+    std::ranges::sort(dependencies);
+    auto dupes = std::ranges::unique(dependencies);
+    dependencies.erase(dupes.begin(), dupes.end());
+
+    SF_RETURN_ERROR_IF_UNEXPECTED(_graph.addNode(id, {}));
 
     // newly created nodes cannot appear as dependencies of existing nodes.
     // this guarantees skipCycleCheck is safe here.
-    auto dependencyResult =
-        setNodeDependencies(id, dsl::extractDependencies(astResult->expr), skipCycleCheck);
-    if (!dependencyResult) {
+    auto result = _graph.setNodeDependencies(id, std::move(dependencies), skipCycleCheck);
+    if (!result) {
         _graph.removeNode(id);
-        return dependencyResult;
+        return result;
     }
-    node.formula = compileNodeFormula(std::move(*astResult));
 
+    _graph.node(id) = {.formula = instantiateFormula(id, formulaTemplate.program, bindings),
+                       .value = 0.0,
+                       .type = NodeType::Formula,
+                       .dirty = true};
     return {};
 }
 
@@ -181,7 +486,7 @@ VoidResult Compiler::addValueNode(NodeId const& id, double value) {
 }
 
 VoidResult Compiler::setNodeFormula(NodeId const& id, std::string_view formula) {
-    SF_RETURN_UNEXPECTED_IF(!_graph.contains(id),
+    SF_RETURN_UNEXPECTED_IF(!_graph.contains(id) || isHidden(id),
                             SF_ERR_NODE_NOT_FOUND,
                             std::format(R"(Trying to set formula of non-existing node "{}")", id));
     SF_RETURN_UNEXPECTED_IF(
@@ -189,13 +494,32 @@ VoidResult Compiler::setNodeFormula(NodeId const& id, std::string_view formula)
         SF_ERR_NODE_TYPE_MISMATCH,
         std::format(R"(Trying to manually change formula of non formula node "{}")", id));
 
-    auto astResult = compileAst(id, formula);
-    SF_RETURN_ERROR_IF_UNEXPECTED(astResult);
+    auto programResult = compileProgram(id, formula);
+    SF_RETURN_ERROR_IF_UNEXPECTED(programResult);
 
-    auto dependencyResult = setNodeDependencies(id, dsl::extractDependencies(astResult->expr));
-    SF_RETURN_ERROR_IF_UNEXPECTED(dependencyResult);
+    Hoisting previous;
+    if (auto it = _hoistings.find(id); it != _hoistings.end()) {
+        previous = std::move(it->second);
+        _hoistings.erase(it);
+    }
+    forgetInlineKeys(id, previous);
 
-    _graph.node(id).formula = compileNodeFormula(std::move(*astResult));
+    auto formulaResult = wireFormula(id, std::move(*programResult), false);
+    if (!formulaResult) {
+        // the failed formula released everything it took
+        for (auto const& key : previous.inlineKeys) {
+            _inlineKeys.try_emplace(key, id);
+        }
+        if (previous.program) {
+            _hoistings[id] = std::move(previous);
+        }
+        rehoistSubexpressions();
+        return std::unexpected(std::move(formulaResult).error());
+    }
+
+    _graph.node(id).formula = std::move(*formulaResult);
+    releaseSharedNodes(previous.uses);
+    rehoistSubexpressions();
 
     return {};
 }
@@ -203,12 +527,222 @@ VoidResult Compiler::setNodeFormula(NodeId const& id, std::string_view formula)
 VoidResult Compiler::setCollectionNodeDependencies(NodeId const& id,
                                                    std::vector<NodeId> const& dependencies,
                                                    bool skipCycleCheck) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkManualCollection(id));
+    for (auto const& dependency : dependencies) {
+        SF_RETURN_UNEXPECTED_IF(
+            isHidden(dependency),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to add non-existing dependency "{}" to "{}")", dependency, id));
+    }
+
+    SF_RETURN_ERROR_IF_UNEXPECTED(setNodeDependencies(id, dependencies, skipCycleCheck));
+    // gates were part of the replaced dependencies
+    _graph.node(id).aggregate->clearGates();
+    return {};
+}
+
+VoidResult Compiler::setModifierNodeGroups(NodeId const& id, ModifierGroups const& groups) {
+    SF_RETURN_UNEXPECTED_IF(
+        isHidden(id),
+        SF_ERR_NODE_NOT_FOUND,
+        std::format(R"(Trying to set modifier groups of non-existing node "{}")", id));
+    SF_RETURN_UNEXPECTED_IF(
+        _graph.contains(id) && (_graph.node(id).type != NodeType::Modifier),
+        SF_ERR_NODE_TYPE_MISMATCH,
+        std::format(R"(Trying to set modifier groups of non modifier node "{}")", id));
+
+    auto members = groups.members();
+    for (auto const& member : members) {
+        SF_RETURN_UNEXPECTED_IF(
+            isHidden(member),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to add non-existing dependency "{}" to "{}")", member, id));
+    }
+
+    SF_RETURN_ERROR_IF_UNEXPECTED(setNodeDependencies(id, std::move(members)));
+    _graph.node(id).modifier->setGroups(groups);
+    return {};
+}
+
+VoidResult Compiler::addCollectionMembers(NodeId const& id, std::span<NodeId const> members) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkManualCollection(id));
+    SF_RETURN_UNEXPECTED_IF(
+        !_graph.contains(id),
+        SF_ERR_NODE_NOT_FOUND,
+        std::format(R"(Trying to add members to non-existing node "{}")", id));
+    for (auto const& member : members) {
+        SF_RETURN_UNEXPECTED_IF(
+            isHidden(member),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to add non-existing dependency "{}" to "{}")", member, id));
+    }
+
+    for (std::size_t i = 0; i < members.size(); ++i) {
+        auto result = addCollectionMember(id, members[i]);
+        if (result) {
+            continue;
+        }
+
+        for (auto const& added : members.first(i)) {
+            removeCollectionMember(id, added);
+        }
+        return std::unexpected(std::move(result).error());
+    }
+    return {};
+}
+
+VoidResult Compiler::removeCollectionMembers(NodeId const& id, std::span<NodeId const> members) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkManualCollection(id));
+    SF_RETURN_UNEXPECTED_IF(
+        !_graph.contains(id),
+        SF_ERR_NODE_NOT_FOUND,
+        std::format(R"(Trying to remove members from non-existing node "{}")", id));
+
+    auto const& aggregate = _graph.node(id).aggregate;
+    for (auto const& member : members) {
+        SF_RETURN_UNEXPECTED_IF(
+            aggregate->isGate(member),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to remove gate "{}" of "{}" as a member)", member, id));
+    }
+
+    SF_RETURN_ERROR_IF_UNEXPECTED(_graph.removeDependencies(id, members));
+    for (auto const& member : members) {
+        aggregate->removeMember(member);
+        releaseGate(id, member);
+    }
+    return {};
+}
+
+VoidResult Compiler::addGatedCollectionMember(NodeId const& id,
+                                              NodeId const& member,
+                                              NodeId const& gate) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkManualCollection(id));
+    SF_RETURN_UNEXPECTED_IF(
+        !_graph.contains(id),
+        SF_ERR_NODE_NOT_FOUND,
+        std::format(R"(Trying to add members to non-existing node "{}")", id));
+    for (auto const* dependency : {&member, &gate}) {
+        SF_RETURN_UNEXPECTED_IF(
+            isHidden(*dependency),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(R"(Trying to add non-existing dependency "{}" to "{}")", *dependency, id));
+    }
+
+    auto const& aggregate = _graph.node(id).aggregate;
+    SF_RETURN_UNEXPECTED_IF(
+        aggregate->isGate(member),
+        SF_ERR_DUPLICATE_DEPENDENCY,
+        std::format(R"(Trying to add gate "{}" of "{}" as a member)", member, id));
+    // gates of several members are a single dependency
+    auto const newGate = !aggregate->isGate(gate);
+    if (newGate && _graph.contains(gate)) {
+        auto const& gateDependents = static_cast<Graph const&>(_graph).dependents(gate);
+        SF_RETURN_UNEXPECTED_IF(
+            std::ranges::find(gateDependents, id) != gateDependents.end(),
+            SF_ERR_DUPLICATE_DEPENDENCY,
+            std::format(R"(Trying to use member "{}" of "{}" as a gate)", gate, id));
+    }
+
+    SF_RETURN_ERROR_IF_UNEXPECTED(addCollectionMember(id, member));
+    if (newGate) {
+        if (auto result = _graph.addDependency(id, gate); !result) {
+            removeCollectionMember(id, member);
+            return result;
+        }
+    }
+    aggregate->setGate(member, gate);
+    return {};
+}
+
+void Compiler::releaseGate(NodeId const& id, NodeId const& member) {
+    if (auto gate = _graph.node(id).aggregate->clearGate(member)) {
+        _graph.removeDependency(id, *gate);
+    }
+}
+
+VoidResult Compiler::checkManualCollection(NodeId const& id) const {
+    SF_RETURN_UNEXPECTED_IF(
+        isHidden(id),
+        SF_ERR_NODE_NOT_FOUND,
+        std::format(R"(Trying to set dependencies of non-existing node "{}")", id));
     SF_RETURN_UNEXPECTED_IF(
         _graph.contains(id) && (_graph.node(id).type != NodeType::Collection),
         SF_ERR_NODE_TYPE_MISMATCH,
         std::format(R"(Trying to manually change dependencies of non collection node "{}")", id));
+    SF_RETURN_UNEXPECTED_IF(
+        _tags.isQueryCollection(id),
+        SF_ERR_NODE_TYPE_MISMATCH,
+        std::format(R"(Trying to manually change dependencies of query collection node "{}")", id));
+    return {};
+}
 
-    return setNodeDependencies(id, dependencies, skipCycleCheck);
+VoidResult Compiler::addCollectionMember(NodeId const& id,
+                                         NodeId const& member,
+                                         bool skipCycleCheck) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_graph.addDependency(id, member, skipCycleCheck));
+    _graph.node(id).aggregate->addMember(member, _graph.node(member));
+    return {};
+}
+
+VoidResult Compiler::removeCollectionMember(NodeId const& id, NodeId const& member) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_graph.removeDependency(id, member));
+    _graph.node(id).aggregate->removeMember(member);
+    return {};
+}
+
+Result<std::vector<NodeId>> Compiler::setNodeTags(NodeId const& id, std::vector<std::string> tags) {
+    SF_RETURN_UNEXPECTED_IF(!_graph.contains(id) || isHidden(id),
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to set tags of non-existing node "{}")", id));
+    for (auto const& tag : tags) {
+        SF_RETURN_UNEXPECTED_IF(!TagQuery::isValidTag(tag),
+                                SF_ERR_INVALID_TAG,
+                                std::format(R"(Trying to set invalid tag "{}" on "{}")", tag, id));
+    }
+    std::ranges::sort(tags);
+    auto const duplicates = std::ranges::unique(tags);
+    tags.erase(duplicates.begin(), duplicates.end());
+
+    auto const changes = _tags.changes(id, tags);
+    for (std::size_t i = 0; i < changes.size(); ++i) {
+        auto const& change = changes[i];
+        auto result = change.joins ? addCollectionMember(change.collection, id)
+                                   : removeCollectionMember(change.collection, id);
+        if (result) {
+            continue;
+        }
+
+        // joining can close a cycle, undo everything applied so far
+        for (auto const& applied : std::span{changes}.first(i)) {
+            if (applied.joins) {
+                removeCollectionMember(applied.collection, id);
+            } else {
+                addCollectionMember(applied.collection, id, skipCycleCheck);
+            }
+        }
+        return std::unexpected(std::move(result).error());
+    }
+    _tags.setTags(id, std::move(tags));
+
+    std::vector<NodeId> collections;
+    collections.reserve(changes.size());
+    for (auto const& change : changes) {
+        collections.push_back(change.collection);
+    }
+    return collections;
+}
+
+VoidResult Compiler::removeNode(NodeId const& id) {
+    SF_RETURN_UNEXPECTED_IF(isHidden(id),
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to remove non-existing node "{}")", id));
+    SF_RETURN_ERROR_IF_UNEXPECTED(_graph.removeNode(id));
+    _tags.removeNode(id);
+    _instantiations.erase(id);
+    releaseHoisting(id);
+
+    return {};
 }
 
 VoidResult Compiler::setNodeDependencies(NodeId const& id,
@@ -224,30 +758,338 @@ VoidResult Compiler::setNodeDependencies(NodeId const& id,
     return _graph.setNodeDependencies(id, dependencies, skipCycleCheck);
 }
 
-Compiler::CompiledAstResult Compiler::compileAst(NodeId const& id, std::string_view formula) {
+Compiler::CompiledAstResult Compiler::compileAst(std::string_view owner,
+                                                 std::string_view formula,
+                                                 std::string_view ownerKind) {
     CompiledAst ast{};
-    ast.source = std::make_unique<std::string>(formula);
-
-    auto astResult = dsl::Tokenizer{*ast.source}
-                         .tokenize()
-                         .and_then([](auto const& tokens) { return dsl::Parser{tokens}.parse(); })
-                         .transform_error([&id](auto&& error) {
-                             error.message.insert(0, std::format(R"(Node "{}": )", id));
-                             return std::move(error);
-                         });
-    SF_RETURN_ERROR_IF_UNEXPECTED(astResult);
+    ast.source = std::make_shared<std::string const>(formula);
+
+    auto const addOwner = [owner, ownerKind](ErrorInfo error) {
+        error.message.insert(0, std::format(R"({} "{}": )", ownerKind, owner));
+        return error;
+    };
+
+    // the token buffer is reused, bulk loading would otherwise allocate it per formula
+    auto tokenResult = dsl::Tokenizer{*ast.source}.tokenize(_tokens);
+    if (!tokenResult) {
+        return std::unexpected(addOwner(std::move(tokenResult).error()));
+    }
+
+    dsl::OptimizeOptions const optimizeOptions{.fastMath = _options.fastMath};
+    auto astResult = dsl::Parser{_tokens, optimizeOptions, _functions}.parse();
+    if (!astResult) {
+        return std::unexpected(addOwner(std::move(astResult).error()));
+    }
 
-    ast.expr = std::move(*astResult.value());
+    ast.expr = std::move(*astResult);
+    analyzeAst(ast, _functions);
     return ast;
 }
 
-NodeFormula Compiler::compileNodeFormula(CompiledAst compiledAst) {
-    return [this, ast = std::make_shared<CompiledAst>(std::move(compiledAst))]() -> NodeValue {
-        dsl::Context ctx{.nodeLookup = [this](std::string_view id) -> double {
-            return _graph.node(std::string(id)).value;
-        }};
-        return dsl::evaluate(ast->expr, ctx);
+void Compiler::analyzeAst(CompiledAst& ast, dsl::FunctionRegistry const& functions) {
+    ast.dependencies = dsl::extractDependencies(ast.expr);
+    ast.conditional =
+        dsl::extractUnconditionalDependencies(ast.expr).size() != ast.dependencies.size();
+    ast.impure = isImpure(ast.expr, functions);
+}
+
+Compiler::ProgramResult Compiler::compileProgram(NodeId const& id, std::string_view formula) {
+    auto key = normalizeFormula(formula);
+    if (auto const* program = _formulaCache.find(key)) {
+        return *program;
+    }
+
+    auto astResult = compileAst(id, formula);
+    SF_RETURN_ERROR_IF_UNEXPECTED(astResult);
+
+    auto program = std::make_shared<CompiledAst const>(std::move(*astResult));
+    _formulaCache.insert(std::move(key), program);
+    return program;
+}
+
+NodeFormula Compiler::compileNodeFormula(NodeId const& id, CompiledAst compiledAst) {
+    analyzeAst(compiledAst, _functions);
+    return instantiateFormula(id, std::make_shared<CompiledAst const>(std::move(compiledAst)), {});
+}
+
+NodeFormula Compiler::instantiateFormula(NodeId const& id,
+                                         std::shared_ptr<CompiledAst const> ast,
+                                         std::vector<NodeId> bindings) {
+    // impure calls have to be evaluated on every evaluation pass
+    _executor.setVolatile(id, ast->impure);
+    _instantiations[id] = {.ast = ast, .bindings = bindings};
+
+    if (!ast->conditional) {
+        return [this, ast = std::move(ast), bindings = std::move(bindings)]() -> NodeValue {
+            dsl::Context ctx{.nodeLookup = [this, &bindings](std::string_view ref) -> double {
+                                 return _graph.node(NodeId{bindReference(ref, bindings)}).value;
+                             },
+                             .functions = &_functions};
+            return dsl::evaluate(ast->expr, ctx);
+        };
+    }
+
+    // dependencies behind ternary branches or && and || are evaluated on first read. the ones
+    // not read are recorded in the graph, so changes to them don't dirty this node.
+    return [this,
+            id,
+            ast = std::move(ast),
+            bindings = std::move(bindings),
+            reads = std::vector<std::string_view>{}]() mutable -> NodeValue {
+        reads.clear();
+        dsl::Context ctx{.nodeLookup = [this, &bindings, &reads](std::string_view ref) -> double {
+            auto const name = bindReference(ref, bindings);
+            NodeId const dependency{name};
+            if (_graph.node(dependency).dirty) {
+                _executor.evaluate(dependency);
+            }
+            reads.push_back(name);
+            return _graph.node(dependency).value;
+        },
+                         .functions = &_functions};
+        auto const value = dsl::evaluate(ast->expr, ctx);
+
+        std::ranges::sort(reads);
+        std::vector<NodeId> unread;
+        for (auto const& dependency : _graph.dependencies(id)) {
+            if (!std::ranges::binary_search(reads, std::string_view{dependency})) {
+                // nothing pulls it in anymore, the next evaluation pass has to reach it
+                if (_graph.node(dependency).dirty) {
+                    _executor.markAsDirtyLeaf(dependency);
+                }
+                unread.push_back(dependency);
+            }
+        }
+        _graph.setUnreadDependencies(id, std::move(unread));
+
+        return value;
     };
 }
 
+Result<NodeFormula> Compiler::wireFormula(NodeId const& id,
+                                          std::shared_ptr<CompiledAst const> program,
+                                          bool skipCycleCheck) {
+    for (auto const& dependency : program->dependencies) {
+        SF_RETURN_UNEXPECTED_IF(
+            isPlaceholder(dependency),
+            SF_ERR_INVALID_DSL,
+            std::format(R"(Node "{}": placeholder <{}> is only allowed in formula templates)",
+                        id,
+                        dependency));
+    }
+    SF_RETURN_ERROR_IF_UNEXPECTED(
+        setNodeDependencies(id, program->dependencies, skipCycleCheck));
+
+    if (!_options.eliminateCommonSubexpressions) {
+        return instantiateFormula(id, std::move(program), {});
+    }
+
+    // hoisting rewrites the expression, the cached program has to stay untouched
+    CompiledAst ast{.source = program->source,
+                    .sharedRefs = {},
+                    .expr = program->expr,
+                    .dependencies = {}};
+    _hoistings[id].program = std::move(program);
+
+    // hoisted subexpressions only depend on a subset of the dependencies validated above,
+    // so rewiring to the hidden nodes cannot introduce a cycle.
+    auto hoisted = shareSubexpressions(id, ast);
+    if (hoisted) {
+        hoisted = setNodeDependencies(id, dsl::extractDependencies(ast.expr), true);
+    }
+    if (!hoisted) {
+        releaseHoisting(id);
+        return std::unexpected(std::move(hoisted).error());
+    }
+    return compileNodeFormula(id, std::move(ast));
+}
+
+VoidResult Compiler::shareSubexpressions(NodeId const& owner, CompiledAst& ast) {
+    std::vector<Subexpression> subexpressions(ast.expr.size());
+    describe(ast.expr, ast.expr.root(), _functions, subexpressions);
+
+    // sharing only replaces subexpressions, the root itself stays in place
+    auto const root = ast.expr.root();
+    std::unordered_map<std::string_view, std::size_t> occurrences;
+    for (dsl::ExprIndex index = 0; index < subexpressions.size(); ++index) {
+        if (index != root && isShareable(subexpressions[index])) {
+            ++occurrences[subexpressions[index].key];
+        }
+    }
+
+    // top down, so the largest shared subexpression is hoisted and the ones inside it are
+    // left to its hidden node. hoisting out of ternary branches is fine, unread hidden nodes
+    // are never evaluated
+    auto pending = children(ast.expr, root);
+    std::ranges::reverse(pending);
+    bool shared = false;
+    while (!pending.empty()) {
+        auto const subexpression = pending.back();
+        pending.pop_back();
+
+        auto const& key = subexpressions[subexpression].key;
+        auto const inlined = _inlineKeys.find(key);
+        if (!isShareable(subexpressions[subexpression]) ||
+            (occurrences[key] < 2 && !_sharedKeys.contains(key) &&
+             (inlined == _inlineKeys.end() || inlined->second == owner))) {
+            if (isShareable(subexpressions[subexpression]) && inlined == _inlineKeys.end()) {
+                _inlineKeys.emplace(key, owner);
+                _hoistings[owner].inlineKeys.push_back(key);
+            }
+            auto nested = children(ast.expr, subexpression);
+            pending.insert(pending.end(), nested.rbegin(), nested.rend());
+            continue;
+        }
+
+        auto const span =
+            std::visit([](auto const& node) { return node.span; }, ast.expr[subexpression]);
+        auto sharedId = acquireSharedNode(ast, subexpression, key);
+        SF_RETURN_ERROR_IF_UNEXPECTED(sharedId);
+
+        _hoistings[owner].uses.push_back(*sharedId);
+        ast.sharedRefs.push_back(std::make_unique<NodeId>(std::move(*sharedId)));
+        ast.expr[subexpression] = dsl::Ref{.name = *ast.sharedRefs.back(), .span = span};
+        shared = true;
+    }
+
+    // the hoisted subtrees are no longer reachable
+    if (shared) {
+        ast.expr.compact();
+    }
+    return {};
+}
+
+Result<NodeId> Compiler::acquireSharedNode(CompiledAst const& ast,
+                                           dsl::ExprIndex subexpression,
+                                           std::string const& key) {
+    if (auto it = _sharedKeys.find(key); it != _sharedKeys.end()) {
+        ++_sharedNodes.at(it->second).users;
+        return it->second;
+    }
+
+    // '$' can't appear in node references, so formulas can never address hidden nodes
+    NodeId id;
+    do {
+        id = std::format("${}", _nextSharedId++);
+    } while (_graph.contains(id));
+
+    SF_RETURN_ERROR_IF_UNEXPECTED(_graph.addNode(
+        id,
+        {.formula = {}, .value = 0.0, .type = NodeType::Formula, .dirty = true}));
+
+    auto program = std::make_shared<CompiledAst const>(
+        CompiledAst{.source = ast.source,
+                    .sharedRefs = {},
+                    .expr = ast.expr.subtree(subexpression),
+                    .dependencies = {}});
+    CompiledAst shared{.source = program->source,
+                       .sharedRefs = {},
+                       .expr = program->expr,
+                       .dependencies = {}};
+    _hoistings[id].program = std::move(program);
+
+    // the formula holding the first occurrence inline switches to the hidden node too. it lets
+    // go of its other inline subexpressions until then, so the ones inside this subexpression
+    // stay inline in the hidden node instead of being shared with it
+    if (auto it = _inlineKeys.find(key); it != _inlineKeys.end()) {
+        auto const holder = it->second;
+        if (auto hoisting = _hoistings.find(holder); hoisting != _hoistings.end()) {
+            forgetInlineKeys(holder, hoisting->second);
+        }
+        _inlineKeys.erase(key);
+        if (std::ranges::find(_rehoists, holder) == _rehoists.end()) {
+            _rehoists.push_back(holder);
+        }
+    }
+
+    // nothing depends on a new hidden node yet, so it cannot close a cycle
+    auto hoisted = shareSubexpressions(id, shared);
+    if (hoisted) {
+        hoisted = _graph.setNodeDependencies(
+            id, dsl::extractDependencies(shared.expr), skipCycleCheck);
+    }
+    if (!hoisted) {
+        releaseHoisting(id);
+        _graph.removeNode(id);
+        return std::unexpected(std::move(hoisted).error());
+    }
+    _graph.node(id).formula = compileNodeFormula(id, std::move(shared));
+
+    _sharedKeys.emplace(key, id);
+    _sharedNodes.emplace(id, SharedNode{.key = key, .users = 1});
+
+    return id;
+}
+
+void Compiler::rehoistSubexpressions() {
+    while (!_rehoists.empty()) {
+        auto const owner = std::move(_rehoists.back());
+        _rehoists.pop_back();
+        // the formula was replaced or removed meanwhile
+        auto const it = _hoistings.find(owner);
+        if (it == _hoistings.end()) {
+            continue;
+        }
+
+        auto previous = std::move(it->second);
+        _hoistings.erase(it);
+        forgetInlineKeys(owner, previous);
+
+        CompiledAst ast{.source = previous.program->source,
+                        .sharedRefs = {},
+                        .expr = previous.program->expr,
+                        .dependencies = {}};
+        _hoistings[owner].program = previous.program;
+
+        // same expression as before, so neither can fail or introduce a cycle
+        [[maybe_unused]] auto hoisted = shareSubexpressions(owner, ast);
+        assert(hoisted);
+        [[maybe_unused]] auto wired = _graph.setNodeDependencies(
+            owner, dsl::extractDependencies(ast.expr), skipCycleCheck);
+        assert(wired);
+        _graph.node(owner).formula = compileNodeFormula(owner, std::move(ast));
+        releaseSharedNodes(previous.uses);
+
+        // its value didn't change, but the new hidden node still has to be evaluated
+        _executor.markDirty(owner);
+    }
+}
+
+void Compiler::releaseHoisting(NodeId const& owner) {
+    auto it = _hoistings.find(owner);
+    if (it == _hoistings.end()) {
+        return;
+    }
+    auto const hoisting = std::move(it->second);
+    _hoistings.erase(it);
+    forgetInlineKeys(owner, hoisting);
+    releaseSharedNodes(hoisting.uses);
+}
+
+void Compiler::forgetInlineKeys(NodeId const& owner, Hoisting const& hoisting) {
+    for (auto const& key : hoisting.inlineKeys) {
+        if (auto it = _inlineKeys.find(key); it != _inlineKeys.end() && it->second == owner) {
+            _inlineKeys.erase(it);
+        }
+    }
+}
+
+void Compiler::releaseSharedNodes(std::vector<NodeId> const& uses) {
+    for (auto const& id : uses) {
+        auto it = _sharedNodes.find(id);
+        assert(it != _sharedNodes.end());
+        if (--it->second.users > 0) {
+            continue;
+        }
+
+        _sharedKeys.erase(it->second.key);
+        _sharedNodes.erase(it);
+
+        [[maybe_unused]] auto result = _graph.removeNode(id);
+        assert(result);
+        _instantiations.erase(id);
+        releaseHoisting(id);
+    }
+}
+
 } // namespace statforge::statkernel
@@ -4,46 +4,219 @@
 #include "types/definitions.hpp"
 #include "types/collection_operation.h"
 #include <dsl/evaluator.hpp>
+#include <dsl/functions.hpp>
+#include <stat_kernel/executor.hpp>
 #include <stat_kernel/graph.hpp>
+#include <stat_kernel/lru_cache.hpp>
+#include <stat_kernel/modifier_aggregate.hpp>
+#include <stat_kernel/tag_index.hpp>
 #include <stat_kernel/node.hpp>
+#include <memory>
+#include <span>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace statforge::statkernel {
 
+struct CompileOptions {
+    // hoist identical subexpressions of formula nodes into hidden shared nodes
+    bool eliminateCommonSubexpressions{false};
+    // allow optimizations that may change results for signed zeros, infinities, NaN or rounding
+    bool fastMath{false};
+};
+
+struct FormulaCacheStats {
+    std::size_t hits{0};
+    std::size_t misses{0};
+    std::size_t size{0};
+    std::size_t capacity{0};
+};
+
+// expression of a formula node and the nodes its references read
+struct FormulaProgram {
+    // shares ownership of the compiled program, references point into it
+    std::shared_ptr<dsl::ExpressionTree const> expr;
+    // distinct references of "expr" and the node each one is bound to
+    std::vector<std::pair<NodeId, NodeId>> references;
+    bool impure{false};
+};
+
 class Compiler {
 public:
     Compiler() = delete;
-    explicit Compiler(statkernel::Graph& graph) : _graph(graph) {
+    // the executor is only used while formulas are evaluated, it may still be under construction
+    Compiler(statkernel::Graph& graph, statkernel::Executor& executor)
+        : _graph(graph), _executor(executor) {
     }
 
+    // drops cached programs, they were compiled with the previous options
+    void setOptions(CompileOptions options);
+    void reset();
+
+    // compiled formulas are cached by their normalized text, 0 disables the cache
+    void setFormulaCacheCapacity(std::size_t capacity);
+    [[nodiscard]] FormulaCacheStats formulaCacheStats() const;
+
+    // only affects formulas compiled after the call
+    VoidResult registerFunction(std::string name,
+                                dsl::Intrinsic callable,
+                                std::size_t minArguments,
+                                std::size_t maxArguments,
+                                bool pure);
+
     VoidResult addCollectionNode(NodeId const& id,
                                  std::vector<NodeId> const& dependencies,
                                  SF_CollectionOperation operation);
+    VoidResult addQueryCollectionNode(NodeId const& id,
+                                      std::string_view query,
+                                      SF_CollectionOperation operation);
     VoidResult addFormulaNode(NodeId const& id, std::string_view formula);
+    VoidResult addModifierNode(NodeId const& id, ModifierGroups const& groups);
+    // placeholders <$0>, <$1>, ... are bound to node ids per instance
+    VoidResult addFormulaTemplate(std::string const& name, std::string_view formula);
+    VoidResult addTemplateNode(NodeId const& id,
+                               std::string const& templateName,
+                               std::vector<NodeId> const& bindings);
     VoidResult addValueNode(NodeId const& id, double value);
 
     VoidResult setNodeFormula(NodeId const& id, std::string_view formula);
     VoidResult setCollectionNodeDependencies(NodeId const& id,
                                              std::vector<NodeId> const& dependencies,
                                              bool skipCycleCheck = false);
+    VoidResult setModifierNodeGroups(NodeId const& id, ModifierGroups const& groups);
+    // all or none of "members" are added or removed, work scales with the number of members
+    VoidResult addCollectionMembers(NodeId const& id, std::span<NodeId const> members);
+    VoidResult removeCollectionMembers(NodeId const& id, std::span<NodeId const> members);
+    // "member" only takes part while "gate" is non-zero and not NaN, several members can share a gate
+    VoidResult addGatedCollectionMember(NodeId const& id,
+                                        NodeId const& member,
+                                        NodeId const& gate);
+    // drops the gate of a member that left "id", and the gate dependency once it's unused
+    void releaseGate(NodeId const& id, NodeId const& member);
+    // returns the query collections "id" joined or left
+    Result<std::vector<NodeId>> setNodeTags(NodeId const& id, std::vector<std::string> tags);
+    VoidResult removeNode(NodeId const& id);
+
+    // hidden nodes are compiler internals and must be treated like non-existing nodes by callers
+    [[nodiscard]] bool isHidden(NodeId const& id) const;
+
+    // "id" has to be a formula node, hidden ones included
+    [[nodiscard]] FormulaProgram formulaProgram(NodeId const& id) const;
+    // registry every formula was compiled with
+    [[nodiscard]] dsl::FunctionRegistry const& functions() const {
+        return _functions;
+    }
 
 private:
     VoidResult setNodeDependencies(NodeId const& id,
                                    std::vector<NodeId> const& dependencies,
                                    bool skipCycleCheck = false);
+    // collections whose members are set by the user, not by a tag query
+    VoidResult checkManualCollection(NodeId const& id) const;
+    // single member changes of collections, the caller validates ids and node types
+    VoidResult addCollectionMember(NodeId const& id,
+                                   NodeId const& member,
+                                   bool skipCycleCheck = false);
+    VoidResult removeCollectionMember(NodeId const& id, NodeId const& member);
 
     struct CompiledAst {
         // store "source" behind pointer to guarantee that copying or
-        // moving this struct wont break string views referencing it
-        std::unique_ptr<std::string> source;
+        // moving this struct wont break string views referencing it.
+        // shared, because hoisted subexpressions keep referencing it.
+        std::shared_ptr<std::string const> source;
+        // names of hidden nodes referenced by the rewritten expression
+        std::vector<std::unique_ptr<NodeId>> sharedRefs;
         dsl::ExpressionTree expr;
+        // distinct references of "expr"
+        std::vector<NodeId> dependencies;
+        // references behind ternary branches or the rhs of && and ||
+        bool conditional{false};
+        // calls impure functions
+        bool impure{false};
     };
     using CompiledAstResult = Result<CompiledAst>;
-    static CompiledAstResult compileAst(NodeId const& id, std::string_view formula);
-    NodeFormula compileCollectionFormula(NodeId const& id, SF_CollectionOperation operation);
-    NodeFormula compileNodeFormula(CompiledAst ast);
+    using ProgramResult = Result<std::shared_ptr<CompiledAst const>>;
+    CompiledAstResult compileAst(std::string_view owner,
+                                 std::string_view formula,
+                                 std::string_view ownerKind = "Node");
+    static void analyzeAst(CompiledAst& ast, dsl::FunctionRegistry const& functions);
+    // looks up the formula cache before compiling
+    ProgramResult compileProgram(NodeId const& id, std::string_view formula);
+    NodeFormula compileCollectionFormula(NodeId const& id,
+                                         std::shared_ptr<CollectionAggregate> aggregate);
+    NodeFormula compileNodeFormula(NodeId const& id, CompiledAst ast);
+    NodeFormula instantiateFormula(NodeId const& id,
+                                   std::shared_ptr<CompiledAst const> ast,
+                                   std::vector<NodeId> bindings);
+
+    Result<NodeFormula> wireFormula(NodeId const& id,
+                                    std::shared_ptr<CompiledAst const> program,
+                                    bool skipCycleCheck);
+    // subexpressions at any depth seen for the first time stay inline, the second occurrence
+    // hoists the largest one and rewrites the formula holding the first one
+    VoidResult shareSubexpressions(NodeId const& owner, CompiledAst& ast);
+    Result<NodeId> acquireSharedNode(CompiledAst const& ast,
+                                     dsl::ExprIndex subexpression,
+                                     std::string const& key);
+    // hoists again every formula whose inline subexpression got shared since, from the program
+    // it was compiled from. runs after the formula that shared it was installed
+    void rehoistSubexpressions();
+    void releaseSharedNodes(std::vector<NodeId> const& uses);
+
+    struct SharedNode {
+        std::string key;
+        std::size_t users{0};
+    };
+
+    // hoisting state of a formula node or hidden node
+    struct Hoisting {
+        // program before hoisting
+        std::shared_ptr<CompiledAst const> program;
+        // hidden nodes referenced, once per reference
+        std::vector<NodeId> uses;
+        // shareable subexpressions kept inline because no other formula had them
+        std::vector<std::string> inlineKeys;
+    };
+    // drops the hoisting of "owner" and releases the hidden nodes it used
+    void releaseHoisting(NodeId const& owner);
+    void forgetInlineKeys(NodeId const& owner, Hoisting const& hoisting);
+
+    struct FormulaTemplate {
+        // shared by all instances
+        std::shared_ptr<CompiledAst const> program;
+        std::size_t placeholders{0};
+    };
 
     statkernel::Graph& _graph;
+    statkernel::Executor& _executor;
+    CompileOptions _options;
+    dsl::FunctionRegistry _functions;
+    // reused by every compilation
+    std::vector<dsl::Token> _tokens;
+
+    std::unordered_map<std::string, NodeId> _sharedKeys;
+    std::unordered_map<NodeId, SharedNode> _sharedNodes;
+    std::unordered_map<NodeId, Hoisting> _hoistings;
+    // inline subexpressions and the formula holding them
+    std::unordered_map<std::string, NodeId> _inlineKeys;
+    // formulas holding a subexpression inline that got shared
+    std::vector<NodeId> _rehoists;
+    std::size_t _nextSharedId{0};
+
+    std::unordered_map<std::string, FormulaTemplate> _templates;
+    TagIndex _tags;
+
+    struct Instantiation {
+        std::shared_ptr<CompiledAst const> ast;
+        std::vector<NodeId> bindings;
+    };
+    // program and bindings every formula node was instantiated with
+    std::unordered_map<NodeId, Instantiation> _instantiations;
+
+    // programs in here never contain hidden nodes, shared subexpressions are hoisted per owner
+    LruCache<std::shared_ptr<CompiledAst const>> _formulaCache{1024};
 };
 
 } // namespace statforge::statkernel
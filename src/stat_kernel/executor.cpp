@@ -1,13 +1,20 @@
 #include "executor.hpp"
+#include "stat_kernel/collection_aggregate.hpp"
+#include "stat_kernel/modifier_aggregate.hpp"
 #include "types/definitions.hpp"
 
+#include <algorithm>
+#include <ranges>
 #include <stack>
+#include <utility>
+#include <vector>
 
 namespace statforge::statkernel {
 
 void Executor::setEvaluationType(EvaluationType type) {
     if (type == EvaluationType::Recursive) {
-        evaluateImpl = &Executor::evaluateRecursive;
+        evaluateImpl = static_cast<void (Executor::*)(std::span<NodeId const>)>(
+            &Executor::evaluateRecursive);
     } else {
         evaluateImpl = &Executor::evaluateIterative;
     }
@@ -15,47 +22,86 @@ void Executor::setEvaluationType(EvaluationType type) {
 
 void Executor::reset() {
     _dirtyLeaves.clear();
+    _volatileNodes.clear();
+    touch();
+}
+
+void Executor::touch() {
+    ++_changeCount;
+    if (_cleanEpoch % 2 == 0) {
+        ++_cleanEpoch;
+    }
 }
 
 void Executor::markDirty(NodeId const& id) {
-    std::stack<NodeId> work;
-    work.push(id);
+    touch();
+    // node and the dependency it was reached from. the graph isn't modified while marking,
+    // so pointing into its dependents lists is safe.
+    std::vector<std::pair<NodeId const*, NodeId const*>> work;
+    work.emplace_back(&id, nullptr);
 
     while (!work.empty()) {
-        auto currentId = work.top();
-        work.pop();
-        auto& currentNode = _graph.node(currentId);
+        auto const [currentId, changedDependency] = work.back();
+        work.pop_back();
+        auto& currentNode = _graph.node(*currentId);
         const bool hasFormula = currentNode.type != NodeType::Value;
 
+        // running aggregates need every changed member, even if they are dirty already
+        if (changedDependency != nullptr) {
+            if (currentNode.aggregate) {
+                currentNode.aggregate->markChanged(*changedDependency);
+            } else if (currentNode.modifier) {
+                currentNode.modifier->markChanged(*changedDependency);
+            }
+        }
+
         if (currentNode.dirty) {
             continue;
         }
 
         currentNode.dirty = hasFormula;
 
-        const auto& dependents = static_cast<const Graph&>(_graph).dependents(currentId);
+        // dependents that didn't read this node during their last evaluation stay clean.
+        // nothing pulls the node itself in then, evaluate() has to reach it as a leaf
+        const auto& dependents = static_cast<const Graph&>(_graph).dependents(*currentId);
+        bool pulled = false;
         for (auto const& dependent : dependents) {
-            work.push(dependent);
+            if (_graph.isActiveDependency(dependent, *currentId)) {
+                work.emplace_back(&dependent, currentId);
+                pulled = true;
+            }
         }
-        if (dependents.empty() && hasFormula) {
-            _dirtyLeaves.emplace_back(currentId);
+        if (!pulled && hasFormula) {
+            _dirtyLeaves.emplace_back(*currentId);
         }
     }
 }
 
 void Executor::markAsDirtyLeaf(NodeId const& id) {
+    touch();
     _dirtyLeaves.emplace_back(id);
 }
 
-void Executor::remove(NodeId const& id) {
-    auto it = std::ranges::find(_dirtyLeaves, id);
-    if (it != _dirtyLeaves.end()) {
-        _dirtyLeaves.erase(it);
+void Executor::setVolatile(NodeId const& id, bool isVolatile) {
+    auto it = std::ranges::find(_volatileNodes, id);
+    if (isVolatile && it == _volatileNodes.end()) {
+        _volatileNodes.push_back(id);
+    } else if (!isVolatile && it != _volatileNodes.end()) {
+        _volatileNodes.erase(it);
     }
 }
 
+void Executor::remove(NodeId const& id) {
+    std::erase(_dirtyLeaves, id);
+    setVolatile(id, false);
+}
+
 void Executor::evaluate(NodeId const& id) {
-    (this->*evaluateImpl)(id);
+    (this->*evaluateImpl)(std::span{&id, 1});
+}
+
+void Executor::evaluate(std::span<NodeId const> ids) {
+    (this->*evaluateImpl)(ids);
 }
 
 NodeValueResult Executor::getNodeValue(NodeId const& id) {
@@ -71,21 +117,42 @@ NodeValueResult Executor::getNodeValue(NodeId const& id) {
 }
 
 VoidResult Executor::evaluate() {
-    for (auto const& node : _dirtyLeaves) {
-        evaluate(node);
+    // leaves were counted when they were marked, the pass itself changes nothing
+    auto const changeCount = _changeCount;
+    for (auto const& node : _volatileNodes) {
+        markDirty(node);
+    }
+    // conditional formulas can leave dependencies they stopped reading as new leaves
+    while (!_dirtyLeaves.empty()) {
+        auto const leaves = std::exchange(_dirtyLeaves, {});
+        for (auto const& node : leaves) {
+            evaluate(node);
+        }
+    }
+    _changeCount = changeCount;
+    if (_cleanEpoch % 2 == 1) {
+        ++_cleanEpoch;
     }
-    _dirtyLeaves.clear();
     return {};
 }
 
+void Executor::evaluateRecursive(std::span<NodeId const> ids) {
+    for (auto const& id : ids) {
+        evaluateRecursive(id);
+    }
+}
+
 void Executor::evaluateRecursive(NodeId const& id) {
     auto& node = _graph.node(id);
     if (!node.dirty) {
         return;
     }
 
+    // unread dependencies are evaluated on demand by the formula itself
     for (auto const& dependency : _graph.dependencies(id)) {
-        evaluateRecursive(dependency);
+        if (_graph.isActiveDependency(id, dependency)) {
+            evaluateRecursive(dependency);
+        }
     }
 
     if (node.type != NodeType::Value) {
@@ -94,8 +161,8 @@ void Executor::evaluateRecursive(NodeId const& id) {
     node.dirty = false;
 }
 
-void Executor::evaluateIterative(NodeId const& id) {
-    if (!_graph.node(id).dirty) {
+void Executor::evaluateIterative(std::span<NodeId const> ids) {
+    if (std::ranges::none_of(ids, [this](NodeId const& id) { return _graph.node(id).dirty; })) {
         return;
     }
 
@@ -103,7 +170,11 @@ void Executor::evaluateIterative(NodeId const& id) {
     std::unordered_map<NodeId, VisitState> visitState;
 
     std::stack<NodeId> stack;
-    stack.push(id);
+    for (auto const& id : ids | std::views::reverse) {
+        if (_graph.node(id).dirty) {
+            stack.push(id);
+        }
+    }
 
     while (!stack.empty()) {
         auto currentId = stack.top();
@@ -125,8 +196,10 @@ void Executor::evaluateIterative(NodeId const& id) {
                 continue;
             }
 
+            // unread dependencies are evaluated on demand by the formula itself
             for (const auto& dep : static_cast<const Graph&>(_graph).dependencies(currentId)) {
-                if (visitState[dep] != VisitState::Visited) {
+                if (visitState[dep] != VisitState::Visited &&
+                    _graph.isActiveDependency(currentId, dep)) {
                     stack.push(dep);
                 }
             }
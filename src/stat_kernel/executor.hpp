@@ -3,6 +3,9 @@
 #include "stat_kernel/graph.hpp"
 #include "types/definitions.hpp"
 
+#include <cstdint>
+#include <span>
+
 namespace statforge::statkernel {
 
 using NodeValueResult = Result<NodeValue>;
@@ -22,17 +25,40 @@ public:
 
     void markDirty(NodeId const& id);
     void markAsDirtyLeaf(NodeId const& id);
+    // volatile nodes are marked dirty at the start of every evaluation pass
+    void setVolatile(NodeId const& id, bool isVolatile);
     void remove(NodeId const& id);
     [[nodiscard]] NodeValueResult getNodeValue(NodeId const& id);
     VoidResult evaluate();
+    void evaluate(NodeId const& id);
+    // one traversal for all "ids", shared dependencies are visited once
+    void evaluate(std::span<NodeId const> ids);
+
+    // even while all nodes are clean after evaluate(), odd once anything changed since.
+    // both transitions move it forward by one
+    [[nodiscard]] std::uint64_t cleanEpoch() const {
+        return _cleanEpoch;
+    }
+    // moves forward on every change, but not when evaluate() reevaluates formulas calling
+    // impure functions
+    [[nodiscard]] std::uint64_t changeCount() const {
+        return _changeCount;
+    }
+    [[nodiscard]] bool hasVolatileNodes() const {
+        return !_volatileNodes.empty();
+    }
 
 private:
-    void evaluate(NodeId const& id);
+    void touch();
+    void evaluateRecursive(std::span<NodeId const> ids);
     void evaluateRecursive(NodeId const& id);
-    void evaluateIterative(NodeId const& id);
-    void (Executor::*evaluateImpl)(NodeId const& id) = &Executor::evaluateIterative;
+    void evaluateIterative(std::span<NodeId const> ids);
+    void (Executor::*evaluateImpl)(std::span<NodeId const> ids) = &Executor::evaluateIterative;
 
     std::vector<NodeId> _dirtyLeaves;
+    std::vector<NodeId> _volatileNodes;
+    std::uint64_t _cleanEpoch{0};
+    std::uint64_t _changeCount{0};
     [[maybe_unused]] statkernel::Graph& _graph;
 };
 
@@ -7,7 +7,9 @@
 
 #include <algorithm>
 #include <experimental/scope>
+#include <iterator>
 #include <stack>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
@@ -18,9 +20,10 @@ namespace {
 bool hasPath(NodeId const& src,
              NodeId const& target,
              std::unordered_map<NodeId, std::vector<NodeId>> const& dependencyMap) {
-    //static for performance gains, avoiding heap allocations on every single call
-    static std::stack<NodeId> work;
-    static std::unordered_set<NodeId> visited;
+    //static for performance gains, avoiding heap allocations on every single call.
+    //per thread, engines may be used on different threads at the same time
+    thread_local std::stack<NodeId> work;
+    thread_local std::unordered_set<NodeId> visited;
 
     //clear data from previous calls
     while (!work.empty()) {
@@ -69,6 +72,10 @@ Node const& Graph::node(NodeId const& id) const {
     return it->second;
 }
 
+std::unordered_map<NodeId, Node> const& Graph::nodes() const {
+    return _nodes;
+}
+
 std::vector<NodeId> const& Graph::dependencies(NodeId const& id) const {
     auto it = _dependenciesMap.find(id);
     if (it != _dependenciesMap.end()) {
@@ -87,12 +94,35 @@ std::vector<NodeId> const& Graph::dependents(NodeId const& id) const {
     return emptyVec;
 }
 
+bool Graph::isActiveDependency(NodeId const& id, NodeId const& dependency) const {
+    if (_unreadDependenciesMap.empty()) {
+        return true;
+    }
+
+    auto it = _unreadDependenciesMap.find(id);
+    return it == _unreadDependenciesMap.end() ||
+           std::ranges::find(it->second, dependency) == it->second.end();
+}
+
+void Graph::setUnreadDependencies(NodeId const& id, std::vector<NodeId> unread) {
+    if (unread.empty()) {
+        _unreadDependenciesMap.erase(id);
+        return;
+    }
+
+    auto& current = _unreadDependenciesMap[id];
+    if (current != unread) {
+        current = std::move(unread);
+    }
+}
+
 VoidResult Graph::addNode(NodeId id, Node node) {
     auto [it, inserted] = _nodes.emplace(std::move(id), std::move(node));
     SF_RETURN_UNEXPECTED_IF(!inserted,
                             SF_ERR_NODE_ALREADY_EXISTS,
                             std::format(R"(Trying to add already existing node "{}")", it->first));
 
+    ++_structureVersion;
     return {};
 }
 
@@ -150,6 +180,86 @@ VoidResult Graph::setNodeDependencies(NodeId id, std::vector<NodeId> newDeps, bo
     }
 
     currentDeps = std::move(newDeps);
+    _unreadDependenciesMap.erase(id);
+
+    return {};
+}
+
+VoidResult Graph::addDependency(NodeId const& id,
+                                NodeId const& dependency,
+                                bool skipCycleCheck) {
+    SF_RETURN_UNEXPECTED_IF(
+        !contains(id),
+        SF_ERR_NODE_NOT_FOUND,
+        std::format(R"(Trying to add dependency to non-existing node "{}")", id));
+    SF_RETURN_UNEXPECTED_IF(
+        !contains(dependency),
+        SF_ERR_DEPENDENCY_DOESNT_EXIST,
+        std::format(R"(Trying to add non-existing dependency "{}" to "{}")", dependency, id));
+    SF_RETURN_UNEXPECTED_IF(dependency == id,
+                            SF_ERR_SELF_REFERENCE,
+                            std::format(R"("{}" is trying to set itself as dependency)", id));
+
+    // dependents lists are usually much shorter than dependency lists of collections
+    auto const& dependencyDependents = static_cast<Graph const&>(*this).dependents(dependency);
+    SF_RETURN_UNEXPECTED_IF(
+        std::ranges::find(dependencyDependents, id) != dependencyDependents.end(),
+        SF_ERR_DUPLICATE_DEPENDENCY,
+        std::format(R"(Trying to add duplicate dependency "{}" to "{}")", dependency, id));
+    SF_RETURN_UNEXPECTED_IF(
+        !skipCycleCheck && hasPath(dependency, id, _dependenciesMap),
+        SF_ERR_DEPENDENCY_LOOP,
+        std::format(R"(Trying to add dependency "{}" to "{}" with cyclic dependency)",
+                    dependency,
+                    id));
+
+    _dependenciesMap[id].push_back(dependency);
+    _dependentsMap[dependency].push_back(id);
+
+    return {};
+}
+
+VoidResult Graph::removeDependency(NodeId const& id, NodeId const& dependency) {
+    return removeDependencies(id, std::span{&dependency, 1});
+}
+
+VoidResult Graph::removeDependencies(NodeId const& id, std::span<NodeId const> dependencies) {
+    // dependents lists are short, checking them keeps validation independent of the list size
+    for (auto const& dependency : dependencies) {
+        auto const& dependencyDependents = static_cast<Graph const&>(*this).dependents(dependency);
+        SF_RETURN_UNEXPECTED_IF(
+            std::ranges::find(dependencyDependents, id) == dependencyDependents.end(),
+            SF_ERR_DEPENDENCY_DOESNT_EXIST,
+            std::format(
+                R"(Trying to remove non-existing dependency "{}" from "{}")", dependency, id));
+    }
+    std::unordered_set<std::string_view> removed;
+    if (dependencies.size() > 1) {
+        removed.reserve(dependencies.size());
+        for (auto const& dependency : dependencies) {
+            SF_RETURN_UNEXPECTED_IF(
+                !removed.insert(dependency).second,
+                SF_ERR_DUPLICATE_DEPENDENCY,
+                std::format(
+                    R"(Trying to remove dependency "{}" from "{}" twice)", dependency, id));
+        }
+    }
+
+    for (auto const& dependency : dependencies) {
+        auto& dependencyDependents = this->dependents(dependency);
+        dependencyDependents.erase(std::ranges::find(dependencyDependents, id));
+    }
+
+    auto& deps = _dependenciesMap.find(id)->second;
+    if (dependencies.size() == 1) {
+        auto it = std::ranges::find(deps, dependencies.front());
+        if (std::next(it) != deps.end()) {
+            *it = std::move(deps.back());
+        }
+        deps.pop_back();
+    } else {
+        std::erase_if(deps, [&](NodeId const& dependency) { return removed.contains(dependency); });
+    }
 
     return {};
 }
@@ -205,15 +315,19 @@ VoidResult Graph::removeNode(NodeId const& id) {
         _dependenciesMap.erase(dependenciesIt);
     }
 
+    _unreadDependenciesMap.erase(id);
     _nodes.erase(nodeIt);
+    ++_structureVersion;
 
     return {};
 }
 
 void Graph::clear() {
+    ++_structureVersion;
     _nodes.clear();
     _dependenciesMap.clear();
     _dependentsMap.clear();
+    _unreadDependenciesMap.clear();
 }
 
 
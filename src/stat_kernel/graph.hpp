@@ -4,6 +4,9 @@
 #include "stat_kernel/node.hpp"
 #include "types/definitions.hpp"
 
+#include <cstdint>
+#include <span>
+
 namespace statforge::statkernel {
 
 class Graph {
@@ -14,14 +17,32 @@ public:
     // invalid and will terminate the program. Call contains() first if necessary.
     [[nodiscard]] Node& node(NodeId const& id);
     [[nodiscard]] Node const& node(NodeId const& id) const;
+    [[nodiscard]] std::unordered_map<NodeId, Node> const& nodes() const;
+    // changes whenever nodes are added or removed, node addresses stay valid until then
+    [[nodiscard]] std::uint64_t structureVersion() const {
+        return _structureVersion;
+    }
 
     [[nodiscard]] std::vector<NodeId> const& dependencies(NodeId const& id) const;
     [[nodiscard]] std::vector<NodeId> const& dependents(NodeId const& id) const;
 
+    // dependencies of conditional formulas that weren't read during their last evaluation.
+    // unread edges stay part of the graph for cycle checks and removal rules, but changes
+    // to the dependency don't dirty the dependent.
+    [[nodiscard]] bool isActiveDependency(NodeId const& id, NodeId const& dependency) const;
+    void setUnreadDependencies(NodeId const& id, std::vector<NodeId> unread);
+
     VoidResult addNode(NodeId id, Node node);
     VoidResult setNodeDependencies(NodeId id,
                                    std::vector<NodeId> deps,
                                    bool skipCycleCheck = false);
+    // single edge changes, they don't preserve the order of the remaining dependencies
+    VoidResult addDependency(NodeId const& id,
+                             NodeId const& dependency,
+                             bool skipCycleCheck = false);
+    VoidResult removeDependency(NodeId const& id, NodeId const& dependency);
+    // removes all or none of "dependencies" with a single pass over the dependency list
+    VoidResult removeDependencies(NodeId const& id, std::span<NodeId const> dependencies);
     VoidResult removeNode(NodeId const& id);
 
     void clear();
@@ -32,6 +53,8 @@ private:
     std::unordered_map<NodeId, Node> _nodes;
     std::unordered_map<NodeId, std::vector<NodeId>> _dependenciesMap;
     std::unordered_map<NodeId, std::vector<NodeId>> _dependentsMap;
+    std::unordered_map<NodeId, std::vector<NodeId>> _unreadDependenciesMap;
+    std::uint64_t _structureVersion{0};
 };
 
 } // namespace statforge::statkernel
\ No newline at end of file
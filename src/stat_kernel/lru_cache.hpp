@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace statforge::statkernel {
+
+// string keyed cache evicting the least recently used entry once "capacity" is exceeded.
+// a capacity of 0 disables caching.
+template <typename Value>
+class LruCache {
+public:
+    explicit LruCache(std::size_t capacity) : _capacity(capacity) {
+    }
+
+    // counts a hit or a miss, a hit marks the entry as most recently used
+    [[nodiscard]] Value const* find(std::string_view key) {
+        auto it = _index.find(key);
+        if (it == _index.end()) {
+            ++_misses;
+            return nullptr;
+        }
+
+        ++_hits;
+        _entries.splice(_entries.begin(), _entries, it->second);
+        return &it->second->second;
+    }
+
+    void insert(std::string key, Value value) {
+        if (_capacity == 0) {
+            return;
+        }
+
+        if (auto it = _index.find(key); it != _index.end()) {
+            it->second->second = std::move(value);
+            _entries.splice(_entries.begin(), _entries, it->second);
+            return;
+        }
+
+        _entries.emplace_front(std::move(key), std::move(value));
+        // list nodes are stable, so the index may view the stored key
+        _index.emplace(_entries.front().first, _entries.begin());
+        evict();
+    }
+
+    void setCapacity(std::size_t capacity) {
+        _capacity = capacity;
+        evict();
+    }
+
+    // drops all entries, counters are kept
+    void clear() {
+        _index.clear();
+        _entries.clear();
+    }
+
+    [[nodiscard]] std::size_t hits() const {
+        return _hits;
+    }
+    [[nodiscard]] std::size_t misses() const {
+        return _misses;
+    }
+    [[nodiscard]] std::size_t size() const {
+        return _entries.size();
+    }
+    [[nodiscard]] std::size_t capacity() const {
+        return _capacity;
+    }
+
+private:
+    void evict() {
+        while (_entries.size() > _capacity) {
+            _index.erase(_entries.back().first);
+            _entries.pop_back();
+        }
+    }
+
+    using Entry = std::pair<std::string, Value>;
+
+    // most recently used first
+    std::list<Entry> _entries;
+    std::unordered_map<std::string_view, typename std::list<Entry>::iterator> _index;
+    std::size_t _capacity;
+    std::size_t _hits{0};
+    std::size_t _misses{0};
+};
+
+} // namespace statforge::statkernel
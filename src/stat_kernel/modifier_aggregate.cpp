@@ -0,0 +1,55 @@
+#include "modifier_aggregate.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace statforge::statkernel {
+
+std::vector<NodeId> ModifierGroups::members() const {
+    std::vector<NodeId> members;
+    members.reserve(base.size() + increased.size() + more.size());
+    members.insert(members.end(), base.begin(), base.end());
+    members.insert(members.end(), increased.begin(), increased.end());
+    members.insert(members.end(), more.begin(), more.end());
+    return members;
+}
+
+void ModifierAggregate::setGroups(ModifierGroups groups) {
+    _groups = std::move(groups);
+    _base.invalidate();
+    _increased.invalidate();
+    _more.invalidate();
+}
+
+void ModifierAggregate::markChanged(NodeId const& member) {
+    for (auto* group : {&_base, &_increased, &_more}) {
+        if (group->contains(member)) {
+            group->markChanged(member);
+            return;
+        }
+    }
+}
+
+void ModifierAggregate::removeMember(NodeId const& member) {
+    for (auto* group : {&_groups.base, &_groups.increased, &_groups.more}) {
+        if (auto it = std::ranges::find(*group, member); it != group->end()) {
+            group->erase(it);
+            break;
+        }
+    }
+    for (auto* group : {&_base, &_increased, &_more}) {
+        if (group->contains(member)) {
+            group->removeMember(member);
+            return;
+        }
+    }
+}
+
+NodeValue ModifierAggregate::update(Graph const& graph) {
+    auto const base = _base.update(graph, _groups.base);
+    auto const increased = _increased.update(graph, _groups.increased);
+    auto const more = _more.update(graph, _groups.more);
+    return base * (1.0 + increased) * more;
+}
+
+} // namespace statforge::statkernel
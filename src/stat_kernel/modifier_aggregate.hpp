@@ -0,0 +1,49 @@
+#pragma once
+
+#include "stat_kernel/collection_aggregate.hpp"
+#include "stat_kernel/graph.hpp"
+#include "types/definitions.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace statforge::statkernel {
+
+// members of a modifier node. a node can only be part of one group
+struct ModifierGroups {
+    // summed up
+    std::vector<NodeId> base;
+    // summed up and applied once, 0.5 means 50% increased
+    std::vector<NodeId> increased;
+    // applied one after another, 0.5 means 50% more
+    std::vector<NodeId> more;
+
+    [[nodiscard]] std::vector<NodeId> members() const;
+};
+
+// sum(base) * (1 + sum(increased)) * product(1 + more), every group updated incrementally
+class ModifierAggregate {
+public:
+    explicit ModifierAggregate(ModifierGroups groups) : _groups(std::move(groups)) {
+    }
+
+    [[nodiscard]] ModifierGroups const& groups() const {
+        return _groups;
+    }
+    // the next update rescans all groups
+    void setGroups(ModifierGroups groups);
+
+    void markChanged(NodeId const& member);
+    void removeMember(NodeId const& member);
+
+    // members have to be evaluated already
+    NodeValue update(Graph const& graph);
+
+private:
+    ModifierGroups _groups;
+    CollectionAggregate _base{SF_COLLECTION_OP_SUM};
+    CollectionAggregate _increased{SF_COLLECTION_OP_SUM};
+    CollectionAggregate _more{SF_COLLECTION_OP_PRODUCT, 1.0};
+};
+
+} // namespace statforge::statkernel
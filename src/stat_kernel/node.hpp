@@ -4,15 +4,20 @@
 #include "types/collection_operation.h"
 
 #include <functional>
+#include <memory>
 
 namespace statforge::statkernel {
 
+class CollectionAggregate; // fwd
+class ModifierAggregate;   // fwd
+
 using NodeFormula = std::function<NodeValue()>;
 
 enum class NodeType : u_int8_t {
     Value,
     Formula,
     Collection,
+    Modifier,
 };
 
 struct Node {
@@ -21,6 +26,10 @@ struct Node {
     NodeType type{};
     SF_CollectionOperation collectionOperation{SF_COLLECTION_OP_SUM};
     bool dirty{false};
+    // running aggregate of incremental collection operations
+    std::shared_ptr<CollectionAggregate> aggregate{};
+    // member groups and running state of modifier nodes
+    std::shared_ptr<ModifierAggregate> modifier{};
 };
 
 } // namespace statforge::statkernel
@@ -0,0 +1,882 @@
+#include "sheet.hpp"
+
+#include "dsl/evaluator.hpp"
+#include "stat_kernel/collection_aggregate.hpp"
+#include "stat_kernel/collection_kernels.hpp"
+#include "stat_kernel/modifier_aggregate.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <variant>
+
+namespace statforge::statkernel {
+
+namespace {
+
+// neumaier steps of every entity, the same arithmetic kernels::add does for one
+void addColumn(std::span<NodeValue> sums,
+               std::span<NodeValue> compensations,
+               std::span<NodeValue const> values) {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        auto const next = sums[i] + values[i];
+        compensations[i] += std::fabs(sums[i]) >= std::fabs(values[i])
+                                ? (sums[i] - next) + values[i]
+                                : (values[i] - next) + sums[i];
+        sums[i] = next;
+    }
+}
+
+bool contains(std::span<NodeIndex const> indices, NodeIndex index) {
+    return std::ranges::find(indices, index) != indices.end();
+}
+
+} // namespace
+
+std::shared_ptr<Sheet const> Sheet::compile(Graph const& graph, Compiler const& compiler) {
+    auto sheet = std::make_shared<Sheet>();
+    auto const& nodes = graph.nodes();
+
+    // kahn's algorithm, a node is placed once all of its dependencies are
+    std::vector<NodeId const*> order;
+    order.reserve(nodes.size());
+    std::unordered_map<std::string_view, std::size_t> pending;
+    for (auto const& [id, node] : nodes) {
+        if (auto const count = graph.dependencies(id).size(); count > 0) {
+            pending.emplace(id, count);
+        } else {
+            order.push_back(&id);
+        }
+    }
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        for (auto const& dependent : graph.dependents(*order[i])) {
+            if (--pending.at(dependent) == 0) {
+                order.push_back(&nodes.find(dependent)->first);
+            }
+        }
+    }
+    assert(order.size() == nodes.size());
+
+    std::unordered_map<std::string_view, NodeIndex> indices;
+    indices.reserve(order.size());
+    for (NodeIndex index = 0; index < order.size(); ++index) {
+        indices.emplace(*order[index], index);
+    }
+    auto const indexOf = [&indices](NodeId const& id) { return indices.at(id); };
+    auto const addInputs = [&sheet, &indexOf](std::vector<NodeId> const& members) {
+        for (auto const& member : members) {
+            sheet->_inputs.push_back(indexOf(member));
+            sheet->_gates.push_back(noGate);
+        }
+        return static_cast<std::uint32_t>(sheet->_inputs.size());
+    };
+
+    sheet->_entries.reserve(order.size());
+    sheet->_defaults.reserve(order.size());
+    sheet->_dependentOffsets.reserve(order.size() + 1);
+    sheet->_dependentOffsets.push_back(0);
+    for (NodeIndex index = 0; index < order.size(); ++index) {
+        auto const& id = *order[index];
+        auto const& node = graph.node(id);
+
+        Entry entry{.type = node.type, .operation = node.collectionOperation};
+        entry.inputsBegin = static_cast<std::uint32_t>(sheet->_inputs.size());
+        switch (node.type) {
+        case NodeType::Value:
+            break;
+        case NodeType::Formula: {
+            auto program = compiler.formulaProgram(id);
+            Program compiled{.expr = std::move(program.expr), .refs = {}};
+            auto const& expr = *compiled.expr;
+            compiled.refs.resize(expr.size());
+            for (dsl::ExprIndex i = 0; i < expr.size(); ++i) {
+                if (auto const* ref = std::get_if<dsl::Ref>(&expr[i])) {
+                    auto it = std::ranges::find(program.references,
+                                                ref->name,
+                                                &std::pair<NodeId, NodeId>::first);
+                    assert(it != program.references.end());
+                    compiled.refs[i] = indexOf(it->second);
+                }
+            }
+            if (program.impure) {
+                sheet->_volatile.push_back(index);
+            }
+            entry.program = static_cast<std::uint32_t>(sheet->_programs.size());
+            sheet->_programs.push_back(std::move(compiled));
+            break;
+        }
+        case NodeType::Collection:
+            // gates are dependencies, but never members
+            for (auto const& member : graph.dependencies(id)) {
+                if (node.aggregate->isGate(member)) {
+                    entry.gated = true;
+                    continue;
+                }
+                auto const* gate = node.aggregate->gate(member);
+                sheet->_inputs.push_back(indexOf(member));
+                sheet->_gates.push_back(gate != nullptr ? indexOf(*gate) : noGate);
+            }
+            break;
+        case NodeType::Modifier: {
+            auto const& groups = node.modifier->groups();
+            entry.baseEnd = addInputs(groups.base);
+            entry.increasedEnd = addInputs(groups.increased);
+            addInputs(groups.more);
+            break;
+        }
+        }
+        entry.inputsEnd = static_cast<std::uint32_t>(sheet->_inputs.size());
+
+        sheet->_entries.push_back(entry);
+        sheet->_defaults.push_back(node.value);
+        for (auto const& dependent : graph.dependents(id)) {
+            sheet->_dependents.push_back(indexOf(dependent));
+        }
+        sheet->_dependentOffsets.push_back(static_cast<std::uint32_t>(sheet->_dependents.size()));
+        if (!compiler.isHidden(id)) {
+            sheet->_indices.emplace(id, index);
+        }
+    }
+
+    sheet->_functions = compiler.functions();
+    return sheet;
+}
+
+std::optional<NodeIndex> Sheet::find(NodeId const& id) const {
+    auto it = _indices.find(id);
+    if (it == _indices.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+template <typename Read>
+NodeValue Sheet::compute(NodeIndex index, Read const& read) const {
+    auto const& entry = _entries[index];
+    switch (entry.type) {
+    case NodeType::Value:
+        break;
+    case NodeType::Formula: {
+        auto const& program = _programs[entry.program];
+        dsl::Context ctx{.nodeLookup = {},
+                         .refLookup = [&program, &read](dsl::ExprIndex ref) -> double {
+                             return read(program.refs[ref]);
+                         },
+                         .functions = &_functions};
+        return dsl::evaluate(*program.expr, ctx);
+    }
+    case NodeType::Collection: {
+        // reused by every instance evaluated on this thread
+        thread_local std::vector<NodeValue> members;
+        members.clear();
+        for (auto i = entry.inputsBegin; i < entry.inputsEnd; ++i) {
+            if (_gates[i] == noGate || dsl::isTruthy(read(_gates[i]))) {
+                members.push_back(read(_inputs[i]));
+            }
+        }
+        return CollectionAggregate::scan(entry.operation, members);
+    }
+    case NodeType::Modifier: {
+        kernels::CompensatedSum base;
+        kernels::CompensatedSum increased;
+        NodeValue more{1};
+        for (auto i = entry.inputsBegin; i < entry.baseEnd; ++i) {
+            kernels::add(base, read(_inputs[i]));
+        }
+        for (auto i = entry.baseEnd; i < entry.increasedEnd; ++i) {
+            kernels::add(increased, read(_inputs[i]));
+        }
+        for (auto i = entry.increasedEnd; i < entry.inputsEnd; ++i) {
+            more *= 1.0 + read(_inputs[i]);
+        }
+        return base.value() * (1.0 + increased.value()) * more;
+    }
+    }
+    return read(index);
+}
+
+SheetInstance::SheetInstance(std::shared_ptr<Sheet const> sheet)
+    : _sheet(std::move(sheet)),
+      _values(_sheet->_defaults),
+      _dirty(_sheet->size(), false),
+      _firstDirty(static_cast<NodeIndex>(_sheet->size())) {
+}
+
+VoidResult SheetInstance::setNodeValue(NodeId const& id, NodeValue value) {
+    auto const index = _sheet->find(id);
+    SF_RETURN_UNEXPECTED_IF(!index,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to set value of non-existing node "{}")", id));
+    SF_RETURN_UNEXPECTED_IF(_sheet->type(*index) != NodeType::Value,
+                            SF_ERR_NODE_TYPE_MISMATCH,
+                            std::format(R"(Trying to change value of non value node "{}")", id));
+
+    setValue(*index, value);
+    return {};
+}
+
+Result<NodeValue> SheetInstance::getNodeValue(NodeId const& id) {
+    auto const index = _sheet->find(id);
+    SF_RETURN_UNEXPECTED_IF(!index,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to get value of non-existing node "{}")", id));
+    return value(*index);
+}
+
+void SheetInstance::setValue(NodeIndex index, NodeValue value) {
+    assert(_sheet->type(index) == NodeType::Value);
+    if (_values[index] == value) {
+        return;
+    }
+    _values[index] = value;
+    markDependents(index);
+}
+
+NodeValue SheetInstance::value(NodeIndex index) {
+    evaluateUntil(index);
+    return _values[index];
+}
+
+void SheetInstance::evaluate() {
+    for (auto const index : _sheet->_volatile) {
+        _dirty[index] = true;
+        _firstDirty = std::min(_firstDirty, index);
+    }
+    if (!_dirty.empty()) {
+        evaluateUntil(static_cast<NodeIndex>(_dirty.size() - 1));
+    }
+}
+
+void SheetInstance::markDependents(NodeIndex index) {
+    for (auto const dependent : _sheet->dependents(index)) {
+        _dirty[dependent] = true;
+        _firstDirty = std::min(_firstDirty, dependent);
+    }
+}
+
+void SheetInstance::evaluateUntil(NodeIndex last) {
+    // dependents always come later, so one forward sweep settles everything up to "last"
+    for (; _firstDirty <= last && _firstDirty < _dirty.size(); ++_firstDirty) {
+        if (!_dirty[_firstDirty]) {
+            continue;
+        }
+        _dirty[_firstDirty] = false;
+
+        auto const value = _sheet->compute(
+            _firstDirty, [this](NodeIndex input) { return _values[input]; });
+        if (value != _values[_firstDirty]) {
+            _values[_firstDirty] = value;
+            markDependents(_firstDirty);
+        }
+    }
+}
+
+SheetFork::SheetFork(std::shared_ptr<Sheet const> sheet) : _sheet(std::move(sheet)) {
+}
+
+VoidResult SheetFork::setNodeValue(NodeId const& id, NodeValue value) {
+    auto const index = _sheet->find(id);
+    SF_RETURN_UNEXPECTED_IF(!index,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to set value of non-existing node "{}")", id));
+    SF_RETURN_UNEXPECTED_IF(_sheet->type(*index) != NodeType::Value,
+                            SF_ERR_NODE_TYPE_MISMATCH,
+                            std::format(R"(Trying to change value of non value node "{}")", id));
+
+    setValue(*index, value);
+    return {};
+}
+
+VoidResult SheetFork::addCollectionMember(NodeId const& id, NodeId const& member) {
+    NodeIndex collection{};
+    NodeIndex index{};
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkCollection(id, member, collection, index));
+    SF_RETURN_UNEXPECTED_IF(index == collection,
+                            SF_ERR_SELF_REFERENCE,
+                            std::format(R"("{}" is trying to set itself as dependency)", id));
+
+    auto const& entry = _sheet->_entries[collection];
+    auto const gates = std::span{_sheet->_gates}.subspan(entry.inputsBegin,
+                                                        entry.inputsEnd - entry.inputsBegin);
+    SF_RETURN_UNEXPECTED_IF(
+        isMember(collection, index) || std::ranges::find(gates, index) != gates.end(),
+        SF_ERR_DUPLICATE_DEPENDENCY,
+        std::format(R"(Trying to add duplicate dependency "{}" to "{}")", member, id));
+    SF_RETURN_UNEXPECTED_IF(
+        reaches(collection, index),
+        SF_ERR_DEPENDENCY_LOOP,
+        std::format(R"(Trying to add dependency "{}" to "{}" with cyclic dependency)", member, id));
+
+    // members removed before come back ungated, like in the kernel
+    auto& members = _members[collection];
+    auto const removed = std::ranges::find(members.removed, index);
+    auto const inputs = std::span{_sheet->_inputs}.subspan(entry.inputsBegin, gates.size());
+    auto const position = std::ranges::find(inputs, index) - inputs.begin();
+    if (removed != members.removed.end() && gates[position] == Sheet::noGate) {
+        members.removed.erase(removed);
+    } else {
+        members.added.push_back(index);
+    }
+    if (members.added.empty() && members.removed.empty()) {
+        _members.erase(collection);
+    }
+    markDirty(collection);
+    return {};
+}
+
+VoidResult SheetFork::removeCollectionMember(NodeId const& id, NodeId const& member) {
+    NodeIndex collection{};
+    NodeIndex index{};
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkCollection(id, member, collection, index));
+    SF_RETURN_UNEXPECTED_IF(
+        !isMember(collection, index),
+        SF_ERR_DEPENDENCY_DOESNT_EXIST,
+        std::format(R"(Trying to remove non-existing dependency "{}" from "{}")", member, id));
+
+    auto& members = _members[collection];
+    if (auto const added = std::ranges::find(members.added, index);
+        added != members.added.end()) {
+        members.added.erase(added);
+    } else {
+        members.removed.push_back(index);
+    }
+    if (members.added.empty() && members.removed.empty()) {
+        _members.erase(collection);
+    }
+    markDirty(collection);
+    return {};
+}
+
+Result<NodeValue> SheetFork::getNodeValue(NodeId const& id) {
+    auto const index = _sheet->find(id);
+    SF_RETURN_UNEXPECTED_IF(!index,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to get value of non-existing node "{}")", id));
+    return value(*index);
+}
+
+void SheetFork::setValue(NodeIndex index, NodeValue value) {
+    assert(_sheet->type(index) == NodeType::Value);
+    if (current(index) == value) {
+        return;
+    }
+    store(index, value);
+    markDependents(index);
+}
+
+NodeValue SheetFork::value(NodeIndex index) {
+    evaluateUntil(index);
+    return current(index);
+}
+
+void SheetFork::evaluate() {
+    for (auto const index : _sheet->_volatile) {
+        markDirty(index);
+    }
+    if (_sheet->size() > 0) {
+        evaluateUntil(static_cast<NodeIndex>(_sheet->size() - 1));
+    }
+}
+
+void SheetFork::clear() {
+    _values.clear();
+    _dirty.clear();
+    _members.clear();
+}
+
+VoidResult SheetFork::checkCollection(NodeId const& id,
+                                      NodeId const& member,
+                                      NodeIndex& collection,
+                                      NodeIndex& index) const {
+    auto const found = _sheet->find(id);
+    SF_RETURN_UNEXPECTED_IF(!found,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to change members of non-existing node "{}")", id));
+    SF_RETURN_UNEXPECTED_IF(
+        _sheet->type(*found) != NodeType::Collection,
+        SF_ERR_NODE_TYPE_MISMATCH,
+        std::format(R"(Trying to change members of non collection node "{}")", id));
+    auto const foundMember = _sheet->find(member);
+    SF_RETURN_UNEXPECTED_IF(
+        !foundMember,
+        SF_ERR_DEPENDENCY_DOESNT_EXIST,
+        std::format(R"(Trying to change non-existing member "{}" of "{}")", member, id));
+
+    collection = *found;
+    index = *foundMember;
+    return {};
+}
+
+bool SheetFork::isMember(NodeIndex collection, NodeIndex member) const {
+    auto const it = _members.find(collection);
+    if (it != _members.end() && contains(it->second.added, member)) {
+        return true;
+    }
+    auto const& entry = _sheet->_entries[collection];
+    auto const inputs = std::span{_sheet->_inputs}.subspan(entry.inputsBegin,
+                                                          entry.inputsEnd - entry.inputsBegin);
+    if (!contains(inputs, member)) {
+        return false;
+    }
+    return it == _members.end() || !contains(it->second.removed, member);
+}
+
+bool SheetFork::reaches(NodeIndex from, NodeIndex to) const {
+    std::vector<NodeIndex> work{from};
+    std::unordered_set<NodeIndex> visited;
+    while (!work.empty()) {
+        auto const current = work.back();
+        work.pop_back();
+        if (current == to) {
+            return true;
+        }
+        if (!visited.insert(current).second) {
+            continue;
+        }
+        auto const dependents = _sheet->dependents(current);
+        work.insert(work.end(), dependents.begin(), dependents.end());
+        for (auto const& [collection, members] : _members) {
+            if (contains(members.added, current)) {
+                work.push_back(collection);
+            }
+        }
+    }
+    return false;
+}
+
+NodeValue SheetFork::compute(NodeIndex index) {
+    auto const it = _members.find(index);
+    if (it == _members.end()) {
+        return _sheet->compute(index, [this](NodeIndex input) { return current(input); });
+    }
+
+    // added members can come later in the sheet's order. they don't depend on the collection,
+    // so settling them first is safe
+    auto const& members = it->second;
+    for (auto const member : members.added) {
+        if (member > index) {
+            evaluateUntil(member);
+        }
+    }
+
+    auto const& entry = _sheet->_entries[index];
+    thread_local std::vector<NodeValue> values;
+    values.clear();
+    for (auto i = entry.inputsBegin; i < entry.inputsEnd; ++i) {
+        auto const gate = _sheet->_gates[i];
+        if (contains(members.removed, _sheet->_inputs[i]) ||
+            (gate != Sheet::noGate && !dsl::isTruthy(current(gate)))) {
+            continue;
+        }
+        values.push_back(current(_sheet->_inputs[i]));
+    }
+    for (auto const member : members.added) {
+        values.push_back(current(member));
+    }
+    return CollectionAggregate::scan(entry.operation, values);
+}
+
+NodeValue SheetFork::current(NodeIndex index) const {
+    auto it = _values.find(index);
+    return it != _values.end() ? it->second : _sheet->_defaults[index];
+}
+
+void SheetFork::store(NodeIndex index, NodeValue value) {
+    // nodes changed back to the sheet's value stop counting as diverged
+    if (value == _sheet->_defaults[index]) {
+        _values.erase(index);
+    } else {
+        _values[index] = value;
+    }
+}
+
+void SheetFork::markDirty(NodeIndex index) {
+    if (_tracked.empty() || _tracked[index]) {
+        _dirty.insert(index);
+    }
+}
+
+void SheetFork::markDependents(NodeIndex index) {
+    for (auto const dependent : _sheet->dependents(index)) {
+        markDirty(dependent);
+    }
+    for (auto const& [collection, members] : _members) {
+        if (contains(members.added, index)) {
+            markDirty(collection);
+        }
+    }
+}
+
+void SheetFork::evaluateUntil(NodeIndex last) {
+    // members added to collections up to "last" can come later in the sheet's order, their
+    // changes only reach the collection once they are settled too
+    for (bool grew = true; grew;) {
+        grew = false;
+        for (auto const& [collection, members] : _members) {
+            if (collection > last) {
+                continue;
+            }
+            for (auto const member : members.added) {
+                if (member > last) {
+                    last = member;
+                    grew = true;
+                }
+            }
+        }
+    }
+
+    while (!_dirty.empty() && *_dirty.begin() <= last) {
+        auto const index = *_dirty.begin();
+        _dirty.erase(_dirty.begin());
+
+        auto const value = compute(index);
+        if (value != current(index)) {
+            store(index, value);
+            markDependents(index);
+        }
+    }
+}
+
+VoidResult scoreCandidates(std::shared_ptr<Sheet const> const& sheet,
+                           std::span<std::vector<Command> const> candidates,
+                           std::span<NodeId const> targets,
+                           std::span<NodeValue> deltas) {
+    SF_RETURN_UNEXPECTED_IF(deltas.size() != candidates.size() * targets.size(),
+                            SF_ERR_INTERNAL_INVALID_ENGINE_STATE,
+                            std::format("Scoring {} candidates on {} targets into {} deltas",
+                                        candidates.size(),
+                                        targets.size(),
+                                        deltas.size()));
+    std::vector<NodeIndex> targetIndices;
+    targetIndices.reserve(targets.size());
+    for (auto const& target : targets) {
+        auto const index = sheet->find(target);
+        SF_RETURN_UNEXPECTED_IF(
+            !index,
+            SF_ERR_NODE_NOT_FOUND,
+            std::format(R"(Trying to score non-existing node "{}")", target));
+        targetIndices.push_back(*index);
+    }
+
+    // union of the cones of all candidates, computed once. unknown nodes are skipped here and
+    // fail when their candidate is applied
+    auto const size = sheet->size();
+    std::vector<bool> forward(size, false);
+    std::vector<bool> backward(size, false);
+    std::vector<std::pair<NodeIndex, NodeIndex>> added;
+    for (auto const& candidate : candidates) {
+        for (auto const& command : candidate) {
+            std::visit(
+                [&sheet, &forward, &added](auto const& change) {
+                    using T = std::decay_t<decltype(change)>;
+
+                    auto const index = sheet->find(change.id);
+                    if (!index || std::is_same_v<T, SetFormulaCommand>) {
+                        return;
+                    }
+                    forward[*index] = true;
+                    if constexpr (std::is_same_v<T, AddMemberCommand>) {
+                        if (auto const member = sheet->find(change.member)) {
+                            added.emplace_back(*member, *index);
+                        }
+                    }
+                },
+                command);
+        }
+    }
+    for (auto const index : targetIndices) {
+        backward[index] = true;
+    }
+    // sheet edges always point forward, so one sweep per direction settles them. added members
+    // can point backward and need another round
+    for (bool grew = true; grew;) {
+        grew = false;
+        for (NodeIndex index = 0; index < size; ++index) {
+            if (forward[index]) {
+                for (auto const dependent : sheet->dependents(index)) {
+                    forward[dependent] = true;
+                }
+            }
+        }
+        for (auto index = static_cast<NodeIndex>(size); index-- > 0;) {
+            auto const dependents = sheet->dependents(index);
+            if (!backward[index] && std::ranges::any_of(dependents, [&backward](NodeIndex d) {
+                    return backward[d];
+                })) {
+                backward[index] = true;
+            }
+        }
+        for (auto const& [member, collection] : added) {
+            if (forward[member] && !forward[collection]) {
+                forward[collection] = true;
+                grew = true;
+            }
+            if (backward[collection] && !backward[member]) {
+                backward[member] = true;
+                grew = true;
+            }
+        }
+    }
+
+    SheetFork fork{sheet};
+    fork._tracked.resize(size);
+    for (std::size_t index = 0; index < size; ++index) {
+        fork._tracked[index] = forward[index] && backward[index];
+    }
+
+    std::optional<ErrorInfo> firstError;
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        auto const row = deltas.subspan(i * targets.size(), targets.size());
+        fork.clear();
+
+        VoidResult result;
+        for (auto const& command : candidates[i]) {
+            result = std::visit(
+                [&fork](auto const& change) -> VoidResult {
+                    using T = std::decay_t<decltype(change)>;
+
+                    if constexpr (std::is_same_v<T, SetValueCommand>) {
+                        return fork.setNodeValue(change.id, change.value);
+                    } else if constexpr (std::is_same_v<T, AddMemberCommand>) {
+                        return fork.addCollectionMember(change.id, change.member);
+                    } else if constexpr (std::is_same_v<T, RemoveMemberCommand>) {
+                        return fork.removeCollectionMember(change.id, change.member);
+                    } else {
+                        return std::unexpected(buildErrorInfo(
+                            SF_ERR_NODE_TYPE_MISMATCH,
+                            std::format(R"(Trying to score formula change of "{}", candidates )"
+                                        "only change values and members",
+                                        change.id)));
+                    }
+                },
+                command);
+            if (!result) {
+                break;
+            }
+        }
+
+        if (!result) {
+            std::ranges::fill(row, std::numeric_limits<NodeValue>::quiet_NaN());
+            if (!firstError) {
+                firstError = std::move(result).error();
+            }
+            continue;
+        }
+        for (std::size_t t = 0; t < targetIndices.size(); ++t) {
+            row[t] = fork.value(targetIndices[t]) - sheet->_defaults[targetIndices[t]];
+        }
+    }
+    if (firstError) {
+        return std::unexpected(std::move(*firstError));
+    }
+    return {};
+}
+
+SheetBatch::SheetBatch(std::shared_ptr<Sheet const> sheet, std::size_t entities)
+    : _sheet(std::move(sheet)),
+      _entities(entities),
+      _values(_sheet->size() * entities),
+      _dirty(_sheet->size() * entities, 0),
+      _dirtyEntities(_sheet->size(), 0),
+      _firstDirty(static_cast<NodeIndex>(_sheet->size())) {
+    for (std::size_t index = 0; index < _sheet->size(); ++index) {
+        std::fill_n(_values.begin() + static_cast<std::ptrdiff_t>(index * _entities),
+                    _entities,
+                    _sheet->_defaults[index]);
+    }
+}
+
+VoidResult SheetBatch::setNodeValue(std::size_t entity, NodeId const& id, NodeValue value) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkEntity(entity));
+    auto const index = _sheet->find(id);
+    SF_RETURN_UNEXPECTED_IF(!index,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to set value of non-existing node "{}")", id));
+    SF_RETURN_UNEXPECTED_IF(_sheet->type(*index) != NodeType::Value,
+                            SF_ERR_NODE_TYPE_MISMATCH,
+                            std::format(R"(Trying to change value of non value node "{}")", id));
+
+    setValue(entity, *index, value);
+    return {};
+}
+
+Result<NodeValue> SheetBatch::getNodeValue(std::size_t entity, NodeId const& id) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkEntity(entity));
+    auto const index = _sheet->find(id);
+    SF_RETURN_UNEXPECTED_IF(!index,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to get value of non-existing node "{}")", id));
+    return value(entity, *index);
+}
+
+void SheetBatch::setValue(std::size_t entity, NodeIndex index, NodeValue value) {
+    assert(_sheet->type(index) == NodeType::Value);
+    auto& current = _values[index * _entities + entity];
+    if (current == value) {
+        return;
+    }
+    current = value;
+    markDependents(index, entity);
+}
+
+NodeValue SheetBatch::value(std::size_t entity, NodeIndex index) {
+    evaluateUntil(index);
+    return _values[index * _entities + entity];
+}
+
+std::span<NodeValue const> SheetBatch::column(NodeIndex index) {
+    evaluateUntil(index);
+    return values(index);
+}
+
+void SheetBatch::evaluate() {
+    for (auto const index : _sheet->_volatile) {
+        std::fill_n(_dirty.begin() + static_cast<std::ptrdiff_t>(index * _entities), _entities, 1);
+        _dirtyEntities[index] = static_cast<std::uint32_t>(_entities);
+        _firstDirty = std::min(_firstDirty, index);
+    }
+    if (_sheet->size() > 0) {
+        evaluateUntil(static_cast<NodeIndex>(_sheet->size() - 1));
+    }
+}
+
+VoidResult SheetBatch::checkEntity(std::size_t entity) const {
+    SF_RETURN_UNEXPECTED_IF(
+        entity >= _entities,
+        SF_ERR_INVALID_ENTITY,
+        std::format("Trying to access entity {} of a batch of {} entities", entity, _entities));
+    return {};
+}
+
+void SheetBatch::markDependents(NodeIndex index, std::size_t entity) {
+    for (auto const dependent : _sheet->dependents(index)) {
+        auto& dirty = _dirty[dependent * _entities + entity];
+        if (dirty == 0) {
+            dirty = 1;
+            ++_dirtyEntities[dependent];
+        }
+        _firstDirty = std::min(_firstDirty, dependent);
+    }
+}
+
+void SheetBatch::evaluateUntil(NodeIndex last) {
+    for (; _firstDirty <= last && _firstDirty < _sheet->size(); ++_firstDirty) {
+        if (_dirtyEntities[_firstDirty] > 0) {
+            evaluateNode(_firstDirty);
+        }
+    }
+}
+
+void SheetBatch::evaluateNode(NodeIndex index) {
+    auto const offset = index * _entities;
+    auto const dirty = std::span{_dirty}.subspan(offset, _entities);
+    _results.resize(_entities);
+
+    if (!computeColumns(index)) {
+        for (std::size_t entity = 0; entity < _entities; ++entity) {
+            if (dirty[entity] != 0) {
+                _results[entity] = _sheet->compute(index, [this, entity](NodeIndex input) {
+                    return _values[input * _entities + entity];
+                });
+            }
+        }
+    }
+
+    for (std::size_t entity = 0; entity < _entities; ++entity) {
+        if (dirty[entity] == 0) {
+            continue;
+        }
+        dirty[entity] = 0;
+        auto& value = _values[offset + entity];
+        if (_results[entity] != value) {
+            value = _results[entity];
+            markDependents(index, entity);
+        }
+    }
+    _dirtyEntities[index] = 0;
+}
+
+bool SheetBatch::computeColumns(NodeIndex index) {
+    auto const& sheet = *_sheet;
+    auto const& entry = sheet._entries[index];
+    auto const inputs = std::span{sheet._inputs};
+    auto const results = std::span{_results};
+
+    if (entry.type == NodeType::Collection) {
+        if (entry.gated || (entry.operation != SF_COLLECTION_OP_SUM &&
+                            entry.operation != SF_COLLECTION_OP_AVERAGE &&
+                            entry.operation != SF_COLLECTION_OP_COUNT)) {
+            return false;
+        }
+
+        auto const members = entry.inputsEnd - entry.inputsBegin;
+        if (entry.operation == SF_COLLECTION_OP_COUNT || members == 0) {
+            std::ranges::fill(results, entry.operation == SF_COLLECTION_OP_COUNT ? members : 0.0);
+            return true;
+        }
+
+        _scratch.assign(_entities, 0.0);
+        auto const compensations = std::span{_scratch};
+        std::ranges::fill(results, 0.0);
+        for (auto const input : inputs.subspan(entry.inputsBegin, members)) {
+            addColumn(results, compensations, values(input));
+        }
+
+        auto const dirty = std::span{_dirty}.subspan(index * _entities, _entities);
+        for (std::size_t entity = 0; entity < _entities; ++entity) {
+            // non-finite sums take the sequential path of a single instance
+            if (!std::isfinite(results[entity]) || !std::isfinite(compensations[entity])) {
+                if (dirty[entity] != 0) {
+                    results[entity] = sheet.compute(index, [this, entity](NodeIndex input) {
+                        return _values[input * _entities + entity];
+                    });
+                }
+                continue;
+            }
+            results[entity] += compensations[entity];
+            if (entry.operation == SF_COLLECTION_OP_AVERAGE) {
+                results[entity] /= static_cast<NodeValue>(members);
+            }
+        }
+        return true;
+    }
+
+    if (entry.type == NodeType::Modifier) {
+        _scratch.assign(_entities * 4, 0.0);
+        auto const scratch = std::span{_scratch};
+        auto const baseSums = scratch.subspan(0, _entities);
+        auto const baseCompensations = scratch.subspan(_entities, _entities);
+        auto const increasedSums = scratch.subspan(2 * _entities, _entities);
+        auto const increasedCompensations = scratch.subspan(3 * _entities, _entities);
+
+        for (auto i = entry.inputsBegin; i < entry.baseEnd; ++i) {
+            addColumn(baseSums, baseCompensations, values(inputs[i]));
+        }
+        for (auto i = entry.baseEnd; i < entry.increasedEnd; ++i) {
+            addColumn(increasedSums, increasedCompensations, values(inputs[i]));
+        }
+        std::ranges::fill(results, 1.0);
+        for (auto i = entry.increasedEnd; i < entry.inputsEnd; ++i) {
+            auto const more = values(inputs[i]);
+            for (std::size_t entity = 0; entity < _entities; ++entity) {
+                results[entity] *= 1.0 + more[entity];
+            }
+        }
+        for (std::size_t entity = 0; entity < _entities; ++entity) {
+            results[entity] = (baseSums[entity] + baseCompensations[entity]) *
+                              (1.0 + (increasedSums[entity] + increasedCompensations[entity])) *
+                              results[entity];
+        }
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace statforge::statkernel
@@ -0,0 +1,272 @@
+#pragma once
+
+#include "dsl/ast.hpp"
+#include "dsl/functions.hpp"
+#include "error/internal/error.hpp"
+#include "stat_kernel/command_queue.hpp"
+#include "stat_kernel/compiler.hpp"
+#include "stat_kernel/graph.hpp"
+#include "stat_kernel/node.hpp"
+#include "types/collection_operation.h"
+#include "types/definitions.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace statforge::statkernel {
+
+using NodeIndex = std::uint32_t;
+
+// immutable compiled form of a graph, shared by any number of instances. nodes are laid out
+// in topological order with dense indices, so dependents always come after their dependencies
+// and a forward sweep evaluates everything in one pass.
+// a sheet is a snapshot, later changes to the graph it was compiled from don't reach it.
+class Sheet {
+public:
+    // every node of "graph" has to be evaluated already, its values become the defaults
+    [[nodiscard]] static std::shared_ptr<Sheet const> compile(Graph const& graph,
+                                                              Compiler const& compiler);
+
+    // std::nullopt for unknown and hidden nodes
+    [[nodiscard]] std::optional<NodeIndex> find(NodeId const& id) const;
+    [[nodiscard]] std::size_t size() const {
+        return _entries.size();
+    }
+    [[nodiscard]] NodeType type(NodeIndex index) const {
+        return _entries[index].type;
+    }
+    // values of all nodes at compile time, by index
+    [[nodiscard]] std::span<NodeValue const> defaults() const {
+        return _defaults;
+    }
+
+private:
+    friend class SheetInstance;
+    friend class SheetBatch;
+    friend class SheetFork;
+    friend VoidResult scoreCandidates(std::shared_ptr<Sheet const> const& sheet,
+                                      std::span<std::vector<Command> const> candidates,
+                                      std::span<NodeId const> targets,
+                                      std::span<NodeValue> deltas);
+
+    struct Entry {
+        NodeType type{};
+        SF_CollectionOperation operation{SF_COLLECTION_OP_SUM};
+        // index into "_programs" for formulas
+        std::uint32_t program{0};
+        // members in "_inputs". modifiers list their base, increased and more members in that
+        // order, "baseEnd" and "increasedEnd" split them
+        std::uint32_t inputsBegin{0};
+        std::uint32_t inputsEnd{0};
+        std::uint32_t baseEnd{0};
+        std::uint32_t increasedEnd{0};
+        // any collection member has a gate
+        bool gated{false};
+    };
+
+    struct Program {
+        // keeps the compiled program alive, shared with the kernel
+        std::shared_ptr<dsl::ExpressionTree const> expr;
+        // node read by the Ref at each expression index, resolved once when compiling
+        std::vector<NodeIndex> refs;
+    };
+
+    static constexpr NodeIndex noGate = ~NodeIndex{0};
+
+    // "read" returns the value of a node by index, it has to be up to date for all
+    // dependencies of "index"
+    template <typename Read>
+    [[nodiscard]] NodeValue compute(NodeIndex index, Read const& read) const;
+    [[nodiscard]] std::span<NodeIndex const> dependents(NodeIndex index) const {
+        return std::span{_dependents}.subspan(_dependentOffsets[index],
+                                              _dependentOffsets[index + 1] -
+                                                  _dependentOffsets[index]);
+    }
+
+    std::vector<Entry> _entries;
+    std::vector<NodeValue> _defaults;
+    std::vector<Program> _programs;
+    // collection and modifier members, gates of collection members at the same index
+    std::vector<NodeIndex> _inputs;
+    std::vector<NodeIndex> _gates;
+    // dependents of node i are [_dependentOffsets[i], _dependentOffsets[i + 1]) of "_dependents"
+    std::vector<std::uint32_t> _dependentOffsets;
+    std::vector<NodeIndex> _dependents;
+    // formulas calling impure functions
+    std::vector<NodeIndex> _volatile;
+    // visible nodes only
+    std::unordered_map<NodeId, NodeIndex> _indices;
+    // formulas index into this copy, later registrations don't affect the sheet
+    dsl::FunctionRegistry _functions;
+};
+
+// values and dirty state of one entity sharing a sheet. creating an instance copies the
+// default values, nothing else is allocated per node.
+// instances are independent of each other and of the kernel the sheet was compiled from,
+// a single instance must not be used by several threads at once.
+class SheetInstance {
+public:
+    explicit SheetInstance(std::shared_ptr<Sheet const> sheet);
+
+    [[nodiscard]] Sheet const& sheet() const {
+        return *_sheet;
+    }
+
+    VoidResult setNodeValue(NodeId const& id, NodeValue value);
+    // only evaluates the dirty nodes up to "id"
+    [[nodiscard]] Result<NodeValue> getNodeValue(NodeId const& id);
+    // "index" has to be a value node
+    void setValue(NodeIndex index, NodeValue value);
+    [[nodiscard]] NodeValue value(NodeIndex index);
+    // evaluates all dirty nodes and every formula calling impure functions
+    void evaluate();
+
+private:
+    void markDependents(NodeIndex index);
+    void evaluateUntil(NodeIndex last);
+
+    std::shared_ptr<Sheet const> _sheet;
+    std::vector<NodeValue> _values;
+    std::vector<bool> _dirty;
+    // no node before it is dirty
+    NodeIndex _firstDirty;
+};
+
+// copy-on-write view of a sheet for what-if evaluation. reads fall through to the values of
+// the sheet until a node diverges, only diverged nodes are stored and reevaluated, so creating
+// a fork allocates nothing and its cost follows the changes made to it.
+// copying a fork only reads it, forks of one parent can be copied on several threads as long
+// as nobody changes or reads the parent meanwhile. a single fork must not be used by several
+// threads at once.
+class SheetFork {
+public:
+    explicit SheetFork(std::shared_ptr<Sheet const> sheet);
+
+    [[nodiscard]] Sheet const& sheet() const {
+        return *_sheet;
+    }
+    // nodes whose value currently differs from the sheet
+    [[nodiscard]] std::size_t diverged() const {
+        return _values.size();
+    }
+
+    VoidResult setNodeValue(NodeId const& id, NodeValue value);
+    // membership changes of collections only this fork sees. added members are never gated
+    VoidResult addCollectionMember(NodeId const& id, NodeId const& member);
+    VoidResult removeCollectionMember(NodeId const& id, NodeId const& member);
+    // only evaluates the dirty nodes up to "id"
+    [[nodiscard]] Result<NodeValue> getNodeValue(NodeId const& id);
+    // "index" has to be a value node
+    void setValue(NodeIndex index, NodeValue value);
+    [[nodiscard]] NodeValue value(NodeIndex index);
+    // evaluates all dirty nodes and every formula calling impure functions
+    void evaluate();
+    // drops every change, the fork reads the sheet again
+    void clear();
+
+private:
+    friend VoidResult scoreCandidates(std::shared_ptr<Sheet const> const& sheet,
+                                      std::span<std::vector<Command> const> candidates,
+                                      std::span<NodeId const> targets,
+                                      std::span<NodeValue> deltas);
+
+    // membership of a collection relative to the sheet
+    struct Members {
+        std::vector<NodeIndex> added;
+        std::vector<NodeIndex> removed;
+    };
+
+    [[nodiscard]] VoidResult checkCollection(NodeId const& id,
+                                             NodeId const& member,
+                                             NodeIndex& collection,
+                                             NodeIndex& index) const;
+    [[nodiscard]] bool isMember(NodeIndex collection, NodeIndex member) const;
+    // "from" reaches "to" through dependents, including members added to this fork
+    [[nodiscard]] bool reaches(NodeIndex from, NodeIndex to) const;
+    [[nodiscard]] NodeValue compute(NodeIndex index);
+    [[nodiscard]] NodeValue current(NodeIndex index) const;
+    void store(NodeIndex index, NodeValue value);
+    void markDirty(NodeIndex index);
+    void markDependents(NodeIndex index);
+    void evaluateUntil(NodeIndex last);
+
+    std::shared_ptr<Sheet const> _sheet;
+    // diverged nodes only
+    std::unordered_map<NodeIndex, NodeValue> _values;
+    // ascending, so dependencies are settled before their dependents
+    std::set<NodeIndex> _dirty;
+    // collections with changed membership
+    std::unordered_map<NodeIndex, Members> _members;
+    // nodes that are reevaluated at all, empty for every node. others keep the sheet's values
+    std::vector<bool> _tracked;
+};
+
+// evaluates every candidate as an overlay on "sheet" without committing anything. candidates
+// are lists of value and membership changes, "deltas" receives the change of every target
+// relative to the sheet, one row of targets per candidate. only nodes that are reachable from
+// any change and reach any target are ever evaluated. rows of failing candidates are NaN and
+// the first failure is returned
+VoidResult scoreCandidates(std::shared_ptr<Sheet const> const& sheet,
+                           std::span<std::vector<Command> const> candidates,
+                           std::span<NodeId const> targets,
+                           std::span<NodeValue> deltas);
+
+// instances of one sheet stored as [node][entity] columns. evaluation walks the nodes once
+// for all entities, so a program runs back to back for every dirty entity. modifiers and
+// ungated SUM, AVERAGE and COUNT collections are computed column wise in loops over all
+// entities the compiler can vectorize, everything else entity by entity.
+// a batch must not be used by several threads at once.
+class SheetBatch {
+public:
+    SheetBatch(std::shared_ptr<Sheet const> sheet, std::size_t entities);
+
+    [[nodiscard]] Sheet const& sheet() const {
+        return *_sheet;
+    }
+    [[nodiscard]] std::size_t entities() const {
+        return _entities;
+    }
+
+    VoidResult setNodeValue(std::size_t entity, NodeId const& id, NodeValue value);
+    // evaluates the dirty nodes up to "id" for all entities
+    [[nodiscard]] Result<NodeValue> getNodeValue(std::size_t entity, NodeId const& id);
+    // "index" has to be a value node
+    void setValue(std::size_t entity, NodeIndex index, NodeValue value);
+    [[nodiscard]] NodeValue value(std::size_t entity, NodeIndex index);
+    // values of "index" for all entities, valid until the next call changing the batch
+    [[nodiscard]] std::span<NodeValue const> column(NodeIndex index);
+    // evaluates all dirty nodes and every formula calling impure functions
+    void evaluate();
+
+private:
+    [[nodiscard]] VoidResult checkEntity(std::size_t entity) const;
+    void markDependents(NodeIndex index, std::size_t entity);
+    void evaluateUntil(NodeIndex last);
+    void evaluateNode(NodeIndex index);
+    // fills "_results" for all entities, false if "index" is computed entity by entity
+    bool computeColumns(NodeIndex index);
+    [[nodiscard]] std::span<NodeValue const> values(NodeIndex index) const {
+        return std::span{_values}.subspan(index * _entities, _entities);
+    }
+
+    std::shared_ptr<Sheet const> _sheet;
+    std::size_t _entities;
+    // node i of entity e at i * _entities + e
+    std::vector<NodeValue> _values;
+    std::vector<std::uint8_t> _dirty;
+    // dirty entities per node
+    std::vector<std::uint32_t> _dirtyEntities;
+    // no node before it is dirty
+    NodeIndex _firstDirty;
+    // one value per entity, reused by every node
+    std::vector<NodeValue> _results;
+    std::vector<NodeValue> _scratch;
+};
+
+} // namespace statforge::statkernel
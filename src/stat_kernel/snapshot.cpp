@@ -0,0 +1,80 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <format>
+
+namespace statforge::statkernel {
+
+std::optional<SnapshotHandle> Snapshot::find(NodeId const& id) const {
+    auto it = _handles->find(id);
+    if (it == _handles->end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+Result<NodeValue> Snapshot::getNodeValue(NodeId const& id) const {
+    auto const handle = find(id);
+    SF_RETURN_UNEXPECTED_IF(!handle,
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to get value of non-existing node "{}")", id));
+    return value(*handle);
+}
+
+void SnapshotPublisher::publish(Graph const& graph, Compiler const& compiler) {
+    if (_structureVersion != graph.structureVersion()) {
+        rebuild(graph, compiler);
+    }
+
+    // readers drop their references with release semantics, once the count is down to ours
+    // nobody reads the buffer anymore
+    std::shared_ptr<Snapshot> buffer;
+    if (_previous && _previous.use_count() == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        buffer = std::move(_previous);
+    } else {
+        buffer = std::make_shared<Snapshot>();
+    }
+
+    buffer->_handles = _handles;
+    buffer->_values.assign(_assigned.size(), std::numeric_limits<NodeValue>::quiet_NaN());
+    for (auto const& [node, handle] : _sources) {
+        buffer->_values[handle] = node->value;
+    }
+    buffer->_version = ++_version;
+
+    _latest.store(buffer, std::memory_order_release);
+    _previous = std::exchange(_current, std::move(buffer));
+}
+
+void SnapshotPublisher::reset() {
+    _latest.store(nullptr, std::memory_order_release);
+    _current.reset();
+    _previous.reset();
+    _assigned.clear();
+    _handles.reset();
+    _sources.clear();
+    _structureVersion.reset();
+}
+
+void SnapshotPublisher::rebuild(Graph const& graph, Compiler const& compiler) {
+    std::unordered_map<NodeId, SnapshotHandle> handles;
+    _sources.clear();
+    for (auto const& [id, node] : graph.nodes()) {
+        if (compiler.isHidden(id)) {
+            continue;
+        }
+        auto const [it, added] =
+            _assigned.try_emplace(id, static_cast<SnapshotHandle>(_assigned.size()));
+        handles.emplace(id, it->second);
+        _sources.emplace_back(&node, it->second);
+    }
+    // ascending handles, the copy walks the buffer front to back
+    std::ranges::sort(_sources, {}, &std::pair<Node const*, SnapshotHandle>::second);
+
+    _handles = std::make_shared<std::unordered_map<NodeId, SnapshotHandle> const>(
+        std::move(handles));
+    _structureVersion = graph.structureVersion();
+}
+
+} // namespace statforge::statkernel
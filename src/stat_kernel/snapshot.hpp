@@ -0,0 +1,77 @@
+#pragma once
+
+#include "error/internal/error.hpp"
+#include "stat_kernel/compiler.hpp"
+#include "stat_kernel/graph.hpp"
+#include "stat_kernel/node.hpp"
+#include "types/definitions.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace statforge::statkernel {
+
+using SnapshotHandle = std::uint32_t;
+
+// read-only values of all visible nodes at the time of publishing, safe to share between
+// threads. handles stay valid for every later snapshot of the same kernel until it's reset,
+// nodes removed in between read as NaN
+class Snapshot {
+public:
+    [[nodiscard]] std::optional<SnapshotHandle> find(NodeId const& id) const;
+    [[nodiscard]] NodeValue value(SnapshotHandle handle) const {
+        return handle < _values.size() ? _values[handle]
+                                       : std::numeric_limits<NodeValue>::quiet_NaN();
+    }
+    [[nodiscard]] Result<NodeValue> getNodeValue(NodeId const& id) const;
+    // increases with every published snapshot
+    [[nodiscard]] std::uint64_t version() const {
+        return _version;
+    }
+
+private:
+    friend class SnapshotPublisher;
+
+    // shared by all snapshots until nodes are added or removed
+    std::shared_ptr<std::unordered_map<NodeId, SnapshotHandle> const> _handles;
+    std::vector<NodeValue> _values;
+    std::uint64_t _version{0};
+};
+
+// owned by the thread using the kernel. publish() copies the current values into a buffer no
+// reader holds anymore and swaps it in, readers only ever load the latest snapshot.
+// two buffers alternate as long as readers drop old snapshots before the next publish
+class SnapshotPublisher {
+public:
+    // nodes have to be evaluated already
+    void publish(Graph const& graph, Compiler const& compiler);
+    // nullptr before the first publish, safe to call from any thread
+    [[nodiscard]] std::shared_ptr<Snapshot const> latest() const {
+        return _latest.load(std::memory_order_acquire);
+    }
+    // existing snapshots stay readable, handles start over
+    void reset();
+
+private:
+    // maps the visible nodes to their handles, only after nodes were added or removed
+    void rebuild(Graph const& graph, Compiler const& compiler);
+
+    std::atomic<std::shared_ptr<Snapshot const>> _latest;
+    std::shared_ptr<Snapshot> _current;
+    std::shared_ptr<Snapshot> _previous;
+    std::uint64_t _version{0};
+
+    // handles are never reused until reset, a node added again gets its old handle back
+    std::unordered_map<NodeId, SnapshotHandle> _assigned;
+    std::shared_ptr<std::unordered_map<NodeId, SnapshotHandle> const> _handles;
+    std::vector<std::pair<Node const*, SnapshotHandle>> _sources;
+    std::optional<std::uint64_t> _structureVersion;
+};
+
+} // namespace statforge::statkernel
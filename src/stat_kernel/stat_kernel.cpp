@@ -2,18 +2,41 @@
 
 #include "error/error.h"
 #include "error/internal/error.hpp"
+#include "stat_kernel/collection_aggregate.hpp"
+#include "stat_kernel/modifier_aggregate.hpp"
 #include "stat_kernel/node.hpp"
 #include "types/definitions.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <format>
+#include <iterator>
+#include <optional>
+#include <span>
 #include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
 
 namespace statforge {
 
+namespace {
+
+VoidResult checkBatch(std::size_t ids, std::size_t values, std::size_t errors) {
+    SF_RETURN_UNEXPECTED_IF(
+        values != ids || (errors != 0 && errors != ids),
+        SF_ERR_INTERNAL_INVALID_ENGINE_STATE,
+        std::format("Batch of {} nodes with {} values and {} error codes", ids, values, errors));
+    return {};
+}
+
+} // namespace
+
 using namespace statkernel;
 
-StatKernel::StatKernel() : _compiler(_graph), _executor(_graph) {
+StatKernel::StatKernel() : _compiler(_graph, _executor), _executor(_graph) {
 }
 
 VoidResult StatKernel::createCollectionNode(NodeId const& id,
@@ -25,6 +48,15 @@ VoidResult StatKernel::createCollectionNode(NodeId const& id,
     return {};
 }
 
+VoidResult StatKernel::createQueryCollectionNode(NodeId const& id,
+                                                 std::string_view query,
+                                                 SF_CollectionOperation operation) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.addQueryCollectionNode(id, query, operation));
+    _executor.markAsDirtyLeaf(id);
+
+    return {};
+}
+
 VoidResult StatKernel::createFormulaNode(NodeId const& id, std::string_view formula) {
     SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.addFormulaNode(id, formula));
     _executor.markAsDirtyLeaf(id);
@@ -32,17 +64,45 @@ VoidResult StatKernel::createFormulaNode(NodeId const& id, std::string_view form
     return {};
 }
 
+VoidResult StatKernel::createModifierNode(NodeId const& id,
+                                          statkernel::ModifierGroups const& groups) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.addModifierNode(id, groups));
+    _executor.markAsDirtyLeaf(id);
+
+    return {};
+}
+
 VoidResult StatKernel::createValueNode(NodeId const& id, double value) {
     return _compiler.addValueNode(id, value);
 }
 
+VoidResult StatKernel::createFormulaTemplate(std::string const& name, std::string_view formula) {
+    return _compiler.addFormulaTemplate(name, formula);
+}
+
+VoidResult StatKernel::createTemplateNode(NodeId const& id,
+                                          std::string const& templateName,
+                                          std::vector<NodeId> const& bindings) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.addTemplateNode(id, templateName, bindings));
+    _executor.markAsDirtyLeaf(id);
+
+    return {};
+}
+
 VoidResult StatKernel::removeNode(NodeId const& id) {
     auto const dependents = static_cast<statkernel::Graph const&>(_graph).dependents(id);
-    if (auto result = _graph.removeNode(id); !result) [[unlikely]] {
+    if (auto result = _compiler.removeNode(id); !result) [[unlikely]] {
         return result;
     }
     _executor.remove(id);
     for (auto const& dependentId : dependents) {
+        auto const& dependent = _graph.node(dependentId);
+        if (dependent.aggregate) {
+            dependent.aggregate->removeMember(id);
+            _compiler.releaseGate(dependentId, id);
+        } else if (dependent.modifier) {
+            dependent.modifier->removeMember(id);
+        }
         _executor.markDirty(dependentId);
     }
 
@@ -50,7 +110,7 @@ VoidResult StatKernel::removeNode(NodeId const& id) {
 }
 
 VoidResult StatKernel::setNodeValue(NodeId const& id, NodeValue value) {
-    SF_RETURN_UNEXPECTED_IF(!_graph.contains(id),
+    SF_RETURN_UNEXPECTED_IF(!_graph.contains(id) || _compiler.isHidden(id),
                             SF_ERR_NODE_NOT_FOUND,
                             std::format(R"(Trying to set value of non-existing node "{}")", id));
 
@@ -83,21 +143,293 @@ VoidResult StatKernel::setNodeDependencies(NodeId const& id,
     return {};
 }
 
+VoidResult StatKernel::setModifierNodeGroups(NodeId const& id,
+                                             statkernel::ModifierGroups const& groups) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.setModifierNodeGroups(id, groups));
+    _executor.markDirty(id);
+
+    return {};
+}
+
+VoidResult StatKernel::addCollectionMember(NodeId const& id, NodeId const& member) {
+    return addCollectionMembers(id, std::span{&member, 1});
+}
+
+VoidResult StatKernel::addCollectionMembers(NodeId const& id, std::span<NodeId const> members) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.addCollectionMembers(id, members));
+    _executor.markDirty(id);
+
+    return {};
+}
+
+VoidResult StatKernel::removeCollectionMember(NodeId const& id, NodeId const& member) {
+    return removeCollectionMembers(id, std::span{&member, 1});
+}
+
+VoidResult StatKernel::removeCollectionMembers(NodeId const& id,
+                                               std::span<NodeId const> members) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.removeCollectionMembers(id, members));
+    _executor.markDirty(id);
+
+    return {};
+}
+
+VoidResult StatKernel::addGatedCollectionMember(NodeId const& id,
+                                                NodeId const& member,
+                                                NodeId const& gate) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_compiler.addGatedCollectionMember(id, member, gate));
+    _executor.markDirty(id);
+
+    return {};
+}
+
+VoidResult StatKernel::setNodeTags(NodeId const& id, std::vector<std::string> tags) {
+    auto collectionsResult = _compiler.setNodeTags(id, std::move(tags));
+    SF_RETURN_ERROR_IF_UNEXPECTED(collectionsResult);
+    for (auto const& collection : *collectionsResult) {
+        _executor.markDirty(collection);
+    }
+
+    return {};
+}
+
 NodeValueResult StatKernel::getNodeValue(NodeId const& id) {
+    SF_RETURN_UNEXPECTED_IF(_compiler.isHidden(id),
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to get value of non-existing node "{}")", id));
     return _executor.getNodeValue(id);
 }
 
+VoidResult StatKernel::setNodeValues(std::span<NodeId const> ids,
+                                     std::span<NodeValue const> values,
+                                     std::span<SF_ErrorCode> errors) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkBatch(ids.size(), values.size(), errors.size()));
+
+    std::optional<ErrorInfo> firstError;
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        auto result = setNodeValue(ids[i], values[i]);
+        if (!errors.empty()) {
+            errors[i] = result ? SF_OK : result.error().errorCode;
+        }
+        if (!result && !firstError) {
+            firstError = std::move(result).error();
+        }
+    }
+    if (firstError) {
+        return std::unexpected(std::move(*firstError));
+    }
+    return {};
+}
+
+VoidResult StatKernel::getNodeValues(std::span<NodeId const> ids,
+                                     std::span<NodeValue> values,
+                                     std::span<SF_ErrorCode> errors) {
+    SF_RETURN_ERROR_IF_UNEXPECTED(checkBatch(ids.size(), values.size(), errors.size()));
+
+    std::optional<ErrorInfo> firstError;
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        if (exists(ids[i])) {
+            continue;
+        }
+        if (!errors.empty()) {
+            errors[i] = SF_ERR_NODE_NOT_FOUND;
+        }
+        if (!firstError) {
+            firstError = buildErrorInfo(
+                SF_ERR_NODE_NOT_FOUND,
+                std::format(R"(Trying to get value of non-existing node "{}")", ids[i]));
+        }
+    }
+
+    if (!firstError) {
+        _executor.evaluate(ids);
+    } else {
+        std::vector<NodeId> found;
+        std::ranges::copy_if(ids, std::back_inserter(found), [this](NodeId const& id) {
+            return exists(id);
+        });
+        _executor.evaluate(found);
+    }
+
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        if (firstError && !exists(ids[i])) {
+            continue;
+        }
+        values[i] = _graph.node(ids[i]).value;
+        if (!errors.empty()) {
+            errors[i] = SF_OK;
+        }
+    }
+    if (firstError) {
+        return std::unexpected(std::move(*firstError));
+    }
+    return {};
+}
+
 VoidResult StatKernel::evaluate() {
     return _executor.evaluate();
 }
 
+Result<NodeValue const*> StatKernel::getNodeValueView(NodeId const& id) const {
+    SF_RETURN_UNEXPECTED_IF(!exists(id),
+                            SF_ERR_NODE_NOT_FOUND,
+                            std::format(R"(Trying to view value of non-existing node "{}")", id));
+    return &_graph.node(id).value;
+}
+
+std::uint64_t StatKernel::cleanEpoch() const {
+    return _executor.cleanEpoch();
+}
+
+bool StatKernel::needsEvaluation() const {
+    return _executor.cleanEpoch() % 2 == 1 || _executor.hasVolatileNodes();
+}
+
+void StatKernel::queueCommand(statkernel::Command command) {
+    _commands.push(std::move(command));
+}
+
+VoidResult StatKernel::applyCommands() {
+    auto const commands = _commands.takeAll();
+
+    // last write wins per node. membership changes build on each other and all run in order
+    std::unordered_map<NodeId, std::size_t> lastValue;
+    std::unordered_map<NodeId, std::size_t> lastFormula;
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+        if (auto const* command = std::get_if<statkernel::SetValueCommand>(&commands[i])) {
+            lastValue[command->id] = i;
+        } else if (auto const* command =
+                       std::get_if<statkernel::SetFormulaCommand>(&commands[i])) {
+            lastFormula[command->id] = i;
+        }
+    }
+
+    std::optional<ErrorInfo> firstError;
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+        auto result = std::visit(
+            [this, i, &lastValue, &lastFormula](auto const& command) -> VoidResult {
+                using T = std::decay_t<decltype(command)>;
+
+                if constexpr (std::is_same_v<T, statkernel::SetValueCommand>) {
+                    if (lastValue[command.id] != i) {
+                        return {};
+                    }
+                    return setNodeValue(command.id, command.value);
+                } else if constexpr (std::is_same_v<T, statkernel::SetFormulaCommand>) {
+                    if (lastFormula[command.id] != i) {
+                        return {};
+                    }
+                    return setNodeFormula(command.id, command.formula);
+                } else if constexpr (std::is_same_v<T, statkernel::AddMemberCommand>) {
+                    return addCollectionMember(command.id, command.member);
+                } else {
+                    return removeCollectionMember(command.id, command.member);
+                }
+            },
+            commands[i]);
+        if (!result && !firstError) {
+            firstError = std::move(result).error();
+        }
+    }
+    if (firstError) {
+        return std::unexpected(std::move(*firstError));
+    }
+    return {};
+}
+
+VoidResult StatKernel::publishSnapshot() {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_executor.evaluate());
+    _snapshots.publish(_graph, _compiler);
+    return {};
+}
+
+std::shared_ptr<statkernel::Snapshot const> StatKernel::latestSnapshot() const {
+    return _snapshots.latest();
+}
+
+Result<std::shared_ptr<statkernel::Sheet const>> StatKernel::compileSheet() {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_executor.evaluate());
+
+    // unread dependencies of conditional formulas may still be dirty
+    std::vector<NodeId> dirty;
+    for (auto const& [id, node] : _graph.nodes()) {
+        if (node.dirty) {
+            dirty.push_back(id);
+        }
+    }
+    _executor.evaluate(dirty);
+
+    return statkernel::Sheet::compile(_graph, _compiler);
+}
+
+Result<statkernel::SheetFork> StatKernel::fork() {
+    auto sheet = forkSheet();
+    SF_RETURN_ERROR_IF_UNEXPECTED(sheet);
+    return statkernel::SheetFork{std::move(*sheet)};
+}
+
+VoidResult StatKernel::scoreCandidates(
+    std::span<std::vector<statkernel::Command> const> candidates,
+    std::span<NodeId const> targets,
+    std::span<NodeValue> deltas) {
+    auto sheet = forkSheet();
+    SF_RETURN_ERROR_IF_UNEXPECTED(sheet);
+    return statkernel::scoreCandidates(*sheet, candidates, targets, deltas);
+}
+
+Result<std::shared_ptr<statkernel::Sheet const>> StatKernel::forkSheet() {
+    SF_RETURN_ERROR_IF_UNEXPECTED(_executor.evaluate());
+
+    // every change is counted and adding or removing nodes bumps the structure version, so an
+    // unchanged pair means an unchanged graph. reevaluated impure formulas don't count, forks
+    // reevaluate them on their own
+    std::pair const state{_graph.structureVersion(), _executor.changeCount()};
+    if (!_forkSheet || state != _forkSheetState) {
+        auto sheet = compileSheet();
+        SF_RETURN_ERROR_IF_UNEXPECTED(sheet);
+        _forkSheet = std::move(*sheet);
+        _forkSheetState = {_graph.structureVersion(), _executor.changeCount()};
+    }
+    return _forkSheet;
+}
+
+bool StatKernel::exists(NodeId const& id) const {
+    return _graph.contains(id) && !_compiler.isHidden(id);
+}
+
 void StatKernel::reset() {
     _graph.clear();
+    _compiler.reset();
     _executor.reset();
+    _snapshots.reset();
+    _forkSheet.reset();
+    // commands were queued for the old graph
+    _commands.clear();
 }
 
 void StatKernel::setEvaluationType(statkernel::Executor::EvaluationType evaluationType) {
     _executor.setEvaluationType(evaluationType);
 }
 
+void StatKernel::setCompileOptions(statkernel::CompileOptions options) {
+    _compiler.setOptions(options);
+}
+
+void StatKernel::setFormulaCacheCapacity(std::size_t capacity) {
+    _compiler.setFormulaCacheCapacity(capacity);
+}
+
+statkernel::FormulaCacheStats StatKernel::formulaCacheStats() const {
+    return _compiler.formulaCacheStats();
+}
+
+VoidResult StatKernel::registerFunction(std::string name,
+                                        dsl::Intrinsic callable,
+                                        std::size_t minArguments,
+                                        std::size_t maxArguments,
+                                        bool pure) {
+    return _compiler.registerFunction(
+        std::move(name), std::move(callable), minArguments, maxArguments, pure);
+}
+
 } // namespace statforge
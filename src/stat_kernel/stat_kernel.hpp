@@ -1,11 +1,18 @@
 #pragma once
 
 #include "error/internal/error.hpp"
+#include "stat_kernel/command_queue.hpp"
 #include "stat_kernel/compiler.hpp"
 #include "stat_kernel/executor.hpp"
 #include "stat_kernel/graph.hpp"
+#include "stat_kernel/sheet.hpp"
+#include "stat_kernel/snapshot.hpp"
 #include "types/collection_operation.h"
 
+#include <cstdint>
+#include <memory>
+#include <span>
+
 namespace statforge {
 
 using NodeValueResult = Result<NodeValue>;
@@ -17,25 +24,120 @@ public:
     VoidResult createCollectionNode(NodeId const& id,
                                     std::vector<NodeId> const& dependencies,
                                     SF_CollectionOperation operation = SF_COLLECTION_OP_SUM);
+    // members are all tagged nodes matching "query", e.g. "tag:FlatLife & !disabled".
+    // membership follows setNodeTags() and can't be set manually.
+    VoidResult createQueryCollectionNode(NodeId const& id,
+                                         std::string_view query,
+                                         SF_CollectionOperation operation = SF_COLLECTION_OP_SUM);
     VoidResult createFormulaNode(NodeId const& id, std::string_view formula);
+    // sum(base) * (1 + sum(increased)) * product(1 + more) in a single node
+    VoidResult createModifierNode(NodeId const& id, statkernel::ModifierGroups const& groups);
     VoidResult createValueNode(NodeId const& id, double value);
 
+    // all nodes created from a template share its compiled program.
+    // placeholders <$0>, <$1>, ... are bound to "bindings" in order. templates have to use
+    // every placeholder up to the highest one.
+    VoidResult createFormulaTemplate(std::string const& name, std::string_view formula);
+    VoidResult createTemplateNode(NodeId const& id,
+                                  std::string const& templateName,
+                                  std::vector<NodeId> const& bindings);
+
     VoidResult removeNode(NodeId const& id);
 
     VoidResult setNodeValue(NodeId const& id, NodeValue value);
     VoidResult setNodeFormula(NodeId const& id, std::string_view formula);
     VoidResult setNodeDependencies(NodeId const& id, std::vector<NodeId> const& dependencies);
+    VoidResult setModifierNodeGroups(NodeId const& id, statkernel::ModifierGroups const& groups);
+    // incremental membership changes of collections created with explicit dependencies,
+    // batches are applied completely or not at all
+    VoidResult addCollectionMember(NodeId const& id, NodeId const& member);
+    VoidResult addCollectionMembers(NodeId const& id, std::span<NodeId const> members);
+    VoidResult removeCollectionMember(NodeId const& id, NodeId const& member);
+    VoidResult removeCollectionMembers(NodeId const& id, std::span<NodeId const> members);
+    // "member" only takes part while "gate" is non-zero and not NaN. flipping the gate doesn't change the
+    // graph, several members can share one gate
+    VoidResult addGatedCollectionMember(NodeId const& id,
+                                        NodeId const& member,
+                                        NodeId const& gate);
+    // replaces the tags of "id", query collections it joins or leaves become dirty
+    VoidResult setNodeTags(NodeId const& id, std::vector<std::string> tags);
     [[nodiscard]] NodeValueResult getNodeValue(NodeId const& id);
+    // batches handle every entry on its own. "errors" is either empty or receives a code per
+    // entry, the first failure is returned. values of failed entries are left unchanged
+    VoidResult setNodeValues(std::span<NodeId const> ids,
+                             std::span<NodeValue const> values,
+                             std::span<SF_ErrorCode> errors = {});
+    // dirty nodes of the batch are evaluated in a single traversal
+    VoidResult getNodeValues(std::span<NodeId const> ids,
+                             std::span<NodeValue> values,
+                             std::span<SF_ErrorCode> errors = {});
+
+    // queues a mutation without blocking, safe to call from any thread while the owning thread
+    // keeps using the kernel. nothing changes until the owning thread calls applyCommands()
+    void queueCommand(statkernel::Command command);
+    // applies all queued commands in the order they were queued. of several value or formula
+    // changes to one node only the last is applied, so dependents are marked dirty once.
+    // failing commands are skipped and the first failure is returned
+    VoidResult applyCommands();
 
     VoidResult evaluate();
+    // address of the value of "id", stable until the node is removed or the kernel is reset.
+    // it holds the current value whenever cleanEpoch() is even
+    [[nodiscard]] Result<NodeValue const*> getNodeValueView(NodeId const& id) const;
+    // even while all nodes are clean after evaluate(), odd once anything changed since.
+    // an unchanged even epoch means no value changed
+    [[nodiscard]] std::uint64_t cleanEpoch() const;
+    // anything changed since the last evaluate() or a formula calls impure functions
+    [[nodiscard]] bool needsEvaluation() const;
+
+    // evaluates the graph and publishes the values of all visible nodes for other threads
+    VoidResult publishSnapshot();
+    // nullptr before the first publish. unlike everything else it may be called from other
+    // threads while the owning thread keeps using the kernel
+    [[nodiscard]] std::shared_ptr<statkernel::Snapshot const> latestSnapshot() const;
+
+    // evaluates the graph and freezes it into a sheet shared by lightweight per-entity
+    // instances. later changes to the kernel don't reach sheets compiled before
+    Result<std::shared_ptr<statkernel::Sheet const>> compileSheet();
+    // evaluates the graph and creates a copy-on-write child of it. all forks share one sheet,
+    // which is only compiled again after the kernel changed
+    Result<statkernel::SheetFork> fork();
+    // scores alternative changes against the current values without committing any of them.
+    // every candidate is a list of value and membership changes, "deltas" receives the change
+    // of every target, one row of targets per candidate. only the union of the nodes the
+    // candidates can affect on the way to the targets is ever evaluated. rows of failing
+    // candidates are NaN and the first failure is returned
+    VoidResult scoreCandidates(std::span<std::vector<statkernel::Command> const> candidates,
+                               std::span<NodeId const> targets,
+                               std::span<NodeValue> deltas);
 
     void reset();
     void setEvaluationType(statkernel::Executor::EvaluationType evaluationType);
+    // only affects formulas compiled after the call
+    void setCompileOptions(statkernel::CompileOptions options);
+    // formulas with the same normalized text reuse one compiled program, 0 disables the cache
+    void setFormulaCacheCapacity(std::size_t capacity);
+    [[nodiscard]] statkernel::FormulaCacheStats formulaCacheStats() const;
+    // registered functions can't be replaced and survive reset()
+    VoidResult registerFunction(std::string name,
+                                dsl::Intrinsic callable,
+                                std::size_t minArguments,
+                                std::size_t maxArguments,
+                                bool pure = true);
 
 private:
+    [[nodiscard]] bool exists(NodeId const& id) const;
+    // evaluates the graph and returns the sheet shared by forks
+    Result<std::shared_ptr<statkernel::Sheet const>> forkSheet();
+
     statkernel::Graph _graph;
     statkernel::Compiler _compiler;
     statkernel::Executor _executor;
+    statkernel::SnapshotPublisher _snapshots;
+    statkernel::CommandQueue _commands;
+    // sheet shared by forks and the structure version and clean epoch it was compiled at
+    std::shared_ptr<statkernel::Sheet const> _forkSheet;
+    std::pair<std::uint64_t, std::uint64_t> _forkSheetState{};
 };
 
 } // namespace statforge
@@ -0,0 +1,101 @@
+#include "tag_index.hpp"
+
+#include <algorithm>
+#include <span>
+
+namespace statforge::statkernel {
+
+std::vector<NodeId> TagIndex::matches(TagQuery const& query, NodeId const& collection) const {
+    std::vector<NodeId> members;
+    for (auto const& [id, tags] : _tags) {
+        if (id != collection && query.matches(tags)) {
+            members.push_back(id);
+        }
+    }
+    return members;
+}
+
+void TagIndex::addQuery(NodeId const& collection, TagQuery query) {
+    for (auto const& tag : query.tags()) {
+        _queriesByTag[tag].push_back(collection);
+    }
+    if (query.matches({})) {
+        _tagFreeQueries.push_back(collection);
+    }
+    _queries.emplace(collection, std::move(query));
+}
+
+std::vector<TagIndex::MembershipChange> TagIndex::changes(
+    NodeId const& id,
+    std::vector<std::string> const& tags) const {
+    auto const previousIt = _tags.find(id);
+    std::span<std::string const> const previous =
+        previousIt == _tags.end() ? std::span<std::string const>{} : previousIt->second;
+
+    std::vector<NodeId const*> candidates;
+    for (auto const& tagList : {previous, std::span<std::string const>{tags}}) {
+        for (auto const& tag : tagList) {
+            if (auto it = _queriesByTag.find(tag); it != _queriesByTag.end()) {
+                for (auto const& collection : it->second) {
+                    candidates.push_back(&collection);
+                }
+            }
+        }
+    }
+    for (auto const& collection : _tagFreeQueries) {
+        candidates.push_back(&collection);
+    }
+    auto const byId = [](NodeId const* collection) -> NodeId const& { return *collection; };
+    std::ranges::sort(candidates, {}, byId);
+    auto const duplicates = std::ranges::unique(candidates, {}, byId);
+    candidates.erase(duplicates.begin(), duplicates.end());
+
+    std::vector<MembershipChange> changes;
+    for (auto const* collection : candidates) {
+        if (*collection == id) {
+            continue;
+        }
+        auto const& query = _queries.at(*collection);
+        bool const wasMember = !previous.empty() && query.matches(previous);
+        bool const isMember = !tags.empty() && query.matches(tags);
+        if (wasMember != isMember) {
+            changes.push_back({.collection = *collection, .joins = isMember});
+        }
+    }
+    return changes;
+}
+
+void TagIndex::setTags(NodeId const& id, std::vector<std::string> tags) {
+    if (tags.empty()) {
+        _tags.erase(id);
+        return;
+    }
+    _tags.insert_or_assign(id, std::move(tags));
+}
+
+void TagIndex::removeNode(NodeId const& id) {
+    _tags.erase(id);
+
+    auto it = _queries.find(id);
+    if (it == _queries.end()) {
+        return;
+    }
+    for (auto const& tag : it->second.tags()) {
+        auto& collections = _queriesByTag[tag];
+        std::erase(collections, id);
+        if (collections.empty()) {
+            _queriesByTag.erase(tag);
+        }
+    }
+    std::erase(_tagFreeQueries, id);
+    _queries.erase(it);
+}
+
+void TagIndex::clear() {
+    _tags.clear();
+    _queries.clear();
+    _queriesByTag.clear();
+    _tagFreeQueries.clear();
+}
+
+} // namespace statforge::statkernel
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "stat_kernel/tag_query.hpp"
+#include "types/definitions.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace statforge::statkernel {
+
+// node tags and the queries defining collection members. only tagged nodes match queries.
+class TagIndex {
+public:
+    struct MembershipChange {
+        NodeId collection;
+        bool joins;
+    };
+
+    [[nodiscard]] bool isQueryCollection(NodeId const& id) const {
+        return _queries.contains(id);
+    }
+    // tagged nodes matching "query", "collection" itself excluded
+    [[nodiscard]] std::vector<NodeId> matches(TagQuery const& query,
+                                              NodeId const& collection) const;
+    void addQuery(NodeId const& collection, TagQuery query);
+
+    // collections "id" joins or leaves once its tags become "tags", which have to be sorted
+    // and distinct. only queries mentioning old or new tags and queries matching nodes
+    // without any of their tags are checked.
+    [[nodiscard]] std::vector<MembershipChange> changes(NodeId const& id,
+                                                        std::vector<std::string> const& tags) const;
+    void setTags(NodeId const& id, std::vector<std::string> tags);
+
+    // drops the tags and query of "id"
+    void removeNode(NodeId const& id);
+    void clear();
+
+private:
+    std::unordered_map<NodeId, std::vector<std::string>> _tags;
+    std::unordered_map<NodeId, TagQuery> _queries;
+    std::unordered_map<std::string, std::vector<NodeId>> _queriesByTag;
+    // queries that match tagged nodes without any of the tags they mention, e.g. "!disabled"
+    std::vector<NodeId> _tagFreeQueries;
+};
+
+} // namespace statforge::statkernel
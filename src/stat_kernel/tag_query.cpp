@@ -0,0 +1,173 @@
+#include "tag_query.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <format>
+
+namespace statforge::statkernel {
+
+namespace {
+
+constexpr std::string_view tagPrefix = "tag:";
+// operands pending during matching, deeper queries are rejected when parsing
+constexpr std::size_t maxStackDepth = 64;
+// parentheses and negations are parsed recursively, deeper ones are rejected
+constexpr std::size_t maxNesting = 256;
+
+bool isTagCharacter(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' || c == '.';
+}
+
+} // namespace
+
+class TagQuery::Parser {
+public:
+    Parser(std::string_view source, TagQuery& query) : _source(source), _query(query) {
+    }
+
+    VoidResult parse() {
+        SF_RETURN_ERROR_IF_UNEXPECTED(parseOr());
+        skipWhitespace();
+        SF_RETURN_UNEXPECTED_IF(_position != _source.size(),
+                                SF_ERR_INVALID_TAG,
+                                error(std::format("unexpected '{}'", _source[_position])));
+        return {};
+    }
+
+private:
+    VoidResult parseOr() {
+        SF_RETURN_ERROR_IF_UNEXPECTED(parseAnd());
+        while (consume('|')) {
+            SF_RETURN_ERROR_IF_UNEXPECTED(parseAnd());
+            _query._program.push_back({.operation = Operation::Or});
+            --_stackDepth;
+        }
+        return {};
+    }
+
+    VoidResult parseAnd() {
+        SF_RETURN_ERROR_IF_UNEXPECTED(parseUnary());
+        while (consume('&')) {
+            SF_RETURN_ERROR_IF_UNEXPECTED(parseUnary());
+            _query._program.push_back({.operation = Operation::And});
+            --_stackDepth;
+        }
+        return {};
+    }
+
+    VoidResult parseUnary() {
+        if (consume('!')) {
+            SF_RETURN_ERROR_IF_UNEXPECTED(enter());
+            SF_RETURN_ERROR_IF_UNEXPECTED(parseUnary());
+            _query._program.push_back({.operation = Operation::Not});
+            --_nesting;
+            return {};
+        }
+        if (consume('(')) {
+            SF_RETURN_ERROR_IF_UNEXPECTED(enter());
+            SF_RETURN_ERROR_IF_UNEXPECTED(parseOr());
+            SF_RETURN_UNEXPECTED_IF(!consume(')'), SF_ERR_INVALID_TAG, error("expected ')'"));
+            --_nesting;
+            return {};
+        }
+        return parseTag();
+    }
+
+    VoidResult enter() {
+        SF_RETURN_UNEXPECTED_IF(
+            ++_nesting > maxNesting, SF_ERR_INVALID_TAG, error("nested too deeply"));
+        return {};
+    }
+
+    VoidResult parseTag() {
+        skipWhitespace();
+        if (_source.substr(_position).starts_with(tagPrefix)) {
+            _position += tagPrefix.size();
+        }
+
+        auto const start = _position;
+        while (_position < _source.size() && isTagCharacter(_source[_position])) {
+            ++_position;
+        }
+        SF_RETURN_UNEXPECTED_IF(_position == start, SF_ERR_INVALID_TAG, error("expected a tag"));
+
+        auto const tag = _source.substr(start, _position - start);
+        auto& tags = _query._tags;
+        auto it = std::ranges::find(tags, tag);
+        if (it == tags.end()) {
+            it = tags.emplace(tags.end(), tag);
+        }
+        _query._program.push_back(
+            {.operation = Operation::Tag, .tag = static_cast<std::uint32_t>(it - tags.begin())});
+        SF_RETURN_UNEXPECTED_IF(
+            ++_stackDepth > maxStackDepth, SF_ERR_INVALID_TAG, error("nested too deeply"));
+        return {};
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (_position < _source.size() && _source[_position] == c) {
+            ++_position;
+            return true;
+        }
+        return false;
+    }
+
+    void skipWhitespace() {
+        while (_position < _source.size() &&
+               std::isspace(static_cast<unsigned char>(_source[_position]))) {
+            ++_position;
+        }
+    }
+
+    [[nodiscard]] std::string error(std::string_view reason) const {
+        return std::format(
+            R"(Invalid tag query "{}": {} at column {})", _source, reason, _position + 1);
+    }
+
+    std::string_view _source;
+    TagQuery& _query;
+    std::size_t _position{0};
+    std::size_t _nesting{0};
+    // operands pending at this point of the program when matching
+    std::size_t _stackDepth{0};
+};
+
+Result<TagQuery> TagQuery::parse(std::string_view query) {
+    TagQuery parsed;
+    SF_RETURN_ERROR_IF_UNEXPECTED(Parser(query, parsed).parse());
+    return parsed;
+}
+
+bool TagQuery::isValidTag(std::string_view tag) {
+    return !tag.empty() && std::ranges::all_of(tag, isTagCharacter);
+}
+
+bool TagQuery::matches(std::span<std::string const> tags) const {
+    std::array<bool, maxStackDepth> stack;
+    std::size_t size = 0;
+
+    for (auto const& instruction : _program) {
+        switch (instruction.operation) {
+        case Operation::Tag:
+            stack[size++] = std::ranges::binary_search(tags, _tags[instruction.tag]);
+            break;
+        case Operation::Not:
+            stack[size - 1] = !stack[size - 1];
+            break;
+        case Operation::And:
+            --size;
+            stack[size - 1] = stack[size - 1] && stack[size];
+            break;
+        case Operation::Or:
+            --size;
+            stack[size - 1] = stack[size - 1] || stack[size];
+            break;
+        }
+    }
+
+    return stack[0];
+}
+
+} // namespace statforge::statkernel
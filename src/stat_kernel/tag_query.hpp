@@ -0,0 +1,47 @@
+#pragma once
+
+#include "error/internal/error.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace statforge::statkernel {
+
+// boolean expression over node tags, e.g. "tag:FlatLife & !disabled".
+// supports ! (not), & (and), | (or) and parentheses, the "tag:" prefix is optional.
+class TagQuery {
+public:
+    [[nodiscard]] static Result<TagQuery> parse(std::string_view query);
+    [[nodiscard]] static bool isValidTag(std::string_view tag);
+
+    // "tags" has to be sorted
+    [[nodiscard]] bool matches(std::span<std::string const> tags) const;
+    // distinct tags the query mentions
+    [[nodiscard]] std::vector<std::string> const& tags() const {
+        return _tags;
+    }
+
+private:
+    enum class Operation : std::uint8_t {
+        Tag,
+        Not,
+        And,
+        Or,
+    };
+    struct Instruction {
+        Operation operation;
+        // index into "_tags" for Operation::Tag
+        std::uint32_t tag{0};
+    };
+
+    class Parser;
+
+    // postfix
+    std::vector<Instruction> _program;
+    std::vector<std::string> _tags;
+};
+
+} // namespace statforge::statkernel
@@ -105,3 +105,33 @@ TEST_CASE("benchmark node dependency evaluation") {
                ms3,
                ok ? "none" : errorMessage);
 }
+
+TEST_CASE("benchmark template node creation") {
+    constexpr size_t minNodeTarget = 100'000;
+
+    Engine engine;
+    CHECK_EQ(engine.createValueNode("a0", 1), SF_OK);
+    CHECK_EQ(engine.createFormulaTemplate("halfRootPlusOne", "root(2, <$0>) + 1"), SF_OK);
+
+    bool ok = true;
+    std::string errorMessage;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t nextId = 1; nextId < minNodeTarget && ok; ++nextId) {
+        const std::string parent = "a" + std::to_string((nextId - 1) / 2);
+        if (engine.createTemplateNode("a" + std::to_string(nextId), "halfRootPlusOne", parent) !=
+            SF_OK) {
+            ok = false;
+            errorMessage = engine.getLastError();
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    CHECK(ok);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::print("Creation of {} template nodes: {}ms\n"
+               "errors: {}\n",
+               minNodeTarget,
+               ms,
+               ok ? "none" : errorMessage);
+}
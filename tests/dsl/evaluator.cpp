@@ -2,6 +2,7 @@
 #include "dsl/parser.hpp"
 #include "dsl/tokenizer.hpp"
 
+#include <cmath>
 #include <cstddef>
 #include <doctest/doctest.h>
 #include <string_view>
@@ -9,6 +10,7 @@
 using statforge::dsl::Context;
 using statforge::dsl::evaluate;
 using statforge::dsl::extractDependencies;
+using statforge::dsl::extractUnconditionalDependencies;
 using statforge::dsl::Parser;
 using statforge::dsl::Tokenizer;
 
@@ -35,13 +37,13 @@ Context makeCtx(std::unordered_map<std::string, double> values = {}) {
 TEST_CASE("power, unary minus, and precedence") {
     auto const& astResult = makeAst("-2^3 + 4 * 5");
     REQUIRE(astResult);
-    CHECK_EQ(evaluate(*astResult.value(), makeCtx()), doctest::Approx(12.0));
+    CHECK_EQ(evaluate(astResult.value(), makeCtx()), doctest::Approx(12.0));
 }
 
 TEST_CASE("numeric boolean logic and comparisons") {
     auto const& astResult = makeAst("(3 > 2) && (4 == 4) || 0"); // (1 && 1) || 0  -> 1
     REQUIRE(astResult);
-    CHECK_EQ(evaluate(*astResult.value(), makeCtx()), 1.0);
+    CHECK_EQ(evaluate(astResult.value(), makeCtx()), 1.0);
 }
 
 TEST_CASE("five-level ternary chain evaluates correctly") {
@@ -55,7 +57,7 @@ TEST_CASE("five-level ternary chain evaluates correctly") {
         c = 1  -> then branch -> result 3
     */
     auto const ctx = makeCtx({{"a", 0.0}, {"b", 0.0}, {"c", 1.0}, {"d", 0.0}});
-    CHECK_EQ(evaluate(*astResult.value(), ctx), doctest::Approx(3.0));
+    CHECK_EQ(evaluate(astResult.value(), ctx), doctest::Approx(3.0));
 }
 
 TEST_CASE("root function computes n-th root") {
@@ -63,7 +65,26 @@ TEST_CASE("root function computes n-th root") {
     auto const& astResult = makeAst(formula);
     REQUIRE(astResult);
 
-    CHECK_EQ(evaluate(*astResult.value(), makeCtx()), doctest::Approx(3.0));
+    CHECK_EQ(evaluate(astResult.value(), makeCtx()), doctest::Approx(3.0));
+}
+
+TEST_CASE("math functions") {
+    std::string formula =
+        "min(<a>, <b>, 3) + max(<a>, <b>) * clamp(<c>, 0, 1) + lerp(<a>, <b>, 0.5)";
+    auto const& astResult = makeAst(formula);
+    REQUIRE(astResult);
+
+    auto const ctx = makeCtx({{"a", 2.0}, {"b", 4.0}, {"c", 1.5}});
+    CHECK_EQ(evaluate(astResult.value(), ctx), doctest::Approx(9.0));
+}
+
+TEST_CASE("min and max ignore NaN arguments") {
+    std::string formula = "min(<a>, <b>) + max(<b>, <a>)";
+    auto const& astResult = makeAst(formula);
+    REQUIRE(astResult);
+
+    auto const ctx = makeCtx({{"a", std::nan("")}, {"b", 4.0}});
+    CHECK_EQ(evaluate(astResult.value(), ctx), 8.0);
 }
 
 TEST_CASE("node reference multiplies correctly") {
@@ -72,19 +93,42 @@ TEST_CASE("node reference multiplies correctly") {
     REQUIRE(astResult);
 
     auto const ctx = makeCtx({{"price", 2.5}, {"qty", 4}});
-    CHECK_EQ(evaluate(*astResult.value(), ctx), doctest::Approx(10.0));
+    CHECK_EQ(evaluate(astResult.value(), ctx), doctest::Approx(10.0));
 }
 
 TEST_CASE("dependencies") {
     std::string formula = "<a> + <b> * <a>";
     auto const& astResult = makeAst(formula);
     REQUIRE(astResult);
-    auto const deps = extractDependencies(*astResult.value());
+    auto const deps = extractDependencies(astResult.value());
     CHECK_EQ(deps.size(), 2);
     CHECK(std::ranges::find(deps, "a") != deps.end());
     CHECK(std::ranges::find(deps, "b") != deps.end());
 }
 
+TEST_CASE("&& and || only evaluate the rhs if it decides the result") {
+    std::string andFormula = "<a> && <missing>";
+    std::string orFormula = "<b> || <missing>";
+    auto const& andResult = makeAst(andFormula);
+    auto const& orResult = makeAst(orFormula);
+    REQUIRE(andResult);
+    REQUIRE(orResult);
+
+    // makeCtx throws on unknown nodes
+    auto const ctx = makeCtx({{"a", 0.0}, {"b", 2.0}});
+    CHECK_EQ(evaluate(andResult.value(), ctx), 0.0);
+    CHECK_EQ(evaluate(orResult.value(), ctx), 1.0);
+}
+
+TEST_CASE("unconditional dependencies skip branches and short-circuited operands") {
+    std::string formula = "<a> ? <b> : (<c> && <d>) + <a> * (<e> || <f>)";
+    auto const& astResult = makeAst(formula);
+    REQUIRE(astResult);
+    auto const deps = extractUnconditionalDependencies(astResult.value());
+    CHECK_EQ(deps, std::vector<statforge::NodeId>{"a"});
+    CHECK_EQ(extractDependencies(astResult.value()).size(), 6);
+}
+
 TEST_CASE("very long alternating add/sub chain evaluates without stack overflow") {
     constexpr std::size_t iterations = 1000;
 
@@ -95,5 +139,5 @@ TEST_CASE("very long alternating add/sub chain evaluates without stack overflow"
     src += "1";
     auto const& astResult = makeAst(src);
     REQUIRE(astResult);
-    CHECK_EQ(evaluate(*astResult.value(), makeCtx()), 1.0);
+    CHECK_EQ(evaluate(astResult.value(), makeCtx()), 1.0);
 }
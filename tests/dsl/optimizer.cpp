@@ -0,0 +1,150 @@
+#include "dsl/ast.hpp"
+#include "dsl/evaluator.hpp"
+#include "dsl/optimizer.hpp"
+#include "dsl/parser.hpp"
+#include "dsl/tokenizer.hpp"
+#include "error/error.h"
+
+#include <cmath>
+#include <doctest/doctest.h>
+#include <limits>
+
+using statforge::dsl::Context;
+using statforge::dsl::dumpSExpr;
+using statforge::dsl::evaluate;
+using statforge::dsl::OptimizeOptions;
+using statforge::dsl::Parser;
+using statforge::dsl::Tokenizer;
+
+// helpers
+
+namespace {
+
+std::string optimized(std::string const& src, OptimizeOptions options = {}) {
+    auto tokenResult = Tokenizer{src}.tokenize();
+    REQUIRE(tokenResult);
+    auto astResult = Parser{tokenResult.value(), options}.parse();
+    REQUIRE(astResult);
+    return dumpSExpr(astResult.value());
+}
+
+std::string fastMath(std::string const& src) {
+    return optimized(src, {.fastMath = true});
+}
+
+double evaluateWith(std::string const& src, double x, OptimizeOptions options = {}) {
+    auto tokenResult = Tokenizer{src}.tokenize();
+    REQUIRE(tokenResult);
+    auto astResult = Parser{tokenResult.value(), options}.parse();
+    REQUIRE(astResult);
+    return evaluate(astResult.value(), Context{.nodeLookup = [x](std::string_view) { return x; }});
+}
+
+} // namespace
+
+// constant folding
+
+TEST_CASE("literal subtrees and pure calls on constants are folded") {
+    CHECK(optimized("1 + 2 * 3") == "7");
+    CHECK(optimized("root(3, 27) + <a>") == "(+ 3 <a>)");
+    CHECK(optimized("(2 > 1) ? <a> : <b>") == "<a>");
+    CHECK(optimized("0 && <a>") == "0");
+    CHECK(optimized("1 || <a>") == "1");
+}
+
+TEST_CASE("division by literal zero is rejected") {
+    for (std::string const src : {"1 / 0", "1 % 0"}) {
+        auto tokenResult = Tokenizer{src}.tokenize();
+        REQUIRE(tokenResult);
+        auto astResult = Parser{tokenResult.value()}.parse();
+        REQUIRE_FALSE(astResult);
+        CHECK_EQ(astResult.error().errorCode, SF_ERR_INVALID_DSL);
+    }
+}
+
+TEST_CASE("math functions on constants are folded") {
+    CHECK(optimized("max(1, 5, 3) + min(2, <a>)") == "(+ 5 (call min 2 <a>))");
+    CHECK(optimized("clamp(7, 0, 5) * floor(2.5) * ceil(2.5) * round(2.5)") == "90");
+    CHECK(optimized("abs(-2) + pow(2, 3) + lerp(0, 10, 0.25) + 7 % 4") == "15.5");
+    CHECK(optimized("exp(0) + log(1) + fmod(-7, 4)") == "-2");
+}
+
+TEST_CASE("rewritten trees only keep reachable nodes") {
+    std::string const src = "(<x> * 1) + (2 * 3) + (<y> ^ 2)";
+    auto tokenResult = Tokenizer{src}.tokenize();
+    REQUIRE(tokenResult);
+    auto astResult = Parser{tokenResult.value()}.parse();
+    REQUIRE(astResult);
+    CHECK_EQ(dumpSExpr(astResult.value()), "(+ (+ <x> 6) (* <y> <y>))");
+    CHECK_EQ(astResult->size(), 7);
+    // children are stored before their parents
+    CHECK_EQ(astResult->root(), 6);
+}
+
+// identities
+
+TEST_CASE("IEEE-safe identities are removed") {
+    CHECK(optimized("<x> * 1") == "<x>");
+    CHECK(optimized("1 * <x>") == "<x>");
+    CHECK(optimized("<x> - 0") == "<x>");
+    CHECK(optimized("<x> ^ 1") == "<x>");
+    CHECK(optimized("<x> / 1") == "<x>");
+    CHECK(optimized("<x> * -1") == "(- <x>)");
+    CHECK(optimized("- -<x>") == "<x>");
+}
+
+TEST_CASE("identities depending on signed zero need fast-math") {
+    CHECK(optimized("<x> + 0") == "(+ <x> 0)");
+    CHECK(optimized("<x> * 0") == "(* <x> 0)");
+    CHECK(fastMath("<x> + 0") == "<x>");
+    CHECK(fastMath("<x> * 0") == "0");
+
+    CHECK(std::signbit(evaluateWith("<x> + 0", -0.0)) == std::signbit(-0.0 + 0.0));
+}
+
+TEST_CASE("math function identities") {
+    CHECK(optimized("min(<x>)") == "<x>");
+    CHECK(optimized("abs(abs(<x>))") == "(call abs <x>)");
+    CHECK(optimized("abs(-<x>)") == "(call abs <x>)");
+    CHECK(optimized("floor(round(<x>))") == "(call round <x>)");
+    CHECK(optimized("pow(<x>, 2)") == "(* <x> <x>)");
+}
+
+TEST_CASE("min and max are only reordered in fast-math") {
+    CHECK(optimized("min(<x>, 3, min(<y>, 1))") == "(call min <x> 3 (call min <y> 1))");
+    CHECK(fastMath("min(<x>, 3, min(<y>, 1))") == "(call min <x> <y> 1)");
+    CHECK(fastMath("max(2, max(4))") == "4");
+}
+
+// strength reduction
+
+TEST_CASE("integer powers become multiply chains") {
+    CHECK(optimized("<x> ^ 2") == "(* <x> <x>)");
+    CHECK(optimized("<x> ^ 3") == "(^ <x> 3)");
+    CHECK(optimized("<x> ^ -1") == "(/ 1 <x>)");
+    CHECK(fastMath("<x> ^ 3") == "(* (* <x> <x>) <x>)");
+    CHECK(fastMath("<x> ^ -2") == "(/ 1 (* <x> <x>))");
+    CHECK(fastMath("<x> ^ 9") == "(^ <x> 9)");
+
+    // duplicating complex bases would evaluate them twice
+    CHECK(optimized("(<x> + <y>) ^ 2") == "(^ (+ <x> <y>) 2)");
+}
+
+TEST_CASE("root with constant index turns into a power") {
+    CHECK(optimized("root(2, <x>)") == "(^ <x> 0.5)");
+    CHECK(optimized("root(1, <x>)") == "<x>");
+    CHECK(fastMath("root(2, <x>)") == "(call sqrt <x>)");
+
+    CHECK_EQ(evaluateWith("root(2, <x>)", 16.0), 4.0);
+    CHECK_EQ(evaluateWith("root(2, <x>)", 16.0, {.fastMath = true}), 4.0);
+}
+
+TEST_CASE("division by constants becomes multiplication") {
+    CHECK(optimized("<x> / 4") == "(* <x> 0.25)");
+    CHECK(optimized("<x> / 100") == "(/ <x> 100)");
+    CHECK(fastMath("<x> / 100") == "(* <x> 0.01)");
+    CHECK(fastMath("<x> / 0") == "(/ <x> 0)");
+
+    CHECK_EQ(evaluateWith("<x> / 4", 10.0), 2.5);
+    CHECK(std::isinf(evaluateWith("<x> / 0", 1.0, {.fastMath = true})));
+}
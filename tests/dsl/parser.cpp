@@ -18,7 +18,7 @@ static std::string sexpr(std::string const& src) {
     REQUIRE(tokenResult);
     auto astResult = Parser{tokenResult.value()}.parse(false); //no constant folding
     REQUIRE(astResult);
-    return dumpSExpr(*astResult.value());
+    return dumpSExpr(astResult.value());
 }
 
 statforge::ErrorInfo parseError(std::string const& src) {
@@ -38,6 +38,10 @@ TEST_CASE("addition binds looser than multiplication") {
     CHECK(sexpr("1 * 2 + 3") == "(+ (* 1 2) 3)");
 }
 
+TEST_CASE("modulo binds like multiplication") {
+    CHECK(sexpr("1 + 7 % 4 * 2") == "(+ 1 (* (% 7 4) 2))");
+}
+
 TEST_CASE("power is tighter than unary - but right-associative") {
     CHECK(sexpr("-2^3") == "(- (^ 2 3))");
     CHECK(sexpr("2 ^ 3 ^ 2") == "(^ 2 (^ 3 2))");
@@ -78,8 +82,28 @@ TEST_CASE("nested call as argument") {
     CHECK(sexpr("root(2, root(3,8))") == "(call root 2 (call root 3 8))");
 }
 
+TEST_CASE("nested calls keep their argument lists apart") {
+    CHECK(sexpr("max(min(<a>, 1), 2, min(3, <b>, 4))") ==
+          "(call max (call min <a> 1) 2 (call min 3 <b> 4))");
+}
+
 TEST_CASE("long argument list") {
-    CHECK_NOTHROW(sexpr("root(1,2,3,4,5,6,7,8,9)"));
+    CHECK_NOTHROW(sexpr("max(1,2,3,4,5,6,7,8,9)"));
+}
+
+TEST_CASE("wrong argument count is rejected") {
+    auto error = parseError("root(1,2,3,4,5,6,7,8,9)");
+    CHECK_EQ(error.errorCode, SF_ERR_INVALID_DSL);
+    CHECK_EQ(error.message, "root() expects 2 arguments, provided: 9");
+
+    error = parseError("min()");
+    CHECK_EQ(error.message, "min() expects at least 1 arguments, provided: 0");
+}
+
+TEST_CASE("unknown function is rejected") {
+    auto error = parseError("foo(1)");
+    CHECK_EQ(error.errorCode, SF_ERR_INVALID_DSL);
+    CHECK_EQ(error.message, "Unknown function 'foo'");
 }
 
 
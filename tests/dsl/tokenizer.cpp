@@ -40,6 +40,11 @@ TEST_CASE("simple arithmetic") {
     CHECK_EQ(tokens[4], TokenKind::Number);
 }
 
+TEST_CASE("modulo") {
+    auto tokens = getTokenKinds("7 % 4");
+    CHECK_EQ(tokens[1], TokenKind::Percent);
+}
+
 TEST_CASE("node reference and comparison") {
     auto tokens = getTokenKinds("<level> == 47");
     CHECK_EQ(tokens[0], TokenKind::NodeRef);
@@ -47,6 +52,13 @@ TEST_CASE("node reference and comparison") {
     CHECK_EQ(tokens[2], TokenKind::Number);
 }
 
+TEST_CASE("template placeholder") {
+    auto tokens = getTokenKinds("<$12> + 1");
+    CHECK_EQ(tokens[0], TokenKind::NodeRef);
+    CHECK_EQ(tokenizeError("<$a>").errorCode, SF_ERR_INVALID_DSL);
+    CHECK_EQ(tokenizeError("<$18446744073709551616>").errorCode, SF_ERR_INVALID_DSL);
+}
+
 TEST_CASE("ternary chain") {
     auto tokens = getTokenKinds("<x> ? 1 : 2");
     CHECK_EQ(tokens[1], TokenKind::Question);
@@ -68,6 +80,16 @@ TEST_CASE("boolean keywords become numeric") {
     CHECK_EQ(tokens[2], TokenKind::Number);
 }
 
+TEST_CASE("token buffer is refilled") {
+    std::vector<statforge::dsl::Token> tokens;
+    REQUIRE(Tokenizer{"1 + 2 * 3"}.tokenize(tokens));
+    CHECK_EQ(tokens.size(), 6);
+    REQUIRE(Tokenizer{"<a>"}.tokenize(tokens));
+    CHECK_EQ(tokens.size(), 2);
+    CHECK_EQ(tokens[0].kind, TokenKind::NodeRef);
+    CHECK_EQ(tokens[0].lexeme, "a");
+}
+
 TEST_CASE("single equals reports invalid dsl") {
     auto error = tokenizeError("1 = 2");
     CHECK_EQ(error.errorCode, SF_ERR_INVALID_DSL);
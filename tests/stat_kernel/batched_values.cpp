@@ -0,0 +1,122 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <format>
+#include <string>
+#include <vector>
+
+using namespace statforge;
+
+TEST_CASE("batched node values") {
+    for (auto const evaluationType : {statkernel::Executor::EvaluationType::Iterative,
+                                      statkernel::Executor::EvaluationType::Recursive}) {
+        StatKernel kernel;
+        kernel.setEvaluationType(evaluationType);
+
+        std::vector<NodeId> ids;
+        std::vector<NodeValue> values;
+        for (int i = 0; i < 50; ++i) {
+            ids.push_back(std::format("v{}", i));
+            values.push_back(i);
+            CHECK(kernel.createValueNode(ids.back(), 0));
+        }
+        CHECK(kernel.createCollectionNode("sum", ids, SF_COLLECTION_OP_SUM));
+        CHECK(kernel.createFormulaNode("double", "<sum> * 2"));
+        CHECK(kernel.createFormulaNode("triple", "<sum> * 3"));
+
+        CHECK(kernel.setNodeValues(ids, values));
+        std::array<NodeId, 4> const read{"double", "sum", "triple", "v7"};
+        std::array<NodeValue, 4> results{};
+        CHECK(kernel.getNodeValues(read, results));
+        CHECK_EQ(results, std::array<NodeValue, 4>{2450, 1225, 3675, 7});
+    }
+}
+
+TEST_CASE("batched node value errors") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createFormulaNode("sum", "<a> + <b>"));
+
+    std::array<NodeId, 4> const ids{"a", "missing", "sum", "b"};
+    std::array<NodeValue, 4> const values{10, 0, 0, 20};
+    std::array<SF_ErrorCode, 4> errors{};
+    checkErrorCode(kernel.setNodeValues(ids, values, errors), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(errors,
+             std::array{SF_OK, SF_ERR_NODE_NOT_FOUND, SF_ERR_NODE_TYPE_MISMATCH, SF_OK});
+
+    std::array<NodeValue, 4> results{-1, -1, -1, -1};
+    checkErrorCode(kernel.getNodeValues(ids, results, errors), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(errors, std::array{SF_OK, SF_ERR_NODE_NOT_FOUND, SF_OK, SF_OK});
+    CHECK_EQ(results, std::array<NodeValue, 4>{10, -1, 30, 20});
+
+    // failures without error codes still apply the valid entries
+    std::array<NodeValue, 4> const more{1, 0, 0, 2};
+    checkErrorCode(kernel.setNodeValues(ids, more), SF_ERR_NODE_NOT_FOUND);
+    checkValue(kernel, "sum", 3.0);
+
+    std::array<NodeValue, 3> tooFew{};
+    checkErrorCode(kernel.getNodeValues(ids, tooFew), SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    std::array<SF_ErrorCode, 1> tooFewErrors{};
+    checkErrorCode(kernel.getNodeValues(ids, results, tooFewErrors),
+                   SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK(kernel.getNodeValues({}, {}));
+}
+
+TEST_CASE("engine batched node values") {
+    Engine engine;
+
+    CHECK_EQ(engine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(engine.createValueNode("b", 2), SF_OK);
+    CHECK_EQ(engine.createFormulaNode("sum", "<a> + <b>"), SF_OK);
+
+    std::array<std::string, 2> const names{"a", "b"};
+    std::array<double, 2> const values{3, 4};
+    CHECK_EQ(engine.setNodeValues(names, values), SF_OK);
+
+    std::array<std::string, 2> const read{"sum", "missing"};
+    std::array<double, 2> results{};
+    std::array<SF_ErrorCode, 2> errors{};
+    CHECK_EQ(engine.getNodeValues(read, results, errors), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(results[0], 7);
+    CHECK_EQ(errors[1], SF_ERR_NODE_NOT_FOUND);
+}
+
+TEST_CASE("c api batched node values") {
+    auto* engine = sf_create_engine();
+
+    CHECK_EQ(sf_create_value_node(engine, "a", 1), SF_OK);
+    CHECK_EQ(sf_create_value_node(engine, "b", 2), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "sum", "<a> + <b>"), SF_OK);
+
+    std::array<char const*, 2> const names{"a", "b"};
+    std::array<double, 2> const values{5, 6};
+    CHECK_EQ(sf_set_node_values(engine, names.data(), values.data(), names.size(), nullptr),
+             SF_OK);
+
+    std::array<char const*, 3> const read{"sum", "a", "missing"};
+    std::array<double, 3> results{};
+    std::array<SF_ErrorCode, 3> errors{};
+    CHECK_EQ(sf_get_node_values(engine, read.data(), results.data(), read.size(), errors.data()),
+             SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(results[0], 11);
+    CHECK_EQ(results[1], 5);
+    CHECK_EQ(errors, std::array{SF_OK, SF_OK, SF_ERR_NODE_NOT_FOUND});
+
+    CHECK_EQ(sf_get_node_values(engine, read.data(), nullptr, read.size(), nullptr),
+             SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(sf_set_node_values(engine, nullptr, values.data(), values.size(), nullptr),
+             SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(sf_get_node_values(engine, nullptr, nullptr, 0, nullptr), SF_OK);
+    CHECK_EQ(sf_set_node_values(nullptr, names.data(), values.data(), 2, nullptr),
+             SF_ERR_INVALID_ENGINE_HANDLE);
+
+    sf_destroy_engine(engine);
+}
@@ -0,0 +1,260 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <cmath>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+using namespace statforge;
+using namespace statforge::statkernel;
+
+namespace {
+
+std::array<NodeId, 3> const targets{"life", "damage", "x3"};
+
+void buildPlanner(StatKernel& kernel) {
+    CHECK(kernel.createValueNode("base", 10));
+    CHECK(kernel.createValueNode("ring", 4));
+    CHECK(kernel.createValueNode("amulet", 6));
+    CHECK(kernel.createValueNode("equipped", 1));
+    CHECK(kernel.createValueNode("x", 1));
+    CHECK(kernel.createCollectionNode("flat", {"base", "ring"}));
+    CHECK(kernel.addGatedCollectionMember("flat", "amulet", "equipped"));
+    CHECK(kernel.createModifierNode("damage", {.base = {"flat"}, .more = {"x"}}));
+    CHECK(kernel.createFormulaNode("life", "<flat> * 10 + <base>"));
+    // chain that ends later in the topological order than "flat"
+    CHECK(kernel.createFormulaNode("x1", "<x> + 1"));
+    CHECK(kernel.createFormulaNode("x2", "<x1> + 1"));
+    CHECK(kernel.createFormulaNode("x3", "<x2> + 1"));
+    CHECK(kernel.createFormulaNode("unrelated", "<x3> * <base>"));
+}
+
+// what applying "commands" to a fresh kernel does to the targets
+std::vector<NodeValue> reference(std::vector<Command> const& commands) {
+    StatKernel kernel;
+    buildPlanner(kernel);
+    std::vector<NodeValue> before;
+    for (auto const& target : targets) {
+        before.push_back(*kernel.getNodeValue(target));
+    }
+    for (auto const& command : commands) {
+        auto const result = std::visit(
+            [&kernel](auto const& change) -> VoidResult {
+                using T = std::decay_t<decltype(change)>;
+
+                if constexpr (std::is_same_v<T, SetValueCommand>) {
+                    return kernel.setNodeValue(change.id, change.value);
+                } else if constexpr (std::is_same_v<T, AddMemberCommand>) {
+                    return kernel.addCollectionMember(change.id, change.member);
+                } else if constexpr (std::is_same_v<T, RemoveMemberCommand>) {
+                    return kernel.removeCollectionMember(change.id, change.member);
+                } else {
+                    return kernel.setNodeFormula(change.id, change.formula);
+                }
+            },
+            command);
+        REQUIRE(result);
+    }
+    std::vector<NodeValue> deltas;
+    for (std::size_t i = 0; i < targets.size(); ++i) {
+        deltas.push_back(*kernel.getNodeValue(targets[i]) - before[i]);
+    }
+    return deltas;
+}
+
+} // namespace
+
+TEST_CASE("scored candidates match applying them") {
+    StatKernel kernel;
+    buildPlanner(kernel);
+
+    std::vector<std::vector<Command>> const candidates{
+        {},
+        {SetValueCommand{"ring", 9}},
+        {SetValueCommand{"ring", 9}, SetValueCommand{"ring", 4}},
+        {RemoveMemberCommand{"flat", "ring"}, SetValueCommand{"x", 2}},
+        {SetValueCommand{"equipped", 0}, SetValueCommand{"amulet", 100}},
+        // the removed gated member comes back ungated
+        {SetValueCommand{"equipped", 0}, RemoveMemberCommand{"flat", "amulet"},
+         AddMemberCommand{"flat", "amulet"}},
+        // "x3" comes after "flat" and has to be settled first
+        {SetValueCommand{"x", 5}, AddMemberCommand{"flat", "x3"}},
+        {AddMemberCommand{"flat", "x3"}, RemoveMemberCommand{"flat", "x3"}},
+    };
+    std::vector<NodeValue> deltas(candidates.size() * targets.size());
+    CHECK(kernel.scoreCandidates(candidates, targets, deltas));
+
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        auto const expected = reference(candidates[i]);
+        for (std::size_t t = 0; t < targets.size(); ++t) {
+            CHECK_EQ(deltas[i * targets.size() + t], expected[t]);
+        }
+    }
+
+    // nothing was committed
+    checkValue(kernel, "life", 210.0);
+    checkValue(kernel, "ring", 4.0);
+    CHECK_FALSE(kernel.needsEvaluation());
+}
+
+TEST_CASE("failing candidates are reported per row") {
+    StatKernel kernel;
+    buildPlanner(kernel);
+
+    std::vector<std::vector<Command>> const candidates{
+        {SetValueCommand{"missing", 1}},
+        {SetValueCommand{"ring", 5}},
+        // "life" depends on "flat"
+        {AddMemberCommand{"flat", "life"}},
+        {AddMemberCommand{"flat", "ring"}},
+        {RemoveMemberCommand{"flat", "x"}},
+        {SetFormulaCommand{"life", "1"}},
+        {SetValueCommand{"life", 1}},
+    };
+    std::vector<NodeValue> deltas(candidates.size() * targets.size());
+    checkErrorCode(kernel.scoreCandidates(candidates, targets, deltas), SF_ERR_NODE_NOT_FOUND);
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        CHECK_EQ(std::isnan(deltas[i * targets.size()]), i != 1);
+    }
+    CHECK_EQ(deltas[targets.size()], 10);
+
+    std::vector<std::vector<Command>> const single{{AddMemberCommand{"flat", "life"}}};
+    std::vector<NodeValue> row(targets.size());
+    checkErrorCode(kernel.scoreCandidates(single, targets, row), SF_ERR_DEPENDENCY_LOOP);
+
+    std::array<NodeId, 1> const missing{"missing"};
+    checkErrorCode(kernel.scoreCandidates(single, missing, std::span{row}.first(1)),
+                   SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.scoreCandidates(single, targets, std::span{row}.first(1)),
+                   SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+}
+
+TEST_CASE("forks change collection members") {
+    StatKernel kernel;
+    buildPlanner(kernel);
+    auto fork = kernel.fork();
+    REQUIRE(fork);
+
+    CHECK(fork->removeCollectionMember("flat", "ring"));
+    CHECK(fork->addCollectionMember("flat", "x3"));
+    auto const flat = fork->getNodeValue("flat");
+    REQUIRE(flat);
+    CHECK_EQ(*flat, 20);
+
+    // changes of added members reach the collection
+    CHECK(fork->setNodeValue("x", 3));
+    auto const changed = fork->getNodeValue("flat");
+    REQUIRE(changed);
+    CHECK_EQ(*changed, 22);
+
+    checkErrorCode(fork->addCollectionMember("flat", "x3"), SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(fork->addCollectionMember("flat", "equipped"), SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(fork->addCollectionMember("flat", "flat"), SF_ERR_SELF_REFERENCE);
+    checkErrorCode(fork->removeCollectionMember("flat", "ring"), SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    checkErrorCode(fork->addCollectionMember("life", "x"), SF_ERR_NODE_TYPE_MISMATCH);
+    checkErrorCode(fork->addCollectionMember("flat", "missing"), SF_ERR_DEPENDENCY_DOESNT_EXIST);
+
+    fork->clear();
+    CHECK_EQ(fork->diverged(), 0);
+    auto const cleared = fork->getNodeValue("flat");
+    REQUIRE(cleared);
+    CHECK_EQ(*cleared, 20);
+    checkValue(kernel, "flat", 20.0);
+}
+
+TEST_CASE("candidate scoring apis") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 1), SF_OK);
+    CHECK_EQ(sf_create_value_node(engine, "b", 2), SF_OK);
+    CHECK_EQ(sf_create_collection_node(engine, "sum", SF_COLLECTION_OP_SUM), SF_OK);
+    CHECK_EQ(sf_add_collection_member(engine, "sum", "a"), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "f", "<sum> * 2"), SF_OK);
+
+    std::array<SF_Change, 2> const first{
+        SF_Change{SF_CHANGE_SET_VALUE, "a", nullptr, 5},
+        SF_Change{SF_CHANGE_ADD_MEMBER, "sum", "b", 0},
+    };
+    std::array<SF_Change, 1> const second{SF_Change{SF_CHANGE_REMOVE_MEMBER, "sum", "a", 0}};
+    std::array<SF_Candidate, 2> const candidates{
+        SF_Candidate{first.data(), first.size()},
+        SF_Candidate{second.data(), second.size()},
+    };
+    std::array<const char*, 2> const names{"sum", "f"};
+    std::array<double, 4> deltas{};
+    CHECK_EQ(sf_score_candidates(
+                 engine, candidates.data(), 2, names.data(), names.size(), deltas.data()),
+             SF_OK);
+    CHECK_EQ(deltas, std::array<double, 4>{6, 12, -1, -2});
+
+    double value = 0;
+    CHECK_EQ(sf_get_node_value(engine, "f", &value), SF_OK);
+    CHECK_EQ(value, 2);
+
+    std::array<SF_Change, 1> const broken{SF_Change{SF_CHANGE_ADD_MEMBER, "sum", nullptr, 0}};
+    SF_Candidate const brokenCandidate{broken.data(), broken.size()};
+    CHECK_EQ(sf_score_candidates(engine, &brokenCandidate, 1, names.data(), 2, deltas.data()),
+             SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(std::string{sf_engine_last_error(engine)}, "member is null");
+    CHECK_EQ(sf_score_candidates(engine, nullptr, 1, names.data(), 2, deltas.data()),
+             SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(sf_score_candidates(nullptr, nullptr, 0, nullptr, 0, nullptr),
+             SF_ERR_INVALID_ENGINE_HANDLE);
+    sf_destroy_engine(engine);
+
+    Engine cppEngine;
+    CHECK_EQ(cppEngine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(cppEngine.createFormulaNode("f", "<a> * 3"), SF_OK);
+    std::vector<std::vector<CandidateChange>> const cppCandidates{
+        {{.type = SF_CHANGE_SET_VALUE, .name = "a", .value = 2}},
+        {{.type = SF_CHANGE_SET_VALUE, .name = "f", .value = 2}},
+    };
+    std::array<std::string, 1> const cppTargets{"f"};
+    std::array<double, 2> cppDeltas{};
+    CHECK_EQ(cppEngine.scoreCandidates(cppCandidates, cppTargets, cppDeltas),
+             SF_ERR_NODE_TYPE_MISMATCH);
+    CHECK_EQ(cppDeltas[0], 3);
+    CHECK(std::isnan(cppDeltas[1]));
+}
+
+TEST_CASE("fork member apis") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 1), SF_OK);
+    CHECK_EQ(sf_create_value_node(engine, "b", 2), SF_OK);
+    CHECK_EQ(sf_create_collection_node(engine, "sum", SF_COLLECTION_OP_SUM), SF_OK);
+    CHECK_EQ(sf_add_collection_member(engine, "sum", "a"), SF_OK);
+
+    auto* fork = sf_fork_engine(engine);
+    REQUIRE(fork != nullptr);
+    CHECK_EQ(sf_add_fork_member(fork, "sum", "b"), SF_OK);
+    CHECK_EQ(sf_remove_fork_member(fork, "sum", "a"), SF_OK);
+    double value = 0;
+    CHECK_EQ(sf_get_fork_value(fork, "sum", &value), SF_OK);
+    CHECK_EQ(value, 2);
+    CHECK_EQ(sf_get_node_value(engine, "sum", &value), SF_OK);
+    CHECK_EQ(value, 1);
+
+    CHECK_EQ(sf_add_fork_member(fork, "sum", "b"), SF_ERR_DUPLICATE_DEPENDENCY);
+    CHECK_EQ(sf_remove_fork_member(fork, "sum", nullptr), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(sf_add_fork_member(nullptr, "sum", "b"), SF_ERR_INVALID_ENGINE_HANDLE);
+    sf_destroy_fork(fork);
+    sf_destroy_engine(engine);
+
+    Engine cppEngine;
+    CHECK_EQ(cppEngine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(cppEngine.createCollectionNode("sum", SF_COLLECTION_OP_SUM), SF_OK);
+    auto cppFork = cppEngine.fork();
+    REQUIRE(cppFork);
+    CHECK_EQ(cppFork->addCollectionMember("sum", "a"), SF_OK);
+    CHECK_EQ(cppFork->getNodeValue("sum", value), SF_OK);
+    CHECK_EQ(value, 1);
+    CHECK_EQ(cppFork->removeCollectionMember("sum", "missing"), SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    CHECK_EQ(cppFork->getLastError(), R"(Trying to change non-existing member "missing" of "sum")");
+}
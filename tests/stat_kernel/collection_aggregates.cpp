@@ -0,0 +1,238 @@
+#include "../test_util.hpp"
+
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <limits>
+
+using namespace statforge;
+
+TEST_CASE("running sums follow member changes") {
+    StatKernel kernel;
+
+    std::vector<NodeId> members;
+    for (int i = 0; i < 100; ++i) {
+        members.push_back(std::format("m{}", i));
+        CHECK(kernel.createValueNode(members.back(), i));
+    }
+    CHECK(kernel.createCollectionNode("sum", members, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createCollectionNode("average", members, SF_COLLECTION_OP_AVERAGE));
+    CHECK(kernel.createFormulaNode("double", "<m7> * 2"));
+    CHECK(kernel.createCollectionNode("nested", {"sum", "double"}, SF_COLLECTION_OP_SUM));
+    checkValue(kernel, "sum", 4950.0);
+    checkValue(kernel, "average", 49.5);
+    checkValue(kernel, "nested", 4964.0);
+
+    // several changes between two evaluations, one member changing twice
+    CHECK(kernel.setNodeValue("m7", 107));
+    CHECK(kernel.setNodeValue("m50", 0));
+    CHECK(kernel.setNodeValue("m7", 207));
+    checkValue(kernel, "sum", 5100.0);
+    checkValue(kernel, "average", 51.0);
+    checkValue(kernel, "nested", 5514.0);
+
+    for (int i = 0; i < 3000; ++i) {
+        CHECK(kernel.setNodeValue(members[i % 100], i));
+        CHECK(kernel.evaluate());
+    }
+    NodeValue expected = 0;
+    for (int i = 2900; i < 3000; ++i) {
+        expected += i;
+    }
+    checkValue(kernel, "sum", expected);
+}
+
+TEST_CASE("running sums survive cancellation") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("small", 1));
+    CHECK(kernel.createValueNode("huge", 0));
+    CHECK(kernel.createCollectionNode("sum", {"small", "huge"}, SF_COLLECTION_OP_SUM));
+    checkValue(kernel, "sum", 1.0);
+
+    CHECK(kernel.setNodeValue("huge", 1e20));
+    checkValue(kernel, "sum", 1e20);
+    CHECK(kernel.setNodeValue("huge", 0));
+    checkValue(kernel, "sum", 1.0);
+}
+
+TEST_CASE("running products handle zeros") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createValueNode("b", 0));
+    CHECK(kernel.createValueNode("c", 5));
+    CHECK(kernel.createCollectionNode("product", {"a", "b", "c"}, SF_COLLECTION_OP_PRODUCT));
+    checkValue(kernel, "product", 0.0);
+
+    CHECK(kernel.setNodeValue("a", 3));
+    checkValue(kernel, "product", 0.0);
+    CHECK(kernel.setNodeValue("b", 4));
+    checkValue(kernel, "product", 60.0);
+    CHECK(kernel.setNodeValue("c", 0));
+    checkValue(kernel, "product", 0.0);
+    CHECK(kernel.setNodeValue("c", 0.5));
+    checkValue(kernel, "product", 6.0);
+}
+
+TEST_CASE("running aggregates handle non-finite members") {
+    StatKernel kernel;
+    auto const inf = std::numeric_limits<double>::infinity();
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createCollectionNode("sum", {"a", "b"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createCollectionNode("product", {"a", "b"}, SF_COLLECTION_OP_PRODUCT));
+    checkValue(kernel, "sum", 3.0);
+
+    CHECK(kernel.setNodeValue("a", inf));
+    checkValue(kernel, "sum", inf);
+    checkValue(kernel, "product", inf);
+    CHECK(kernel.setNodeValue("b", 0));
+    CHECK(std::isnan(*kernel.getNodeValue("product")));
+    CHECK(kernel.setNodeValue("a", 3));
+    CHECK(kernel.setNodeValue("b", 4));
+    checkValue(kernel, "sum", 7.0);
+    checkValue(kernel, "product", 12.0);
+
+    CHECK(kernel.setNodeValue("a", 1e300));
+    CHECK(kernel.setNodeValue("b", 1e300));
+    checkValue(kernel, "product", inf);
+    CHECK(kernel.setNodeValue("b", 1e-300));
+    checkValue(kernel, "product", doctest::Approx(1.0));
+}
+
+TEST_CASE("running aggregates follow membership changes") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createValueNode("c", 4));
+    CHECK(kernel.createCollectionNode("sum", {"a", "b", "c"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createCollectionNode("product", {"a", "b", "c"}, SF_COLLECTION_OP_PRODUCT));
+    CHECK(kernel.createCollectionNode("average", {"a", "b", "c"}, SF_COLLECTION_OP_AVERAGE));
+    checkValue(kernel, "sum", 7.0);
+
+    // changed and removed before the next evaluation
+    CHECK(kernel.setNodeValue("b", 20));
+    CHECK(kernel.removeNode("b"));
+    checkValue(kernel, "sum", 5.0);
+    checkValue(kernel, "product", 4.0);
+    checkValue(kernel, "average", 2.5);
+
+    CHECK(kernel.createValueNode("b", 8));
+    CHECK(kernel.setNodeDependencies("sum", {"a", "b"}));
+    CHECK(kernel.setNodeDependencies("product", {"a", "b", "c"}));
+    checkValue(kernel, "sum", 9.0);
+    checkValue(kernel, "product", 32.0);
+
+    CHECK(kernel.setNodeValue("b", 2));
+    checkValue(kernel, "sum", 3.0);
+    checkValue(kernel, "product", 8.0);
+
+    CHECK(kernel.setNodeDependencies("sum", {}));
+    checkValue(kernel, "sum", 0.0);
+}
+
+TEST_CASE("ordered aggregates follow member changes") {
+    StatKernel kernel;
+
+    std::vector<NodeId> members;
+    for (int i = 0; i < 100; ++i) {
+        members.push_back(std::format("m{}", i));
+        CHECK(kernel.createValueNode(members.back(), (i * 37) % 100));
+    }
+    CHECK(kernel.createCollectionNode("min", members, SF_COLLECTION_OP_MIN));
+    CHECK(kernel.createCollectionNode("max", members, SF_COLLECTION_OP_MAX));
+    CHECK(kernel.createCollectionNode("median", members, SF_COLLECTION_OP_MEDIAN));
+    checkValue(kernel, "min", 0.0);
+    checkValue(kernel, "max", 99.0);
+    checkValue(kernel, "median", 49.5);
+
+    // m0 holds 0, m73 holds 1
+    CHECK(kernel.setNodeValue("m0", 500));
+    checkValue(kernel, "min", 1.0);
+    checkValue(kernel, "max", 500.0);
+    checkValue(kernel, "median", 50.5);
+
+    // duplicates of the current extremes
+    CHECK(kernel.setNodeValue("m1", 500));
+    CHECK(kernel.setNodeValue("m0", -3));
+    CHECK(kernel.setNodeValue("m2", -3));
+    checkValue(kernel, "min", -3.0);
+    checkValue(kernel, "max", 500.0);
+    CHECK(kernel.setNodeValue("m2", 2));
+    checkValue(kernel, "min", -3.0);
+
+    std::vector<NodeValue> values(100);
+    for (int i = 0; i < 3000; ++i) {
+        auto const value = static_cast<NodeValue>((i * 7919) % 1000);
+        values[i % 100] = value;
+        CHECK(kernel.setNodeValue(members[i % 100], value));
+        CHECK(kernel.evaluate());
+    }
+    std::ranges::sort(values);
+    checkValue(kernel, "min", values.front());
+    checkValue(kernel, "max", values.back());
+    checkValue(kernel, "median", (values[49] + values[50]) / 2.0);
+}
+
+TEST_CASE("ordered aggregates handle non-finite members") {
+    StatKernel kernel;
+    auto const inf = std::numeric_limits<double>::infinity();
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createValueNode("c", 3));
+    CHECK(kernel.createCollectionNode("min", {"a", "b", "c"}, SF_COLLECTION_OP_MIN));
+    CHECK(kernel.createCollectionNode("max", {"a", "b", "c"}, SF_COLLECTION_OP_MAX));
+    CHECK(kernel.createCollectionNode("median", {"a", "b", "c"}, SF_COLLECTION_OP_MEDIAN));
+    checkValue(kernel, "median", 2.0);
+
+    CHECK(kernel.setNodeValue("a", -inf));
+    CHECK(kernel.setNodeValue("c", inf));
+    checkValue(kernel, "min", -inf);
+    checkValue(kernel, "max", inf);
+    checkValue(kernel, "median", 2.0);
+
+    CHECK(kernel.setNodeValue("b", std::numeric_limits<double>::quiet_NaN()));
+    CHECK(kernel.evaluate());
+    CHECK(kernel.setNodeValue("b", 5));
+    CHECK(kernel.setNodeValue("c", 4));
+    checkValue(kernel, "min", -inf);
+    checkValue(kernel, "max", 5.0);
+    checkValue(kernel, "median", 4.0);
+}
+
+TEST_CASE("ordered aggregates follow membership changes") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createValueNode("c", 4));
+    CHECK(kernel.createValueNode("d", 8));
+    CHECK(kernel.createCollectionNode("min", {"a", "b", "c", "d"}, SF_COLLECTION_OP_MIN));
+    CHECK(kernel.createCollectionNode("max", {"a", "b", "c", "d"}, SF_COLLECTION_OP_MAX));
+    CHECK(kernel.createCollectionNode("median", {"a", "b", "c", "d"}, SF_COLLECTION_OP_MEDIAN));
+    checkValue(kernel, "median", 3.0);
+
+    CHECK(kernel.removeNode("a"));
+    checkValue(kernel, "min", 2.0);
+    checkValue(kernel, "median", 4.0);
+    CHECK(kernel.removeNode("d"));
+    checkValue(kernel, "max", 4.0);
+    checkValue(kernel, "median", 3.0);
+
+    CHECK(kernel.setNodeDependencies("median", {"b"}));
+    checkValue(kernel, "median", 2.0);
+    CHECK(kernel.setNodeDependencies("median", {}));
+    checkValue(kernel, "median", 0.0);
+    CHECK(kernel.removeNode("b"));
+    CHECK(kernel.removeNode("c"));
+    checkValue(kernel, "min", 0.0);
+    checkValue(kernel, "max", 0.0);
+}
@@ -0,0 +1,72 @@
+#include "stat_kernel/collection_kernels.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace statforge;
+namespace kernels = statforge::statkernel::kernels;
+
+namespace {
+
+// every length up to a few full vectors of the widest instruction set, with and without tail
+std::vector<std::vector<NodeValue>> randomInputs() {
+    std::mt19937 generator{47};
+    std::uniform_real_distribution<NodeValue> distribution{-100.0, 100.0};
+
+    std::vector<std::vector<NodeValue>> inputs;
+    for (std::size_t size = 1; size <= 40; ++size) {
+        auto& values = inputs.emplace_back(size);
+        std::ranges::generate(values, [&] { return distribution(generator); });
+    }
+    return inputs;
+}
+
+} // namespace
+
+TEST_CASE("collection kernels dispatch to an instruction set") {
+    CHECK_FALSE(kernels::instructionSet().empty());
+}
+
+TEST_CASE("collection kernels match sequential scans") {
+    for (auto values : randomInputs()) {
+        auto const sum = std::accumulate(values.begin(), values.end(), NodeValue{0});
+        CHECK_EQ(kernels::sum(values).value(), doctest::Approx(sum));
+        CHECK_EQ(kernels::min(values), *std::ranges::min_element(values));
+        CHECK_EQ(kernels::max(values), *std::ranges::max_element(values));
+
+        auto sorted = values;
+        std::ranges::sort(sorted);
+        auto const middle = sorted.size() / 2;
+        auto const median = sorted.size() % 2 == 1 ? sorted[middle]
+                                                   : (sorted[middle - 1] + sorted[middle]) / 2.0;
+        CHECK_EQ(kernels::median(values), median);
+    }
+}
+
+TEST_CASE("collection kernels compensate sums") {
+    std::vector<NodeValue> values;
+    for (int i = 0; i < 11; ++i) {
+        values.insert(values.end(), {1e20, 1.0, -1e20});
+    }
+    CHECK_EQ(kernels::sum(values).value(), 11.0);
+    CHECK_EQ(kernels::sum({}).value(), 0.0);
+}
+
+TEST_CASE("collection kernels count zeros in products") {
+    std::vector<NodeValue> values(37, 1.0);
+    values[3] = 0.0;
+    values[20] = 0.0;
+    values[36] = 0.0;
+    values[5] = 2.0;
+    values[33] = -4.0;
+
+    auto const product = kernels::product(values);
+    CHECK_EQ(product.zeros, 3);
+    CHECK_EQ(product.product, -8.0);
+    CHECK_EQ(product.value(), 0.0);
+    CHECK_EQ(kernels::product({}).value(), 1.0);
+}
@@ -0,0 +1,288 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <format>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace statforge;
+
+TEST_CASE("incremental collection members") {
+    StatKernel kernel;
+
+    std::vector<NodeId> members;
+    for (int i = 0; i < 10; ++i) {
+        members.push_back(std::format("m{}", i));
+        CHECK(kernel.createValueNode(members.back(), i));
+    }
+    CHECK(kernel.createCollectionNode("sum", {"m0"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createCollectionNode("median", {}, SF_COLLECTION_OP_MEDIAN));
+    CHECK(kernel.createCollectionNode("count", {}, SF_COLLECTION_OP_COUNT));
+    CHECK(kernel.createFormulaNode("double", "<sum> * 2"));
+    checkValue(kernel, "double", 0.0);
+
+    CHECK(kernel.addCollectionMember("sum", "m3"));
+    checkValue(kernel, "double", 6.0);
+    CHECK(kernel.addCollectionMembers("sum", std::span{members}.subspan(4)));
+    CHECK(kernel.addCollectionMembers("median", members));
+    CHECK(kernel.addCollectionMembers("count", members));
+    checkValue(kernel, "sum", 42.0);
+    checkValue(kernel, "median", 4.5);
+    checkValue(kernel, "count", 10.0);
+
+    CHECK(kernel.setNodeValue("m9", 19));
+    checkValue(kernel, "double", 104.0);
+
+    CHECK(kernel.removeCollectionMember("sum", "m0"));
+    std::array<NodeId, 3> const removed{"m9", "m1", "m2"};
+    CHECK(kernel.removeCollectionMembers("median", removed));
+    CHECK(kernel.removeCollectionMembers("count", removed));
+    checkValue(kernel, "double", 104.0);
+    checkValue(kernel, "median", 5.0);
+    checkValue(kernel, "count", 7.0);
+
+    // removed members no longer update the collection
+    CHECK(kernel.setNodeValue("m9", 0));
+    checkValue(kernel, "median", 5.0);
+    CHECK(kernel.setNodeValue("m0", 100));
+    checkValue(kernel, "sum", 33.0);
+
+    // a full replacement afterwards still works
+    CHECK(kernel.setNodeDependencies("sum", {"m1", "m2"}));
+    checkValue(kernel, "double", 6.0);
+    CHECK(kernel.addCollectionMember("sum", "m0"));
+    checkValue(kernel, "double", 206.0);
+}
+
+TEST_CASE("collection member batches are all or nothing") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createValueNode("c", 4));
+    CHECK(kernel.createCollectionNode("sum", {"a"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createCollectionNode("outer", {"sum"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createFormulaNode("formula", "<a>"));
+    CHECK(kernel.createQueryCollectionNode("query", "x"));
+    checkValue(kernel, "outer", 1.0);
+
+    std::array<NodeId, 3> missing{"b", "missing", "c"};
+    checkErrorCode(kernel.addCollectionMembers("sum", missing), SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    std::array<NodeId, 3> duplicate{"b", "c", "b"};
+    checkErrorCode(kernel.addCollectionMembers("sum", duplicate), SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(kernel.addCollectionMember("sum", "a"), SF_ERR_DUPLICATE_DEPENDENCY);
+    std::array<NodeId, 2> cyclic{"b", "outer"};
+    checkErrorCode(kernel.addCollectionMembers("sum", cyclic), SF_ERR_DEPENDENCY_LOOP);
+    checkErrorCode(kernel.addCollectionMember("sum", "sum"), SF_ERR_SELF_REFERENCE);
+    checkValue(kernel, "outer", 1.0);
+
+    std::array<NodeId, 2> notMembers{"a", "b"};
+    checkErrorCode(kernel.removeCollectionMembers("sum", notMembers),
+                   SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    std::array<NodeId, 2> twice{"a", "a"};
+    checkErrorCode(kernel.removeCollectionMembers("sum", twice), SF_ERR_DUPLICATE_DEPENDENCY);
+    CHECK(kernel.setNodeValue("a", 3));
+    checkValue(kernel, "outer", 3.0);
+
+    checkErrorCode(kernel.addCollectionMember("missing", "a"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.addCollectionMember("formula", "b"), SF_ERR_NODE_TYPE_MISMATCH);
+    checkErrorCode(kernel.removeCollectionMember("formula", "a"), SF_ERR_NODE_TYPE_MISMATCH);
+    checkErrorCode(kernel.addCollectionMember("query", "b"), SF_ERR_NODE_TYPE_MISMATCH);
+
+    CHECK(kernel.addCollectionMembers("sum", std::span<NodeId const>{}));
+    CHECK(kernel.removeCollectionMembers("sum", std::span<NodeId const>{}));
+    checkValue(kernel, "outer", 3.0);
+}
+
+TEST_CASE("gated collection members") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("life", 100));
+    CHECK(kernel.createFormulaNode("lowLife", "<life> < 50"));
+    CHECK(kernel.createValueNode("shield", 1));
+    CHECK(kernel.createValueNode("base", 5));
+    CHECK(kernel.createValueNode("lowLifeBonus", 10));
+    CHECK(kernel.createValueNode("lowLifeBonus2", 20));
+    CHECK(kernel.createValueNode("shieldBonus", 40));
+    CHECK(kernel.createCollectionNode("sum", {"base"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createCollectionNode("median", {"base"}, SF_COLLECTION_OP_MEDIAN));
+    CHECK(kernel.createCollectionNode("count", {"base"}, SF_COLLECTION_OP_COUNT));
+    for (auto const* collection : {"sum", "median", "count"}) {
+        CHECK(kernel.addGatedCollectionMember(collection, "lowLifeBonus", "lowLife"));
+        CHECK(kernel.addGatedCollectionMember(collection, "lowLifeBonus2", "lowLife"));
+        CHECK(kernel.addGatedCollectionMember(collection, "shieldBonus", "shield"));
+    }
+    checkValue(kernel, "sum", 45.0);
+    checkValue(kernel, "median", 22.5);
+    checkValue(kernel, "count", 2.0);
+
+    CHECK(kernel.setNodeValue("life", 30));
+    checkValue(kernel, "sum", 75.0);
+    checkValue(kernel, "median", 15.0);
+    checkValue(kernel, "count", 4.0);
+
+    // gated members are followed while closed and while open
+    CHECK(kernel.setNodeValue("shield", 0));
+    CHECK(kernel.setNodeValue("shieldBonus", 1000));
+    CHECK(kernel.setNodeValue("lowLifeBonus", 11));
+    checkValue(kernel, "sum", 36.0);
+    checkValue(kernel, "median", 11.0);
+    checkValue(kernel, "count", 3.0);
+
+    // several flips between two evaluations
+    for (int i = 0; i < 6; ++i) {
+        CHECK(kernel.setNodeValue("shield", i % 2));
+        CHECK(kernel.setNodeValue("life", i % 2 == 0 ? 100 : 30));
+    }
+    checkValue(kernel, "sum", 1036.0);
+    for (int i = 0; i < 100; ++i) {
+        CHECK(kernel.setNodeValue("shield", i % 2));
+        CHECK(kernel.evaluate());
+    }
+    checkValue(kernel, "sum", 1036.0);
+    CHECK(kernel.setNodeValue("life", 100));
+    checkValue(kernel, "sum", 1005.0);
+    checkValue(kernel, "count", 2.0);
+
+    // the gate dependency goes away with its last member
+    CHECK(kernel.removeCollectionMember("sum", "shieldBonus"));
+    checkValue(kernel, "sum", 5.0);
+    CHECK(kernel.addCollectionMember("sum", "shield"));
+    checkValue(kernel, "sum", 6.0);
+
+    // members of a removed gate take part unconditionally
+    CHECK(kernel.removeNode("lowLife"));
+    checkValue(kernel, "sum", 37.0);
+    checkValue(kernel, "count", 4.0);
+
+    // a full replacement drops all gates
+    CHECK(kernel.setNodeDependencies("median", {"shield", "shieldBonus"}));
+    checkValue(kernel, "median", 500.5);
+    CHECK(kernel.setNodeValue("shield", 0));
+    checkValue(kernel, "median", 500.0);
+}
+
+TEST_CASE("NaN gates are closed") {
+    auto const nan = std::numeric_limits<double>::quiet_NaN();
+    StatKernel kernel;
+    CHECK(kernel.createValueNode("gate", nan));
+    CHECK(kernel.createValueNode("base", 5));
+    CHECK(kernel.createValueNode("bonus", 10));
+    CHECK(kernel.createValueNode("extra", 20));
+    CHECK(kernel.createCollectionNode("sum", {"base"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.addGatedCollectionMember("sum", "bonus", "gate"));
+    checkValue(kernel, "sum", 5.0);
+    CHECK(kernel.setNodeValue("gate", 1));
+    checkValue(kernel, "sum", 15.0);
+    CHECK(kernel.setNodeValue("gate", nan));
+    checkValue(kernel, "sum", 5.0);
+
+    auto sheet = kernel.compileSheet();
+    REQUIRE(sheet);
+    statkernel::SheetInstance instance{*sheet};
+    CHECK(instance.setNodeValue("gate", 1));
+    CHECK(instance.setNodeValue("gate", nan));
+    auto const value = instance.getNodeValue("sum");
+    REQUIRE(value);
+    CHECK_EQ(*value, 5.0);
+
+    // forks with membership changes aggregate on their own
+    auto fork = kernel.fork();
+    REQUIRE(fork);
+    CHECK(fork->addCollectionMember("sum", "extra"));
+    CHECK(fork->setNodeValue("gate", 1));
+    CHECK(fork->setNodeValue("gate", nan));
+    auto const forked = fork->getNodeValue("sum");
+    REQUIRE(forked);
+    CHECK_EQ(*forked, 25.0);
+}
+
+TEST_CASE("gated collection member errors") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createValueNode("flag", 1));
+    CHECK(kernel.createCollectionNode("sum", {"a"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createFormulaNode("cyclic", "<sum> > 0"));
+    CHECK(kernel.createQueryCollectionNode("query", "x"));
+
+    checkErrorCode(kernel.addGatedCollectionMember("sum", "b", "a"), SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(kernel.addGatedCollectionMember("sum", "b", "b"), SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(kernel.addGatedCollectionMember("sum", "b", "cyclic"), SF_ERR_DEPENDENCY_LOOP);
+    checkErrorCode(kernel.addGatedCollectionMember("sum", "b", "missing"),
+                   SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    checkErrorCode(kernel.addGatedCollectionMember("query", "b", "flag"),
+                   SF_ERR_NODE_TYPE_MISMATCH);
+    checkValue(kernel, "sum", 1.0);
+
+    CHECK(kernel.addGatedCollectionMember("sum", "b", "flag"));
+    checkValue(kernel, "sum", 3.0);
+    checkErrorCode(kernel.addGatedCollectionMember("sum", "flag", "a"),
+                   SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(kernel.addCollectionMember("sum", "flag"), SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(kernel.removeCollectionMember("sum", "flag"), SF_ERR_DEPENDENCY_DOESNT_EXIST);
+
+    // removing the gated member releases the gate
+    CHECK(kernel.removeNode("b"));
+    CHECK(kernel.addCollectionMember("sum", "flag"));
+    checkValue(kernel, "sum", 2.0);
+}
+
+TEST_CASE("engine collection members") {
+    Engine engine;
+
+    CHECK_EQ(engine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(engine.createValueNode("b", 2), SF_OK);
+    CHECK_EQ(engine.createCollectionNode("sum", SF_COLLECTION_OP_SUM), SF_OK);
+    std::array<std::string, 2> const members{"a", "b"};
+    CHECK_EQ(engine.addCollectionMembers("sum", members), SF_OK);
+    CHECK_EQ(engine.removeCollectionMember("sum", "a"), SF_OK);
+    CHECK_EQ(engine.addCollectionMember("sum", "a"), SF_OK);
+
+    double value{};
+    CHECK_EQ(engine.getNodeValue("sum", value), SF_OK);
+    CHECK_EQ(value, 3);
+
+    CHECK_EQ(engine.createValueNode("c", 4), SF_OK);
+    CHECK_EQ(engine.createValueNode("flag", 0), SF_OK);
+    CHECK_EQ(engine.addGatedCollectionMember("sum", "c", "flag"), SF_OK);
+    CHECK_EQ(engine.getNodeValue("sum", value), SF_OK);
+    CHECK_EQ(value, 3);
+    CHECK_EQ(engine.setNodeValue("flag", 1), SF_OK);
+    CHECK_EQ(engine.getNodeValue("sum", value), SF_OK);
+    CHECK_EQ(value, 7);
+}
+
+TEST_CASE("c api collection members") {
+    auto* engine = sf_create_engine();
+
+    CHECK_EQ(sf_create_value_node(engine, "a", 1), SF_OK);
+    CHECK_EQ(sf_create_value_node(engine, "b", 2), SF_OK);
+    CHECK_EQ(sf_create_collection_node(engine, "sum", SF_COLLECTION_OP_SUM), SF_OK);
+    std::array<char const*, 2> members{"a", "b"};
+    CHECK_EQ(sf_add_collection_members(engine, "sum", members.data(), members.size()), SF_OK);
+    CHECK_EQ(sf_remove_collection_member(engine, "sum", "b"), SF_OK);
+
+    double value{};
+    CHECK_EQ(sf_get_node_value(engine, "sum", &value), SF_OK);
+    CHECK_EQ(value, 1);
+
+    members[1] = nullptr;
+    CHECK_EQ(sf_remove_collection_members(engine, "sum", members.data(), members.size()),
+             SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(sf_add_collection_members(engine, "sum", nullptr, 1),
+             SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(sf_add_collection_member(engine, "sum", "b"), SF_OK);
+    CHECK_EQ(sf_get_node_value(engine, "sum", &value), SF_OK);
+    CHECK_EQ(value, 3);
+
+    sf_destroy_engine(engine);
+}
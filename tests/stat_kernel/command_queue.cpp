@@ -0,0 +1,156 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace statforge;
+using namespace statforge::statkernel;
+
+TEST_CASE("queued commands apply in order with the last write winning") {
+    StatKernel kernel;
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createFormulaNode("f", "<a>"));
+    CHECK(kernel.createCollectionNode("sum", {"a"}));
+    CHECK(kernel.evaluate());
+
+    kernel.queueCommand(SetValueCommand{"a", 5});
+    kernel.queueCommand(SetFormulaCommand{"f", "<a> + <b>"});
+    kernel.queueCommand(SetValueCommand{"a", 7});
+    kernel.queueCommand(AddMemberCommand{"sum", "b"});
+    kernel.queueCommand(SetFormulaCommand{"f", "<a> * <b>"});
+    kernel.queueCommand(RemoveMemberCommand{"sum", "a"});
+
+    // nothing changes before the owner applies the commands
+    checkValue(kernel, "a", 1.0);
+    checkValue(kernel, "sum", 1.0);
+
+    CHECK(kernel.applyCommands());
+    checkValue(kernel, "a", 7.0);
+    checkValue(kernel, "f", 14.0);
+    checkValue(kernel, "sum", 2.0);
+
+    // membership changes build on each other
+    kernel.queueCommand(AddMemberCommand{"sum", "a"});
+    kernel.queueCommand(RemoveMemberCommand{"sum", "a"});
+    kernel.queueCommand(AddMemberCommand{"sum", "a"});
+    CHECK(kernel.applyCommands());
+    checkValue(kernel, "sum", 9.0);
+
+    // nothing queued
+    CHECK(kernel.applyCommands());
+}
+
+TEST_CASE("failing commands don't stop the rest") {
+    StatKernel kernel;
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f", "<a>"));
+
+    kernel.queueCommand(SetValueCommand{"missing", 1});
+    kernel.queueCommand(SetValueCommand{"f", 1});
+    kernel.queueCommand(SetValueCommand{"a", 3});
+    checkErrorCode(kernel.applyCommands(), SF_ERR_NODE_NOT_FOUND);
+    checkValue(kernel, "f", 3.0);
+
+    // only the last formula of "f" is compiled, the broken one before it never fails
+    kernel.queueCommand(SetFormulaCommand{"f", "<a> +"});
+    kernel.queueCommand(SetFormulaCommand{"f", "<a> + 1"});
+    CHECK(kernel.applyCommands());
+    checkValue(kernel, "f", 4.0);
+
+    kernel.queueCommand(SetValueCommand{"a", 10});
+    kernel.reset();
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.applyCommands());
+    checkValue(kernel, "a", 1.0);
+}
+
+TEST_CASE("commands are queued from several threads") {
+    constexpr int threads = 4;
+    constexpr int perThread = 1000;
+
+    StatKernel kernel;
+    CHECK(kernel.createCollectionNode("total", {}));
+    for (int t = 0; t < threads; ++t) {
+        for (int i = 0; i < perThread; ++i) {
+            CHECK(kernel.createValueNode(std::format("v{}_{}", t, i), 0));
+        }
+    }
+
+    std::atomic<int> finished{0};
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t) {
+        producers.emplace_back([&kernel, &finished, t] {
+            for (int i = 0; i < perThread; ++i) {
+                auto const id = std::format("v{}_{}", t, i);
+                kernel.queueCommand(AddMemberCommand{"total", id});
+                kernel.queueCommand(SetValueCommand{id, 2});
+                kernel.queueCommand(SetValueCommand{id, 1});
+            }
+            ++finished;
+        });
+    }
+    // the owner keeps applying while producers are still queueing
+    while (finished.load() < threads) {
+        CHECK(kernel.applyCommands());
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+
+    CHECK(kernel.applyCommands());
+    checkValue(kernel, "total", static_cast<double>(threads * perThread));
+}
+
+TEST_CASE("command apis") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 1), SF_OK);
+    CHECK_EQ(sf_create_value_node(engine, "b", 2), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "f", "<a>"), SF_OK);
+    CHECK_EQ(sf_create_collection_node(engine, "sum", SF_COLLECTION_OP_SUM), SF_OK);
+    CHECK_EQ(sf_add_collection_member(engine, "sum", "a"), SF_OK);
+
+    CHECK_EQ(sf_queue_set_node_value(engine, "a", 4), SF_OK);
+    CHECK_EQ(sf_queue_set_node_formula(engine, "f", "<a> * 2"), SF_OK);
+    CHECK_EQ(sf_queue_add_collection_member(engine, "sum", "b"), SF_OK);
+    CHECK_EQ(sf_queue_remove_collection_member(engine, "sum", "a"), SF_OK);
+    CHECK_EQ(sf_apply_commands(engine), SF_OK);
+
+    double value = 0;
+    CHECK_EQ(sf_get_node_value(engine, "f", &value), SF_OK);
+    CHECK_EQ(value, 8);
+    CHECK_EQ(sf_get_node_value(engine, "sum", &value), SF_OK);
+    CHECK_EQ(value, 2);
+
+    CHECK_EQ(sf_queue_set_node_value(engine, "missing", 1), SF_OK);
+    CHECK_EQ(sf_apply_commands(engine), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(std::string{sf_engine_last_error(engine)},
+             R"(Trying to set value of non-existing node "missing")");
+
+    CHECK_EQ(sf_queue_set_node_value(engine, nullptr, 1), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(std::string{sf_last_error()}, "name is null");
+    CHECK_EQ(sf_queue_set_node_value(nullptr, "a", 1), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(sf_apply_commands(nullptr), SF_ERR_INVALID_ENGINE_HANDLE);
+    sf_destroy_engine(engine);
+
+    Engine cppEngine;
+    CHECK_EQ(cppEngine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(cppEngine.createCollectionNode("sum", SF_COLLECTION_OP_SUM), SF_OK);
+    cppEngine.queueSetNodeValue("a", 3);
+    cppEngine.queueAddCollectionMember("sum", "a");
+    cppEngine.queueSetNodeFormula("a", "1");
+    cppEngine.queueRemoveCollectionMember("sum", "a");
+    cppEngine.queueAddCollectionMember("sum", "a");
+    CHECK_EQ(cppEngine.applyCommands(), SF_ERR_NODE_TYPE_MISMATCH);
+    CHECK_EQ(cppEngine.getNodeValue("sum", value), SF_OK);
+    CHECK_EQ(value, 3);
+}
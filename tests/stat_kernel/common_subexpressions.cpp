@@ -0,0 +1,189 @@
+#include "../test_util.hpp"
+
+#include "error/error.h"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+using namespace statforge;
+
+namespace {
+
+void enableSharing(StatKernel& kernel) {
+    kernel.setCompileOptions({.eliminateCommonSubexpressions = true});
+}
+
+// hidden nodes included
+std::size_t nodeCount(StatKernel& kernel) {
+    auto sheet = kernel.compileSheet();
+    REQUIRE(sheet);
+    return (*sheet)->size();
+}
+
+} // namespace
+
+TEST_CASE("shared subexpressions evaluate like inlined ones") {
+    StatKernel kernel;
+    enableSharing(kernel);
+
+    CHECK(kernel.createValueNode("IncLife", 50));
+    CHECK(kernel.createValueNode("MoreLife", 20));
+    CHECK(kernel.createValueNode("BaseLife", 100));
+    CHECK(kernel.createValueNode("BaseMana", 40));
+
+    CHECK(kernel.createFormulaNode("Life",
+                                   "<BaseLife> * ((1 + <IncLife>/100) * (1 + <MoreLife>/100))"));
+    CHECK(kernel.createFormulaNode("Mana",
+                                   "<BaseMana> * ((1 + <IncLife>/100) * (1 + <MoreLife>/100))"));
+    CHECK(kernel.createFormulaNode("Root", "root(2, <BaseLife>) + root(2, <BaseLife>)"));
+
+    checkValue(kernel, "Life", doctest::Approx(180.0));
+    checkValue(kernel, "Mana", doctest::Approx(72.0));
+    checkValue(kernel, "Root", doctest::Approx(20.0));
+
+    CHECK(kernel.setNodeValue("IncLife", 100));
+    checkValue(kernel, "Life", doctest::Approx(240.0));
+    checkValue(kernel, "Mana", doctest::Approx(96.0));
+}
+
+TEST_CASE("literals only share with exactly equal literals") {
+    StatKernel kernel;
+    enableSharing(kernel);
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f1", "(<a> + 0.1234567) * 2"));
+    CHECK(kernel.createFormulaNode("f2", "(<a> + 0.1234568) * 2"));
+
+    checkValue(kernel, "f1", doctest::Approx(2.2469134));
+    checkValue(kernel, "f2", doctest::Approx(2.2469136));
+}
+
+TEST_CASE("hidden nodes are not visible by name") {
+    StatKernel kernel;
+    enableSharing(kernel);
+
+    CHECK(kernel.createValueNode("a", 4));
+    CHECK(kernel.createFormulaNode("f", "root(2, <a>) * 3"));
+    CHECK(kernel.createFormulaNode("g", "root(2, <a>) * 4"));
+    checkValue(kernel, "f", doctest::Approx(6.0));
+
+    checkErrorCode(kernel.getNodeValue("$0"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.removeNode("$0"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.setNodeFormula("$0", "1"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.createCollectionNode("c", {"$0"}), SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    checkValue(kernel, "f", doctest::Approx(6.0));
+}
+
+TEST_CASE("hidden nodes are released when no formula uses them") {
+    StatKernel kernel;
+    enableSharing(kernel);
+
+    CHECK(kernel.createValueNode("a", 9));
+    CHECK(kernel.createFormulaNode("f1", "root(2, <a>) + 1"));
+    CHECK(kernel.createFormulaNode("f2", "root(2, <a>) + 2"));
+    checkValue(kernel, "f1", doctest::Approx(4.0));
+    checkValue(kernel, "f2", doctest::Approx(5.0));
+
+    SUBCASE("removing all users") {
+        CHECK(kernel.removeNode("f1"));
+        checkErrorCode(kernel.removeNode("a"), SF_ERR_DEPENDENT_FORMULA_NODE);
+        CHECK(kernel.removeNode("f2"));
+        CHECK(kernel.removeNode("a"));
+    }
+
+    SUBCASE("replacing formulas") {
+        CHECK(kernel.setNodeFormula("f1", "5"));
+        CHECK(kernel.setNodeFormula("f2", "root(2, <a>) + 3"));
+        checkValue(kernel, "f2", doctest::Approx(6.0));
+        CHECK(kernel.setNodeFormula("f2", "6"));
+        CHECK(kernel.removeNode("a"));
+        checkValue(kernel, "f2", 6);
+    }
+}
+
+TEST_CASE("subexpressions are only hoisted once a second formula uses them") {
+    StatKernel kernel;
+    enableSharing(kernel);
+
+    CHECK(kernel.createValueNode("a", 50));
+    CHECK(kernel.createValueNode("b", 100));
+    CHECK(kernel.createFormulaNode("f1", "<b> * (1 + <a> / 100)"));
+    CHECK_EQ(nodeCount(kernel), 3);
+
+    // the first formula switches to the hidden node as well
+    CHECK(kernel.createFormulaNode("f2", "<b> + (1 + <a> / 100)"));
+    CHECK_EQ(nodeCount(kernel), 5);
+    checkValue(kernel, "f1", doctest::Approx(150.0));
+    checkValue(kernel, "f2", doctest::Approx(101.5));
+
+    CHECK(kernel.setNodeValue("a", 100));
+    checkValue(kernel, "f1", doctest::Approx(200.0));
+    checkValue(kernel, "f2", doctest::Approx(102.0));
+
+    CHECK(kernel.createFormulaNode("f3", "<b> - (1 + <a> / 100)"));
+    CHECK_EQ(nodeCount(kernel), 6);
+    checkValue(kernel, "f3", doctest::Approx(98.0));
+    CHECK(kernel.removeNode("f1"));
+    CHECK(kernel.removeNode("f2"));
+    CHECK(kernel.removeNode("f3"));
+    CHECK(kernel.removeNode("a"));
+    CHECK_EQ(nodeCount(kernel), 1);
+}
+
+TEST_CASE("nested subexpressions are shared") {
+    StatKernel kernel;
+    enableSharing(kernel);
+
+    CHECK(kernel.createValueNode("IncLife", 50));
+    CHECK(kernel.createValueNode("MoreLife", 20));
+    CHECK(kernel.createValueNode("BaseLife", 100));
+    CHECK(kernel.createValueNode("BaseMana", 40));
+
+    // (<BaseLife> * (1 + <IncLife>/100)) * (1 + <MoreLife>/100), both factors are shared
+    CHECK(kernel.createFormulaNode("Life",
+                                   "<BaseLife> * (1 + <IncLife>/100) * (1 + <MoreLife>/100)"));
+    CHECK(kernel.createFormulaNode("Mana",
+                                   "<BaseMana> * (1 + <IncLife>/100) * (1 + <MoreLife>/100)"));
+    CHECK_EQ(nodeCount(kernel), 8);
+    checkValue(kernel, "Life", doctest::Approx(180.0));
+    checkValue(kernel, "Mana", doctest::Approx(72.0));
+    CHECK(kernel.setNodeValue("IncLife", 100));
+    checkValue(kernel, "Life", doctest::Approx(240.0));
+    checkValue(kernel, "Mana", doctest::Approx(96.0));
+
+    CHECK(kernel.createValueNode("a", 16));
+    CHECK(kernel.createFormulaNode("f1", "(sqrt(<a>) + 1) * 2"));
+    CHECK(kernel.createFormulaNode("f2", "(sqrt(<a>) + 2) * 3"));
+    CHECK_EQ(nodeCount(kernel), 12);
+    checkValue(kernel, "f1", doctest::Approx(10.0));
+    checkValue(kernel, "f2", doctest::Approx(18.0));
+}
+
+TEST_CASE("the largest shared subexpression is hoisted") {
+    StatKernel kernel;
+    enableSharing(kernel);
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 3));
+    CHECK(kernel.createValueNode("c", 3));
+    CHECK(kernel.createFormulaNode("f1", "sqrt(<a> + <b>) * <c> + 1"));
+    CHECK(kernel.createFormulaNode("f2", "sqrt(<a> + <b>) * <c> - 1"));
+    CHECK_EQ(nodeCount(kernel), 6);
+
+    // the inner root is shared out of the hidden node once a third formula uses it
+    CHECK(kernel.createFormulaNode("f3", "sqrt(<a> + <b>) / 2"));
+    CHECK_EQ(nodeCount(kernel), 8);
+    checkValue(kernel, "f1", doctest::Approx(7.0));
+    checkValue(kernel, "f2", doctest::Approx(5.0));
+    checkValue(kernel, "f3", doctest::Approx(1.0));
+
+    CHECK(kernel.setNodeValue("a", 13));
+    checkValue(kernel, "f1", doctest::Approx(13.0));
+    checkValue(kernel, "f2", doctest::Approx(11.0));
+    checkValue(kernel, "f3", doctest::Approx(2.0));
+
+    CHECK(kernel.removeNode("f3"));
+    CHECK(kernel.removeNode("f2"));
+    CHECK(kernel.removeNode("f1"));
+    CHECK_EQ(nodeCount(kernel), 3);
+}
@@ -0,0 +1,90 @@
+#include "../test_util.hpp"
+
+#include "error/error.h"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+using namespace statforge;
+
+TEST_CASE("ternary picks up changes after switching branches") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("IsMinionBuild", 0));
+    CHECK(kernel.createValueNode("PlayerDamage", 10));
+    CHECK(kernel.createValueNode("MinionDamage", 5));
+    CHECK(kernel.createFormulaNode("MinionDamageScaled", "<MinionDamage> * 3"));
+    CHECK(kernel.createFormulaNode("Damage",
+                                   "<IsMinionBuild> ? <MinionDamageScaled> : <PlayerDamage>"));
+
+    checkValue(kernel, "Damage", 10.0);
+
+    // the inactive branch changes, the active one must stay untouched
+    CHECK(kernel.setNodeValue("MinionDamage", 7));
+    checkValue(kernel, "Damage", 10.0);
+
+    CHECK(kernel.setNodeValue("IsMinionBuild", 1));
+    checkValue(kernel, "Damage", 21.0);
+
+    CHECK(kernel.setNodeValue("PlayerDamage", 100));
+    CHECK(kernel.setNodeValue("MinionDamage", 2));
+    checkValue(kernel, "Damage", 6.0);
+
+    CHECK(kernel.setNodeValue("IsMinionBuild", 0));
+    checkValue(kernel, "Damage", 100.0);
+}
+
+TEST_CASE("short-circuited operands are read once they decide the result") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("Enabled", 0));
+    CHECK(kernel.createValueNode("Charges", 3));
+    CHECK(kernel.createFormulaNode("HasCharges", "<Charges> > 0"));
+    CHECK(kernel.createFormulaNode("Active", "<Enabled> && <HasCharges>"));
+    CHECK(kernel.createFormulaNode("Bonus", "<Active> ? 50 : 0"));
+
+    checkValue(kernel, "Bonus", 0.0);
+
+    CHECK(kernel.setNodeValue("Charges", 0));
+    CHECK(kernel.setNodeValue("Enabled", 1));
+    CHECK(kernel.evaluate());
+    checkValue(kernel, "Bonus", 0.0);
+
+    CHECK(kernel.setNodeValue("Charges", 2));
+    CHECK(kernel.evaluate());
+    checkValue(kernel, "Bonus", 50.0);
+    checkValue(kernel, "HasCharges", 1.0);
+}
+
+TEST_CASE("unread dependencies still count for cycle checks and removal") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("Flag", 0));
+    CHECK(kernel.createValueNode("Other", 1));
+    CHECK(kernel.createFormulaNode("Inner", "<Other> + 1"));
+    CHECK(kernel.createFormulaNode("Outer", "<Flag> ? <Inner> : 0"));
+    checkValue(kernel, "Outer", 0.0);
+
+    checkErrorCode(kernel.setNodeFormula("Inner", "<Outer> + 1"), SF_ERR_DEPENDENCY_LOOP);
+    checkErrorCode(kernel.removeNode("Inner"), SF_ERR_DEPENDENT_FORMULA_NODE);
+}
+
+TEST_CASE("shared subexpressions inside branches are only evaluated when taken") {
+    StatKernel kernel;
+    kernel.setCompileOptions({.eliminateCommonSubexpressions = true});
+
+    CHECK(kernel.createValueNode("Flag", 1));
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createFormulaNode("f1", "<Flag> ? (<a> + 1) * 2 : 0"));
+    CHECK(kernel.createFormulaNode("f2", "<Flag> ? 0 : (<a> + 1) * 2"));
+    checkValue(kernel, "f1", 6.0);
+    checkValue(kernel, "f2", 0.0);
+
+    CHECK(kernel.setNodeValue("a", 4));
+    checkValue(kernel, "f1", 10.0);
+
+    CHECK(kernel.setNodeValue("Flag", 0));
+    CHECK(kernel.setNodeValue("a", 5));
+    checkValue(kernel, "f1", 0.0);
+    checkValue(kernel, "f2", 12.0);
+}
@@ -0,0 +1,98 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <atomic>
+#include <format>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace statforge;
+
+TEST_CASE("engine groups evaluate dirty engines") {
+    constexpr std::size_t count = 64;
+
+    std::vector<SF_Engine*> engines;
+    std::vector<const double*> views;
+    auto* group = sf_create_engine_group();
+    for (std::size_t i = 0; i < count; ++i) {
+        auto* engine = sf_create_engine();
+        CHECK_EQ(sf_create_value_node(engine, "a", static_cast<double>(i)), SF_OK);
+        CHECK_EQ(sf_create_formula_node(engine, "f", "<a> * 2"), SF_OK);
+        const double* view = nullptr;
+        CHECK_EQ(sf_get_node_value_view(engine, "f", &view), SF_OK);
+        CHECK_EQ(sf_group_add_engine(group, engine), SF_OK);
+        engines.push_back(engine);
+        views.push_back(view);
+    }
+    // added twice is still evaluated once
+    CHECK_EQ(sf_group_add_engine(group, engines[0]), SF_OK);
+
+    for (std::size_t threads : {4, 1, 0, 200}) {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i % 3 == 0) {
+                CHECK_EQ(sf_set_node_value(engines[i], "a", static_cast<double>(i + threads)),
+                         SF_OK);
+            }
+        }
+        CHECK_EQ(sf_group_evaluate(group, threads), SF_OK);
+        for (std::size_t i = 0; i < count; ++i) {
+            CHECK(sf_get_clean_epoch(engines[i]) % 2 == 0);
+            auto const a = i % 3 == 0 ? i + threads : i;
+            CHECK_EQ(*views[i], static_cast<double>(a * 2));
+        }
+    }
+
+    // removed engines are left alone
+    CHECK_EQ(sf_group_remove_engine(group, engines[1]), SF_OK);
+    CHECK_EQ(sf_group_remove_engine(group, engines[1]), SF_OK);
+    CHECK_EQ(sf_set_node_value(engines[1], "a", 100), SF_OK);
+    CHECK_EQ(sf_group_evaluate(group, 4), SF_OK);
+    CHECK(sf_get_clean_epoch(engines[1]) % 2 == 1);
+
+    CHECK_EQ(sf_group_evaluate(nullptr, 4), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(std::string{sf_last_error()}, "group is null");
+    CHECK_EQ(sf_group_add_engine(group, nullptr), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(sf_group_remove_engine(nullptr, engines[0]), SF_ERR_INVALID_ENGINE_HANDLE);
+
+    sf_destroy_engine_group(group);
+    for (auto* engine : engines) {
+        sf_destroy_engine(engine);
+    }
+}
+
+TEST_CASE("engine groups keep evaluating impure engines") {
+    std::array<Engine, 8> engines;
+    std::atomic<int> ticks{0};
+    EngineGroup group;
+    for (auto& engine : engines) {
+        CHECK_EQ(engine.registerFunction(
+                     "tick",
+                     [&ticks](std::span<double const>) { return ++ticks; },
+                     0,
+                     0,
+                     false),
+                 SF_OK);
+        CHECK_EQ(engine.createFormulaNode("t", "tick()"), SF_OK);
+        group.add(engine);
+    }
+
+    group.evaluate(3);
+    CHECK_EQ(ticks.load(), 8);
+    group.evaluate(3);
+    CHECK_EQ(ticks.load(), 16);
+
+    group.remove(engines[0]);
+    group.evaluate();
+    CHECK_EQ(ticks.load(), 23);
+
+    // moved groups keep their engines
+    auto moved = std::move(group);
+    moved.evaluate(2);
+    CHECK_EQ(ticks.load(), 30);
+}
@@ -0,0 +1,93 @@
+#include "api/c.h"
+#include "api/cpp.hpp"
+
+#include <doctest/doctest.h>
+
+#include <format>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using namespace statforge;
+
+TEST_CASE("errors are kept per engine") {
+    auto* first = sf_create_engine();
+    auto* second = sf_create_engine();
+
+    CHECK_EQ(sf_set_node_value(first, "a", 1), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(sf_set_node_value(second, "b", 1), SF_ERR_NODE_NOT_FOUND);
+    CHECK(std::string_view{sf_engine_last_error(first)}.find(R"("a")") != std::string_view::npos);
+    CHECK(std::string_view{sf_engine_last_error(second)}.find(R"("b")") != std::string_view::npos);
+
+    // reading consumes the error
+    CHECK_EQ(std::string_view{sf_engine_last_error(first)}, "");
+
+    // argument errors of a valid engine are reported to it
+    CHECK_EQ(sf_create_value_node(first, nullptr, 1), SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(std::string_view{sf_engine_last_error(first)}, "name is null");
+    CHECK_EQ(std::string_view{sf_engine_last_error(second)}, "");
+
+    // calls without an engine report to the calling thread
+    CHECK_EQ(sf_create_value_node(nullptr, "a", 1), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(std::string_view{sf_engine_last_error(nullptr)}, "engine is null");
+
+    sf_destroy_engine(first);
+    sf_destroy_engine(second);
+}
+
+TEST_CASE("engines on different threads don't share errors") {
+    auto const work = [](std::string const& prefix, bool& consistent) {
+        Engine engine;
+        for (int i = 0; i < 1000; ++i) {
+            auto const name = std::format("{}{}", prefix, i);
+            if (engine.setNodeValue(name, 1) != SF_ERR_NODE_NOT_FOUND ||
+                engine.getLastError().find(std::format(R"("{}")", name)) == std::string::npos) {
+                consistent = false;
+            }
+        }
+    };
+
+    bool firstConsistent = true;
+    bool secondConsistent = true;
+    std::thread first(work, "first", std::ref(firstConsistent));
+    std::thread second(work, "second", std::ref(secondConsistent));
+    first.join();
+    second.join();
+    CHECK(firstConsistent);
+    CHECK(secondConsistent);
+}
+
+TEST_CASE("engine-less errors are kept per thread") {
+    sf_set_error("main");
+    std::thread other([] { sf_set_error("other"); });
+    other.join();
+    CHECK_EQ(std::string_view{sf_last_error()}, "main");
+}
+
+TEST_CASE("handles keep their own errors") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 1), SF_OK);
+    auto* fork = sf_fork_engine(engine);
+    REQUIRE(fork != nullptr);
+    auto* group = sf_create_engine_group();
+
+    sf_set_error("main");
+    double value = 0;
+    CHECK_EQ(sf_get_fork_value(fork, "missing", &value), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(sf_group_add_engine(group, nullptr), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(std::string_view{sf_last_error()}, "main");
+    CHECK_EQ(std::string_view{sf_engine_last_error(engine)}, "");
+    CHECK_EQ(std::string_view{sf_group_last_error(group)}, "engine is null");
+    CHECK_EQ(std::string_view{sf_fork_last_error(fork)},
+             R"(Trying to get value of non-existing node "missing")");
+    // reading consumes the error
+    CHECK_EQ(std::string_view{sf_fork_last_error(fork)}, "");
+
+    CHECK_EQ(sf_set_fork_value(nullptr, "a", 1), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(std::string_view{sf_fork_last_error(nullptr)}, "fork is null");
+
+    sf_destroy_engine_group(group);
+    sf_destroy_fork(fork);
+    sf_destroy_engine(engine);
+}
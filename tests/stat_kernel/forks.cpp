@@ -0,0 +1,208 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+#include "stat_kernel/sheet.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <format>
+#include <span>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace statforge;
+
+namespace {
+
+void buildPlanner(StatKernel& kernel) {
+    CHECK(kernel.createValueNode("base", 10));
+    CHECK(kernel.createValueNode("item", 0));
+    CHECK(kernel.createValueNode("unrelated", 1));
+    CHECK(kernel.createValueNode("equipped", 0));
+    CHECK(kernel.createCollectionNode("flat", {"base"}));
+    CHECK(kernel.addGatedCollectionMember("flat", "item", "equipped"));
+    CHECK(kernel.createModifierNode("damage", {.base = {"flat"}, .increased = {"unrelated"}}));
+    CHECK(kernel.createFormulaNode("other", "<unrelated> * 3"));
+}
+
+} // namespace
+
+TEST_CASE("forks diverge from their parent") {
+    StatKernel kernel;
+    buildPlanner(kernel);
+
+    auto fork = kernel.fork();
+    REQUIRE(fork);
+    CHECK_EQ(fork->diverged(), 0);
+    auto const damage = fork->getNodeValue("damage");
+    REQUIRE(damage);
+    CHECK_EQ(*damage, 20);
+
+    CHECK(fork->setNodeValue("item", 5));
+    CHECK(fork->setNodeValue("equipped", 1));
+    auto const equipped = fork->getNodeValue("damage");
+    REQUIRE(equipped);
+    CHECK_EQ(*equipped, 30);
+    // only the changed values and what depends on them are stored
+    CHECK_EQ(fork->diverged(), 4);
+    checkValue(kernel, "damage", 20.0);
+
+    // changing back stops the divergence
+    CHECK(fork->setNodeValue("equipped", 0));
+    fork->evaluate();
+    CHECK_EQ(fork->diverged(), 1);
+    auto const unequipped = fork->getNodeValue("damage");
+    REQUIRE(unequipped);
+    CHECK_EQ(*unequipped, 20);
+
+    // later changes to the kernel don't reach existing forks
+    CHECK(kernel.setNodeValue("base", 20));
+    checkValue(kernel, "damage", 40.0);
+    auto const unchanged = fork->getNodeValue("damage");
+    REQUIRE(unchanged);
+    CHECK_EQ(*unchanged, 20);
+
+    checkErrorCode(fork->getNodeValue("missing"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(fork->setNodeValue("damage", 1), SF_ERR_NODE_TYPE_MISMATCH);
+}
+
+TEST_CASE("forks share a sheet until the kernel changes") {
+    StatKernel kernel;
+    buildPlanner(kernel);
+
+    auto first = kernel.fork();
+    auto second = kernel.fork();
+    REQUIRE(first);
+    REQUIRE(second);
+    CHECK_EQ(&first->sheet(), &second->sheet());
+
+    CHECK(kernel.setNodeValue("base", 20));
+    auto changedValue = kernel.fork();
+    REQUIRE(changedValue);
+    CHECK_NE(&changedValue->sheet(), &first->sheet());
+    auto const damage = changedValue->getNodeValue("damage");
+    REQUIRE(damage);
+    CHECK_EQ(*damage, 40);
+
+    CHECK(kernel.setNodeFormula("other", "<unrelated> * 4"));
+    auto changedFormula = kernel.fork();
+    REQUIRE(changedFormula);
+    auto const other = changedFormula->getNodeValue("other");
+    REQUIRE(other);
+    CHECK_EQ(*other, 4);
+
+    CHECK(kernel.createValueNode("extra", 1));
+    auto changedStructure = kernel.fork();
+    REQUIRE(changedStructure);
+    CHECK(changedStructure->getNodeValue("extra"));
+    CHECK_FALSE(changedFormula->getNodeValue("extra"));
+}
+
+TEST_CASE("impure formulas don't recompile the sheet of forks") {
+    StatKernel kernel;
+    double roll = 1;
+    CHECK(kernel.registerFunction(
+        "roll", [&roll](std::span<double const>) { return roll; }, 0, 0, false));
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createFormulaNode("f", "<a> * roll()"));
+
+    auto first = kernel.fork();
+    roll = 3;
+    auto second = kernel.fork();
+    REQUIRE(first);
+    REQUIRE(second);
+    CHECK_EQ(&first->sheet(), &second->sheet());
+
+    // the fork reevaluates the impure formula itself
+    second->evaluate();
+    auto const f = second->getNodeValue("f");
+    REQUIRE(f);
+    CHECK_EQ(*f, 6);
+
+    CHECK(kernel.setNodeValue("a", 3));
+    auto changed = kernel.fork();
+    REQUIRE(changed);
+    CHECK_NE(&changed->sheet(), &first->sheet());
+}
+
+TEST_CASE("candidates are scored on copies of one fork in parallel") {
+    constexpr int candidates = 64;
+
+    StatKernel kernel;
+    buildPlanner(kernel);
+    auto base = kernel.fork();
+    REQUIRE(base);
+    CHECK(base->setNodeValue("equipped", 1));
+
+    std::vector<double> scores(candidates);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&base, &scores, t] {
+            for (int i = t; i < candidates; i += 4) {
+                statkernel::SheetFork candidate{*base};
+                std::ignore = candidate.setNodeValue("item", i);
+                auto const damage = candidate.getNodeValue("damage");
+                scores[i] = damage ? *damage : -1;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 0; i < candidates; ++i) {
+        CHECK_EQ(scores[i], (10 + i) * 2);
+    }
+}
+
+TEST_CASE("fork apis") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 2), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "f", "<a> * 3"), SF_OK);
+
+    auto* fork = sf_fork_engine(engine);
+    REQUIRE(fork != nullptr);
+    CHECK_EQ(sf_set_fork_value(fork, "a", 4), SF_OK);
+    auto* copy = sf_copy_fork(fork);
+    REQUIRE(copy != nullptr);
+    CHECK_EQ(sf_set_fork_value(copy, "a", 5), SF_OK);
+    sf_evaluate_fork(copy);
+
+    double value = 0;
+    CHECK_EQ(sf_get_fork_value(fork, "f", &value), SF_OK);
+    CHECK_EQ(value, 12);
+    CHECK_EQ(sf_get_fork_value(copy, "f", &value), SF_OK);
+    CHECK_EQ(value, 15);
+    CHECK_EQ(sf_get_node_value(engine, "f", &value), SF_OK);
+    CHECK_EQ(value, 6);
+
+    CHECK_EQ(sf_get_fork_value(fork, "missing", &value), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(std::string{sf_fork_last_error(fork)},
+             R"(Trying to get value of non-existing node "missing")");
+    CHECK_EQ(std::string{sf_fork_last_error(copy)}, "");
+    CHECK_EQ(sf_set_fork_value(nullptr, "a", 1), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(sf_copy_fork(nullptr), nullptr);
+    CHECK_EQ(sf_fork_engine(nullptr), nullptr);
+    sf_destroy_fork(copy);
+    sf_destroy_fork(fork);
+    sf_destroy_engine(engine);
+
+    Engine cppEngine;
+    CHECK_EQ(cppEngine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(cppEngine.createFormulaNode("f", "<a> + 1"), SF_OK);
+    auto cppFork = cppEngine.fork();
+    REQUIRE(cppFork);
+    CHECK_EQ(cppFork->setNodeValue("a", 2), SF_OK);
+    auto child = cppFork->fork();
+    CHECK_EQ(child.setNodeValue("a", 3), SF_OK);
+    CHECK_EQ(child.getNodeValue("f", value), SF_OK);
+    CHECK_EQ(value, 4);
+    CHECK_EQ(cppFork->getNodeValue("f", value), SF_OK);
+    CHECK_EQ(value, 3);
+    CHECK_EQ(cppFork->setNodeValue("f", 1), SF_ERR_NODE_TYPE_MISMATCH);
+    CHECK_EQ(cppFork->getLastError(), R"(Trying to change value of non value node "f")");
+}
@@ -0,0 +1,141 @@
+#include "../test_util.hpp"
+
+#include "error/error.h"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <cmath>
+#include <span>
+
+using namespace statforge;
+
+TEST_CASE("formulas differing only in whitespace share a compiled program") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createValueNode("b", 3));
+    CHECK(kernel.createFormulaNode("f1", "<a> * <b> + 1"));
+    CHECK(kernel.createFormulaNode("f2", "<a>*<b>+1"));
+    CHECK(kernel.createFormulaNode("f3", "  <a> *\n<b>   + 1 "));
+
+    auto stats = kernel.formulaCacheStats();
+    CHECK_EQ(stats.misses, 1);
+    CHECK_EQ(stats.hits, 2);
+    CHECK_EQ(stats.size, 1);
+
+    checkValue(kernel, "f1", 7.0);
+    checkValue(kernel, "f2", 7.0);
+    checkValue(kernel, "f3", 7.0);
+
+    CHECK(kernel.setNodeValue("b", 4));
+    checkValue(kernel, "f2", 9.0);
+}
+
+TEST_CASE("whitespace separating tokens is part of the cache key") {
+    StatKernel kernel;
+
+    CHECK(kernel.createFormulaNode("f1", "12"));
+    checkErrorCode(kernel.createFormulaNode("f2", "1 2"), SF_ERR_INVALID_DSL);
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f3", "<a> <= 2"));
+    checkErrorCode(kernel.createFormulaNode("f4", "<a> < = 2"), SF_ERR_INVALID_DSL);
+    checkValue(kernel, "f1", 12.0);
+    checkValue(kernel, "f3", 1.0);
+}
+
+TEST_CASE("toggling a formula reuses cached programs") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createFormulaNode("f", "<a> + 1"));
+    for (int i = 0; i < 5; ++i) {
+        CHECK(kernel.setNodeFormula("f", "<a> * 10"));
+        checkValue(kernel, "f", 20.0);
+        CHECK(kernel.setNodeFormula("f", "<a> + 1"));
+        checkValue(kernel, "f", 3.0);
+    }
+
+    auto const stats = kernel.formulaCacheStats();
+    CHECK_EQ(stats.misses, 2);
+    CHECK_EQ(stats.hits, 9);
+}
+
+TEST_CASE("cached programs are rewired per node") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f", "<a> + 1"));
+    CHECK(kernel.createFormulaNode("g", "<f> + 1"));
+    CHECK(kernel.createFormulaNode("h", "<g> + 1"));
+    // a cache hit must still be checked for cycles
+    checkErrorCode(kernel.setNodeFormula("f", "<g> + 1"), SF_ERR_DEPENDENCY_LOOP);
+    CHECK_EQ(kernel.formulaCacheStats().hits, 1);
+    checkValue(kernel, "f", 2.0);
+    checkValue(kernel, "g", 3.0);
+}
+
+TEST_CASE("failed compilations are not cached") {
+    StatKernel kernel;
+
+    checkErrorCode(kernel.createFormulaNode("f", "frac(1.5)"), SF_ERR_INVALID_DSL);
+    CHECK(kernel.registerFunction(
+        "frac", [](std::span<double const> args) { return args[0] - std::floor(args[0]); }, 1, 1));
+    CHECK(kernel.createFormulaNode("f", "frac(1.5)"));
+    checkValue(kernel, "f", 0.5);
+    CHECK_EQ(kernel.formulaCacheStats().size, 1);
+}
+
+TEST_CASE("cache capacity evicts least recently used programs") {
+    StatKernel kernel;
+    kernel.setFormulaCacheCapacity(2);
+
+    CHECK(kernel.createFormulaNode("f1", "1"));
+    CHECK(kernel.createFormulaNode("f2", "2"));
+    CHECK(kernel.createFormulaNode("f3", "1"));
+    CHECK(kernel.createFormulaNode("f4", "3"));
+    CHECK_EQ(kernel.formulaCacheStats().size, 2);
+
+    // "2" was evicted, "1" was used more recently
+    CHECK(kernel.createFormulaNode("f5", "1"));
+    CHECK(kernel.createFormulaNode("f6", "2"));
+    auto stats = kernel.formulaCacheStats();
+    CHECK_EQ(stats.hits, 2);
+    CHECK_EQ(stats.misses, 4);
+
+    kernel.setFormulaCacheCapacity(0);
+    CHECK_EQ(kernel.formulaCacheStats().size, 0);
+    CHECK(kernel.createFormulaNode("f7", "1"));
+    CHECK_EQ(kernel.formulaCacheStats().size, 0);
+    checkValue(kernel, "f7", 1.0);
+}
+
+TEST_CASE("changing compile options drops cached programs") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createFormulaNode("f1", "<a> * <a> + <a> * <a>"));
+    kernel.setCompileOptions({.eliminateCommonSubexpressions = true});
+    CHECK_EQ(kernel.formulaCacheStats().size, 0);
+
+    // with subexpression sharing the cached program is copied before it is rewritten
+    CHECK(kernel.createFormulaNode("f2", "<a> * <a> + <a> * <a>"));
+    CHECK(kernel.createFormulaNode("f3", "<a>*<a> + <a>*<a>"));
+    CHECK_EQ(kernel.formulaCacheStats().hits, 1);
+    checkValue(kernel, "f1", 8.0);
+    checkValue(kernel, "f2", 8.0);
+    checkValue(kernel, "f3", 8.0);
+
+    CHECK(kernel.setNodeValue("a", 3));
+    checkValue(kernel, "f3", 18.0);
+}
+
+TEST_CASE("formula cache survives reset") {
+    StatKernel kernel;
+
+    CHECK(kernel.createFormulaNode("f", "1 + 2"));
+    kernel.reset();
+    CHECK(kernel.createFormulaNode("f", "1 + 2"));
+    checkValue(kernel, "f", 3.0);
+    CHECK_EQ(kernel.formulaCacheStats().hits, 1);
+}
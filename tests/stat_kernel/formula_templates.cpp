@@ -0,0 +1,104 @@
+#include "../test_util.hpp"
+
+#include "error/error.h"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+using namespace statforge;
+
+TEST_CASE("template instances evaluate with their own bindings") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("BaseLife", 100));
+    CHECK(kernel.createValueNode("IncLife", 50));
+    CHECK(kernel.createValueNode("BaseMana", 40));
+    CHECK(kernel.createValueNode("IncMana", 25));
+    CHECK(kernel.createFormulaTemplate("increased", "<$0> * (1 + <$1>/100)"));
+
+    CHECK(kernel.createTemplateNode("Life", "increased", {"BaseLife", "IncLife"}));
+    CHECK(kernel.createTemplateNode("Mana", "increased", {"BaseMana", "IncMana"}));
+    checkValue(kernel, "Life", doctest::Approx(150.0));
+    checkValue(kernel, "Mana", doctest::Approx(50.0));
+
+    CHECK(kernel.setNodeValue("IncLife", 100));
+    checkValue(kernel, "Life", doctest::Approx(200.0));
+    checkValue(kernel, "Mana", doctest::Approx(50.0));
+}
+
+TEST_CASE("templates may mix placeholders and fixed references") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("Global", 2));
+    CHECK(kernel.createValueNode("a", 3));
+    CHECK(kernel.createFormulaTemplate("scaled", "<$0> * <Global> + <$1>"));
+
+    // the same node may be bound to several placeholders
+    CHECK(kernel.createTemplateNode("f", "scaled", {"a", "a"}));
+    checkValue(kernel, "f", 9.0);
+
+    CHECK(kernel.setNodeValue("Global", 3));
+    checkValue(kernel, "f", 12.0);
+
+    // fixed references are resolved per instance, so they can't be removed either
+    checkErrorCode(kernel.removeNode("Global"), SF_ERR_DEPENDENT_FORMULA_NODE);
+}
+
+TEST_CASE("conditional templates track reads per instance") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("on", 1));
+    CHECK(kernel.createValueNode("off", 0));
+    CHECK(kernel.createValueNode("x", 5));
+    CHECK(kernel.createValueNode("y", 7));
+    CHECK(kernel.createFormulaTemplate("pick", "<$0> ? <$1> : <$2>"));
+
+    CHECK(kernel.createTemplateNode("f1", "pick", {"on", "x", "y"}));
+    CHECK(kernel.createTemplateNode("f2", "pick", {"off", "x", "y"}));
+    checkValue(kernel, "f1", 5.0);
+    checkValue(kernel, "f2", 7.0);
+
+    CHECK(kernel.setNodeValue("x", 6));
+    CHECK(kernel.setNodeValue("y", 8));
+    checkValue(kernel, "f1", 6.0);
+    checkValue(kernel, "f2", 8.0);
+}
+
+TEST_CASE("template errors") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaTemplate("t", "<$0> + <$1>"));
+
+    checkErrorCode(kernel.createFormulaTemplate("t", "<$0>"), SF_ERR_TEMPLATE_ALREADY_EXISTS);
+    checkErrorCode(kernel.createFormulaTemplate("broken", "<$0> +"), SF_ERR_INVALID_DSL);
+    // placeholders have to be numbered without gaps
+    checkErrorCode(kernel.createFormulaTemplate("gap", "<$0> + <$2>"), SF_ERR_INVALID_DSL);
+    checkErrorCode(kernel.createFormulaTemplate("gap", "<$1>"), SF_ERR_INVALID_DSL);
+    CHECK(kernel.createFormulaTemplate("reordered", "<$1> + <$0> * <$1>"));
+    // indices past the range of size_t used to wrap around to another placeholder
+    checkErrorCode(kernel.createFormulaTemplate("overflow", "<$0> + <$18446744073709551616>"),
+                   SF_ERR_INVALID_DSL);
+    checkErrorCode(kernel.createTemplateNode("f", "missing", {"a"}), SF_ERR_TEMPLATE_NOT_FOUND);
+    checkErrorCode(kernel.createTemplateNode("f", "t", {"a"}), SF_ERR_TEMPLATE_BINDING_MISMATCH);
+    checkErrorCode(kernel.createTemplateNode("f", "t", {"a", "b"}),
+                   SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    checkErrorCode(kernel.createTemplateNode("f", "t", {"a", "f"}), SF_ERR_SELF_REFERENCE);
+    checkErrorCode(kernel.createFormulaNode("g", "<$0> + 1"), SF_ERR_INVALID_DSL);
+
+    // failed instantiations leave nothing behind
+    CHECK(kernel.createTemplateNode("f", "t", {"a", "a"}));
+    checkValue(kernel, "f", 2.0);
+}
+
+TEST_CASE("template instances can get their own formula") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 4));
+    CHECK(kernel.createFormulaTemplate("double", "<$0> * 2"));
+    CHECK(kernel.createTemplateNode("f", "double", {"a"}));
+    checkValue(kernel, "f", 8.0);
+
+    CHECK(kernel.setNodeFormula("f", "<a> + 1"));
+    checkValue(kernel, "f", 5.0);
+}
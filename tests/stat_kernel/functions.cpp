@@ -0,0 +1,115 @@
+#include "../test_util.hpp"
+
+#include "dsl/functions.hpp"
+#include "error/error.h"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <span>
+
+using namespace statforge;
+
+namespace {
+
+double sum(std::span<double const> args) {
+    double value{0};
+    for (double const arg : args) {
+        value += arg;
+    }
+    return value;
+}
+
+} // namespace
+
+TEST_CASE("host functions are callable from formulas") {
+    StatKernel kernel;
+    CHECK(kernel.registerFunction("total", sum, 1, dsl::variadic));
+    CHECK(kernel.registerFunction(
+        "scale", [](std::span<double const> args) { return args[0] * args[1]; }, 2, 2));
+
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createValueNode("b", 3));
+    CHECK(kernel.createFormulaNode("f", "scale(total(<a>, <b>, 1, 2, 3, 4, 5, 6, 7), 2)"));
+    checkValue(kernel, "f", 66.0);
+
+    CHECK(kernel.setNodeValue("b", 4));
+    checkValue(kernel, "f", 68.0);
+}
+
+TEST_CASE("invalid registrations are rejected") {
+    StatKernel kernel;
+    CHECK(kernel.registerFunction("total", sum, 0, dsl::variadic));
+
+    checkErrorCode(kernel.registerFunction("total", sum, 0, 1), SF_ERR_FUNCTION_ALREADY_EXISTS);
+    checkErrorCode(kernel.registerFunction("root", sum, 0, 1), SF_ERR_FUNCTION_ALREADY_EXISTS);
+    checkErrorCode(kernel.registerFunction("1total", sum, 0, 1), SF_ERR_INVALID_FUNCTION);
+    checkErrorCode(kernel.registerFunction("true", sum, 0, 1), SF_ERR_INVALID_FUNCTION);
+    checkErrorCode(kernel.registerFunction("total2", sum, 2, 1), SF_ERR_INVALID_FUNCTION);
+    checkErrorCode(kernel.registerFunction("total2", nullptr, 0, 1), SF_ERR_INVALID_FUNCTION);
+}
+
+TEST_CASE("calls are checked against the registry") {
+    StatKernel kernel;
+    CHECK(kernel.registerFunction(
+        "twice", [](std::span<double const> args) { return 2 * args[0]; }, 1, 1));
+    CHECK(kernel.createValueNode("a", 1));
+
+    checkErrorCode(kernel.createFormulaNode("f1", "thrice(<a>)"), SF_ERR_INVALID_DSL);
+    checkErrorCode(kernel.createFormulaNode("f2", "twice(<a>, 2)"), SF_ERR_INVALID_DSL);
+    checkErrorCode(kernel.createFormulaNode("f3", "twice()"), SF_ERR_INVALID_DSL);
+    CHECK(kernel.createFormulaNode("f4", "twice(<a>)"));
+}
+
+TEST_CASE("pure calls on constants are folded at compile time") {
+    StatKernel kernel;
+    int calls{0};
+    CHECK(kernel.registerFunction(
+        "count", [&calls](std::span<double const> args) { return ++calls + args[0]; }, 1, 1));
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f", "count(10) + <a>"));
+    CHECK_EQ(calls, 1);
+
+    checkValue(kernel, "f", 12.0);
+    CHECK(kernel.setNodeValue("a", 2));
+    CHECK(kernel.evaluate());
+    checkValue(kernel, "f", 13.0);
+    CHECK_EQ(calls, 1);
+}
+
+TEST_CASE("impure calls are evaluated on every pass") {
+    StatKernel kernel;
+    double roll{0};
+    CHECK(kernel.registerFunction(
+        "roll", [&roll](std::span<double const>) { return roll; }, 0, 0, false));
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f", "roll() + <a>"));
+    CHECK(kernel.createFormulaNode("g", "<f> * 2"));
+    checkValue(kernel, "g", 2.0);
+
+    roll = 5;
+    checkValue(kernel, "g", 2.0); // cached until the next pass
+    CHECK(kernel.evaluate());
+    checkValue(kernel, "g", 12.0);
+
+    CHECK(kernel.setNodeFormula("f", "<a> + 1"));
+    roll = 7;
+    CHECK(kernel.evaluate());
+    checkValue(kernel, "g", 4.0);
+}
+
+TEST_CASE("impure calls are not shared between formulas") {
+    StatKernel kernel;
+    kernel.setCompileOptions({.eliminateCommonSubexpressions = true});
+    int calls{0};
+    CHECK(kernel.registerFunction(
+        "next", [&calls](std::span<double const> args) { return ++calls * args[0]; }, 1, 1, false));
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f1", "next(<a> + 1) * 2"));
+    CHECK(kernel.createFormulaNode("f2", "next(<a> + 1) * 2"));
+    CHECK(kernel.evaluate());
+    CHECK_EQ(calls, 2);
+}
@@ -0,0 +1,118 @@
+#include "../test_util.hpp"
+
+#include "api/cpp.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+using namespace statforge;
+using statforge::statkernel::ModifierGroups;
+
+TEST_CASE("modifier node combines base, increased and more") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("flat1", 10));
+    CHECK(kernel.createValueNode("flat2", 5));
+    CHECK(kernel.createValueNode("inc1", 0.5));
+    CHECK(kernel.createValueNode("inc2", 0.25));
+    CHECK(kernel.createValueNode("more1", 0.2));
+    CHECK(kernel.createValueNode("more2", 1));
+    CHECK(kernel.createModifierNode("damage",
+                                    {.base = {"flat1", "flat2"},
+                                     .increased = {"inc1", "inc2"},
+                                     .more = {"more1", "more2"}}));
+    checkValue(kernel, "damage", doctest::Approx(15 * 1.75 * 1.2 * 2));
+
+    CHECK(kernel.createModifierNode("empty", {}));
+    checkValue(kernel, "empty", 0.0);
+    CHECK(kernel.createModifierNode("baseOnly", {.base = {"flat1"}, .increased = {}, .more = {}}));
+    checkValue(kernel, "baseOnly", 10.0);
+}
+
+TEST_CASE("modifier node follows member changes") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("flat", 100));
+    CHECK(kernel.createValueNode("strength", 50));
+    CHECK(kernel.createFormulaNode("strengthBonus", "<strength> / 500"));
+    CHECK(kernel.createValueNode("more", 0));
+    CHECK(kernel.createModifierNode(
+        "life", {.base = {"flat"}, .increased = {"strengthBonus"}, .more = {"more"}}));
+    CHECK(kernel.createFormulaNode("doubled", "<life> * 2"));
+    checkValue(kernel, "doubled", doctest::Approx(220.0));
+
+    CHECK(kernel.setNodeValue("strength", 100));
+    checkValue(kernel, "life", doctest::Approx(120.0));
+    CHECK(kernel.setNodeValue("flat", 50));
+    CHECK(kernel.setNodeValue("more", 0.5));
+    checkValue(kernel, "life", doctest::Approx(90.0));
+    checkValue(kernel, "doubled", doctest::Approx(180.0));
+
+    // 100% less zeroes the stat until the modifier is gone again
+    CHECK(kernel.setNodeValue("more", -1));
+    checkValue(kernel, "life", 0.0);
+    CHECK(kernel.setNodeValue("more", 0));
+    checkValue(kernel, "life", doctest::Approx(60.0));
+}
+
+TEST_CASE("modifier node members can change") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("flat", 10));
+    CHECK(kernel.createValueNode("inc", 1));
+    CHECK(kernel.createValueNode("more", 1));
+    CHECK(kernel.createModifierNode(
+        "stat", {.base = {"flat"}, .increased = {"inc"}, .more = {"more"}}));
+    checkValue(kernel, "stat", 40.0);
+
+    CHECK(kernel.removeNode("more"));
+    checkValue(kernel, "stat", 20.0);
+    CHECK(kernel.removeNode("inc"));
+    checkValue(kernel, "stat", 10.0);
+
+    CHECK(kernel.createValueNode("other", 0.5));
+    CHECK(kernel.setModifierNodeGroups("stat",
+                                       {.base = {"flat"}, .increased = {}, .more = {"other"}}));
+    checkValue(kernel, "stat", 15.0);
+    CHECK(kernel.setNodeValue("other", 1.5));
+    checkValue(kernel, "stat", 25.0);
+}
+
+TEST_CASE("modifier node errors") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createCollectionNode("sum", {"a"}));
+    CHECK(kernel.createModifierNode("stat", {.base = {"a"}, .increased = {}, .more = {}}));
+
+    checkErrorCode(
+        kernel.createModifierNode("twice", {.base = {"a"}, .increased = {"a"}, .more = {}}),
+        SF_ERR_DUPLICATE_DEPENDENCY);
+    checkErrorCode(
+        kernel.createModifierNode("missing", {.base = {"b"}, .increased = {}, .more = {}}),
+        SF_ERR_DEPENDENCY_DOESNT_EXIST);
+    checkErrorCode(kernel.getNodeValue("twice"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.setNodeDependencies("stat", {"a"}), SF_ERR_NODE_TYPE_MISMATCH);
+    checkErrorCode(kernel.setModifierNodeGroups("sum", {}), SF_ERR_NODE_TYPE_MISMATCH);
+    checkErrorCode(
+        kernel.setModifierNodeGroups("stat", {.base = {"stat"}, .increased = {}, .more = {}}),
+        SF_ERR_SELF_REFERENCE);
+    checkValue(kernel, "stat", 1.0);
+}
+
+TEST_CASE("engine modifier node") {
+    Engine engine;
+
+    CHECK_EQ(engine.createValueNode("flat", 10), SF_OK);
+    CHECK_EQ(engine.createValueNode("inc1", 0.5), SF_OK);
+    CHECK_EQ(engine.createValueNode("inc2", 0.5), SF_OK);
+    CHECK_EQ(engine.createModifierNode("stat", "flat", "inc1, inc2", ""), SF_OK);
+
+    double value{};
+    CHECK_EQ(engine.getNodeValue("stat", value), SF_OK);
+    CHECK_EQ(value, 20);
+
+    CHECK_EQ(engine.setModifierNodeGroups("stat", "flat", "", "inc1 inc2"), SF_OK);
+    CHECK_EQ(engine.getNodeValue("stat", value), SF_OK);
+    CHECK_EQ(value, 22.5);
+}
@@ -0,0 +1,270 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+#include "stat_kernel/sheet.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <string>
+#include <vector>
+
+using namespace statforge;
+
+namespace {
+
+std::array<NodeId, 11> const visible{
+    "a", "b", "flag", "gate", "product", "sum", "gated", "modified", "shared1", "shared2", "bound"};
+
+void buildSheet(StatKernel& kernel) {
+    kernel.setCompileOptions({.eliminateCommonSubexpressions = true});
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createValueNode("b", 3));
+    CHECK(kernel.createValueNode("flag", 1));
+    CHECK(kernel.createValueNode("gate", 0));
+    CHECK(kernel.createFormulaNode("product", "<flag> ? <a> * <b> : <b> + 1"));
+    CHECK(kernel.createCollectionNode("sum", {"a", "b", "product"}, SF_COLLECTION_OP_SUM));
+    CHECK(kernel.createCollectionNode("gated", {"a"}, SF_COLLECTION_OP_MAX));
+    CHECK(kernel.addGatedCollectionMember("gated", "product", "gate"));
+    CHECK(kernel.createModifierNode("modified",
+                                    {.base = {"sum"}, .increased = {"a"}, .more = {"b"}}));
+    // hoisted into a hidden node
+    CHECK(kernel.createFormulaNode("shared1", "(<a> + <b>) * (<a> + <b>) + 1"));
+    CHECK(kernel.createFormulaNode("shared2", "(<a> + <b>) * (<a> + <b>) + 2"));
+    CHECK(kernel.createFormulaTemplate("scaled", "<$0> * 10 + <$1>"));
+    CHECK(kernel.createTemplateNode("bound", "scaled", {"modified", "gated"}));
+}
+
+void checkMatches(StatKernel& kernel, statkernel::SheetInstance& instance) {
+    for (auto const& id : visible) {
+        auto expected = kernel.getNodeValue(id);
+        auto actual = instance.getNodeValue(id);
+        REQUIRE(expected);
+        REQUIRE(actual);
+        CHECK_EQ(*actual, *expected);
+    }
+}
+
+} // namespace
+
+TEST_CASE("sheet instances follow their own values") {
+    StatKernel kernel;
+    buildSheet(kernel);
+
+    auto sheet = kernel.compileSheet();
+    REQUIRE(sheet);
+    statkernel::SheetInstance first{*sheet};
+    statkernel::SheetInstance second{*sheet};
+    checkMatches(kernel, first);
+
+    std::array<std::array<NodeValue, 4>, 4> const steps{{
+        {5, 7, 1, 1},
+        {5, 7, 0, 1},
+        {-1, 0.5, 0, 0},
+        {4, 4, 1, 1},
+    }};
+    for (auto const& step : steps) {
+        std::array<NodeId, 4> const inputs{"a", "b", "flag", "gate"};
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            CHECK(kernel.setNodeValue(inputs[i], step[i]));
+            CHECK(first.setNodeValue(inputs[i], step[i]));
+        }
+        checkMatches(kernel, first);
+    }
+
+    // untouched by the other instance
+    for (auto const& id : visible) {
+        auto value = second.getNodeValue(id);
+        REQUIRE(value);
+        auto const index = second.sheet().find(id);
+        REQUIRE(index);
+        CHECK_EQ(*value, second.sheet().defaults()[*index]);
+    }
+}
+
+TEST_CASE("sheets are snapshots of the kernel") {
+    StatKernel kernel;
+    buildSheet(kernel);
+    CHECK(kernel.setNodeValue("a", 4));
+
+    auto sheet = kernel.compileSheet();
+    REQUIRE(sheet);
+    statkernel::SheetInstance instance{*sheet};
+    auto const product = instance.getNodeValue("product");
+    REQUIRE(product);
+    CHECK_EQ(*product, 12);
+
+    CHECK(kernel.setNodeFormula("product", "<a> - <b>"));
+    CHECK(kernel.removeNode("bound"));
+    checkValue(kernel, "product", 1.0);
+    auto const unchanged = instance.getNodeValue("product");
+    REQUIRE(unchanged);
+    CHECK_EQ(*unchanged, 12);
+    CHECK(instance.getNodeValue("bound"));
+
+    checkErrorCode(instance.getNodeValue("missing"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(instance.setNodeValue("product", 1), SF_ERR_NODE_TYPE_MISMATCH);
+    // hidden nodes stay hidden
+    for (std::size_t i = 0; i < 4; ++i) {
+        checkErrorCode(instance.getNodeValue(std::format("${}", i)), SF_ERR_NODE_NOT_FOUND);
+    }
+}
+
+TEST_CASE("sheet instances reevaluate impure formulas") {
+    StatKernel kernel;
+    double ticks = 0;
+    CHECK(kernel.registerFunction(
+        "tick", [&ticks](std::span<double const>) { return ++ticks; }, 0, 0, false));
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("pure", "<a> * 2"));
+    CHECK(kernel.createFormulaNode("impure", "tick() + <a>"));
+
+    auto sheet = kernel.compileSheet();
+    REQUIRE(sheet);
+    statkernel::SheetInstance instance{*sheet};
+    auto const compiled = instance.getNodeValue("impure");
+    REQUIRE(compiled);
+
+    instance.evaluate();
+    auto const evaluated = instance.getNodeValue("impure");
+    REQUIRE(evaluated);
+    CHECK_EQ(*evaluated, ticks + 1);
+    CHECK_GT(*evaluated, *compiled);
+
+    // only once per change, reading it again doesn't call it
+    auto const before = ticks;
+    CHECK(instance.setNodeValue("a", 5));
+    auto const changed = instance.getNodeValue("impure");
+    REQUIRE(changed);
+    CHECK_EQ(*changed, before + 6);
+    CHECK(instance.getNodeValue("impure"));
+    CHECK_EQ(ticks, before + 1);
+    auto const pure = instance.getNodeValue("pure");
+    REQUIRE(pure);
+    CHECK_EQ(*pure, 10);
+}
+
+TEST_CASE("sheet c api") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 2), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "f", "<a> * 3"), SF_OK);
+
+    auto* sheet = sf_compile_sheet(engine);
+    REQUIRE(sheet != nullptr);
+    auto* first = sf_create_sheet_instance(sheet);
+    auto* second = sf_create_sheet_instance(sheet);
+    // instances keep the sheet alive
+    sf_release_sheet(sheet);
+    sf_destroy_engine(engine);
+
+    CHECK_EQ(sf_set_instance_value(first, "a", 5), SF_OK);
+    double value = 0;
+    CHECK_EQ(sf_get_instance_value(first, "f", &value), SF_OK);
+    CHECK_EQ(value, 15);
+    CHECK_EQ(sf_get_instance_value(second, "f", &value), SF_OK);
+    CHECK_EQ(value, 6);
+
+    CHECK_EQ(sf_set_instance_value(first, "f", 1), SF_ERR_NODE_TYPE_MISMATCH);
+    CHECK_EQ(std::string{sf_instance_last_error(first)},
+             R"(Trying to change value of non value node "f")");
+    CHECK_EQ(sf_get_instance_value(first, "missing", &value), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(sf_get_instance_value(nullptr, "f", &value), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(sf_get_instance_value(first, "f", nullptr), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(sf_create_sheet_instance(nullptr), nullptr);
+    CHECK_EQ(sf_compile_sheet(nullptr), nullptr);
+
+    sf_destroy_sheet_instance(first);
+    sf_destroy_sheet_instance(second);
+}
+
+TEST_CASE("entity batches match single instances") {
+    StatKernel kernel;
+    buildSheet(kernel);
+    CHECK(kernel.createCollectionNode("average", {"a", "b", "sum"}, SF_COLLECTION_OP_AVERAGE));
+    CHECK(kernel.createCollectionNode("count", {"a", "b"}, SF_COLLECTION_OP_COUNT));
+
+    auto sheet = kernel.compileSheet();
+    REQUIRE(sheet);
+    constexpr std::size_t entities = 37;
+    statkernel::SheetBatch batch{*sheet, entities};
+    std::vector<statkernel::SheetInstance> instances(entities, statkernel::SheetInstance{*sheet});
+
+    std::array<NodeId, 4> const inputs{"a", "b", "flag", "gate"};
+    for (int round = 0; round < 4; ++round) {
+        // every third entity stays untouched per round
+        for (std::size_t entity = 0; entity < entities; ++entity) {
+            if ((entity + round) % 3 == 0) {
+                continue;
+            }
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                auto const value = static_cast<NodeValue>((entity * 7 + i * 3 + round) % 5) - 1;
+                CHECK(batch.setNodeValue(entity, inputs[i], value));
+                CHECK(instances[entity].setNodeValue(inputs[i], value));
+            }
+        }
+        if (round % 2 == 0) {
+            batch.evaluate();
+        }
+
+        for (std::size_t entity = 0; entity < entities; ++entity) {
+            for (auto const& id : {"sum", "gated", "modified", "bound", "average", "count"}) {
+                auto expected = instances[entity].getNodeValue(id);
+                auto actual = batch.getNodeValue(entity, id);
+                REQUIRE(expected);
+                REQUIRE(actual);
+                CHECK_EQ(*actual, *expected);
+            }
+        }
+    }
+
+    auto const index = sheet.value()->find("count");
+    REQUIRE(index);
+    auto const counts = batch.column(*index);
+    CHECK_EQ(counts.size(), entities);
+    CHECK(std::ranges::all_of(counts, [](NodeValue count) { return count == 2; }));
+
+    checkErrorCode(batch.getNodeValue(entities, "a"), SF_ERR_INVALID_ENTITY);
+    checkErrorCode(batch.setNodeValue(0, "sum", 1), SF_ERR_NODE_TYPE_MISMATCH);
+    checkErrorCode(batch.getNodeValue(0, "missing"), SF_ERR_NODE_NOT_FOUND);
+}
+
+TEST_CASE("entity batch apis") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 2), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "f", "<a> * 3"), SF_OK);
+
+    auto* batch = sf_create_entity_batch(engine, 4);
+    REQUIRE(batch != nullptr);
+    sf_destroy_engine(engine);
+    CHECK_EQ(sf_set_entity_value(batch, 2, "a", 5), SF_OK);
+    sf_evaluate_entity_batch(batch);
+    double value = 0;
+    CHECK_EQ(sf_get_entity_value(batch, 2, "f", &value), SF_OK);
+    CHECK_EQ(value, 15);
+    CHECK_EQ(sf_get_entity_value(batch, 3, "f", &value), SF_OK);
+    CHECK_EQ(value, 6);
+    CHECK_EQ(sf_get_entity_value(batch, 4, "f", &value), SF_ERR_INVALID_ENTITY);
+    CHECK_EQ(std::string{sf_entity_batch_last_error(batch)},
+             "Trying to access entity 4 of a batch of 4 entities");
+    CHECK_EQ(sf_set_entity_value(nullptr, 0, "a", 1), SF_ERR_INVALID_ENGINE_HANDLE);
+    sf_destroy_entity_batch(batch);
+
+    Engine cppEngine;
+    CHECK_EQ(cppEngine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(cppEngine.createFormulaNode("f", "<a> + 1"), SF_OK);
+    auto entities = cppEngine.createEntityBatch(3);
+    REQUIRE(entities);
+    CHECK_EQ(entities->entities(), 3);
+    CHECK_EQ(entities->setNodeValue(1, "a", 10), SF_OK);
+    CHECK_EQ(entities->getNodeValue(1, "f", value), SF_OK);
+    CHECK_EQ(value, 11);
+    CHECK_EQ(entities->getNodeValue(0, "f", value), SF_OK);
+    CHECK_EQ(value, 2);
+    CHECK_EQ(entities->setNodeValue(0, "f", 1), SF_ERR_NODE_TYPE_MISMATCH);
+    CHECK_EQ(entities->getLastError(), R"(Trying to change value of non value node "f")");
+    CHECK(entities->getLastError().empty());
+}
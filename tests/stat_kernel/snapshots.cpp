@@ -0,0 +1,190 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "api/cpp.hpp"
+#include "stat_kernel/snapshot.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cmath>
+#include <format>
+#include <string>
+#include <thread>
+
+using namespace statforge;
+
+TEST_CASE("snapshots keep the values they were published with") {
+    StatKernel kernel;
+    CHECK_FALSE(kernel.latestSnapshot());
+
+    CHECK(kernel.createValueNode("a", 2));
+    CHECK(kernel.createFormulaNode("f", "<a> * 3"));
+    CHECK(kernel.publishSnapshot());
+    auto first = kernel.latestSnapshot();
+    REQUIRE(first);
+    CHECK_EQ(first->version(), 1);
+    auto const a = first->find("a");
+    auto const f = first->find("f");
+    REQUIRE(a);
+    REQUIRE(f);
+    CHECK_EQ(first->value(*f), 6);
+
+    CHECK(kernel.setNodeValue("a", 4));
+    CHECK(kernel.publishSnapshot());
+    auto second = kernel.latestSnapshot();
+    REQUIRE(second);
+    CHECK_EQ(second->version(), 2);
+    CHECK_EQ(second->find("f"), f);
+    CHECK_EQ(second->value(*f), 12);
+    CHECK_EQ(first->value(*f), 6);
+
+    // removed nodes keep their handle, added ones get new handles
+    CHECK(kernel.removeNode("f"));
+    CHECK(kernel.createValueNode("b", 1));
+    CHECK(kernel.publishSnapshot());
+    auto third = kernel.latestSnapshot();
+    REQUIRE(third);
+    CHECK_FALSE(third->find("f"));
+    CHECK(std::isnan(third->value(*f)));
+    CHECK_EQ(third->find("a"), a);
+    auto const b = third->find("b");
+    REQUIRE(b);
+    CHECK_NE(*b, *f);
+    CHECK_EQ(third->value(*b), 1);
+
+    CHECK(kernel.createFormulaNode("f", "<a> + <b>"));
+    CHECK(kernel.publishSnapshot());
+    auto fourth = kernel.latestSnapshot();
+    REQUIRE(fourth);
+    CHECK_EQ(fourth->find("f"), f);
+    CHECK_EQ(fourth->value(*f), 5);
+    auto const value = fourth->getNodeValue("f");
+    REQUIRE(value);
+    CHECK_EQ(*value, 5);
+    checkErrorCode(fourth->getNodeValue("missing"), SF_ERR_NODE_NOT_FOUND);
+    CHECK(std::isnan(fourth->value(1000)));
+
+    kernel.reset();
+    CHECK_FALSE(kernel.latestSnapshot());
+    CHECK_EQ(fourth->value(*f), 5);
+}
+
+TEST_CASE("snapshots skip hidden nodes") {
+    StatKernel kernel;
+    kernel.setCompileOptions({.eliminateCommonSubexpressions = true});
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createFormulaNode("x", "(<a> + <b>) * (<a> + <b>) + 1"));
+    CHECK(kernel.createFormulaNode("y", "(<a> + <b>) * (<a> + <b>) + 2"));
+    CHECK(kernel.publishSnapshot());
+
+    auto snapshot = kernel.latestSnapshot();
+    REQUIRE(snapshot);
+    auto const y = snapshot->find("y");
+    REQUIRE(y);
+    CHECK_EQ(snapshot->value(*y), 11);
+    for (std::size_t i = 0; i < 4; ++i) {
+        CHECK_FALSE(snapshot->find(std::format("${}", i)));
+    }
+}
+
+TEST_CASE("snapshot buffers are reused once readers release them") {
+    StatKernel kernel;
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.publishSnapshot());
+    auto const* first = kernel.latestSnapshot().get();
+    CHECK(kernel.publishSnapshot());
+    auto const* second = kernel.latestSnapshot().get();
+    CHECK_NE(first, second);
+    CHECK(kernel.publishSnapshot());
+    CHECK_EQ(kernel.latestSnapshot().get(), first);
+
+    // a held snapshot is never overwritten
+    auto held = kernel.latestSnapshot();
+    CHECK(kernel.setNodeValue("a", 2));
+    CHECK(kernel.publishSnapshot());
+    CHECK(kernel.setNodeValue("a", 3));
+    CHECK(kernel.publishSnapshot());
+    CHECK_NE(kernel.latestSnapshot().get(), held.get());
+    CHECK_EQ(held->value(*held->find("a")), 1);
+    CHECK_EQ(held->version(), 3);
+}
+
+TEST_CASE("snapshots are read while the owner keeps publishing") {
+    StatKernel kernel;
+    CHECK(kernel.createValueNode("a", 0));
+    CHECK(kernel.createFormulaNode("twice", "<a> * 2"));
+    CHECK(kernel.publishSnapshot());
+    auto const a = kernel.latestSnapshot()->find("a");
+    auto const twice = kernel.latestSnapshot()->find("twice");
+    REQUIRE(a);
+    REQUIRE(twice);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> inconsistent{0};
+    std::thread reader{[&] {
+        std::uint64_t version = 0;
+        while (!done.load()) {
+            auto snapshot = kernel.latestSnapshot();
+            if (snapshot->value(*twice) != snapshot->value(*a) * 2 ||
+                snapshot->version() < version) {
+                ++inconsistent;
+            }
+            version = snapshot->version();
+        }
+    }};
+    for (int i = 1; i <= 2000; ++i) {
+        CHECK(kernel.setNodeValue("a", i));
+        CHECK(kernel.publishSnapshot());
+    }
+    done = true;
+    reader.join();
+
+    CHECK_EQ(inconsistent.load(), 0);
+    CHECK_EQ(kernel.latestSnapshot()->value(*twice), 4000);
+}
+
+TEST_CASE("snapshot apis") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_acquire_snapshot(engine), nullptr);
+    CHECK_EQ(sf_create_value_node(engine, "a", 2), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "f", "<a> + 1"), SF_OK);
+    CHECK_EQ(sf_publish_snapshot(engine), SF_OK);
+
+    auto* snapshot = sf_acquire_snapshot(engine);
+    REQUIRE(snapshot != nullptr);
+    CHECK_EQ(sf_snapshot_version(snapshot), 1);
+    SF_SnapshotHandle handle = 0;
+    CHECK_EQ(sf_snapshot_find(snapshot, "f", &handle), SF_OK);
+    CHECK_EQ(sf_snapshot_value(snapshot, handle), 3);
+
+    CHECK_EQ(sf_set_node_value(engine, "a", 5), SF_OK);
+    CHECK_EQ(sf_publish_snapshot(engine), SF_OK);
+    CHECK_EQ(sf_snapshot_value(snapshot, handle), 3);
+
+    CHECK_EQ(sf_snapshot_find(nullptr, "f", &handle), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(std::string{sf_last_error()}, "snapshot is null");
+    CHECK(std::isnan(sf_snapshot_value(nullptr, handle)));
+    CHECK_EQ(sf_publish_snapshot(nullptr), SF_ERR_INVALID_ENGINE_HANDLE);
+    CHECK_EQ(sf_acquire_snapshot(nullptr), nullptr);
+
+    CHECK_EQ(sf_snapshot_find(snapshot, "missing", &handle), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(std::string{sf_snapshot_last_error(snapshot)},
+             R"(Trying to find non-existing node "missing")");
+    sf_release_snapshot(snapshot);
+    sf_destroy_engine(engine);
+
+    Engine cppEngine;
+    CHECK_FALSE(cppEngine.latestSnapshot());
+    CHECK_EQ(cppEngine.createValueNode("a", 2), SF_OK);
+    CHECK_EQ(cppEngine.publishSnapshot(), SF_OK);
+    auto latest = cppEngine.latestSnapshot();
+    REQUIRE(latest);
+    CHECK_EQ(latest->version(), 1);
+    auto const a = latest->find("a");
+    REQUIRE(a);
+    CHECK_EQ(latest->value(*a), 2);
+    CHECK_FALSE(latest->find("missing"));
+}
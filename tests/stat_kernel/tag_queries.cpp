@@ -0,0 +1,169 @@
+#include "../test_util.hpp"
+
+#include "api/cpp.hpp"
+#include "stat_kernel/stat_kernel.hpp"
+#include "stat_kernel/tag_query.hpp"
+
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+using namespace statforge;
+using statforge::statkernel::TagQuery;
+
+namespace {
+
+bool matches(std::string_view query, std::vector<std::string> tags) {
+    auto parsed = TagQuery::parse(query);
+    REQUIRE(parsed);
+    return parsed->matches(tags);
+}
+
+} // namespace
+
+TEST_CASE("tag query matching") {
+    CHECK(matches("tag:FlatLife", {"FlatLife"}));
+    CHECK(matches("FlatLife", {"FlatLife", "fire"}));
+    CHECK_FALSE(matches("tag:FlatLife & !disabled", {"FlatLife", "disabled"}));
+    CHECK(matches("tag:FlatLife & !disabled", {"FlatLife", "fire"}));
+    CHECK(matches("(fire | cold) & !disabled", {"cold"}));
+    CHECK_FALSE(matches("(fire | cold) & !disabled", {"lightning"}));
+    CHECK(matches("fire | cold & disabled", {"fire"}));
+    CHECK(matches("!!fire", {"fire"}));
+
+    auto query = TagQuery::parse("a & (b | !a)");
+    REQUIRE(query);
+    CHECK_EQ(query->tags(), std::vector<std::string>{"a", "b"});
+}
+
+TEST_CASE("invalid tag queries") {
+    for (auto const* query : {"", "a &", "(a", "a b", "tag:", "a $ b", "a)", "!"}) {
+        checkErrorCode(TagQuery::parse(query), SF_ERR_INVALID_TAG);
+    }
+
+    // right nested operands are pending while matching, parentheses and negations aren't
+    std::string nested;
+    for (int i = 0; i < 100; ++i) {
+        nested += "a & (";
+    }
+    nested += "a" + std::string(100, ')');
+    checkErrorCode(TagQuery::parse(nested), SF_ERR_INVALID_TAG);
+    CHECK(TagQuery::parse(std::string(100, '(') + "a" + std::string(100, ')')));
+    CHECK(TagQuery::parse(std::string(100, '!') + "a"));
+
+    // rejected as soon as parsing gets too deep, the recursion never runs out of stack
+    for (auto const c : {'!', '('}) {
+        auto const result = TagQuery::parse(std::string(300, c) + "a");
+        checkErrorCode(result, SF_ERR_INVALID_TAG);
+        CHECK_NE(result.error().message.find("nested too deeply at column 258"), std::string::npos);
+    }
+}
+
+TEST_CASE("query collection follows node tags") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("life1", 10));
+    CHECK(kernel.createValueNode("life2", 5));
+    CHECK(kernel.createValueNode("mana", 7));
+    CHECK(kernel.setNodeTags("life1", {"FlatLife"}));
+    CHECK(kernel.setNodeTags("mana", {"FlatMana"}));
+    CHECK(kernel.createQueryCollectionNode("flatLife", "tag:FlatLife & !disabled"));
+    CHECK(kernel.createQueryCollectionNode(
+        "lifeCount", "FlatLife & !disabled", SF_COLLECTION_OP_COUNT));
+    checkValue(kernel, "flatLife", 10.0);
+
+    CHECK(kernel.setNodeTags("life2", {"FlatLife", "FlatLife"}));
+    checkValue(kernel, "flatLife", 15.0);
+    checkValue(kernel, "lifeCount", 2.0);
+
+    CHECK(kernel.setNodeValue("life2", 6));
+    checkValue(kernel, "flatLife", 16.0);
+
+    CHECK(kernel.setNodeTags("life1", {"disabled", "FlatLife"}));
+    checkValue(kernel, "flatLife", 6.0);
+    CHECK(kernel.setNodeTags("life1", {"FlatLife"}));
+    checkValue(kernel, "flatLife", 16.0);
+
+    CHECK(kernel.removeNode("life2"));
+    checkValue(kernel, "flatLife", 10.0);
+    checkValue(kernel, "lifeCount", 1.0);
+
+    CHECK(kernel.setNodeTags("life1", {}));
+    checkValue(kernel, "flatLife", 0.0);
+}
+
+TEST_CASE("query collection members") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createValueNode("b", 2));
+    CHECK(kernel.createValueNode("untagged", 100));
+    CHECK(kernel.setNodeTags("a", {"fire"}));
+
+    // queries without positive tags only match tagged nodes and never the collection itself
+    CHECK(kernel.createQueryCollectionNode("enabled", "!disabled"));
+    CHECK(kernel.setNodeTags("enabled", {"total"}));
+    checkValue(kernel, "enabled", 1.0);
+    CHECK(kernel.setNodeTags("b", {"cold"}));
+    checkValue(kernel, "enabled", 3.0);
+
+    // members that weren't evaluated before they joined
+    CHECK(kernel.createFormulaNode("doubled", "<b> * 2"));
+    CHECK(kernel.createQueryCollectionNode("fire", "fire", SF_COLLECTION_OP_MAX));
+    CHECK(kernel.setNodeTags("doubled", {"fire"}));
+    checkValue(kernel, "fire", 4.0);
+    CHECK(kernel.setNodeValue("b", 0.25));
+    checkValue(kernel, "fire", 1.0);
+
+    // nested query collections
+    CHECK(kernel.createQueryCollectionNode("totals", "total"));
+    checkValue(kernel, "totals", 1.75);
+
+    CHECK(kernel.removeNode("enabled"));
+    checkValue(kernel, "totals", 0.0);
+    CHECK(kernel.setNodeTags("untagged", {"cold"}));
+    CHECK(kernel.createQueryCollectionNode("cold", "cold"));
+    checkValue(kernel, "cold", 100.25);
+}
+
+TEST_CASE("node tag errors") {
+    StatKernel kernel;
+
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createQueryCollectionNode("x", "x"));
+    CHECK(kernel.createQueryCollectionNode("y", "y"));
+    CHECK(kernel.setNodeTags("x", {"y"}));
+    CHECK(kernel.setNodeTags("a", {"x", "y"}));
+    checkValue(kernel, "y", 2.0);
+
+    checkErrorCode(kernel.setNodeTags("a", {"not valid"}), SF_ERR_INVALID_TAG);
+    checkErrorCode(kernel.setNodeTags("missing", {"x"}), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.createQueryCollectionNode("z", "x &"), SF_ERR_INVALID_TAG);
+    checkErrorCode(kernel.getNodeValue("z"), SF_ERR_NODE_NOT_FOUND);
+    checkErrorCode(kernel.setNodeDependencies("x", {"a"}), SF_ERR_NODE_TYPE_MISMATCH);
+
+    // y already contains x, x can't contain y. membership stays as it was
+    checkErrorCode(kernel.setNodeTags("y", {"x"}), SF_ERR_DEPENDENCY_LOOP);
+    CHECK(kernel.setNodeValue("a", 3));
+    checkValue(kernel, "x", 3.0);
+    checkValue(kernel, "y", 6.0);
+}
+
+TEST_CASE("engine query collection") {
+    Engine engine;
+
+    CHECK_EQ(engine.createValueNode("a", 1), SF_OK);
+    CHECK_EQ(engine.createValueNode("b", 2), SF_OK);
+    CHECK_EQ(engine.createQueryCollectionNode("sum", "tag:FlatLife", SF_COLLECTION_OP_SUM), SF_OK);
+    CHECK_EQ(engine.setNodeTags("a", "FlatLife, fire"), SF_OK);
+    CHECK_EQ(engine.setNodeTags("b", "FlatLife"), SF_OK);
+
+    double value{};
+    CHECK_EQ(engine.getNodeValue("sum", value), SF_OK);
+    CHECK_EQ(value, 3);
+
+    CHECK_EQ(engine.setNodeTags("a", ""), SF_OK);
+    CHECK_EQ(engine.getNodeValue("sum", value), SF_OK);
+    CHECK_EQ(value, 2);
+}
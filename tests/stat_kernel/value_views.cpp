@@ -0,0 +1,101 @@
+#include "../test_util.hpp"
+
+#include "api/c.h"
+#include "stat_kernel/stat_kernel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <format>
+#include <string>
+
+using namespace statforge;
+
+TEST_CASE("value views follow evaluations") {
+    StatKernel kernel;
+    CHECK(kernel.createValueNode("a", 1));
+    CHECK(kernel.createFormulaNode("f", "<a> * 2"));
+    CHECK(kernel.cleanEpoch() % 2 == 1);
+
+    auto view = kernel.getNodeValueView("f");
+    REQUIRE(view);
+    CHECK(kernel.evaluate());
+    auto const clean = kernel.cleanEpoch();
+    CHECK(clean % 2 == 0);
+    CHECK_EQ(**view, 2);
+
+    // unchanged values don't touch the epoch
+    CHECK(kernel.setNodeValue("a", 1));
+    CHECK_EQ(kernel.cleanEpoch(), clean);
+
+    CHECK(kernel.setNodeValue("a", 4));
+    CHECK_EQ(kernel.cleanEpoch(), clean + 1);
+    CHECK(kernel.setNodeValue("a", 5));
+    CHECK_EQ(kernel.cleanEpoch(), clean + 1);
+    CHECK(kernel.evaluate());
+    CHECK_EQ(kernel.cleanEpoch(), clean + 2);
+    CHECK_EQ(**view, 10);
+
+    // other nodes don't move existing values
+    for (int i = 0; i < 1000; ++i) {
+        CHECK(kernel.createFormulaNode(std::format("g{}", i), "<f> + 1"));
+    }
+    auto again = kernel.getNodeValueView("f");
+    REQUIRE(again);
+    CHECK_EQ(*again, *view);
+    CHECK(kernel.evaluate());
+    checkValue(kernel, "g999", 11.0);
+
+    checkErrorCode(kernel.getNodeValueView("missing"), SF_ERR_NODE_NOT_FOUND);
+}
+
+TEST_CASE("evaluation reaches dependencies no branch reads") {
+    StatKernel kernel;
+    CHECK(kernel.createValueNode("Flag", 1));
+    CHECK(kernel.createValueNode("Other", 1));
+    CHECK(kernel.createFormulaNode("Inner", "<Other> + 1"));
+    CHECK(kernel.createFormulaNode("Outer", "<Flag> ? <Inner> : 0"));
+    auto inner = kernel.getNodeValueView("Inner");
+    REQUIRE(inner);
+    CHECK(kernel.evaluate());
+    CHECK_EQ(**inner, 2);
+
+    // "Outer" stops reading "Inner" while it's dirty
+    CHECK(kernel.setNodeValue("Other", 7));
+    CHECK(kernel.setNodeValue("Flag", 0));
+    CHECK(kernel.evaluate());
+    CHECK(kernel.cleanEpoch() % 2 == 0);
+    CHECK_EQ(**inner, 8);
+
+    // unread, so only "Inner" is dirtied
+    CHECK(kernel.setNodeValue("Other", 2));
+    CHECK(kernel.evaluate());
+    CHECK_EQ(**inner, 3);
+    checkValue(kernel, "Outer", 0.0);
+}
+
+TEST_CASE("value views c api") {
+    auto* engine = sf_create_engine();
+    CHECK_EQ(sf_create_value_node(engine, "a", 2), SF_OK);
+    CHECK_EQ(sf_create_formula_node(engine, "f", "<a> * 3"), SF_OK);
+
+    const double* view = nullptr;
+    CHECK_EQ(sf_get_node_value_view(engine, "f", &view), SF_OK);
+    REQUIRE(view != nullptr);
+    sf_evaluate_engine(engine);
+    auto const epoch = sf_get_clean_epoch(engine);
+    CHECK(epoch % 2 == 0);
+    CHECK_EQ(*view, 6);
+
+    CHECK_EQ(sf_set_node_value(engine, "a", 3), SF_OK);
+    CHECK_NE(sf_get_clean_epoch(engine), epoch);
+    sf_evaluate_engine(engine);
+    CHECK_EQ(*view, 9);
+
+    CHECK_EQ(sf_get_node_value_view(engine, "missing", &view), SF_ERR_NODE_NOT_FOUND);
+    CHECK_EQ(std::string{sf_engine_last_error(engine)},
+             R"(Trying to view value of non-existing node "missing")");
+    CHECK_EQ(sf_get_node_value_view(engine, "f", nullptr), SF_ERR_INTERNAL_INVALID_ENGINE_STATE);
+    CHECK_EQ(sf_get_clean_epoch(nullptr), 0);
+
+    sf_destroy_engine(engine);
+}